@@ -17,6 +17,9 @@ If you want to use it in a program you sell, contact me
 
 This software comes with absolutely no warranty.
 
+Changes: added RProgram, a flat compiled form of ROperation with inlined
+numbers and folded constant subtrees (math-parser-benchmark-project).
+
 */
 
 #include"mathexpr.h"
@@ -999,69 +1002,87 @@ const double sqrtmaxfloat=sqrt(DBL_MAX);
 const double sqrtminfloat=sqrt(DBL_MIN);
 const double inveps=.1/DBL_EPSILON;
 
-void  Addition(double*&p)
-{if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat){*(--p)=ErrVal;return;};
-if(*(--p)==ErrVal||fabsl(*p)>sqrtmaxfloat){*p=ErrVal;return;};
-*p+=(*(p+1));}
-void  Soustraction(double*&p)
-{if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat){*(--p)=ErrVal;return;};
-if(*(--p)==ErrVal||fabsl(*p)>sqrtmaxfloat){*p=ErrVal;return;};
-*p-=(*(p+1));}
-void  Multiplication(double*&p)
-{if(fabsl(*p)<sqrtminfloat){*--p=0;return;};
-if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat){*(--p)=ErrVal;return;};
-if(fabsl(*(--p))<sqrtminfloat){*p=0;return;};
-if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat){*p=ErrVal;return;};
-*p*=(*(p+1));}
-void  Division(double*&p)
-{if(fabsl(*p)<sqrtminfloat||*p==ErrVal||fabsl(*p)>sqrtmaxfloat)
-	{*(--p)=ErrVal;return;};
-if(fabsl(*(--p))<sqrtminfloat)*p=0;else if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat)
-	{*p=ErrVal;return;};
-*p/=(*(p+1));}
-void  Puissance(double*&p)
-{double v2=*p--,v1=*p;
-if(!v1){*p=0;return;};
-if(v2==ErrVal||v1==ErrVal||fabsl(v2*logl(fabsl(v1)))>DBL_MAX_EXP){*p=ErrVal;return;};
-*p=((v1>0||!fmodl(v2,1))?powl(v1,v2):ErrVal);}
-void  RacineN(double*&p)
-{double v2=*p--,v1=*p;
-if(v1==ErrVal||v2==ErrVal||!v1||v2*logl(fabsl(v1))<DBL_MIN_EXP){*p=ErrVal;return;};
-if(v2>=0){*p=powl(v2,1/v1);return;};
-*p=((fabsl(fmodl(v1,2))==1)?-powl(-v2,1/v1):ErrVal);}
-void  Puiss10(double*&p)
-{if(fabsl(*p)<sqrtminfloat){*(--p)=0;return;};
-if(*p==ErrVal||fabsl(*p)>DBL_MAX_10_EXP){*(--p)=ErrVal;return;};
-if(fabsl(*(--p))<sqrtminfloat)*p=0;else if(*p==ErrVal||fabsl(*p)>sqrtmaxfloat)
-{*p=ErrVal;return;};
-*p*=pow10l(*(p+1));}
-void  ArcTangente2(double*&p)
-{if(*p==ErrVal||fabsl(*p)>inveps){*(--p)=ErrVal;return;};
-if(*(--p)==ErrVal||fabsl(*p)>inveps){*p=ErrVal;return;};
-*p=(*p||*(p+1)?atan2(*p,*(p+1)):ErrVal);}
+// The operators on values, v1 being the first and v2 the second operand.
+// They are shared by the pfoncld code of ROperation and by RProgram
+
+static inline double VAddition(double v1,double v2)
+{if(v2==ErrVal||fabsl(v2)>sqrtmaxfloat)return ErrVal;
+if(v1==ErrVal||fabsl(v1)>sqrtmaxfloat)return ErrVal;
+return v1+v2;}
+static inline double VSoustraction(double v1,double v2)
+{if(v2==ErrVal||fabsl(v2)>sqrtmaxfloat)return ErrVal;
+if(v1==ErrVal||fabsl(v1)>sqrtmaxfloat)return ErrVal;
+return v1-v2;}
+static inline double VMultiplication(double v1,double v2)
+{if(fabsl(v2)<sqrtminfloat)return 0;
+if(v2==ErrVal||fabsl(v2)>sqrtmaxfloat)return ErrVal;
+if(fabsl(v1)<sqrtminfloat)return 0;
+if(v1==ErrVal||fabsl(v1)>sqrtmaxfloat)return ErrVal;
+return v1*v2;}
+static inline double VDivision(double v1,double v2)
+{if(fabsl(v2)<sqrtminfloat||v2==ErrVal||fabsl(v2)>sqrtmaxfloat)return ErrVal;
+if(fabsl(v1)<sqrtminfloat)v1=0;else if(v1==ErrVal||fabsl(v1)>sqrtmaxfloat)return ErrVal;
+return v1/v2;}
+static inline double VPuissance(double v1,double v2)
+{if(!v1)return 0;
+if(v2==ErrVal||v1==ErrVal||fabsl(v2*logl(fabsl(v1)))>DBL_MAX_EXP)return ErrVal;
+return ((v1>0||!fmodl(v2,1))?powl(v1,v2):ErrVal);}
+static inline double VRacineN(double v1,double v2)
+{if(v1==ErrVal||v2==ErrVal||!v1||v2*logl(fabsl(v1))<DBL_MIN_EXP)return ErrVal;
+if(v2>=0)return powl(v2,1/v1);
+return ((fabsl(fmodl(v1,2))==1)?-powl(-v2,1/v1):ErrVal);}
+static inline double VPuiss10(double v1,double v2)
+{if(fabsl(v2)<sqrtminfloat)return 0;
+if(v2==ErrVal||fabsl(v2)>DBL_MAX_10_EXP)return ErrVal;
+if(fabsl(v1)<sqrtminfloat)v1=0;else if(v1==ErrVal||fabsl(v1)>sqrtmaxfloat)return ErrVal;
+return v1*pow10l(v2);}
+static inline double VArcTangente2(double v1,double v2)
+{if(v2==ErrVal||fabsl(v2)>inveps)return ErrVal;
+if(v1==ErrVal||fabsl(v1)>inveps)return ErrVal;
+return (v1||v2?atan2(v1,v2):ErrVal);}
+static inline double VAbsolu(double v){return ((v==ErrVal)?ErrVal:fabsl(v));}
+static inline double VOppose(double v){return ((v==ErrVal)?ErrVal:-v);}
+static inline double VArcSinus(double v)
+{return ((v==ErrVal||fabsl(v)>1)?ErrVal:asinl(v));}
+static inline double VArcCosinus(double v)
+{return ((v==ErrVal||fabsl(v)>1)?ErrVal:acosl(v));}
+static inline double VArcTangente(double v)
+{return ((v==ErrVal)?ErrVal:atanl(v));}
+static inline double VLogarithme(double v)
+{return ((v==ErrVal||v<=0)?ErrVal:logl(v));}
+static inline double VExponentielle(double v)
+{return ((v==ErrVal||v>DBL_MAX_EXP)?ErrVal:expl(v));}
+static inline double VSinus(double v)
+{return ((v==ErrVal||fabsl(v)>inveps)?ErrVal:sinl(v));}
+static inline double VTangente(double v)
+{return ((v==ErrVal||fabsl(v)>inveps)?ErrVal:tanl(v));}
+static inline double VCosinus(double v)
+{return ((v==ErrVal||fabsl(v)>inveps)?ErrVal:cosl(v));}
+static inline double VRacine(double v)
+{return ((v==ErrVal||v>sqrtmaxfloat||v<0)?ErrVal:sqrtl(v));}
+
+void  Addition(double*&p){double v2=*p--;*p=VAddition(*p,v2);}
+void  Soustraction(double*&p){double v2=*p--;*p=VSoustraction(*p,v2);}
+void  Multiplication(double*&p){double v2=*p--;*p=VMultiplication(*p,v2);}
+void  Division(double*&p){double v2=*p--;*p=VDivision(*p,v2);}
+void  Puissance(double*&p){double v2=*p--;*p=VPuissance(*p,v2);}
+void  RacineN(double*&p){double v2=*p--;*p=VRacineN(*p,v2);}
+void  Puiss10(double*&p){double v2=*p--;*p=VPuiss10(*p,v2);}
+void  ArcTangente2(double*&p){double v2=*p--;*p=VArcTangente2(*p,v2);}
 void  NextVal(double*&){}
 void  RFunc(double*&){}
 void  JuxtF(double*&){}
-void  Absolu(double*&p){*p=((*p==ErrVal)?ErrVal:fabsl(*p));}
-void  Oppose(double*&p){*p=((*p==ErrVal)?ErrVal:-*p);}
-void  ArcSinus(double*&p)
-{*p=((*p==ErrVal||fabsl(*p)>1)?ErrVal:asinl(*p));}
-void  ArcCosinus(double*&p)
-{*p=((*p==ErrVal||fabsl(*p)>1)?ErrVal:acosl(*p));}
-void  ArcTangente(double*&p)
-{*p=((*p==ErrVal)?ErrVal:atanl(*p));}
-void  Logarithme(double*&p)
-{*p=((*p==ErrVal||*p<=0)?ErrVal:logl(*p));}
-void  Exponentielle(double*&p)
-{*p=((*p==ErrVal||*p>DBL_MAX_EXP)?ErrVal:expl(*p));}
-void  Sinus(double*&p)
-{*p=((*p==ErrVal||fabsl(*p)>inveps)?ErrVal:sinl(*p));}
-void  Tangente(double*&p)
-{*p=((*p==ErrVal||fabsl(*p)>inveps)?ErrVal:tanl(*p));}
-void  Cosinus(double*&p)
-{*p=((*p==ErrVal||fabsl(*p)>inveps)?ErrVal:cosl(*p));}
-void  Racine(double*&p)
-{*p=((*p==ErrVal||*p>sqrtmaxfloat||*p<0)?ErrVal:sqrtl(*p));}
+void  Absolu(double*&p){*p=VAbsolu(*p);}
+void  Oppose(double*&p){*p=VOppose(*p);}
+void  ArcSinus(double*&p){*p=VArcSinus(*p);}
+void  ArcCosinus(double*&p){*p=VArcCosinus(*p);}
+void  ArcTangente(double*&p){*p=VArcTangente(*p);}
+void  Logarithme(double*&p){*p=VLogarithme(*p);}
+void  Exponentielle(double*&p){*p=VExponentielle(*p);}
+void  Sinus(double*&p){*p=VSinus(*p);}
+void  Tangente(double*&p){*p=VTangente(*p);}
+void  Cosinus(double*&p){*p=VCosinus(*p);}
+void  Racine(double*&p){*p=VRacine(*p);}
 void FonctionError(double*&p){*p=ErrVal;}
 inline void ApplyRFunc(PRFunction rf,double*&p)
 {p-=rf->nvars-1;*p=rf->Val(p);}
@@ -1076,6 +1097,150 @@ double ROperation::Val() const
   return *p3;
 }
 
+// RProgram : the instructions are executed by the same operators on values
+// as the pfoncld code of ROperation, dispatched by a switch
+
+static int RPNodes(const ROperation&o)
+{return 1+(o.mmb1!=NULL?RPNodes(*o.mmb1):0)+(o.mmb2!=NULL?RPNodes(*o.mmb2):0);}
+
+// v is the last operand, taken from the instruction or from the stack
+static double RPExec(const RInstr*p,const RInstr*pend,double*s)
+{
+  double*sp=s-1,v;
+  for(;p<pend;p++){
+    if(!p->narg){*(++sp)=*p->pval;continue;}
+    v=(p->pval!=NULL?*p->pval:*sp--);
+    switch(p->op){
+    case Add:*sp=VAddition(*sp,v);break;
+    case Sub:*sp=VSoustraction(*sp,v);break;
+    case Mult:*sp=VMultiplication(*sp,v);break;
+    case Div:*sp=VDivision(*sp,v);break;
+    case Pow:*sp=VPuissance(*sp,v);break;
+    case NthRoot:*sp=VRacineN(*sp,v);break;
+    case E10:*sp=VPuiss10(*sp,v);break;
+    case Atan:if(p->narg>1)*sp=VArcTangente2(*sp,v);else *(++sp)=VArcTangente(v);break;
+    case Opp:*(++sp)=VOppose(v);break;
+    case Sin:*(++sp)=VSinus(v);break;
+    case Sqrt:*(++sp)=VRacine(v);break;
+    case Ln:*(++sp)=VLogarithme(v);break;
+    case Exp:*(++sp)=VExponentielle(v);break;
+    case Cos:*(++sp)=VCosinus(v);break;
+    case Tg:*(++sp)=VTangente(v);break;
+    case Asin:*(++sp)=VArcSinus(v);break;
+    case Acos:*(++sp)=VArcCosinus(v);break;
+    case Abs:*(++sp)=VAbsolu(v);break;
+    case Fun:{*(++sp)=v;double*q=sp;ApplyRFunc(p->pfunc,q);sp=q;}break;
+    default:*(++sp)=ErrVal;
+    }
+  }
+  return *sp;
+}
+
+// Emits the code of o at code[n]. Returns 1 if it does not depend on
+// variables or functions. depth/maxdepth track the stack size
+static signed char RPEmit(const ROperation&o,RInstr*code,int&n,int&depth,int&maxdepth)
+{
+  RInstr ins;ins.op=o.op;ins.narg=1;ins.val=0;ins.pval=NULL;ins.pfunc=NULL;
+  signed char c=1;int n0=n,n2=n;
+  switch(o.op){
+  case Num:case ErrOp:
+    if(o.op==Num||o.mmb2==NULL){
+      ins.op=Num;ins.narg=0;ins.val=(o.op==Num?o.ValC:ErrVal);ins.pval=&code[n].val;
+      code[n++]=ins;if(++depth>maxdepth)maxdepth=depth;return 1;
+    }
+    n2=n;c=RPEmit(*o.mmb2,code,n,depth,maxdepth);break;
+  case Var:
+    ins.narg=0;ins.pval=o.pvarval;
+    code[n++]=ins;if(++depth>maxdepth)maxdepth=depth;return 0;
+  case Juxt:  // Leaves both members on the stack
+    c=RPEmit(*o.mmb1,code,n,depth,maxdepth);
+    c=RPEmit(*o.mmb2,code,n,depth,maxdepth)&&c;
+    return c;
+  case Add:case Sub:case Mult:case Div:case Pow:case NthRoot:case E10:
+    c=RPEmit(*o.mmb1,code,n,depth,maxdepth);
+    n2=n;c=RPEmit(*o.mmb2,code,n,depth,maxdepth)&&c;
+    ins.narg=2;break;
+  case Atan:
+    n2=n;c=RPEmit(*o.mmb2,code,n,depth,maxdepth);
+    ins.narg=(o.mmb2->NMembers()>1?2:1);break;
+  case Fun:
+    n2=n;RPEmit(*o.mmb2,code,n,depth,maxdepth);
+    ins.pfunc=o.pfunc;ins.narg=o.pfunc->nvars;c=0;break;
+  case Opp:case Sqrt:case Abs:case Sin:case Cos:case Tg:
+  case Ln:case Exp:case Acos:case Asin:
+    n2=n;c=RPEmit(*o.mmb2,code,n,depth,maxdepth);break;
+  default:
+    n2=n;c=RPEmit(*o.mmb2,code,n,depth,maxdepth);ins.op=ErrOp;
+  }
+  code[n++]=ins;depth-=ins.narg-1;
+  if(c){  // Constant subtree, replace its code by its value
+    double*s=new double[maxdepth+1];
+    ins.op=Num;ins.narg=0;ins.val=RPExec(code+n0,code+n,s);ins.pfunc=NULL;
+    delete[]s;
+    n=n0;ins.pval=&code[n].val;code[n++]=ins;
+  }
+  else if(n-n2==2&&!code[n2].narg){
+    // The last operand is a single push, let the operation read it
+    ins.val=code[n2].val;ins.pval=(code[n2].op==Num?&code[n2].val:code[n2].pval);
+    n=n2;code[n++]=ins;
+  }
+  return c;
+}
+
+// Copy code, numbers are read through pointers into the code itself
+static void RPCopy(RInstr*dst,const RInstr*src,int n)
+{
+  memcpy(dst,src,n*sizeof(RInstr));
+  int i;
+  for(i=0;i<n;i++)if(src[i].pval==&src[i].val)dst[i].pval=&dst[i].val;
+}
+
+RProgram::RProgram()
+{pcode=NULL;ncode=0;pstack=NULL;nstack=0;}
+
+RProgram::RProgram(const ROperation&op)
+{pcode=NULL;ncode=0;pstack=NULL;nstack=0;Compile(op);}
+
+RProgram::RProgram(const RProgram&prog)
+{pcode=NULL;ncode=0;pstack=NULL;nstack=0;*this=prog;}
+
+RProgram::~RProgram()
+{Destroy();}
+
+void RProgram::Destroy()
+{
+  if(pcode!=NULL){delete[]pcode;pcode=NULL;}
+  if(pstack!=NULL){delete[]pstack;pstack=NULL;}
+  ncode=nstack=0;
+}
+
+RProgram& RProgram::operator=(const RProgram&prog)
+{
+  if(this==&prog)return *this;
+  Destroy();
+  ncode=prog.ncode;nstack=prog.nstack;
+  if(ncode){pcode=new RInstr[ncode];RPCopy(pcode,prog.pcode,ncode);}
+  if(nstack)pstack=new double[nstack];
+  return *this;
+}
+
+void RProgram::Compile(const ROperation&op)
+{
+  Destroy();
+  RInstr*code=new RInstr[RPNodes(op)];
+  int n=0,depth=0,maxdepth=0;
+  RPEmit(op,code,n,depth,maxdepth);
+  pcode=new RInstr[n];RPCopy(pcode,code,n);ncode=n;
+  delete[]code;
+  nstack=(maxdepth>0?maxdepth:1);pstack=new double[nstack];
+}
+
+double RProgram::Val() const
+{
+  if(!ncode)return ErrVal;
+  return RPExec(pcode,pcode+ncode,pstack);
+}
+
 void BCDouble(pfoncld*&pf,pfoncld*pf1,pfoncld*pf2,
 	      double**&pv,double**pv1,double**pv2,
 	      double*&pp,double*pp1,double*pp2,
@@ -17,6 +17,9 @@ If you want to use it in a program you sell, contact me
 
 This software comes with absolutely no warranty.
 
+Changes: added RProgram, a flat compiled form of ROperation with inlined
+numbers and folded constant subtrees (math-parser-benchmark-project).
+
 */
 
 #ifndef _MATHEXPR_H
@@ -142,6 +145,35 @@ public:
   ROperation operator()(const ROperation&);
 };
 
+// Flat compiled form of an ROperation : one contiguous postfix instruction
+// stream using the ROperator codes, numbers inlined, subtrees without
+// variables or functions folded into a number. An operation whose last
+// operand is a number or a variable reads it itself through pval, which
+// saves one instruction. Evaluation gives the same values as
+// ROperation::Val() and does not allocate.
+// The variables and functions of the operation must outlive the program.
+struct RInstr{
+  ROperator op;
+  int narg;           // Values taken from the stack, 0 for Num and Var
+  double val;         // Inlined number
+  const double*pval;  // Num, Var : value to push. Others : last operand or NULL
+  RFunction*pfunc;
+};
+
+class RProgram{
+  RInstr*pcode;int ncode;
+  double*pstack;int nstack;
+  void Destroy();
+ public:
+  RProgram();
+  RProgram(const ROperation&);
+  RProgram(const RProgram&);
+  ~RProgram();
+  RProgram& operator=(const RProgram&);
+  void Compile(const ROperation&);
+  double Val() const;
+  int NInstr() const {return ncode;};
+};
 
 char* MidStr(const char*s,int i1,int i2);
 char* CopyStr(const char*s);
@@ -137,6 +137,18 @@ size_t ATMSP<T>::parse(ATMSB<T> &bc, const std::string &exps, const std::string
 	return noErr;
 }
 
+// Parse into a temporary bytecode and fuse it. Only the program is kept
+#if !defined(COMPLEX)
+template <typename T>
+size_t ATMSP<T>::parse(ATMSB_FUSED<T> &prog, const std::string &exps, const std::string &vars) {
+
+	ATMSB<T> bc;
+	size_t err = parse(bc, exps, vars);
+	if ( err ) return err;
+	return prog.fuse(bc, varLst.size()) ? noErr : funErr;
+}
+#endif
+
 // Calculate expressions
 template <typename T>
 void ATMSP<T>::expression(ATMSB<T> &bc) {
@@ -23,6 +23,7 @@
 #include <csetjmp>         // longjump()
 #include <cstdlib>         // strtod()
 #include <cmath>           // Math. functions
+#include <vector>          // Fused program instructions
 #include "atmsp.base.h"    // Basic parser settings and stack/list-stuff
 
 
@@ -116,6 +117,292 @@ struct ATMSB {
 };
 
 
+/** *********************************************************************** **
+ **                                                                         **
+ ** Fused bytecode. An alternative execution engine for the bytecode of     **
+ ** ATMSB. fuse() translates the operator/value arrays into a dense opcode  **
+ ** array and merges frequent sequences like "push var, add" or "push num,  **
+ ** mul" into superinstructions. run() dispatches with computed gotos for   **
+ ** gcc/clang and a switch elsewhere. Numbers and constants are inlined,    **
+ ** so the object is independent from the ATMSB it was created from.       **
+ **                                                                         **
+ ** The fused program is immutable after fuse(). It holds neither variables **
+ ** nor a stack and its instructions are sized to the expression, so one    **
+ ** program may be shared by any number of threads, each of them evaluating **
+ ** with its own ATMSP_CONTEXT and its own variable values.                 **
+ **                                                                         **
+ ** *********************************************************************** **/
+#if !defined(COMPLEX)
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define ATMSP_COMPUTED_GOTO
+#endif
+
+/// Per thread execution state of ATMSB_FUSED programs
+template <typename T>
+struct ATMSP_CONTEXT {
+
+	T stk[ATMSP_SIZE];
+
+	/// Catch NaN/inf-errors for x/0 et al. 0==success, 1 else
+	size_t fltErr;
+
+	ATMSP_CONTEXT() : fltErr(0) {}
+};
+
+template <typename T>
+class ATMSB_FUSED {
+
+public:
+
+	/// Opcodes. Suffix V: right operand is a variable, N: it is a number,
+	/// VV: both operands are variables and the result is pushed
+	enum {
+		PUSHV, PUSHN,
+		ADD, ADDV, ADDN, ADDVV,
+		SUB, SUBV, SUBN, SUBVV,
+		MUL, MULV, MULN, MULVV,
+		DIV, DIVV, DIVN, DIVVV,
+		POW, POW2, POW3, POW4, POW2V,
+		CHS, ABS, SQRT,
+		SIN, COS, TAN, SINH, TANH, COSH,
+		EXP, LOG, LOG10, LOG2,
+		ASIN, ACOS, ATAN, MAX, MIN, SIG, FLOOR, ROUND,
+		END, OPCOUNT
+	};
+
+	ATMSB_FUSED() : op(1), nVar(0) { op[0].code = END; }
+
+	/// Superinstruction pass. Returns false if bc contains an operator this
+	/// engine does not implement (atan2). nVars is the number of variables
+	/// bc was parsed with, the row width of the batch interface
+	bool fuse(const ATMSB<T> &bc, size_t nVars);
+
+	/// Evaluate for the variable values vars[0..numVars()-1]. Float errors
+	/// are reported in ctx.fltErr
+	T run(const T *vars, ATMSP_CONTEXT<T> &ctx) const;
+
+	/// Evaluate n rows of numVars() values each, stored one row after the
+	/// other in vars, into out[0..n-1]. Returns the number of rows with a
+	/// float error
+	size_t run(const T *vars, size_t n, T *out) const;
+
+	size_t numVars() const { return nVar; }
+
+	/// Bytes held by the program including its instruction array
+	size_t memSize() const { return sizeof(*this) + op.capacity()*sizeof(OP); }
+
+private:
+
+	/// A single instruction. a/b are variable indices, val an inlined number
+	struct OP {
+		unsigned int code;
+		unsigned short a, b;
+		T val;
+	};
+
+	/// Instructions including END
+	std::vector<OP> op;
+	size_t nVar;
+};
+
+
+// Superinstruction pass. First map every operator to its plain opcode with
+// the value inlined, then merge "push, binary operator" pairs and triples
+template <typename T>
+bool ATMSB_FUSED<T>::fuse(const ATMSB<T> &bc, size_t nVars) {
+
+	typedef void (ATMSB<T>::*FUN)();
+	static const struct { FUN fun; unsigned int code; } funTab[] = {
+		{ &ATMSB<T>::padd,   ADD   }, { &ATMSB<T>::psub,   SUB   },
+		{ &ATMSB<T>::pmul,   MUL   }, { &ATMSB<T>::pdiv,   DIV   },
+		{ &ATMSB<T>::pchs,   CHS   }, { &ATMSB<T>::pabs,   ABS   },
+		{ &ATMSB<T>::psqrt,  SQRT  }, { &ATMSB<T>::ppow,   POW   },
+		{ &ATMSB<T>::ppow2,  POW2  }, { &ATMSB<T>::ppow3,  POW3  },
+		{ &ATMSB<T>::ppow4,  POW4  }, { &ATMSB<T>::psin,   SIN   },
+		{ &ATMSB<T>::pcos,   COS   }, { &ATMSB<T>::ptan,   TAN   },
+		{ &ATMSB<T>::psinh,  SINH  }, { &ATMSB<T>::ptanh,  TANH  },
+		{ &ATMSB<T>::pcosh,  COSH  }, { &ATMSB<T>::pexp,   EXP   },
+		{ &ATMSB<T>::plog,   LOG   }, { &ATMSB<T>::plog10, LOG10 },
+		{ &ATMSB<T>::plog2,  LOG2  }, { &ATMSB<T>::pasin,  ASIN  },
+		{ &ATMSB<T>::pacos,  ACOS  }, { &ATMSB<T>::patan,  ATAN  },
+		{ &ATMSB<T>::pmax,   MAX   }, { &ATMSB<T>::pmin,   MIN   },
+		{ &ATMSB<T>::psig,   SIG   }, { &ATMSB<T>::pfloor, FLOOR },
+		{ &ATMSB<T>::pround, ROUND }
+	};
+
+	/// Plain opcodes. Numbers and constants never change after parsing
+	OP plain[ATMSP_SIZE];
+	size_t n = 0, valInd = 0;
+	for (size_t i=0; i<bc.opCnt; i++) {
+		OP o; o.code = END; o.a = o.b = 0; o.val = (T)0;
+		if ( bc.fun[i] == &ATMSB<T>::ppush ) {
+			const T *p = bc.val[valInd++];
+			if ( p>=bc.var && p<bc.var+ATMSP_MAXVAR ) { o.code = PUSHV; o.a = (unsigned short)(p-bc.var); }
+			else { o.code = PUSHN; o.val = *p; }
+		}
+		else {
+			for (size_t j=0; j<sizeof(funTab)/sizeof(funTab[0]); j++)
+				if ( bc.fun[i] == funTab[j].fun ) { o.code = funTab[j].code; break; }
+			if ( o.code == END ) return false;
+
+			// Fold the sign of negative numbers
+			if ( o.code==CHS && n && plain[n-1].code==PUSHN ) { plain[n-1].val = -plain[n-1].val; continue; }
+		}
+		plain[n++] = o;
+	}
+
+	/// Merge. ADD/SUB/MUL/DIV are consecutive groups of plain, V, N and VV
+	OP merged[ATMSP_SIZE+1];
+	size_t cnt = 0;
+	for (size_t i=0; i<n; i++) {
+		OP o = plain[i];
+		unsigned int next = i+1<n ? plain[i+1].code : (unsigned int)END;
+		bool binOp = next==ADD || next==SUB || next==MUL || next==DIV;
+
+		if ( o.code==PUSHV && binOp ) {
+			o.code = next+1; i++;
+			if ( cnt && merged[cnt-1].code==PUSHV ) { o.b = o.a; o.a = merged[--cnt].a; o.code = next+3; }
+			else o.b = o.a;
+		}
+		else if ( o.code==PUSHN && binOp ) { o.code = next+2; i++; }
+		else if ( o.code==PUSHV && next==POW2 ) { o.code = POW2V; i++; }
+		merged[cnt++] = o;
+	}
+	merged[cnt].code = END;
+
+	op.assign(merged, merged+cnt+1);
+	nVar = nVars;
+	return true;
+}
+
+// Bytecode execution. sp points behind the stack top
+template <typename T>
+T ATMSB_FUSED<T>::run(const T *var, ATMSP_CONTEXT<T> &ctx) const {
+
+	const OP *o = &op[0];
+	T *sp = ctx.stk, t;
+	ctx.fltErr = 0;
+
+	#if defined(ATMSP_COMPUTED_GOTO)
+
+	/// Must be in the order of the opcode enum
+	static void * const lbl[OPCOUNT] = {
+		&&L_PUSHV, &&L_PUSHN,
+		&&L_ADD, &&L_ADDV, &&L_ADDN, &&L_ADDVV,
+		&&L_SUB, &&L_SUBV, &&L_SUBN, &&L_SUBVV,
+		&&L_MUL, &&L_MULV, &&L_MULN, &&L_MULVV,
+		&&L_DIV, &&L_DIVV, &&L_DIVN, &&L_DIVVV,
+		&&L_POW, &&L_POW2, &&L_POW3, &&L_POW4, &&L_POW2V,
+		&&L_CHS, &&L_ABS, &&L_SQRT,
+		&&L_SIN, &&L_COS, &&L_TAN, &&L_SINH, &&L_TANH, &&L_COSH,
+		&&L_EXP, &&L_LOG, &&L_LOG10, &&L_LOG2,
+		&&L_ASIN, &&L_ACOS, &&L_ATAN, &&L_MAX, &&L_MIN, &&L_SIG, &&L_FLOOR, &&L_ROUND,
+		&&L_END
+	};
+
+	#define ATMSP_OP(OP) L_##OP:
+	#define ATMSP_NEXT goto *lbl[(++o)->code]
+
+	goto *lbl[o->code];
+
+	#else
+
+	#define ATMSP_OP(OP) case OP:
+	#define ATMSP_NEXT ++o; continue
+
+	for (;;) switch ( o->code ) {
+
+	#endif
+
+	/// Division by zero sets fltErr and yields 0 just like ATMSB::pdiv
+	#define ATMSP_DIV(X, Y) t = (Y); X = t!=(T)0 ? (X)/t : T((ctx.fltErr=1)-1)
+
+	ATMSP_OP(PUSHV) *sp++ = var[o->a]; ATMSP_NEXT;
+	ATMSP_OP(PUSHN) *sp++ = o->val; ATMSP_NEXT;
+
+	ATMSP_OP(ADD)   --sp; sp[-1] = sp[-1]+sp[0]; ATMSP_NEXT;
+	ATMSP_OP(ADDV)  sp[-1] = sp[-1]+var[o->b]; ATMSP_NEXT;
+	ATMSP_OP(ADDN)  sp[-1] = sp[-1]+o->val; ATMSP_NEXT;
+	ATMSP_OP(ADDVV) *sp++ = var[o->a]+var[o->b]; ATMSP_NEXT;
+
+	ATMSP_OP(SUB)   --sp; sp[-1] = sp[-1]-sp[0]; ATMSP_NEXT;
+	ATMSP_OP(SUBV)  sp[-1] = sp[-1]-var[o->b]; ATMSP_NEXT;
+	ATMSP_OP(SUBN)  sp[-1] = sp[-1]-o->val; ATMSP_NEXT;
+	ATMSP_OP(SUBVV) *sp++ = var[o->a]-var[o->b]; ATMSP_NEXT;
+
+	ATMSP_OP(MUL)   --sp; sp[-1] = sp[-1]*sp[0]; ATMSP_NEXT;
+	ATMSP_OP(MULV)  sp[-1] = sp[-1]*var[o->b]; ATMSP_NEXT;
+	ATMSP_OP(MULN)  sp[-1] = sp[-1]*o->val; ATMSP_NEXT;
+	ATMSP_OP(MULVV) *sp++ = var[o->a]*var[o->b]; ATMSP_NEXT;
+
+	ATMSP_OP(DIV)   --sp; ATMSP_DIV(sp[-1], sp[0]); ATMSP_NEXT;
+	ATMSP_OP(DIVV)  ATMSP_DIV(sp[-1], var[o->b]); ATMSP_NEXT;
+	ATMSP_OP(DIVN)  ATMSP_DIV(sp[-1], o->val); ATMSP_NEXT;
+	ATMSP_OP(DIVVV) *sp = var[o->a]; ATMSP_DIV(*sp, var[o->b]); ++sp; ATMSP_NEXT;
+
+	ATMSP_OP(POW)   --sp; sp[-1] = pow(sp[-1], sp[0]); ATMSP_NEXT;
+	ATMSP_OP(POW2)  sp[-1] = sp[-1]*sp[-1]; ATMSP_NEXT;
+	ATMSP_OP(POW3)  sp[-1] = sp[-1]*sp[-1]*sp[-1]; ATMSP_NEXT;
+	ATMSP_OP(POW4)  sp[-1] = (sp[-1]*sp[-1]) * (sp[-1]*sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(POW2V) *sp++ = var[o->a]*var[o->a]; ATMSP_NEXT;
+
+	ATMSP_OP(CHS)   sp[-1] = -sp[-1]; ATMSP_NEXT;
+	#if !defined(MPFR)
+	ATMSP_OP(ABS)   sp[-1] = std::abs(sp[-1]); ATMSP_NEXT;
+	#else
+	ATMSP_OP(ABS)   sp[-1] = abs(sp[-1]); ATMSP_NEXT;
+	#endif
+	ATMSP_OP(SQRT)  sp[-1] = sp[-1]>=(T)0 ? sqrt(sp[-1]) : T((ctx.fltErr=1)-1); ATMSP_NEXT;
+
+	ATMSP_OP(SIN)   sp[-1] = sin(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(COS)   sp[-1] = cos(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(TAN)   sp[-1] = tan(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(SINH)  sp[-1] = sinh(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(TANH)  sp[-1] = tanh(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(COSH)  sp[-1] = cosh(sp[-1]); ATMSP_NEXT;
+
+	ATMSP_OP(EXP)   sp[-1] = exp(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(LOG)   sp[-1] = log(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(LOG10) sp[-1] = log10(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(LOG2)  sp[-1] = log10(sp[-1])/log10((T)2); ATMSP_NEXT;
+
+	ATMSP_OP(ASIN)  sp[-1] = sp[-1]>=(T)-1 && sp[-1]<=(T)1 ? asin(sp[-1]) : T((ctx.fltErr=1)-1); ATMSP_NEXT;
+	ATMSP_OP(ACOS)  sp[-1] = sp[-1]>=(T)-1 && sp[-1]<=(T)1 ? acos(sp[-1]) : T((ctx.fltErr=1)-1); ATMSP_NEXT;
+	ATMSP_OP(ATAN)  sp[-1] = atan(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(MAX)   --sp; if (sp[0]>sp[-1]) sp[-1] = sp[0]; ATMSP_NEXT;
+	ATMSP_OP(MIN)   --sp; if (sp[0]<sp[-1]) sp[-1] = sp[0]; ATMSP_NEXT;
+	ATMSP_OP(SIG)   sp[-1] = sp[-1]>(T)0 ? (T)1 : sp[-1]<(T)0 ? (T)-1 : (T)0; ATMSP_NEXT;
+	ATMSP_OP(FLOOR) sp[-1] = floor(sp[-1]); ATMSP_NEXT;
+	ATMSP_OP(ROUND) sp[-1] = floor(sp[-1]+(T)0.5); ATMSP_NEXT;
+
+	ATMSP_OP(END)   return sp[-1];
+
+	#if !defined(ATMSP_COMPUTED_GOTO)
+	}
+	#endif
+
+	#undef ATMSP_DIV
+	#undef ATMSP_NEXT
+	#undef ATMSP_OP
+}
+
+// Batch execution. One context serves all rows
+template <typename T>
+size_t ATMSB_FUSED<T>::run(const T *vars, size_t n, T *out) const {
+
+	ATMSP_CONTEXT<T> ctx;
+	size_t errCnt = 0;
+	for (size_t i=0; i<n; i++, vars+=nVar) {
+		out[i] = run(vars, ctx);
+		errCnt += ctx.fltErr;
+	}
+	return errCnt;
+}
+
+#endif    // !COMPLEX
+
+
 /** *********************************************************************** **
  **                                                                         **
  ** Parser class. Parses a string and generates the bytecode. For certain   **
@@ -176,6 +463,12 @@ public:
 	/// Returns noErr==0 on success, error code else
 	size_t parse(ATMSB<T> &bc, const std::string &exp, const std::string &vars);
 
+	/// Parse and translate the bytecode into an immutable fused program
+	/// Returns noErr==0 on success, funErr for operators it does not support
+	#if !defined(COMPLEX)
+	size_t parse(ATMSB_FUSED<T> &prog, const std::string &exp, const std::string &vars);
+	#endif
+
 	/// Message error-string for a specific error number
 	const std::string errMessage(size_t errNum) { return errLst[errNum-1]; }
 };
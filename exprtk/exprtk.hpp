@@ -35,6 +35,7 @@
 
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cmath>
 #include <complex>
@@ -51,6 +52,7 @@
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <typeinfo>
 #include <utility>
 #include <vector>
 
@@ -4303,6 +4305,247 @@ namespace exprtk
          }
       }
 
+      /*
+         Bump allocator holding all nodes of one compiled expression.
+         Nodes are placed contiguously in allocation order, children
+         before their parents, and released together when the arena
+         is destroyed. The nodes are of type arena_node<node_type>,
+         deleting one runs its destructor only, the memory is given
+         back with the arena. Nodes discarded while compiling keep
+         their space until then.
+
+         The arena lives at the start of its own memory. When compiling
+         is done the unused end of its last chunk is handed to the next
+         arena of the same parser, so consecutive expressions are packed
+         into shared, reference counted chunks.
+      */
+      class node_arena
+      {
+      private:
+
+         enum
+         {
+            alignment          = 16,
+            min_chunk_size     = 256,
+            max_chunk_size     = 16 * 1024,
+            min_remainder_size = 128
+         };
+
+         struct chunk_t
+         {
+            std::atomic<std::size_t> ref_count;
+            std::size_t size;
+         };
+
+         struct segment_t
+         {
+            chunk_t*   chunk;
+            char*      begin;
+            char*      end;
+            segment_t* next;
+         };
+
+      public:
+
+         class parser_state
+         {
+         public:
+
+            parser_state()
+            : chunk_(0),
+              begin_(0),
+              end_  (0),
+              chunk_size_(min_chunk_size)
+            {}
+
+           ~parser_state()
+            {
+               reset();
+            }
+
+            inline void reset()
+            {
+               if (chunk_)
+               {
+                  unref(chunk_);
+               }
+
+               chunk_ = 0;
+               begin_ = 0;
+               end_   = 0;
+            }
+
+         private:
+
+            parser_state(const parser_state&);
+            parser_state& operator=(const parser_state&);
+
+            chunk_t*      chunk_;
+            char*         begin_;
+            char*         end_;
+            std::size_t   chunk_size_;
+
+            friend class node_arena;
+         };
+
+         static inline node_arena* create(const std::size_t size_hint, parser_state& r)
+         {
+            const std::size_t self_size = aligned(sizeof(node_arena)) + aligned(sizeof(segment_t));
+
+            chunk_t* chunk = r.chunk_;
+            char*    begin = r.begin_;
+            char*    end   = r.end_;
+
+            if (chunk && (static_cast<std::size_t>(end - begin) >= (self_size + size_hint)))
+            {
+               // The reference to the remainder moves to the new arena.
+               r.chunk_ = 0;
+               r.reset();
+            }
+            else
+            {
+               r.reset();
+               r.chunk_size_ = std::max(r.chunk_size_,std::min<std::size_t>(size_hint,max_chunk_size));
+               chunk = new_chunk(self_size + size_hint,r.chunk_size_);
+               begin = reinterpret_cast<char*>(chunk) + aligned(sizeof(chunk_t));
+               end   = reinterpret_cast<char*>(chunk) + chunk->size;
+            }
+
+            node_arena* arena = new (begin) node_arena(r.chunk_size_);
+
+            segment_t* segment = reinterpret_cast<segment_t*>(begin + aligned(sizeof(node_arena)));
+            segment->chunk = chunk;
+            segment->begin = begin;
+            segment->end   = end;
+            segment->next  = 0;
+
+            arena->segment_list_ = segment;
+            arena->cursor_       = begin + self_size;
+            arena->end_          = end;
+            arena->size_         = static_cast<std::size_t>(end - begin);
+
+            return arena;
+         }
+
+         static inline void destroy(node_arena* arena)
+         {
+            segment_t* segment = arena->segment_list_;
+
+            arena->~node_arena();
+
+            while (segment)
+            {
+               segment_t* next = segment->next;
+               unref(segment->chunk);
+               segment = next;
+            }
+         }
+
+         inline void* allocate(std::size_t size)
+         {
+            size = aligned(size);
+
+            if (size > static_cast<std::size_t>(end_ - cursor_))
+            {
+               add_segment(size);
+            }
+
+            void* result = cursor_;
+            cursor_ += size;
+
+            return result;
+         }
+
+         // Hand the unused end of the arena over to the next one, no node can be allocated afterwards.
+         inline void close(parser_state& r)
+         {
+            r.reset();
+            r.chunk_size_ = chunk_size_;
+
+            if (static_cast<std::size_t>(end_ - cursor_) >= min_remainder_size)
+            {
+               r.chunk_ = segment_list_->chunk;
+               r.begin_ = cursor_;
+               r.end_   = end_;
+               ++r.chunk_->ref_count;
+
+               segment_list_->end = cursor_;
+               size_ -= static_cast<std::size_t>(end_ - cursor_);
+            }
+
+            end_ = cursor_;
+         }
+
+         inline std::size_t size() const
+         {
+            return size_;
+         }
+
+      private:
+
+         explicit node_arena(const std::size_t chunk_size)
+         : segment_list_(0),
+           chunk_size_(chunk_size),
+           cursor_(0),
+           end_   (0),
+           size_  (0)
+         {}
+
+         node_arena(const node_arena&);
+         node_arena& operator=(const node_arena&);
+
+         static inline std::size_t aligned(const std::size_t size)
+         {
+            return (size + (alignment - 1)) & ~static_cast<std::size_t>(alignment - 1);
+         }
+
+         static inline chunk_t* new_chunk(const std::size_t size, std::size_t& chunk_size)
+         {
+            const std::size_t total_size = std::max(aligned(sizeof(chunk_t)) + size,chunk_size);
+
+            chunk_t* chunk = reinterpret_cast<chunk_t*>(::operator new(total_size));
+            new (&chunk->ref_count) std::atomic<std::size_t>(1);
+            chunk->size = total_size;
+
+            chunk_size = std::min<std::size_t>(2 * chunk_size,max_chunk_size);
+
+            return chunk;
+         }
+
+         static inline void unref(chunk_t* chunk)
+         {
+            if (0 == --chunk->ref_count)
+            {
+               ::operator delete(chunk);
+            }
+         }
+
+         inline void add_segment(const std::size_t size)
+         {
+            const std::size_t segment_size = aligned(sizeof(segment_t));
+
+            chunk_t* chunk = new_chunk(segment_size + size,chunk_size_);
+            char*    begin = reinterpret_cast<char*>(chunk) + aligned(sizeof(chunk_t));
+
+            segment_t* segment = reinterpret_cast<segment_t*>(begin);
+            segment->chunk = chunk;
+            segment->begin = begin;
+            segment->end   = reinterpret_cast<char*>(chunk) + chunk->size;
+            segment->next  = segment_list_;
+            segment_list_  = segment;
+
+            cursor_ = begin + segment_size;
+            end_    = segment->end;
+            size_  += static_cast<std::size_t>(end_ - begin);
+         }
+
+         segment_t* segment_list_;
+         std::size_t chunk_size_;
+         char* cursor_;
+         char* end_;
+         std::size_t size_;
+      };
+
       template <typename T>
       class expression_node
       {
@@ -4370,6 +4613,30 @@ namespace exprtk
          }
       };
 
+      // A node placed into a node_arena. Deleting it runs the destructors of the
+      // node as usual, the memory is left to the arena.
+      template <typename Node>
+      class arena_node : public Node
+      {
+      public:
+
+         template <typename... Args>
+         explicit arena_node(Args&&... args)
+         : Node(std::forward<Args>(args)...)
+         {}
+
+         static inline void operator delete(void*)
+         {}
+      };
+
+      // Exact type test that also holds for the arena_node of the type.
+      template <typename Node, typename T>
+      inline bool is_node_type(const expression_node<T>* node)
+      {
+         return (typeid(*node) == typeid(Node)) ||
+                (typeid(*node) == typeid(arena_node<Node>));
+      }
+
       template <typename T>
       inline bool is_generally_string_node(const expression_node<T>* node);
 
@@ -5152,8 +5419,22 @@ namespace exprtk
          branch_t branch_[2];
       };
 
+      template <typename T>
+      class bob_base_node : public expression_node<T>
+      {
+      public:
+
+         virtual ~bob_base_node()
+         {}
+
+         inline virtual operator_type operation() const
+         {
+            return details::e_default;
+         }
+      };
+
       template <typename T, typename Operation>
-      class binary_ext_node : public expression_node<T>
+      class binary_ext_node : public bob_base_node<T>
       {
       public:
 
@@ -5182,7 +5463,7 @@ namespace exprtk
             return expression_node<T>::e_binary_ext;
          }
 
-         inline operator_type operation()
+         inline operator_type operation() const
          {
             return Operation::operation();
          }
@@ -5330,6 +5611,18 @@ namespace exprtk
             return expression_node<T>::e_conditional;
          }
 
+         inline expression_node<T>* branch(const std::size_t& index = 0) const
+         {
+            if (0 == index)
+               return test_;
+            else if (1 == index)
+               return consequent_;
+            else if (2 == index)
+               return alternative_;
+            else
+               return reinterpret_cast<expression_ptr>(0);
+         }
+
       private:
 
          expression_ptr test_;
@@ -5375,6 +5668,16 @@ namespace exprtk
             return expression_node<T>::e_conditional;
          }
 
+         inline expression_node<T>* branch(const std::size_t& index = 0) const
+         {
+            if (0 == index)
+               return test_;
+            else if (1 == index)
+               return consequent_;
+            else
+               return reinterpret_cast<expression_ptr>(0);
+         }
+
       private:
 
          expression_ptr test_;
@@ -11560,6 +11863,11 @@ namespace exprtk
          virtual ~vob_base_node()
          {}
 
+         inline virtual operator_type operation() const
+         {
+            return details::e_default;
+         }
+
          virtual const T& v() const = 0;
       };
 
@@ -11571,6 +11879,11 @@ namespace exprtk
          virtual ~bov_base_node()
          {}
 
+         inline virtual operator_type operation() const
+         {
+            return details::e_default;
+         }
+
          virtual const T& v() const = 0;
       };
 
@@ -12614,8 +12927,25 @@ namespace exprtk
          const qfunc_t f_;
       };
 
+      template <typename T, typename T0, typename T1, typename T2, typename T3>
+      class sf4ext_type_node : public T0oT1oT2oT3_base_node<T>
+      {
+      public:
+
+         virtual ~sf4ext_type_node()
+         {}
+
+         virtual T0 t0() const = 0;
+
+         virtual T1 t1() const = 0;
+
+         virtual T2 t2() const = 0;
+
+         virtual T3 t3() const = 0;
+      };
+
       template <typename T, typename T0, typename T1, typename T2, typename T3, typename SF4Operation>
-      class T0oT1oT2oT3_sf4ext : public T0oT1oT2oT3_base_node<T>
+      class T0oT1oT2oT3_sf4ext : public sf4ext_type_node<T,T0,T1,T2,T3>
       {
       public:
 
@@ -12664,7 +12994,7 @@ namespace exprtk
 
          inline T3 t3() const
          {
-            return t2_;
+            return t3_;
          }
 
          std::string type_id() const
@@ -13524,8 +13854,30 @@ namespace exprtk
       };
       #endif
 
+      template <typename T>
+      class ipow_base_node : public expression_node<T>
+      {
+      public:
+
+         virtual ~ipow_base_node()
+         {}
+
+         virtual const T& v() const = 0;
+
+         virtual unsigned int power() const = 0;
+      };
+
+      template <typename PowOp>
+      struct ipow_power;
+
+      template <typename T, unsigned int N>
+      struct ipow_power<numeric::fast_exp<T,N> >
+      {
+         enum { value = N };
+      };
+
       template <typename T, typename PowOp>
-      class ipow_node : public expression_node<T>
+      class ipow_node : public ipow_base_node<T>
       {
       public:
 
@@ -13546,6 +13898,16 @@ namespace exprtk
             return expression_node<T>::e_ipow;
          }
 
+         inline const T& v() const
+         {
+            return v_;
+         }
+
+         inline unsigned int power() const
+         {
+            return ipow_power<PowOp>::value;
+         }
+
       private:
 
          ipow_node(const ipow_node<T,PowOp>&);
@@ -13555,7 +13917,7 @@ namespace exprtk
       };
 
       template <typename T, typename PowOp>
-      class ipowinv_node : public expression_node<T>
+      class ipowinv_node : public ipow_base_node<T>
       {
       public:
 
@@ -13576,6 +13938,16 @@ namespace exprtk
             return expression_node<T>::e_ipowinv;
          }
 
+         inline const T& v() const
+         {
+            return v_;
+         }
+
+         inline unsigned int power() const
+         {
+            return ipow_power<PowOp>::value;
+         }
+
       private:
 
          ipowinv_node(const ipowinv_node<T,PowOp>&);
@@ -13602,6 +13974,24 @@ namespace exprtk
          return (0 != dynamic_cast<const voc_base_node<T>*>(node));
       }
 
+      template <typename T>
+      inline bool is_vob_node(const expression_node<T>* node)
+      {
+         return (0 != dynamic_cast<const vob_base_node<T>*>(node));
+      }
+
+      template <typename T>
+      inline bool is_bov_node(const expression_node<T>* node)
+      {
+         return (0 != dynamic_cast<const bov_base_node<T>*>(node));
+      }
+
+      template <typename T>
+      inline bool is_bob_node(const expression_node<T>* node)
+      {
+         return (0 != dynamic_cast<const bob_base_node<T>*>(node));
+      }
+
       template <typename T>
       inline bool is_cob_node(const expression_node<T>* node)
       {
@@ -13632,6 +14022,12 @@ namespace exprtk
          return (0 != dynamic_cast<const uv_base_node<T>*>(node));
       }
 
+      template <typename T>
+      inline bool is_ipow_node(const expression_node<T>* node)
+      {
+         return (0 != dynamic_cast<const ipow_base_node<T>*>(node));
+      }
+
       template <typename T>
       inline bool is_string_node(const expression_node<T>* node)
       {
@@ -13716,50 +14112,1375 @@ namespace exprtk
          return false;
       }
 
-      class node_allocator
+      template <typename T>
+      class flat_program_node : public expression_node<T>
       {
       public:
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[1])
-         {
-            return allocate<ResultNode>(operation,branch[0]);
-         }
+         // Linear register program equivalent to an expression tree made of
+         // arithmetic, variable, constant, conditional and builtin function nodes.
+         // Operands point at variables, at the constant pool or at registers,
+         // conditionals become jumps. The fused sf3ext/sf4ext nodes are expanded
+         // into their operations, and two adjacent +-*/ instructions of which the
+         // second consumes the result of the first are merged into one. Leaf nodes
+         // over variables and constants that have no instructions of their own
+         // (vovov through function pointers, ipow etc.) are called through their
+         // value(), which does not recurse. The registers belong to the program, so
+         // it must not be evaluated by two threads at once.
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[2])
-         {
-            return allocate<ResultNode>(operation,branch[0],branch[1]);
-         }
+         typedef expression_node<T>* expression_ptr;
+         typedef typename expression_node<T>::node_type node_type;
+
+         // Fused pairs: (arg0 op0 arg1) op1 arg2 for _l, arg2 op1 (arg0 op0 arg1) for _r,
+         // listed in the order of fused_type().
+         #define exprtk_flat_fused_list(f)                                   \
+         f(add,+,add,+) f(add,+,sub,-) f(add,+,mul,*) f(add,+,div,/)         \
+         f(sub,-,add,+) f(sub,-,sub,-) f(sub,-,mul,*) f(sub,-,div,/)         \
+         f(mul,*,add,+) f(mul,*,sub,-) f(mul,*,mul,*) f(mul,*,div,/)         \
+         f(div,/,add,+) f(div,/,sub,-) f(div,/,mul,*) f(div,/,div,/)         \
+
+         // Builtins with an instruction of their own, the others go through
+         // numeric::process as e_unary/e_binary.
+         #define exprtk_flat_unary_list(f)                                   \
+         f(abs) f(sqrt) f(exp) f(log) f(sin) f(cos)                          \
+
+         #define exprtk_flat_binary_list(f)                                  \
+         f(pow,numeric::pow<T>(a,b)) f(min,std::min<T>(a,b))                 \
+         f(max,std::max<T>(a,b))                                             \
+         f(lt ,(a <  b) ? T(1) : T(0)) f(lte,(a <= b) ? T(1) : T(0))         \
+         f(gt ,(a >  b) ? T(1) : T(0)) f(gte,(a >= b) ? T(1) : T(0))         \
+
+         enum instruction_type
+         {
+            e_add   , e_sub   , e_mul    , e_div   ,
+            e_neg   , e_binary, e_unary  , e_call  ,
+            e_copy  , e_jump  , e_jump_if_false,
+
+            #define exprtk_flat_unary_enum(op) e_##op,
+            #define exprtk_flat_binary_enum(op,expr) e_##op,
+            exprtk_flat_unary_list (exprtk_flat_unary_enum )
+            exprtk_flat_binary_list(exprtk_flat_binary_enum)
+            #undef exprtk_flat_unary_enum
+            #undef exprtk_flat_binary_enum
+
+            e_return,
+
+            #define exprtk_flat_fused_enum(n0,o0,n1,o1) e_##n0##_##n1##_l, e_##n0##_##n1##_r,
+            exprtk_flat_fused_list(exprtk_flat_fused_enum)
+            #undef exprtk_flat_fused_enum
+
+            e_fused_end
+         };
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[3])
+         struct instruction
          {
-            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2]);
-         }
+            instruction_type type;
+            operator_type    operation;
+            T*               result;
+            const T*         arg0;
+            const T*         arg1;
+            const T*         arg2;
+            expression_ptr   node;
+            std::size_t      target;
+         };
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[4])
-         {
-            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3]);
-         }
+         flat_program_node()
+         : constant_count_(0),
+           registers_(0),
+           branches_ (0)
+         {}
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[5])
+         inline T value() const
          {
-            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3],branch[4]);
-         }
+            const instruction* begin = &program_[0];
+            const instruction* i     = begin;
 
-         template <typename ResultNode, typename OpType, typename ExprNode>
-         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[6])
-         {
-            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3],branch[4],branch[5]);
-         }
+            #if defined(__GNUC__) || defined(__clang__)
+            // Direct threading, every instruction jumps to its successor itself.
+            static const void* const label[] =
+                                     {
+                                       &&l_e_add   , &&l_e_sub   , &&l_e_mul    , &&l_e_div   ,
+                                       &&l_e_neg   , &&l_e_binary, &&l_e_unary  , &&l_e_call  ,
+                                       &&l_e_copy  , &&l_e_jump  , &&l_e_jump_if_false,
 
-         template <typename node_type>
-         inline expression_node<typename node_type::value_type>* allocate() const
-         {
-            return new node_type();
+                                       #define exprtk_flat_unary_label(op) &&l_e_##op,
+                                       #define exprtk_flat_binary_label(op,expr) &&l_e_##op,
+                                       exprtk_flat_unary_list (exprtk_flat_unary_label )
+                                       exprtk_flat_binary_list(exprtk_flat_binary_label)
+                                       #undef exprtk_flat_unary_label
+                                       #undef exprtk_flat_binary_label
+
+                                       &&l_e_return,
+
+                                       #define exprtk_flat_fused_label(n0,o0,n1,o1) \
+                                       &&l_e_##n0##_##n1##_l, &&l_e_##n0##_##n1##_r,
+                                       exprtk_flat_fused_list(exprtk_flat_fused_label)
+                                       #undef exprtk_flat_fused_label
+
+                                       &&l_e_return
+                                     };
+
+            #define exprtk_flat_op(op) l_##op :
+            #define exprtk_flat_dispatch goto *label[i->type];
+            #define exprtk_flat_next     ++i; exprtk_flat_dispatch
+
+            exprtk_flat_dispatch
+            #else
+            #define exprtk_flat_op(op) case op :
+            #define exprtk_flat_dispatch continue;
+            #define exprtk_flat_next     ++i; exprtk_flat_dispatch
+
+            for ( ; ; )
+            switch (i->type)
+            #endif
+            {
+               exprtk_flat_op(e_add   ) *i->result = *i->arg0 + *i->arg1; exprtk_flat_next
+               exprtk_flat_op(e_sub   ) *i->result = *i->arg0 - *i->arg1; exprtk_flat_next
+               exprtk_flat_op(e_mul   ) *i->result = *i->arg0 * *i->arg1; exprtk_flat_next
+               exprtk_flat_op(e_div   ) *i->result = *i->arg0 / *i->arg1; exprtk_flat_next
+               exprtk_flat_op(e_neg   ) *i->result = -(*i->arg0);         exprtk_flat_next
+               exprtk_flat_op(e_binary) *i->result = numeric::process<T>(i->operation,*i->arg0,*i->arg1);
+                                        exprtk_flat_next
+               exprtk_flat_op(e_unary ) *i->result = numeric::process<T>(i->operation,*i->arg0);
+                                        exprtk_flat_next
+               exprtk_flat_op(e_call  ) *i->result = i->node->value(); exprtk_flat_next
+               exprtk_flat_op(e_copy  ) *i->result = *i->arg0;         exprtk_flat_next
+               exprtk_flat_op(e_jump  ) i = begin + i->target;         exprtk_flat_dispatch
+               exprtk_flat_op(e_jump_if_false)
+                                        if (!is_true(*i->arg0))
+                                        {
+                                           i = begin + i->target;
+                                           exprtk_flat_dispatch
+                                        }
+                                        exprtk_flat_next
+
+               #define exprtk_flat_unary_op(op)                                                      \
+               exprtk_flat_op(e_##op) *i->result = numeric::op(*i->arg0); exprtk_flat_next          \
+
+               #define exprtk_flat_binary_op(op,expr)                                                \
+               exprtk_flat_op(e_##op)                                                               \
+               {                                                                                    \
+                  const T a = *i->arg0;                                                             \
+                  const T b = *i->arg1;                                                             \
+                  *i->result = expr;                                                                \
+               }                                                                                    \
+               exprtk_flat_next                                                                     \
+
+               exprtk_flat_unary_list (exprtk_flat_unary_op )
+               exprtk_flat_binary_list(exprtk_flat_binary_op)
+               #undef exprtk_flat_unary_op
+               #undef exprtk_flat_binary_op
+
+               #define exprtk_flat_fused_op(n0,o0,n1,o1)                                            \
+               exprtk_flat_op(e_##n0##_##n1##_l)                                                    \
+                  *i->result = (*i->arg0 o0 *i->arg1) o1 *i->arg2; exprtk_flat_next                 \
+               exprtk_flat_op(e_##n0##_##n1##_r)                                                    \
+                  *i->result = *i->arg2 o1 (*i->arg0 o0 *i->arg1); exprtk_flat_next                 \
+
+               exprtk_flat_fused_list(exprtk_flat_fused_op)
+               #undef exprtk_flat_fused_op
+
+               exprtk_flat_op(e_return) return *i->arg0;
+            }
+
+            #undef exprtk_flat_op
+            #undef exprtk_flat_dispatch
+            #undef exprtk_flat_next
+         }
+
+         inline typename expression_node<T>::node_type type() const
+         {
+            return expression_node<T>::e_none;
+         }
+
+         inline std::size_t size() const
+         {
+            return program_.size();
+         }
+
+         // e_unary/e_binary for the builtin instructions, the type itself otherwise.
+         // The operation of a builtin instruction is kept in its operation field.
+         static inline instruction_type generic_type(const instruction_type type)
+         {
+            switch (type)
+            {
+               #define exprtk_flat_unary_case(op) case e_##op :
+               #define exprtk_flat_binary_case(op,expr) case e_##op :
+               exprtk_flat_unary_list (exprtk_flat_unary_case ) return e_unary;
+               exprtk_flat_binary_list(exprtk_flat_binary_case) return e_binary;
+               #undef exprtk_flat_unary_case
+               #undef exprtk_flat_binary_case
+               default : return type;
+            }
+         }
+
+         inline const std::vector<instruction>& instructions() const
+         {
+            return program_;
+         }
+
+         inline std::size_t register_count() const
+         {
+            return data_.size() - constant_count_;
+         }
+
+         // Register an operand address refers to, false for variables and constants.
+         inline bool register_index(const T* p, std::size_t& index) const
+         {
+            const T* begin = data_.empty() ? reinterpret_cast<const T*>(0) : &data_[0] + constant_count_;
+
+            if (data_.empty() || (p < begin) || (p >= &data_[0] + data_.size()))
+               return false;
+
+            index = static_cast<std::size_t>(p - begin);
+            return true;
+         }
+
+         // Build the program for the tree below root, returns false if the tree contains
+         // a node the program has no equivalent for or, unless leaf is set, consists of
+         // a single leaf node.
+         inline bool compile(expression_ptr root, const bool leaf = false)
+         {
+            program_  .clear();
+            pending_  .clear();
+            constants_.clear();
+            constant_count_ = 0;
+            registers_ = 0;
+            branches_  = 0;
+
+            operand result;
+
+            if (!emit(root,0,result) || (!leaf && (0 == branches_)))
+            {
+               pending_  .clear();
+               constants_.clear();
+               return false;
+            }
+
+            push(e_return, 0, result);
+
+            fuse();
+
+            data_.resize(constants_.size() + registers_);
+            std::copy(constants_.begin(), constants_.end(), data_.begin());
+            constant_count_ = constants_.size();
+
+            program_.resize(pending_.size());
+
+            for (std::size_t i = 0; i < pending_.size(); ++i)
+            {
+               instruction& ins = program_[i];
+
+               ins.type      = pending_[i].type;
+               ins.operation = pending_[i].operation;
+               ins.result    = &data_[constants_.size() + pending_[i].result];
+               ins.arg0      = address(pending_[i].arg0);
+               ins.arg1      = address(pending_[i].arg1);
+               ins.arg2      = address(pending_[i].arg2);
+               ins.node      = pending_[i].node;
+               ins.target    = pending_[i].target;
+            }
+
+            pending_  .clear();
+            constants_.clear();
+
+            return true;
+         }
+
+      private:
+
+         struct operand
+         {
+            enum kind_t { e_none, e_variable, e_constant, e_register };
+
+            operand(kind_t k = e_none, const T* v = 0, const std::size_t i = 0)
+            : kind(k),
+              var(v),
+              index(i)
+            {}
+
+            inline bool is_register(const std::size_t& reg) const
+            {
+               return (e_register == kind) && (reg == index);
+            }
+
+            kind_t      kind;
+            const T*    var;
+            std::size_t index;
+         };
+
+         struct pending_instruction
+         {
+            instruction_type type;
+            operator_type    operation;
+            std::size_t      result;
+            operand          arg0;
+            operand          arg1;
+            operand          arg2;
+            expression_ptr   node;
+            std::size_t      target;
+         };
+
+         inline const T* address(const operand& o)
+         {
+            switch (o.kind)
+            {
+               case operand::e_variable : return o.var;
+               case operand::e_constant : return &data_[o.index];
+               case operand::e_register : return &data_[constants_.size() + o.index];
+               default                  : return reinterpret_cast<const T*>(0);
+            }
+         }
+
+         inline operand constant(const T& v)
+         {
+            constants_.push_back(v);
+            return operand(operand::e_constant, 0, constants_.size() - 1);
+         }
+
+         inline operand variable(const T& v)
+         {
+            return operand(operand::e_variable, &v);
+         }
+
+         inline operand reg_operand(const std::size_t reg)
+         {
+            return operand(operand::e_register, 0, reg);
+         }
+
+         inline std::size_t push(const instruction_type type,
+                                 const std::size_t reg,
+                                 const operand& arg0 = operand(),
+                                 const operand& arg1 = operand(),
+                                 const operator_type operation = details::e_default,
+                                 const expression_ptr node = expression_ptr(0))
+         {
+            pending_instruction ins;
+
+            ins.type      = type;
+            ins.operation = operation;
+            ins.result    = reg;
+            ins.arg0      = arg0;
+            ins.arg1      = arg1;
+            ins.node      = node;
+            ins.target    = 0;
+
+            pending_.push_back(ins);
+            registers_ = std::max(registers_, reg + 1);
+
+            return pending_.size() - 1;
+         }
+
+         inline operand binary(const operator_type operation,
+                               const operand& arg0, const operand& arg1,
+                               const std::size_t reg)
+         {
+            switch (operation)
+            {
+               case details::e_add : push(e_add, reg, arg0, arg1); break;
+               case details::e_sub : push(e_sub, reg, arg0, arg1); break;
+               case details::e_mul : push(e_mul, reg, arg0, arg1); break;
+               case details::e_div : push(e_div, reg, arg0, arg1); break;
+
+               #define exprtk_flat_binary_case(op,expr)                              \
+               case details::e_##op : push(e_##op, reg, arg0, arg1, operation); break; \
+
+               exprtk_flat_binary_list(exprtk_flat_binary_case)
+               #undef exprtk_flat_binary_case
+
+               default             : push(e_binary, reg, arg0, arg1, operation); break;
+            }
+
+            return reg_operand(reg);
+         }
+
+         inline operand unary(const operator_type operation, const operand& arg, const std::size_t reg)
+         {
+            switch (operation)
+            {
+               case details::e_neg : push(e_neg, reg, arg); break;
+
+               #define exprtk_flat_unary_case(op)                                    \
+               case details::e_##op : push(e_##op, reg, arg, operand(), operation); break; \
+
+               exprtk_flat_unary_list(exprtk_flat_unary_case)
+               #undef exprtk_flat_unary_case
+
+               default             : push(e_unary, reg, arg, operand(), operation); break;
+            }
+
+            return reg_operand(reg);
+         }
+
+         // Evaluate into reg or any register above it, the caller's registers are below.
+         inline bool emit(expression_ptr node, const std::size_t reg, operand& result)
+         {
+            if (0 == node)
+               return false;
+
+            operator_type operation = details::e_default;
+
+            if (is_variable_node(node))
+            {
+               result = variable(static_cast<variable_node<T>*>(node)->ref());
+               return true;
+            }
+            else if (is_constant_node(node))
+            {
+               result = constant(node->value());
+               return true;
+            }
+            else if (is_vov_node(node))
+            {
+               const vov_base_node<T>* n = static_cast<const vov_base_node<T>*>(node);
+               result = binary(n->operation(), variable(n->v0()), variable(n->v1()), reg);
+               return true;
+            }
+            else if (is_cov_node(node))
+            {
+               const cov_base_node<T>* n = static_cast<const cov_base_node<T>*>(node);
+               result = binary(n->operation(), constant(n->c()), variable(n->v()), reg);
+               return true;
+            }
+            else if (is_voc_node(node))
+            {
+               const voc_base_node<T>* n = static_cast<const voc_base_node<T>*>(node);
+               result = binary(n->operation(), variable(n->v()), constant(n->c()), reg);
+               return true;
+            }
+            else if (is_uv_node(node))
+            {
+               const uv_base_node<T>* n = static_cast<const uv_base_node<T>*>(node);
+               result = unary(n->operation(), variable(n->v()), reg);
+               return true;
+            }
+            else if (emit_sf3ext(node, reg, result) || emit_sf4ext(node, reg, result))
+            {
+               return true;
+            }
+            else if (is_leaf(node))
+            {
+               push(e_call, reg, operand(), operand(), details::e_default, node);
+               result = reg_operand(reg);
+               return true;
+            }
+
+            ++branches_;
+
+            if (is_vob_node(node))
+            {
+               const vob_base_node<T>* n = static_cast<const vob_base_node<T>*>(node);
+               operand arg;
+
+               if (!emit(n->branch(0), reg, arg))
+                  return false;
+
+               result = binary(n->operation(), variable(n->v()), arg, reg);
+               return true;
+            }
+            else if (is_bov_node(node))
+            {
+               const bov_base_node<T>* n = static_cast<const bov_base_node<T>*>(node);
+               operand arg;
+
+               if (!emit(n->branch(0), reg, arg))
+                  return false;
+
+               result = binary(n->operation(), arg, variable(n->v()), reg);
+               return true;
+            }
+            else if (is_cob_node(node))
+            {
+               const cob_base_node<T>* n = static_cast<const cob_base_node<T>*>(node);
+               operand arg;
+
+               if (!emit(n->branch(0), reg, arg))
+                  return false;
+
+               result = binary(n->operation(), constant(n->c()), arg, reg);
+               return true;
+            }
+            else if (is_boc_node(node))
+            {
+               const boc_base_node<T>* n = static_cast<const boc_base_node<T>*>(node);
+               operand arg;
+
+               if (!emit(n->branch(0), reg, arg))
+                  return false;
+
+               result = binary(n->operation(), arg, constant(n->c()), reg);
+               return true;
+            }
+            else if (is_bob_node(node))
+            {
+               const bob_base_node<T>* n = static_cast<const bob_base_node<T>*>(node);
+               return emit_binary(n->operation(), n->branch(0), n->branch(1), reg, result);
+            }
+            else if (is_node_type<binary_node<T> >(node))
+            {
+               binary_node<T>* n = static_cast<binary_node<T>*>(node);
+               return emit_binary(n->operation(), n->branch(0), n->branch(1), reg, result);
+            }
+            else if (is_node_type<unary_node<T> >(node))
+            {
+               const unary_node<T>* n = static_cast<const unary_node<T>*>(node);
+               operand arg;
+
+               if (!emit(n->branch(0), reg, arg))
+                  return false;
+
+               result = unary(n->operation(), arg, reg);
+               return true;
+            }
+            else if (unary_operation(node->type(), operation) && node->branch(0))
+            {
+               // unary_branch_node, its operation is only known through the node type
+               operand arg;
+
+               if (!emit(node->branch(0), reg, arg))
+                  return false;
+
+               result = unary(operation, arg, reg);
+               return true;
+            }
+            else if (is_node_type<conditional_node<T> >(node))
+            {
+               return emit_conditional(node->branch(0), node->branch(1), node->branch(2), reg, result);
+            }
+            else if (is_node_type<cons_conditional_node<T> >(node))
+            {
+               return emit_conditional(node->branch(0), node->branch(1), expression_ptr(0), reg, result);
+            }
+
+            return false;
+         }
+
+         inline bool emit_binary(const operator_type operation,
+                                 expression_ptr branch0, expression_ptr branch1,
+                                 const std::size_t reg, operand& result)
+         {
+            operand arg0;
+            operand arg1;
+
+            if (!emit(branch0, reg, arg0))
+               return false;
+
+            if (!emit(branch1, (operand::e_register == arg0.kind) ? reg + 1 : reg, arg1))
+               return false;
+
+            result = binary(operation, arg0, arg1, reg);
+            return true;
+         }
+
+         // An absent alternative yields NaN, as cons_conditional_node does.
+         inline bool emit_conditional(expression_ptr test,
+                                      expression_ptr consequent,
+                                      expression_ptr alternative,
+                                      const std::size_t reg, operand& result)
+         {
+            operand arg;
+
+            if (!emit(test, reg, arg))
+               return false;
+
+            const std::size_t jump_alternative = push(e_jump_if_false, reg, arg);
+
+            if (!emit(consequent, reg, arg))
+               return false;
+
+            move(arg, reg);
+
+            const std::size_t jump_end = push(e_jump, reg);
+
+            pending_[jump_alternative].target = pending_.size();
+
+            if (alternative)
+            {
+               if (!emit(alternative, reg, arg))
+                  return false;
+            }
+            else
+               arg = constant(std::numeric_limits<T>::quiet_NaN());
+
+            move(arg, reg);
+
+            pending_[jump_end].target = pending_.size();
+
+            result = reg_operand(reg);
+            return true;
+         }
+
+         inline void move(const operand& arg, const std::size_t reg)
+         {
+            if (!arg.is_register(reg))
+            {
+               push(e_copy, reg, arg);
+            }
+         }
+
+         template <typename Type>
+         inline operand sf_operand(Type t)
+         {
+            if (is_const_ref<Type>::result)
+               return variable(t);
+            else
+               return constant(t);
+         }
+
+         template <typename T0, typename T1, typename T2>
+         inline bool sf3ext_operands(const expression_ptr node, operand (&t)[4])
+         {
+            typedef sf3ext_type_node<T,T0,T1,T2> sf3ext_t;
+
+            if (const sf3ext_t* n = dynamic_cast<const sf3ext_t*>(node))
+            {
+               t[0] = sf_operand<T0>(n->t0());
+               t[1] = sf_operand<T1>(n->t1());
+               t[2] = sf_operand<T2>(n->t2());
+               return true;
+            }
+
+            return false;
+         }
+
+         template <typename T0, typename T1, typename T2, typename T3>
+         inline bool sf4ext_operands(const expression_ptr node, operand (&t)[4])
+         {
+            typedef sf4ext_type_node<T,T0,T1,T2,T3> sf4ext_t;
+
+            if (const sf4ext_t* n = dynamic_cast<const sf4ext_t*>(node))
+            {
+               t[0] = sf_operand<T0>(n->t0());
+               t[1] = sf_operand<T1>(n->t1());
+               t[2] = sf_operand<T2>(n->t2());
+               t[3] = sf_operand<T3>(n->t3());
+               return true;
+            }
+
+            return false;
+         }
+
+         // The id of an sf3ext/sf4ext operation spells out its formula, e.g. "(t+t)/t",
+         // the t being the operands in order. Ids that are not such a formula are left
+         // to e_call.
+         inline bool emit_sf3ext(const expression_ptr node, const std::size_t reg, operand& result)
+         {
+            if (!is_sf3ext_node(node))
+               return false;
+
+            typedef const T& v;
+            typedef const T  c;
+
+            operand t[4];
+
+            if (
+                 !sf3ext_operands<v,v,v>(node,t) && !sf3ext_operands<v,v,c>(node,t) &&
+                 !sf3ext_operands<v,c,v>(node,t) && !sf3ext_operands<c,v,v>(node,t) &&
+                 !sf3ext_operands<c,v,c>(node,t) && !sf3ext_operands<c,c,v>(node,t) &&
+                 !sf3ext_operands<v,c,c>(node,t) && !sf3ext_operands<c,c,c>(node,t)
+               )
+               return false;
+
+            return emit_formula(static_cast<const T0oT1oT2_base_node<T>*>(node)->type_id(), t, 3, reg, result);
+         }
+
+         inline bool emit_sf4ext(const expression_ptr node, const std::size_t reg, operand& result)
+         {
+            if (!is_sf4ext_node(node))
+               return false;
+
+            typedef const T& v;
+            typedef const T  c;
+
+            operand t[4];
+
+            if (
+                 !sf4ext_operands<v,v,v,v>(node,t) && !sf4ext_operands<v,v,v,c>(node,t) &&
+                 !sf4ext_operands<v,v,c,v>(node,t) && !sf4ext_operands<v,c,v,v>(node,t) &&
+                 !sf4ext_operands<c,v,v,v>(node,t) && !sf4ext_operands<c,v,c,v>(node,t) &&
+                 !sf4ext_operands<v,c,v,c>(node,t) && !sf4ext_operands<c,v,v,c>(node,t) &&
+                 !sf4ext_operands<v,c,c,v>(node,t)
+               )
+               return false;
+
+            return emit_formula(static_cast<const T0oT1oT2oT3_base_node<T>*>(node)->type_id(), t, 4, reg, result);
+         }
+
+         inline bool emit_formula(const std::string& id,
+                                  const operand (&t)[4], const std::size_t count,
+                                  const std::size_t reg, operand& result)
+         {
+            const std::size_t size = pending_.size();
+
+            std::size_t pos  = 0;
+            std::size_t next = 0;
+
+            if (
+                 emit_formula(id, pos, t, next, reg, result) &&
+                 (id.size() == pos) && (count == next)
+               )
+               return true;
+
+            pending_.resize(size);
+            return false;
+         }
+
+         // formula := term | term op term, term := 't' | '(' formula ')'
+         inline bool emit_formula(const std::string& id, std::size_t& pos,
+                                  const operand (&t)[4], std::size_t& next,
+                                  const std::size_t reg, operand& result)
+         {
+            operand arg0;
+            operand arg1;
+
+            if (!emit_term(id, pos, t, next, reg, arg0))
+               return false;
+
+            if ((pos == id.size()) || (')' == id[pos]))
+            {
+               result = arg0;
+               return true;
+            }
+
+            operator_type operation = details::e_default;
+
+            switch (id[pos++])
+            {
+               case '+' : operation = details::e_add; break;
+               case '-' : operation = details::e_sub; break;
+               case '*' : operation = details::e_mul; break;
+               case '/' : operation = details::e_div; break;
+               default  : return false;
+            }
+
+            if (!emit_term(id, pos, t, next, (operand::e_register == arg0.kind) ? reg + 1 : reg, arg1))
+               return false;
+
+            result = binary(operation, arg0, arg1, reg);
+            return true;
+         }
+
+         inline bool emit_term(const std::string& id, std::size_t& pos,
+                               const operand (&t)[4], std::size_t& next,
+                               const std::size_t reg, operand& result)
+         {
+            if (pos >= id.size())
+               return false;
+            else if ('t' == id[pos])
+            {
+               if (next >= 4)
+                  return false;
+
+               ++pos;
+               result = t[next++];
+               return true;
+            }
+            else if ('(' == id[pos])
+            {
+               ++pos;
+
+               if (!emit_formula(id, pos, t, next, reg, result))
+                  return false;
+               else if ((pos >= id.size()) || (')' != id[pos]))
+                  return false;
+
+               ++pos;
+               return true;
+            }
+
+            return false;
+         }
+
+         // Merge pairs of +-*/ instructions where the second consumes the register the
+         // first writes. Every register value has exactly one consumer, so the first
+         // result is not needed anywhere else. Jump targets are not merged into their
+         // predecessor.
+         inline void fuse()
+         {
+            const std::size_t n = pending_.size();
+
+            std::vector<bool> is_target(n + 1, false);
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+               if ((e_jump == pending_[i].type) || (e_jump_if_false == pending_[i].type))
+                  is_target[pending_[i].target] = true;
+            }
+
+            std::vector<std::size_t> index(n + 1, 0);
+            std::vector<pending_instruction> program;
+            program.reserve(n);
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+               index[i] = program.size();
+
+               if ((i + 1 < n) && !is_target[i + 1] && is_basic(pending_[i]) && is_basic(pending_[i + 1]))
+               {
+                  const pending_instruction& first  = pending_[i    ];
+                  const pending_instruction& second = pending_[i + 1];
+
+                  const bool left  = second.arg0.is_register(first.result);
+                  const bool right = second.arg1.is_register(first.result);
+
+                  if (left != right)
+                  {
+                     pending_instruction ins = second;
+
+                     ins.type = fused_type(first.type, second.type, right);
+                     ins.arg0 = first.arg0;
+                     ins.arg1 = first.arg1;
+                     ins.arg2 = left ? second.arg1 : second.arg0;
+
+                     program.push_back(ins);
+                     index[++i] = program.size() - 1;
+
+                     continue;
+                  }
+               }
+
+               program.push_back(pending_[i]);
+            }
+
+            index[n] = program.size();
+
+            for (std::size_t i = 0; i < program.size(); ++i)
+            {
+               if ((e_jump == program[i].type) || (e_jump_if_false == program[i].type))
+                  program[i].target = index[program[i].target];
+            }
+
+            pending_.swap(program);
+         }
+
+         static inline bool is_basic(const pending_instruction& ins)
+         {
+            switch (ins.type)
+            {
+               case e_add :
+               case e_sub :
+               case e_mul :
+               case e_div : return true;
+               default    : return false;
+            }
+         }
+
+         static inline instruction_type fused_type(const instruction_type first,
+                                                   const instruction_type second,
+                                                   const bool right)
+         {
+            return static_cast<instruction_type>(e_return + 1 + 2 * (4 * first + second) + (right ? 1 : 0));
+         }
+
+         // Nodes combining variables and constants only, safe to call as one instruction.
+         static inline bool is_leaf(const expression_ptr node)
+         {
+            switch (node->type())
+            {
+               case expression_node<T>::e_vov     :
+               case expression_node<T>::e_cov     :
+               case expression_node<T>::e_voc     :
+               case expression_node<T>::e_uvouv   :
+               case expression_node<T>::e_ipow    :
+               case expression_node<T>::e_ipowinv : return true;
+               default                            : break;
+            }
+
+            return is_t0ot1ot2_node(node) || is_t0ot1ot2ot3_node(node);
+         }
+
+         static inline bool unary_operation(const node_type& type, operator_type& operation)
+         {
+            switch (type)
+            {
+               #define case_stmt(op)                                       \
+               case expression_node<T>::op : operation = details::op;      \
+                                             return true;                  \
+
+               case_stmt(e_abs  ) case_stmt(e_acos ) case_stmt(e_acosh)
+               case_stmt(e_asin ) case_stmt(e_asinh) case_stmt(e_atan )
+               case_stmt(e_atanh) case_stmt(e_ceil ) case_stmt(e_cos  )
+               case_stmt(e_cosh ) case_stmt(e_exp  ) case_stmt(e_expm1)
+               case_stmt(e_floor) case_stmt(e_log  ) case_stmt(e_log10)
+               case_stmt(e_log2 ) case_stmt(e_log1p) case_stmt(e_neg  )
+               case_stmt(e_pos  ) case_stmt(e_round) case_stmt(e_sin  )
+               case_stmt(e_sinc ) case_stmt(e_sinh ) case_stmt(e_sqrt )
+               case_stmt(e_tan  ) case_stmt(e_tanh ) case_stmt(e_cot  )
+               case_stmt(e_sec  ) case_stmt(e_csc  ) case_stmt(e_r2d  )
+               case_stmt(e_d2r  ) case_stmt(e_d2g  ) case_stmt(e_g2d  )
+               case_stmt(e_notl ) case_stmt(e_sgn  ) case_stmt(e_erf  )
+               case_stmt(e_erfc ) case_stmt(e_ncdf ) case_stmt(e_frac )
+               case_stmt(e_trunc)
+               #undef case_stmt
+
+               default : return false;
+            }
+         }
+
+         flat_program_node(const flat_program_node<T>&);
+         flat_program_node<T>& operator=(const flat_program_node<T>&);
+
+         std::vector<instruction>         program_;
+         std::vector<T>                   data_;
+         std::vector<pending_instruction> pending_;
+         std::vector<T>                   constants_;
+         std::size_t                      constant_count_;
+         std::size_t                      registers_;
+         std::size_t                      branches_;
+      };
+
+      template <typename T>
+      class flat_batch_program
+      {
+      public:
+
+         // Evaluation of an expression tree over many rows at once. The tree is
+         // compiled into a flat_program_node (a single leaf is accepted here), the
+         // variables bound at compile() read their values from columns, every register
+         // of the program becomes a tile of tile_size rows and each instruction
+         // processes a whole tile in a plain loop the compiler can vectorize. Both
+         // alternatives of a conditional are evaluated, a select instruction picks the
+         // value of each row. Integer powers become repeated multiplications, other
+         // instructions calling node->value() are evaluated row by row, for them the
+         // bound variables are set to the values of the row, so they hold the values
+         // of some row afterwards.
+
+         typedef flat_program_node<T>                   program_t;
+         typedef typename program_t::instruction        program_instruction;
+         typedef typename program_t::instruction_type   instruction_type;
+         typedef expression_node<T>*                    expression_ptr;
+
+         enum { tile_size = 64 };
+
+         flat_batch_program()
+         : tiles_ (0),
+           result_(0)
+         {}
+
+         inline bool compile(expression_ptr root, const std::vector<T*>& variables)
+         {
+            return source_.compile(root, true) && translate(source_, variables);
+         }
+
+         // Evaluate rows [0,n), columns[i] holds the values of the i-th bound variable.
+         inline void value(const T* const* columns, T* result, const std::size_t n)
+         {
+            for (std::size_t i = 0; i < broadcast_.size(); ++i)
+            {
+               T* tile = &data_[broadcast_[i].second * tile_size];
+               std::fill(tile, tile + tile_size, *broadcast_[i].first);
+            }
+
+            for (std::size_t row = 0; row < n; row += tile_size)
+            {
+               const std::size_t size = std::min<std::size_t>(tile_size, n - row);
+
+               for (std::size_t i = 0; i < slots_.size(); ++i)
+               {
+                  if (slot_info::e_column == slots_[i].kind)
+                     pointers_[i] = columns[slots_[i].index] + row;
+               }
+
+               execute(size, columns, row);
+
+               const T* r = pointers_[result_];
+               std::copy(r, r + size, result + row);
+            }
+         }
+
+      private:
+
+         enum
+         {
+            e_select = program_t::e_fused_end,
+            e_ipow   ,
+            e_ipowinv
+         };
+
+         struct slot_info
+         {
+            enum kind_t { e_none, e_tile, e_column };
+
+            kind_t      kind;
+            std::size_t index;
+         };
+
+         struct condition
+         {
+            std::size_t mask;
+            std::size_t save;
+            std::size_t result;
+         };
+
+         struct instruction
+         {
+            int            type;
+            operator_type  operation;
+            std::size_t    result;
+            std::size_t    arg0;
+            std::size_t    arg1;
+            std::size_t    arg2;
+            expression_ptr node;
+            unsigned int   power;
+         };
+
+         inline bool translate(const program_t& program, const std::vector<T*>& variables)
+         {
+            const std::vector<program_instruction>& source = program.instructions();
+
+            program_   .clear();
+            slots_     .clear();
+            broadcast_ .clear();
+            conditions_.clear();
+            variables_ = variables;
+            tiles_     = program.register_count();
+
+            std::vector<std::vector<std::size_t> > ends(source.size() + 1);
+            std::vector<std::size_t> alternative(source.size() + 1, source.size());
+
+            for (std::size_t i = 0; i < source.size(); ++i)
+            {
+               const program_instruction& ins = source[i];
+
+               // Selects of conditionals ending here, the innermost first.
+               for (std::size_t j = ends[i].size(); j > 0; --j)
+               {
+                  const condition& c = conditions_[ends[i][j - 1]];
+                  push(e_select, c.result, tile_slot(c.mask), tile_slot(c.save));
+               }
+
+               std::size_t result = 0;
+
+               switch (ins.type)
+               {
+                  case program_t::e_jump_if_false :
+                     {
+                        condition c;
+                        c.mask   = tiles_++;
+                        c.save   = tiles_++;
+                        c.result = 0;
+
+                        push(program_t::e_copy, c.mask, slot(program, ins.arg0));
+
+                        alternative[ins.target] = conditions_.size();
+                        conditions_.push_back(c);
+                     }
+                     break;
+
+                  case program_t::e_jump :
+                     {
+                        // the consequent ends here, its value is in the result register
+                        if (
+                             (alternative[i + 1] >= conditions_.size()) ||
+                             !program.register_index(ins.result, result)
+                           )
+                           return false;
+
+                        condition& c = conditions_[alternative[i + 1]];
+                        c.result = result;
+
+                        push(program_t::e_copy, c.save, tile_slot(result));
+                        ends[ins.target].push_back(alternative[i + 1]);
+                     }
+                     break;
+
+                  case program_t::e_return :
+                     result_ = slot(program, ins.arg0);
+                     break;
+
+                  default :
+                     if (!program.register_index(ins.result, result))
+                        return false;
+
+                     if ((program_t::e_call == ins.type) && is_ipow_node(ins.node))
+                     {
+                        const ipow_base_node<T>* n = static_cast<const ipow_base_node<T>*>(ins.node);
+
+                        push((expression_node<T>::e_ipowinv == n->type()) ? e_ipowinv : e_ipow,
+                             result, slot(program, &n->v()));
+                        program_.back().power = n->power();
+                        break;
+                     }
+
+                     push(program_t::generic_type(ins.type), result,
+                          slot(program, ins.arg0),
+                          slot(program, ins.arg1),
+                          slot(program, ins.arg2),
+                          ins.operation, ins.node);
+                     break;
+               }
+            }
+
+            data_.assign(tiles_ * tile_size, T(0));
+            pointers_.resize(slots_.size());
+
+            for (std::size_t i = 0; i < slots_.size(); ++i)
+            {
+               if (slot_info::e_tile == slots_[i].kind)
+                  pointers_[i] = &data_[slots_[i].index * tile_size];
+            }
+
+            return true;
+         }
+
+         inline void push(const int type, const std::size_t result,
+                          const std::size_t arg0 = 0,
+                          const std::size_t arg1 = 0,
+                          const std::size_t arg2 = 0,
+                          const operator_type operation = details::e_default,
+                          const expression_ptr node = expression_ptr(0))
+         {
+            instruction ins;
+
+            ins.type      = type;
+            ins.operation = operation;
+            ins.result    = result;
+            ins.arg0      = arg0;
+            ins.arg1      = arg1;
+            ins.arg2      = arg2;
+            ins.node      = node;
+            ins.power     = 0;
+
+            program_.push_back(ins);
+         }
+
+         inline std::size_t add_slot(const typename slot_info::kind_t kind, const std::size_t index)
+         {
+            for (std::size_t i = 0; i < slots_.size(); ++i)
+            {
+               if ((kind == slots_[i].kind) && (index == slots_[i].index))
+                  return i;
+            }
+
+            slot_info s;
+            s.kind  = kind;
+            s.index = index;
+
+            slots_.push_back(s);
+
+            return slots_.size() - 1;
+         }
+
+         inline std::size_t tile_slot(const std::size_t tile)
+         {
+            return add_slot(slot_info::e_tile, tile);
+         }
+
+         // Registers are tiles, bound variables columns and all other variables and
+         // constants tiles filled with their value at the start of value().
+         inline std::size_t slot(const program_t& program, const T* p)
+         {
+            std::size_t index = 0;
+
+            if (0 == p)
+               return add_slot(slot_info::e_none, 0);
+            else if (program.register_index(p, index))
+               return tile_slot(index);
+
+            for (std::size_t i = 0; i < variables_.size(); ++i)
+            {
+               if (p == variables_[i])
+                  return add_slot(slot_info::e_column, i);
+            }
+
+            for (std::size_t i = 0; i < broadcast_.size(); ++i)
+            {
+               if (p == broadcast_[i].first)
+                  return tile_slot(broadcast_[i].second);
+            }
+
+            broadcast_.push_back(std::make_pair(p, tiles_++));
+
+            return tile_slot(broadcast_.back().second);
+         }
+
+         inline void execute(const std::size_t n, const T* const* columns, const std::size_t row)
+         {
+            for (std::size_t i = 0; i < program_.size(); ++i)
+            {
+               const instruction& ins = program_[i];
+
+               T*       r = &data_[ins.result * tile_size];
+               const T* a = pointers_[ins.arg0];
+               const T* b = pointers_[ins.arg1];
+               const T* c = pointers_[ins.arg2];
+
+               #define exprtk_batch_loop(expr)                  \
+               for (std::size_t k = 0; k < n; ++k) r[k] = expr; \
+
+               switch (ins.type)
+               {
+                  case program_t::e_add  : exprtk_batch_loop(a[k] + b[k]) break;
+                  case program_t::e_sub  : exprtk_batch_loop(a[k] - b[k]) break;
+                  case program_t::e_mul  : exprtk_batch_loop(a[k] * b[k]) break;
+                  case program_t::e_div  : exprtk_batch_loop(a[k] / b[k]) break;
+                  case program_t::e_neg  : exprtk_batch_loop(-a[k]      ) break;
+                  case program_t::e_copy : exprtk_batch_loop(a[k]       ) break;
+
+                  case e_select          : exprtk_batch_loop(is_true(a[k]) ? b[k] : r[k]) break;
+
+                  case e_ipow    :
+                  case e_ipowinv :
+                     {
+                        // left to right binary exponentiation, the leading bit is a itself
+                        unsigned int bit = 1;
+
+                        while (bit <= (ins.power >> 1))
+                        {
+                           bit <<= 1;
+                        }
+
+                        exprtk_batch_loop(a[k])
+
+                        for (bit >>= 1; bit; bit >>= 1)
+                        {
+                           exprtk_batch_loop(r[k] * r[k])
+
+                           if (ins.power & bit)
+                           {
+                              exprtk_batch_loop(r[k] * a[k])
+                           }
+                        }
+
+                        if (e_ipowinv == ins.type)
+                        {
+                           exprtk_batch_loop(T(1) / r[k])
+                        }
+                     }
+                     break;
+
+                  case program_t::e_unary :
+                     switch (ins.operation)
+                     {
+                        #define exprtk_batch_unary(op)                                  \
+                        case details::e_##op : exprtk_batch_loop(numeric::op(a[k])) break; \
+
+                        exprtk_batch_unary(abs  ) exprtk_batch_unary(sqrt ) exprtk_batch_unary(exp  )
+                        exprtk_batch_unary(log  ) exprtk_batch_unary(log10) exprtk_batch_unary(sin  )
+                        exprtk_batch_unary(cos  ) exprtk_batch_unary(tan  ) exprtk_batch_unary(floor)
+                        exprtk_batch_unary(ceil )
+                        #undef exprtk_batch_unary
+
+                        default : exprtk_batch_loop(numeric::process<T>(ins.operation,a[k])) break;
+                     }
+                     break;
+
+                  case program_t::e_binary :
+                     switch (ins.operation)
+                     {
+                        case details::e_pow : exprtk_batch_loop(numeric::pow<T>(a[k],b[k])  ) break;
+                        case details::e_min : exprtk_batch_loop(std::min<T>(a[k],b[k])      ) break;
+                        case details::e_max : exprtk_batch_loop(std::max<T>(a[k],b[k])      ) break;
+                        case details::e_lt  : exprtk_batch_loop((a[k] <  b[k]) ? T(1) : T(0)) break;
+                        case details::e_lte : exprtk_batch_loop((a[k] <= b[k]) ? T(1) : T(0)) break;
+                        case details::e_gt  : exprtk_batch_loop((a[k] >  b[k]) ? T(1) : T(0)) break;
+                        case details::e_gte : exprtk_batch_loop((a[k] >= b[k]) ? T(1) : T(0)) break;
+                        default : exprtk_batch_loop(numeric::process<T>(ins.operation,a[k],b[k])) break;
+                     }
+                     break;
+
+                  case program_t::e_call :
+                     for (std::size_t k = 0; k < n; ++k)
+                     {
+                        for (std::size_t v = 0; v < variables_.size(); ++v)
+                        {
+                           *variables_[v] = columns[v][row + k];
+                        }
+
+                        r[k] = ins.node->value();
+                     }
+                     break;
+
+                  #define exprtk_batch_fused_op(n0,o0,n1,o1)                                    \
+                  case program_t::e_##n0##_##n1##_l :                                           \
+                     exprtk_batch_loop((a[k] o0 b[k]) o1 c[k]) break;                           \
+                  case program_t::e_##n0##_##n1##_r :                                           \
+                     exprtk_batch_loop(c[k] o1 (a[k] o0 b[k])) break;                           \
+
+                  exprtk_flat_fused_list(exprtk_batch_fused_op)
+                  #undef exprtk_batch_fused_op
+
+                  default : break;
+               }
+
+               #undef exprtk_batch_loop
+            }
+         }
+
+         flat_batch_program(const flat_batch_program<T>&);
+         flat_batch_program<T>& operator=(const flat_batch_program<T>&);
+
+         program_t                                         source_;
+         std::vector<instruction>                          program_;
+         std::vector<slot_info>                            slots_;
+         std::vector<const T*>                             pointers_;
+         std::vector<std::pair<const T*,std::size_t> >     broadcast_;
+         std::vector<condition>                            conditions_;
+         std::vector<T*>                                   variables_;
+         std::vector<T>                                    data_;
+         std::size_t                                       tiles_;
+         std::size_t                                       result_;
+      };
+
+      #undef exprtk_flat_fused_list
+      #undef exprtk_flat_unary_list
+      #undef exprtk_flat_binary_list
+
+      class node_allocator
+      {
+      public:
+
+         node_allocator()
+         : arena_(0)
+         {}
+
+         inline node_arena* set_arena(node_arena* arena)
+         {
+            node_arena* previous = arena_;
+            arena_ = arena;
+            return previous;
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[1])
+         {
+            return allocate<ResultNode>(operation,branch[0]);
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[2])
+         {
+            return allocate<ResultNode>(operation,branch[0],branch[1]);
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[3])
+         {
+            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2]);
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[4])
+         {
+            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3]);
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[5])
+         {
+            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3],branch[4]);
+         }
+
+         template <typename ResultNode, typename OpType, typename ExprNode>
+         inline expression_node<typename ResultNode::value_type>* allocate(OpType& operation, ExprNode (&branch)[6])
+         {
+            return allocate<ResultNode>(operation,branch[0],branch[1],branch[2],branch[3],branch[4],branch[5]);
+         }
+
+         template <typename node_type>
+         inline expression_node<typename node_type::value_type>* allocate() const
+         {
+            return create<node_type>();
          }
 
          template <typename node_type,
@@ -13768,89 +15489,89 @@ namespace exprtk
                    template <typename,typename> class Sequence>
          inline expression_node<typename node_type::value_type>* allocate(const Sequence<Type,Allocator>& seq) const
          {
-            return new node_type(seq);
+            return create<node_type>(seq);
          }
 
          template <typename node_type, typename T1>
          inline expression_node<typename node_type::value_type>* allocate(T1& t1) const
          {
-            return new node_type(t1);
+            return create<node_type>(t1);
          }
 
          template <typename node_type, typename T1>
          inline expression_node<typename node_type::value_type>* allocate_c(const T1& t1) const
          {
-            return new node_type(t1);
+            return create<node_type>(t1);
          }
 
          template <typename node_type,
                    typename T1, typename T2>
          inline expression_node<typename node_type::value_type>* allocate(const T1& t1, const T2& t2) const
          {
-            return new node_type(t1,t2);
+            return create<node_type>(t1,t2);
          }
 
          template <typename node_type,
                    typename T1, typename T2>
          inline expression_node<typename node_type::value_type>* allocate_cr(const T1& t1, T2& t2) const
          {
-            return new node_type(t1,t2);
+            return create<node_type>(t1,t2);
          }
 
          template <typename node_type,
                    typename T1, typename T2>
          inline expression_node<typename node_type::value_type>* allocate_rc(T1& t1, const T2& t2) const
          {
-            return new node_type(t1,t2);
+            return create<node_type>(t1,t2);
          }
 
          template <typename node_type,
                    typename T1, typename T2>
          inline expression_node<typename node_type::value_type>* allocate_rr(T1& t1, T2& t2) const
          {
-            return new node_type(t1,t2);
+            return create<node_type>(t1,t2);
          }
 
          template <typename node_type,
                    typename T1, typename T2>
          inline expression_node<typename node_type::value_type>* allocate_tt(T1 t1, T2 t2) const
          {
-            return new node_type(t1,t2);
+            return create<node_type>(t1,t2);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3>
          inline expression_node<typename node_type::value_type>* allocate_ttt(T1 t1, T2 t2, T3 t3) const
          {
-            return new node_type(t1,t2,t3);
+            return create<node_type>(t1,t2,t3);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3, typename T4>
          inline expression_node<typename node_type::value_type>* allocate_tttt(T1 t1, T2 t2, T3 t3, T4 t4) const
          {
-            return new node_type(t1,t2,t3,t4);
+            return create<node_type>(t1,t2,t3,t4);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3>
          inline expression_node<typename node_type::value_type>* allocate_rrr(T1& t1, T2& t2, T3& t3) const
          {
-            return new node_type(t1,t2,t3);
+            return create<node_type>(t1,t2,t3);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3, typename T4>
          inline expression_node<typename node_type::value_type>* allocate_rrrr(T1& t1, T2& t2, T3& t3, T4& t4) const
          {
-            return new node_type(t1,t2,t3,t4);
+            return create<node_type>(t1,t2,t3,t4);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3, typename T4, typename T5>
          inline expression_node<typename node_type::value_type>* allocate_rrrrr(T1& t1, T2& t2, T3& t3, T4& t4, T5& t5) const
          {
-            return new node_type(t1,t2,t3,t4,t5);
+            return create<node_type>(t1,t2,t3,t4,t5);
          }
 
          template <typename node_type,
@@ -13858,7 +15579,7 @@ namespace exprtk
          inline expression_node<typename node_type::value_type>* allocate(const T1& t1, const T2& t2,
                                                                           const T3& t3) const
          {
-            return new node_type(t1,t2,t3);
+            return create<node_type>(t1,t2,t3);
          }
 
          template <typename node_type,
@@ -13867,7 +15588,7 @@ namespace exprtk
          inline expression_node<typename node_type::value_type>* allocate(const T1& t1, const T2& t2,
                                                                           const T3& t3, const T4& t4) const
          {
-            return new node_type(t1,t2,t3,t4);
+            return create<node_type>(t1,t2,t3,t4);
          }
 
          template <typename node_type,
@@ -13877,7 +15598,7 @@ namespace exprtk
                                                                           const T3& t3, const T4& t4,
                                                                           const T5& t5) const
          {
-            return new node_type(t1,t2,t3,t4,t5);
+            return create<node_type>(t1,t2,t3,t4,t5);
          }
 
          template <typename node_type,
@@ -13887,7 +15608,7 @@ namespace exprtk
                                                                           const T3& t3, const T4& t4,
                                                                           const T5& t5, const T6& t6) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6);
+            return create<node_type>(t1,t2,t3,t4,t5,t6);
          }
 
          template <typename node_type,
@@ -13899,7 +15620,7 @@ namespace exprtk
                                                                           const T5& t5, const T6& t6,
                                                                           const T7& t7) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6,t7);
+            return create<node_type>(t1,t2,t3,t4,t5,t6,t7);
          }
 
          template <typename node_type,
@@ -13912,7 +15633,7 @@ namespace exprtk
                                                                           const T5& t5, const T6& t6,
                                                                           const T7& t7, const T8& t8) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6,t7,t8);
+            return create<node_type>(t1,t2,t3,t4,t5,t6,t7,t8);
          }
 
          template <typename node_type,
@@ -13926,7 +15647,7 @@ namespace exprtk
                                                                           const T7& t7, const T8& t8,
                                                                           const T9& t9) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6,t7,t8,t9);
+            return create<node_type>(t1,t2,t3,t4,t5,t6,t7,t8,t9);
          }
 
          template <typename node_type,
@@ -13941,14 +15662,14 @@ namespace exprtk
                                                                           const T7& t7, const  T8&  t8,
                                                                           const T9& t9, const T10& t10) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6,t7,t8,t9,t10);
+            return create<node_type>(t1,t2,t3,t4,t5,t6,t7,t8,t9,t10);
          }
 
          template <typename node_type,
                    typename T1, typename T2, typename T3>
          inline expression_node<typename node_type::value_type>* allocate_type(T1 t1, T2 t2, T3 t3) const
          {
-            return new node_type(t1,t2,t3);
+            return create<node_type>(t1,t2,t3);
          }
 
          template <typename node_type,
@@ -13957,7 +15678,7 @@ namespace exprtk
          inline expression_node<typename node_type::value_type>* allocate_type(T1 t1, T2 t2,
                                                                                T3 t3, T4 t4) const
          {
-            return new node_type(t1,t2,t3,t4);
+            return create<node_type>(t1,t2,t3,t4);
          }
 
          template <typename node_type,
@@ -13968,7 +15689,7 @@ namespace exprtk
                                                                                T3 t3, T4 t4,
                                                                                T5 t5) const
          {
-            return new node_type(t1,t2,t3,t4,t5);
+            return create<node_type>(t1,t2,t3,t4,t5);
          }
 
          template <typename node_type,
@@ -13980,7 +15701,7 @@ namespace exprtk
                                                                                T5 t5, T6 t6,
                                                                                T7 t7) const
          {
-            return new node_type(t1,t2,t3,t4,t5,t6,t7);
+            return create<node_type>(t1,t2,t3,t4,t5,t6,t7);
          }
 
          template <typename T>
@@ -13989,6 +15710,21 @@ namespace exprtk
             delete e;
             e = 0;
          }
+
+      private:
+
+         // Nodes of an arena are arena_node<node_type>, see node_arena.
+         template <typename node_type, typename... Args>
+         inline expression_node<typename node_type::value_type>* create(Args&&... args) const
+         {
+            if (arena_)
+               return new (arena_->allocate(sizeof(arena_node<node_type>)))
+                          arena_node<node_type>(std::forward<Args>(args)...);
+            else
+               return new node_type(std::forward<Args>(args)...);
+         }
+
+         node_arena* arena_;
       };
 
       inline void load_operations_map(std::multimap<std::string,details::base_operation_t,details::ilesscompare>& m)
@@ -15783,7 +17519,10 @@ namespace exprtk
          expression_holder()
          : ref_count(0),
            expr     (0),
+           tree     (0),
            results  (0),
+           arena    (0),
+           batch    (0),
            retinv_null(false),
            return_invoked(&retinv_null)
          {}
@@ -15791,13 +17530,22 @@ namespace exprtk
          expression_holder(expression_ptr e)
          : ref_count(1),
            expr     (e),
+           tree     (0),
            results  (0),
+           arena    (0),
+           batch    (0),
            retinv_null(false),
            return_invoked(&retinv_null)
          {}
 
         ~expression_holder()
          {
+            if (tree)
+            {
+               delete expr;
+               expr = tree;
+            }
+
             if (expr && details::branch_deletable(expr))
             {
                delete expr;
@@ -15833,12 +17581,26 @@ namespace exprtk
             {
                delete results;
             }
+
+            if (batch)
+            {
+               delete batch;
+            }
+
+            if (arena)
+            {
+               details::node_arena::destroy(arena);
+            }
          }
 
          std::size_t ref_count;
          expression_ptr expr;
+         expression_ptr tree;
          local_data_list_t local_data_list;
          results_context_t* results;
+         details::node_arena* arena;
+         details::flat_batch_program<T>* batch;
+         std::vector<T*> batch_variables;
          bool  retinv_null;
          bool* return_invoked;
 
@@ -15974,6 +17736,102 @@ namespace exprtk
          return (*expression_holder_->return_invoked);
       }
 
+      // Replace tree evaluation by a linear register program, see details::flat_program_node.
+      // Returns false and keeps evaluating the tree if the expression contains nodes
+      // the program does not support (loops, assignments, strings, vectors, user
+      // functions etc.) or is too small to benefit. Copies of the expression share
+      // the program, it must not be evaluated concurrently.
+      inline bool flatten()
+      {
+         if (0 == expression_holder_)
+            return false;
+         else if (expression_holder_->tree)
+            return true;
+
+         details::flat_program_node<T>* program = new details::flat_program_node<T>();
+
+         if (!program->compile(expression_holder_->expr))
+         {
+            delete program;
+            return false;
+         }
+
+         expression_holder_->tree = expression_holder_->expr;
+         expression_holder_->expr = program;
+
+         return true;
+      }
+
+      inline bool flattened() const
+      {
+         return expression_holder_ && expression_holder_->tree;
+      }
+
+      // Prepare value(columns,result,n): variables[i] takes its values from columns[i].
+      // The tree is compiled into a tiled program, see details::flat_batch_program.
+      // Returns false if that is not possible, value() then copies every row into the
+      // variables and evaluates the expression. Both ways the variables are
+      // overwritten with values of the columns.
+      inline bool bind_columns(const std::vector<T*>& variables)
+      {
+         if (0 == expression_holder_)
+            return false;
+
+         if (expression_holder_->batch)
+         {
+            delete expression_holder_->batch;
+            expression_holder_->batch = 0;
+         }
+
+         expression_holder_->batch_variables = variables;
+
+         details::expression_node<T>* root = expression_holder_->tree ?
+                                             expression_holder_->tree :
+                                             expression_holder_->expr;
+
+         details::flat_batch_program<T>* batch = new details::flat_batch_program<T>();
+
+         if (!batch->compile(root, variables))
+         {
+            delete batch;
+            return false;
+         }
+
+         expression_holder_->batch = batch;
+
+         return true;
+      }
+
+      // Evaluate n rows into result, columns in the order of the bind_columns() variables.
+      inline void value(const T* const* columns, T* result, const std::size_t n)
+      {
+         if (expression_holder_->batch)
+         {
+            expression_holder_->batch->value(columns, result, n);
+            return;
+         }
+
+         const std::vector<T*>& variables = expression_holder_->batch_variables;
+
+         for (std::size_t i = 0; i < n; ++i)
+         {
+            for (std::size_t v = 0; v < variables.size(); ++v)
+            {
+               *variables[v] = columns[v][i];
+            }
+
+            result[i] = value();
+         }
+      }
+
+      inline std::size_t node_arena_size() const
+      {
+         if (expression_holder_ && expression_holder_->arena)
+            return expression_holder_->arena->size();
+         else
+            return 0;
+      }
+
    private:
 
       inline symtab_list_t get_symbol_table_list() const
@@ -16071,6 +17929,14 @@ namespace exprtk
          }
       }
 
+      inline void set_node_arena(details::node_arena* arena)
+      {
+         if (expression_holder_)
+         {
+            expression_holder_->arena = arena;
+         }
+      }
+
       inline void set_retinvk(bool* retinvk_ptr)
       {
          if (expression_holder_)
@@ -16094,27 +17960,37 @@ namespace exprtk
 
       static inline bool is_constant(const expression<T>& expr)
       {
-         return details::is_constant_node(expr.expression_holder_->expr);
+         return details::is_constant_node(root(expr));
       }
 
       static inline bool is_variable(const expression<T>& expr)
       {
-         return details::is_variable_node(expr.expression_holder_->expr);
+         return details::is_variable_node(root(expr));
       }
 
       static inline bool is_unary(const expression<T>& expr)
       {
-         return details::is_unary_node(expr.expression_holder_->expr);
+         return details::is_unary_node(root(expr));
       }
 
       static inline bool is_binary(const expression<T>& expr)
       {
-         return details::is_binary_node(expr.expression_holder_->expr);
+         return details::is_binary_node(root(expr));
       }
 
       static inline bool is_function(const expression<T>& expr)
       {
-         return details::is_function(expr.expression_holder_->expr);
+         return details::is_function(root(expr));
+      }
+
+   private:
+
+      static inline const details::expression_node<T>* root(const expression<T>& expr)
+      {
+         if (expr.expression_holder_->tree)
+            return expr.expression_holder_->tree;
+         else
+            return expr.expression_holder_->expr;
       }
    };
 
@@ -17342,7 +19218,8 @@ namespace exprtk
             e_collect_funcs        =  512,
             e_collect_assings      = 1024,
             e_disable_usr_on_rsrvd = 2048,
-            e_disable_zero_return  = 4096
+            e_disable_zero_return  = 4096,
+            e_node_arena           = 8192
          };
 
          enum settings_base_funcs
@@ -17520,6 +19397,18 @@ namespace exprtk
             return *this;
          }
 
+         settings_store& enable_node_arena()
+         {
+            enable_node_arena_ = true;
+            return *this;
+         }
+
+         settings_store& disable_node_arena()
+         {
+            enable_node_arena_ = false;
+            return *this;
+         }
+
          bool replacer_enabled           () const { return enable_replacer_;           }
          bool commutative_check_enabled  () const { return enable_commutative_check_;  }
          bool joiner_enabled             () const { return enable_joiner_;             }
@@ -17533,6 +19422,7 @@ namespace exprtk
          bool vardef_disabled            () const { return disable_vardef_;            }
          bool rsrvd_sym_usr_disabled     () const { return disable_rsrvd_sym_usr_;     }
          bool zero_return_disabled       () const { return disable_zero_return_;       }
+         bool node_arena_enabled         () const { return enable_node_arena_;         }
 
          bool function_enabled(const std::string& function_name)
          {
@@ -17833,6 +19723,7 @@ namespace exprtk
             disable_vardef_            = (compile_options & e_disable_vardef      ) == e_disable_vardef;
             disable_rsrvd_sym_usr_     = (compile_options & e_disable_usr_on_rsrvd) == e_disable_usr_on_rsrvd;
             disable_zero_return_       = (compile_options & e_disable_zero_return ) == e_disable_zero_return;
+            enable_node_arena_         = (compile_options & e_node_arena          ) == e_node_arena;
          }
 
          std::string assign_opr_to_string(details::operator_type opr)
@@ -17891,6 +19782,7 @@ namespace exprtk
          bool disable_vardef_;
          bool disable_rsrvd_sym_usr_;
          bool disable_zero_return_;
+         bool enable_node_arena_;
 
          disabled_entity_set_t disabled_func_set_ ;
          disabled_entity_set_t disabled_ctrl_set_ ;
@@ -18053,8 +19945,24 @@ namespace exprtk
 
          next_token();
 
+         // With the node arena enabled every node of the expression, including
+         // those discarded while optimising, is allocated from one arena that is
+         // handed over to the expression. Expressions take about 6 bytes of nodes
+         // per character, an arena starts in the remainder of the previous one
+         // if that is large enough.
+         details::node_arena* arena = settings_.node_arena_enabled() ?
+                                      details::node_arena::create(6 * expression_string.size(),node_arena_state_) : 0;
+         details::node_arena* previous_arena = node_allocator_.set_arena(arena);
+
          expression_node_ptr e = parse_corpus();
 
+         node_allocator_.set_arena(previous_arena);
+
+         if (arena)
+         {
+            arena->close(node_arena_state_);
+         }
+
          if ((0 != e) && (token_t::e_eof == current_token().type))
          {
             bool* retinvk_ptr = 0;
@@ -18068,6 +19976,7 @@ namespace exprtk
             }
 
             expr.set_expression(e);
+            expr.set_node_arena(arena);
             expr.set_retinvk(retinvk_ptr);
 
             register_local_vars(expr);
@@ -18094,6 +20003,11 @@ namespace exprtk
                delete e;
             }
 
+            if (arena)
+            {
+               details::node_arena::destroy(arena);
+            }
+
             return false;
          }
       }
@@ -31851,6 +33765,7 @@ namespace exprtk
       settings_store settings_;
       expression_generator<T> expression_generator_;
       details::node_allocator node_allocator_;
+      details::node_arena::parser_state node_arena_state_;
       symtab_store symtab_store_;
       dependent_entity_collector dec_;
       std::deque<parser_error::type> error_list_;
@@ -2588,12 +2588,6 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 {
     if(mData->mParseErrorType != FP_NO_ERROR) return Value_t(0);
 
-    const unsigned* const byteCode = &(mData->mByteCode[0]);
-    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
-    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
-    unsigned IP, DP=0;
-    int SP=-1;
-
 #ifdef FP_USE_THREAD_SAFE_EVAL
     /* If Eval() may be called by multiple threads simultaneously,
      * then Eval() must allocate its own stack.
@@ -2616,9 +2610,79 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 #endif
 #else
     /* No thread safety, so use a global stack. */
-    std::vector<Value_t>& Stack = mData->mStack;
+    Value_t* const Stack =
+        mData->mStack.empty() ? 0 : &(mData->mStack[0]);
 #endif
 
+    return EvalWithStack(Vars, 1, Stack, mData->mEvalErrorType);
+}
+
+/* Reentrant evaluation: the stack is provided by the caller and the error
+ * code is returned through evalError, so several threads may evaluate the
+ * same parser concurrently (as long as it contains no functions added with
+ * AddFunction(name, FunctionParserBase&), whose Eval() is not reentrant).
+ * scratch must hold at least GetStackSize() values.
+ */
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars,
+                                          Value_t* scratch,
+                                          int* evalError) const
+{
+    int evalErrorType = 0;
+    Value_t result = Value_t(0);
+    if(mData->mParseErrorType == FP_NO_ERROR)
+        result = EvalWithStack(Vars, 1, scratch, evalErrorType);
+    if(evalError) *evalError = evalErrorType;
+    return result;
+}
+
+/* Evaluates n rows of structure-of-arrays input: the value of variable k in
+ * row i is varsSoA[k*stride + i]. The bytecode loop reads the variables in
+ * place and one stack is used for all rows. Returns the error code of the
+ * last failing row (its result is 0), or 0.
+ */
+template<typename Value_t>
+int FunctionParserBase<Value_t>::EvalBatch(const Value_t* varsSoA,
+                                           std::size_t stride,
+                                           std::size_t n,
+                                           Value_t* out) const
+{
+    if(mData->mParseErrorType != FP_NO_ERROR)
+    {
+        for(std::size_t i = 0; i < n; ++i) out[i] = Value_t(0);
+        return 0;
+    }
+
+    std::vector<Value_t> stack(GetStackSize());
+
+    int lastError = 0;
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        int evalErrorType = 0;
+        out[i] = EvalWithStack(varsSoA + i, stride, &stack[0], evalErrorType);
+        if(evalErrorType) lastError = evalErrorType;
+    }
+    return lastError;
+}
+
+template<typename Value_t>
+unsigned FunctionParserBase<Value_t>::GetStackSize() const
+{
+    return mData->mStackSize ? mData->mStackSize : 1;
+}
+
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalWithStack(const Value_t* Vars,
+                                                   std::size_t VarStride,
+                                                   Value_t* Stack,
+                                                   int& evalErrorType) const
+{
+    const unsigned* const byteCode = &(mData->mByteCode[0]);
+    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
+    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
+    unsigned IP, DP=0;
+    int SP=-1;
+
     for(IP=0; IP<byteCodeSize; ++IP)
     {
         switch(byteCode[IP])
@@ -2629,19 +2693,19 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
           case  cAcos:
               if(IsComplexType<Value_t>::result == false
               && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalErrorType=4; return Value_t(0); }
               Stack[SP] = fp_acos(Stack[SP]); break;
 
           case cAcosh:
               if(IsComplexType<Value_t>::result == false
               && Stack[SP] < Value_t(1))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalErrorType=4; return Value_t(0); }
               Stack[SP] = fp_acosh(Stack[SP]); break;
 
           case  cAsin:
               if(IsComplexType<Value_t>::result == false
               && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalErrorType=4; return Value_t(0); }
               Stack[SP] = fp_asin(Stack[SP]); break;
 
           case cAsinh: Stack[SP] = fp_asinh(Stack[SP]); break;
@@ -2655,7 +2719,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
               ?  (Stack[SP] == Value_t(-1) || Stack[SP] == Value_t(1))
               :  (Stack[SP] <= Value_t(-1) || Stack[SP] >= Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalErrorType=4; return Value_t(0); }
               Stack[SP] = fp_atanh(Stack[SP]); break;
 
           case  cCbrt: Stack[SP] = fp_cbrt(Stack[SP]); break;
@@ -2670,7 +2734,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t t = fp_tan(Stack[SP]);
                   if(t == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalErrorType=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/t; break;
               }
 
@@ -2678,7 +2742,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t s = fp_sin(Stack[SP]);
                   if(s == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalErrorType=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/s; break;
               }
 
@@ -2710,14 +2774,14 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalErrorType=3; return Value_t(0); }
               Stack[SP] = fp_log(Stack[SP]); break;
 
           case cLog10:
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalErrorType=3; return Value_t(0); }
               Stack[SP] = fp_log10(Stack[SP]);
               break;
 
@@ -2725,7 +2789,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalErrorType=3; return Value_t(0); }
               Stack[SP] = fp_log2(Stack[SP]);
               break;
 
@@ -2746,7 +2810,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               // x:0 ^ y:negative is failure
               if(Stack[SP-1] == Value_t(0) &&
                  Stack[SP] < Value_t(0))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalErrorType=3; return Value_t(0); }
               Stack[SP-1] = fp_pow(Stack[SP-1], Stack[SP]);
               --SP; break;
 
@@ -2756,7 +2820,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t c = fp_cos(Stack[SP]);
                   if(c == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalErrorType=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/c; break;
               }
 
@@ -2767,7 +2831,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
           case  cSqrt:
               if(IsComplexType<Value_t>::result == false &&
                  Stack[SP] < Value_t(0))
-              { mData->mEvalErrorType=2; return Value_t(0); }
+              { evalErrorType=2; return Value_t(0); }
               Stack[SP] = fp_sqrt(Stack[SP]); break;
 
           case   cTan: Stack[SP] = fp_tan(Stack[SP]); break;
@@ -2794,12 +2858,12 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cDiv:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalErrorType=1; return Value_t(0); }
               Stack[SP-1] /= Stack[SP]; --SP; break;
 
           case   cMod:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalErrorType=1; return Value_t(0); }
               Stack[SP-1] = fp_mod(Stack[SP-1], Stack[SP]);
               --SP; break;
 
@@ -2871,7 +2935,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
                       mData->mFuncParsers[index].mParserPtr->EvalError();
                   if(error)
                   {
-                      mData->mEvalErrorType = error;
+                      evalErrorType = error;
                       return 0;
                   }
                   break;
@@ -2899,7 +2963,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP-1] == Value_t(0)
                :   !(Stack[SP-1] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalErrorType=3; return Value_t(0); }
               Stack[SP-1] = fp_log2(Stack[SP-1]) * Stack[SP];
               --SP;
               break;
@@ -2941,7 +3005,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cInv:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalErrorType=1; return Value_t(0); }
               Stack[SP] = Value_t(1)/Stack[SP];
               break;
 
@@ -2951,14 +3015,14 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cRDiv:
               if(Stack[SP-1] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalErrorType=1; return Value_t(0); }
               Stack[SP-1] = Stack[SP] / Stack[SP-1]; --SP; break;
 
           case   cRSub: Stack[SP-1] = Stack[SP] - Stack[SP-1]; --SP; break;
 
           case   cRSqrt:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalErrorType=1; return Value_t(0); }
               Stack[SP] = Value_t(1) / fp_sqrt(Stack[SP]); break;
 
 #ifdef FP_SUPPORT_COMPLEX_NUMBERS
@@ -2974,15 +3038,319 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
 // Variables:
           default:
-              Stack[++SP] = Vars[byteCode[IP]-VarBegin];
+              Stack[++SP] = Vars[(byteCode[IP]-VarBegin)*VarStride];
         }
     }
 
-    mData->mEvalErrorType=0;
+    evalErrorType=0;
     return Stack[SP];
 }
 
 
+//===========================================================================
+// Bytecode serialization
+//===========================================================================
+/* Format (native byte order):
+     char[4]   "FPBC"
+     unsigned  format version
+     unsigned  type tag of Value_t, sizeof(Value_t)
+     unsigned  VarBegin (changes with the opcode set of the library)
+     unsigned  amount of functions and of function parsers
+     unsigned  stack size, bytecode size, immed size, variable string size
+     unsigned  amount of variables
+     unsigned  bytecode[bytecode size]
+     Value_t   immed[immed size]
+     char      variables[variable string size]
+   Functions are referenced by index, so a parser loading the bytecode must
+   have the same functions added in the same order as the one saving it.
+*/
+namespace
+{
+    const char BytecodeMagic[4] = { 'F', 'P', 'B', 'C' };
+    const unsigned BytecodeFormatVersion = 2;
+
+    // Upper bound of the stack, bytecode, immed and variable string sizes
+    // accepted by LoadBytecode, so a damaged header cannot allocate much.
+    const unsigned BytecodeMaxLength = 1U << 22;
+
+    // Types whose values are stored as raw bytes, 0 for the others.
+    template<typename Value_t> struct BytecodeTypeTag { enum { value = 0 }; };
+    template<> struct BytecodeTypeTag<double> { enum { value = 1 }; };
+    template<> struct BytecodeTypeTag<float> { enum { value = 2 }; };
+    template<> struct BytecodeTypeTag<long double> { enum { value = 3 }; };
+    template<> struct BytecodeTypeTag<long> { enum { value = 4 }; };
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+    template<> struct BytecodeTypeTag<std::complex<double> >
+    { enum { value = 5 }; };
+    template<> struct BytecodeTypeTag<std::complex<float> >
+    { enum { value = 6 }; };
+    template<> struct BytecodeTypeTag<std::complex<long double> >
+    { enum { value = 7 }; };
+#endif
+
+    template<typename T>
+    inline void writeRaw(std::ostream& os, const T* data, std::size_t amount)
+    {
+        if(amount)
+            os.write(reinterpret_cast<const char*>(data),
+                     std::streamsize(amount * sizeof(T)));
+    }
+
+    template<typename T>
+    inline bool readRaw(std::istream& is, T* data, std::size_t amount)
+    {
+        if(amount)
+            is.read(reinterpret_cast<char*>(data),
+                    std::streamsize(amount * sizeof(T)));
+        return bool(is);
+    }
+}
+
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::SaveBytecode(std::ostream& os) const
+{
+    if(BytecodeTypeTag<Value_t>::value == 0) return false;
+    if(mData->mParseErrorType != FP_NO_ERROR) return false;
+
+    const unsigned header[] =
+    {
+        BytecodeFormatVersion,
+        unsigned(BytecodeTypeTag<Value_t>::value),
+        unsigned(sizeof(Value_t)),
+        unsigned(VarBegin),
+        unsigned(mData->mFuncPtrs.size()),
+        unsigned(mData->mFuncParsers.size()),
+        mData->mStackSize,
+        unsigned(mData->mByteCode.size()),
+        unsigned(mData->mImmed.size()),
+        unsigned(mData->mVariablesString.size()),
+        mData->mVariablesAmount
+    };
+
+    os.write(BytecodeMagic, sizeof(BytecodeMagic));
+    writeRaw(os, header, sizeof(header)/sizeof(header[0]));
+    writeRaw(os, mData->mByteCode.empty() ? 0 : &mData->mByteCode[0],
+             mData->mByteCode.size());
+    writeRaw(os, mData->mImmed.empty() ? 0 : &mData->mImmed[0],
+             mData->mImmed.size());
+    writeRaw(os, mData->mVariablesString.c_str(),
+             mData->mVariablesString.size());
+    return bool(os);
+}
+
+/* Replaces the parsed function and the variables with the ones read from
+   the stream. Returns false if the data is malformed, was saved by a
+   different library version or for a different Value_t, or the functions
+   added to this parser do not match. The bytecode is verified before the
+   parser is modified, a rejected record leaves it unchanged. Only if the
+   variable names clash with identifiers of this parser the previous
+   function is lost and GetParseErrorType() returns INVALID_VARS.
+*/
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::LoadBytecode(std::istream& is)
+{
+    if(BytecodeTypeTag<Value_t>::value == 0) return false;
+
+    char magic[sizeof(BytecodeMagic)];
+    unsigned header[11];
+    if(!readRaw(is, magic, sizeof(magic))
+    || std::memcmp(magic, BytecodeMagic, sizeof(magic)) != 0
+    || !readRaw(is, header, sizeof(header)/sizeof(header[0])))
+        return false;
+
+    if(header[0] != BytecodeFormatVersion
+    || header[1] != unsigned(BytecodeTypeTag<Value_t>::value)
+    || header[2] != unsigned(sizeof(Value_t))
+    || header[3] != unsigned(VarBegin)
+    || header[4] != mData->mFuncPtrs.size()
+    || header[5] != mData->mFuncParsers.size()
+    || header[6] > BytecodeMaxLength
+    || header[7] == 0 || header[7] > BytecodeMaxLength
+    || header[8] > BytecodeMaxLength
+    || header[9] > BytecodeMaxLength
+    || header[10] > header[9])
+        return false;
+
+    const unsigned stackSize = header[6];
+    const unsigned varAmount = header[10];
+    std::vector<unsigned> byteCode(header[7]);
+    std::vector<Value_t> immed(header[8]);
+    std::string vars(header[9], ' ');
+    if(!readRaw(is, &byteCode[0], byteCode.size())
+    || !readRaw(is, immed.empty() ? 0 : &immed[0], immed.size())
+    || !readRaw(is, vars.empty() ? 0 : &vars[0], vars.size()))
+        return false;
+
+    if(!VerifyBytecode(byteCode, unsigned(immed.size()), varAmount, stackSize))
+        return false;
+
+    CopyOnWrite();
+
+    if(!ParseVariables(vars) || mData->mVariablesAmount != varAmount)
+    {
+        mData->mParseErrorType = INVALID_VARS;
+        return false;
+    }
+
+    mData->mByteCode.swap(byteCode);
+    mData->mImmed.swap(immed);
+    mData->mStackSize = stackSize;
+    mData->mParseErrorType = FP_NO_ERROR;
+    mData->mEvalErrorType = 0;
+    mData->mHasByteCodeFlags = false;
+
+#ifndef FP_USE_THREAD_SAFE_EVAL
+    mData->mStack.resize(stackSize);
+#endif
+
+    return true;
+}
+
+/* Checks that Eval() of the given bytecode stays within its buffers: every
+   opcode is known and has its operands, functions and variables exist,
+   cImmed reads below immedSize and the stack never holds more than
+   stackSize or fewer values than an opcode pops. Jumps must go forward,
+   so the stack depth and immed index at each instruction are known once
+   all instructions before it are checked; every path must reach it with
+   the same ones.
+*/
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::VerifyBytecode
+(const std::vector<unsigned>& byteCode, unsigned immedSize,
+ unsigned varAmount, unsigned stackSize) const
+{
+    const unsigned size = unsigned(byteCode.size());
+    std::vector<int> depthAt(size+1, -1);
+    std::vector<unsigned> dpAt(size+1, 0);
+    depthAt[0] = 0;
+
+    struct Flow
+    {
+        std::vector<int>& depthAt;
+        std::vector<unsigned>& dpAt;
+
+        bool to(unsigned ip, int depth, unsigned dp) const
+        {
+            if(depthAt[ip] < 0)
+            {
+                depthAt[ip] = depth;
+                dpAt[ip] = dp;
+                return true;
+            }
+            return depthAt[ip] == depth && dpAt[ip] == dp;
+        }
+    } flow = { depthAt, dpAt };
+
+    for(unsigned IP = 0; IP < size; ++IP)
+    {
+        int depth = depthAt[IP];
+        unsigned dp = dpAt[IP];
+        if(depth < 0) continue; // operand or not reachable
+
+        const unsigned opcode = byteCode[IP];
+        int pops = 0, pushes = 0;
+        unsigned operands = 0;
+
+        switch(opcode)
+        {
+          case cAbs: case cAcos: case cAcosh: case cAsin: case cAsinh:
+          case cAtan: case cAtanh: case cCbrt: case cCeil: case cCos:
+          case cCosh: case cCot: case cCsc: case cExp: case cExp2:
+          case cFloor: case cInt: case cLog: case cLog10: case cLog2:
+          case cTrunc: case cSec: case cSin: case cSinh: case cSqrt:
+          case cTan: case cTanh: case cNeg: case cNot: case cNotNot:
+          case cDeg: case cRad: case cAbsNot: case cAbsNotNot:
+          case cInv: case cSqr: case cRSqrt:
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+          case cReal: case cImag: case cArg: case cConj:
+#endif
+              pops = 1; pushes = 1; break;
+
+          case cAtan2: case cHypot: case cMax: case cMin: case cPow:
+          case cAdd: case cSub: case cMul: case cDiv: case cMod:
+          case cEqual: case cNEqual: case cLess: case cLessOrEq:
+          case cGreater: case cGreaterOrEq: case cAnd: case cOr:
+          case cAbsAnd: case cAbsOr: case cRDiv: case cRSub:
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+          case cPolar:
+#endif
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cLog2by:
+#endif
+              pops = 2; pushes = 1; break;
+
+          case cSinCos: case cSinhCosh: case cDup:
+              pops = 1; pushes = 2; break;
+
+          case cImmed:
+              if(dp >= immedSize) return false;
+              ++dp; pushes = 1; break;
+
+          case cIf: case cAbsIf: case cJump:
+          {
+              if(IP + 2 >= size) return false;
+              const unsigned target = byteCode[IP+1];
+              if(target < IP + 2 || target >= size) return false;
+              if(opcode != cJump)
+              {
+                  if(depth < 1) return false;
+                  --depth;
+                  if(!flow.to(IP+3, depth, dp)) return false;
+              }
+              if(!flow.to(target+1, depth, byteCode[IP+2])) return false;
+              IP += 2;
+              continue;
+          }
+
+          case cFCall: case cPCall:
+          {
+              if(IP + 1 >= size) return false;
+              const unsigned index = byteCode[IP+1];
+              if(opcode == cFCall
+                 ? index >= mData->mFuncPtrs.size()
+                 : index >= mData->mFuncParsers.size())
+                  return false;
+              pops = int(opcode == cFCall ? mData->mFuncPtrs[index].mParams
+                                          : mData->mFuncParsers[index].mParams);
+              pushes = 1; operands = 1;
+              break;
+          }
+
+          case cFetch:
+              if(IP + 1 >= size || byteCode[IP+1] >= unsigned(depth))
+                  return false;
+              pushes = 1; operands = 1; break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cPopNMov:
+              if(IP + 2 >= size
+              || byteCode[IP+1] >= unsigned(depth)
+              || byteCode[IP+2] >= unsigned(depth))
+                  return false;
+              pops = depth; pushes = int(byteCode[IP+1]) + 1; operands = 2;
+              break;
+
+          case cNop: break;
+#endif
+
+          default:
+              if(opcode < VarBegin || opcode - VarBegin >= varAmount)
+                  return false;
+              pushes = 1; break;
+        }
+
+        if(depth < pops || unsigned(depth - pops + pushes) > stackSize)
+            return false;
+        depth += pushes - pops;
+
+        IP += operands;
+        if(!flow.to(IP+1, depth, dp)) return false;
+    }
+
+    return depthAt[size] >= 1;
+}
+
+
 //===========================================================================
 // Variable deduction
 //===========================================================================
@@ -59,6 +59,14 @@ class FunctionParserBase
     Value_t Eval(const Value_t* Vars);
     int EvalError() const;
 
+    // Reentrant evaluation with a caller provided stack of GetStackSize()
+    // values, and evaluation of many rows given as one array per variable.
+    Value_t Eval(const Value_t* Vars, Value_t* scratch,
+                 int* evalError = 0) const;
+    int EvalBatch(const Value_t* varsSoA, std::size_t stride, std::size_t n,
+                  Value_t* out) const;
+    unsigned GetStackSize() const;
+
     bool AddConstant(const std::string& name, Value_t value);
     bool AddUnit(const std::string& name, Value_t value);
 
@@ -80,6 +88,10 @@ class FunctionParserBase
 
     void Optimize();
 
+    // Store the (optimized) bytecode, and restore it without parsing.
+    bool SaveBytecode(std::ostream&) const;
+    bool LoadBytecode(std::istream&);
+
 
     int ParseAndDeduceVariables(const std::string& function,
                                 int* amountOfVariablesFound = 0,
@@ -146,12 +158,15 @@ class FunctionParserBase
     bool CheckRecursiveLinking(const FunctionParserBase*) const;
     bool NameExists(const char*, unsigned);
     bool ParseVariables(const std::string&);
+    bool VerifyBytecode(const std::vector<unsigned>&, unsigned, unsigned,
+                        unsigned) const;
     int ParseFunction(const char*, bool);
     const char* SetErrorType(ParseErrorType, const char*);
 
     void AddFunctionOpcode(unsigned);
     void AddImmedOpcode(Value_t v);
     void incStackPtr();
+    Value_t EvalWithStack(const Value_t*, std::size_t, Value_t*, int&) const;
     void CompilePowi(long);
     bool TryCompilePowi(Value_t);
 
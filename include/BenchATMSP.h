@@ -11,19 +11,29 @@ class BenchATMSP : public Benchmark
 {
 public:
 
-  BenchATMSP();
+  BenchATMSP(bool bFused = false);
 
   double DoBenchmark(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
 
-  void PreprocessExpr(std::vector<std::string> &vExpr);
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+  double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+
+  FootprintResult DoFootprintBenchmark(const std::vector<std::string> &vExpr);
 
   void PreprocessExpr(std::string &vExpr);
 
 private:
 
+  double DoBenchmarkFused(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatchFused(const std::string &sExpr, const BatchColumns &cols);
+
   std::string replaceAll(std::string result,
                          const std::string& replaceWhat,
                          const std::string& replaceWithWhat);
+
+  bool m_bFused;
 };
 
 #endif
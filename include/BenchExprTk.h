@@ -11,10 +11,41 @@ class BenchExprTk : public Benchmark
 {
 public:
 
-  BenchExprTk();
+  enum EMode
+  {
+    STANDARD,   ///< nodes allocated one by one on the heap
+    MEMO,       ///< evaluation through a MemoCache keyed on the used variables
+    ARENA,      ///< all nodes of an expression in one bump arena
+    FLAT,       ///< tree linearized into a register program where possible
+    BATCH       ///< all rows at once, variables bound to columns and evaluated in tiles
+  };
+
+  BenchExprTk(EMode eMode = STANDARD);
 
   double DoBenchmark(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
+
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+  double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+
+  FootprintResult DoFootprintBenchmark(const std::vector<std::string> &vExpr);
+
+  std::size_t PrewarmExprCache(const std::vector<std::string> &vExpr);
+  bool GetExprCacheStats(ExprCacheStats &stats) const;
+
+protected:
+
+  bool LookupCompiled(const std::string &sExpr);
+
+private:
+
+  struct CachedExpr;
+
+  std::shared_ptr<CachedExpr> CompileCached(const std::string &sExpr) const;
 
+  EMode m_eMode;
+  ExprCache<CachedExpr> m_cache;
 };
 
 #endif
@@ -14,6 +14,9 @@ public:
   BenchExprTkFloat();
 
   double DoBenchmark(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
+
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
 
 };
 
@@ -9,10 +9,32 @@ class BenchFParser : public Benchmark
 {
 public:
 
-   BenchFParser();
+   BenchFParser(bool bShared = false);
 
    double DoBenchmark(const std::string &sExpr, long iCount);
+   double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
 
+   double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+   double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+
+   std::size_t PrewarmExprCache(const std::vector<std::string> &vExpr);
+   bool GetExprCacheStats(ExprCacheStats &stats) const;
+   StartupResult DoStartupBenchmark(const std::vector<std::string> &vExpr,
+                                    const std::string &sFile);
+
+protected:
+
+   bool LookupCompiled(const std::string &sExpr);
+
+private:
+
+   struct CachedExpr;
+
+   std::shared_ptr<CachedExpr> CompileCached(const std::string &sExpr) const;
+
+   bool m_bShared;
+   ExprCache<CachedExpr> m_cache;
 };
 
 #endif
\ No newline at end of file
@@ -11,10 +11,22 @@ class BenchLepton : public Benchmark
 {
 public:
 
-   BenchLepton();
+   BenchLepton(bool bSlots = false);
 
    double DoBenchmark(const std::string &sExpr, long iCount);
+   double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
 
+   double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+   double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+
+   GradientResult DoGradientBenchmark(const std::string &sExpr, long iCount);
+
+private:
+
+   double DoBenchmarkSlots(const std::string &sExpr, long iCount);
+
+   bool m_bSlots;
 };
 
 #endif
@@ -15,6 +15,8 @@ public:
 
    double DoBenchmark(const std::string &sExpr, long iCount);
 
+   double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
 };
 
 #endif
@@ -11,10 +11,16 @@ class BenchMathExpr : public Benchmark
 {
 public:
 
-  BenchMathExpr();
+  BenchMathExpr(bool bFlat = false);
 
   double DoBenchmark(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
 
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+private:
+
+  bool m_bFlat;
 };
 
 #endif
@@ -2,20 +2,44 @@
 #define BENCH_MUPARSER_2_H
 
 #include "Benchmark.h"
+#include "cpuid.h"
 
 
 //-------------------------------------------------------------------------------------------------
 class BenchMuParser2 : public Benchmark
 {
 public:
-   BenchMuParser2(bool bEnableOptimizer = true);
+
+   enum EMode
+   {
+      STANDARD,   ///< one Eval() per row
+      BULK,       ///< Eval(results, n), rows distributed over OpenMP threads
+      BLOCK,      ///< EvalBlocked(results, n), bytecode executed once per block of rows
+      JIT,        ///< one Eval() per row, bytecode translated into native code
+      REGCODE,    ///< one Eval() per row, bytecode translated into register code
+      MEMO        ///< one Eval() per row through a MemoCache keyed on the used variables
+   };
+
+   BenchMuParser2(EMode eMode = STANDARD, simd_level_t eSimd = SIMD_NONE);
    double DoBenchmark(const std::string &sExpr, long iCount);
+   double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
+   double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+   double DoCompileBenchmark(const std::string &sExpr, long iCount);
    std::string GetShortName() const;
-   virtual void PreprocessExpr(std::vector<std::string> &vExpr);
    virtual void PreprocessExpr(std::string &s);
+   std::size_t PrewarmExprCache(const std::vector<std::string> &vExpr);
+   bool GetExprCacheStats(ExprCacheStats &stats) const;
+
+protected:
+   bool LookupCompiled(const std::string &sExpr);
 
 private:
-   bool m_bUseBulkMode;
+   struct CachedExpr;
+
+   std::shared_ptr<CachedExpr> CompileCached(const std::string &sExpr) const;
+
+   EMode m_eMode;
+   ExprCache<CachedExpr> m_cache;
    double DoBenchmarkBulk(const std::string &sExpr, long iCount);
    double DoBenchmarkStd(const std::string &sExpr, long iCount);
 };
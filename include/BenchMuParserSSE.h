@@ -15,7 +15,9 @@ public:
 
   double DoBenchmark(const std::string &sExpr, long iCount);
 
-  std::string BenchMuParserSSE::GetShortName() const;
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+  std::string GetShortName() const;
 
 };
 
@@ -9,12 +9,21 @@ class BenchMuParserX : public Benchmark
 {
 public:
 
-  BenchMuParserX();
+  BenchMuParserX(bool bFastPath = false);
 
   double DoBenchmark(const std::string &sExpr, long iCount);
+  double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
+  double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+
+  double DoCompileBenchmark(const std::string &sExpr, long iCount);
+
+  bool GetPoolStats(PoolStats &stats) const;
 
   std::string GetShortName() const;
 
+private:
+
+  bool m_bFastPath;
 };
 
 #endif
@@ -4,7 +4,126 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <functional>
 #include "Stopwatch.h"
+#include "Statistics.h"
+#include "MemoCache.h"
+#include "ExprCache.h"
+#include "ExprCorpus.h"
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Common start line for the threads of a multi-threaded benchmark.
+
+  Every worker calls Arrive() once its private setup (parsing, variable binding) is done and
+  is released together with all others when the controlling thread calls Open(). This keeps
+  setup work out of the timed section.
+*/
+class StartGate
+{
+public:
+   StartGate(int nThreads);
+
+   void Arrive();
+   void Abandon();
+   void WaitForAll() const;
+   void Open();
+
+private:
+   int m_nThreads;
+   std::atomic<int> m_nArrived;
+   std::atomic<bool> m_bOpen;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Structure of arrays input of the batch benchmarks, one column per variable.
+
+  Row i holds the values the scalar benchmarks use in their i-th iteration, so evaluating all
+  rows yields the same sum as DoBenchmark.
+*/
+struct BatchColumns
+{
+   BatchColumns(long nRows);
+
+   long rows;
+   std::vector<double> a;
+   std::vector<double> b;
+   std::vector<double> c;
+   std::vector<double> x;
+   std::vector<double> y;
+   std::vector<double> z;
+   std::vector<double> w;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Outcome of Benchmark::DoStartupBenchmark, times are in ms for all formulas. */
+struct StartupResult
+{
+   StartupResult();
+
+   bool supported;
+   std::size_t formulas;      ///< formulas the application starts with
+   std::size_t failed;        ///< formulas that did not compile
+   std::size_t mismatches;    ///< restored formulas evaluating differently from compiled ones
+   std::size_t bytes;         ///< size of the stored compiled forms
+   double coldTime;           ///< compiling (and optimizing) every formula
+   double saveTime;           ///< writing the compiled forms
+   double warmTime;           ///< reading the compiled forms back
+   std::string failReason;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Outcome of Benchmark::DoFootprintBenchmark. */
+struct FootprintResult
+{
+   FootprintResult();
+
+   bool supported;
+   std::size_t formulas;      ///< compiled formulas held at the same time
+   std::size_t failed;        ///< formulas that did not compile
+   std::size_t bytes;         ///< heap still held once all formulas are compiled, 0 if not measurable
+   double compileTime;        ///< compiling all formulas in ms
+   double evalTime;           ///< evaluating every held formula once in ms
+   double sum;                ///< sum of these results, equal for equivalent engines
+   std::string failReason;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Outcome of Benchmark::DoGradientBenchmark, times are in ms for all iterations. */
+struct GradientResult
+{
+   GradientResult();
+
+   bool supported;
+   int variables;             ///< number of partial derivatives computed per iteration
+   double value;              ///< value of the expression
+   double gradientSum;        ///< sum of the partial derivatives, equal for equivalent engines
+   double deviation;          ///< largest relative difference of a partial derivative between the methods
+   double adTime;             ///< value and gradient in one automatic differentiation sweep
+   double symbolicTime;       ///< value and every symbolic derivative evaluated separately
+   std::string failReason;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Counters of the memory pool of a parser, see Benchmark::GetPoolStats. */
+struct PoolStats
+{
+   PoolStats();
+
+   std::size_t hits;          ///< allocations served from a free list
+   std::size_t misses;        ///< allocations that requested memory from the system
+   std::size_t remoteFrees;   ///< blocks released by a thread that did not allocate them
+   std::size_t live;          ///< blocks in use
+   std::size_t peakLive;      ///< peak number of blocks in use
+   std::size_t bytes;         ///< memory requested from the system
+   std::size_t pools;         ///< number of thread pools
+};
 
 
 //-------------------------------------------------------------------------------------------------
@@ -25,13 +144,27 @@ public:
    Benchmark(EBaseType eBaseType = DOUBLE);
    virtual ~Benchmark();
 
-   void DoAll(std::vector<std::string> vExpr, long num);
+   void DoAll(const ExprCorpus &vExpr, long num);
 
    virtual double DoBenchmark(const std::string &sExpr, long iCount) = 0;
-   virtual void PreprocessExpr(std::vector<std::string> &vExpr);
+   double DoBenchmarkRepeated(const std::string &sExpr, long iCount, int nWarmup, int nRepeat,
+                              const BatchColumns *pBatch = nullptr);
+   virtual double DoBenchmarkBatch(const std::string &sExpr, const BatchColumns &cols);
+   virtual double DoBenchmarkThreaded(const std::string &sExpr, long iCount, int nThreads);
+   virtual double DoCompileBenchmark(const std::string &sExpr, long iCount);
+   double DoCompileBenchmarkWithMemory(const std::string &sExpr, long iCount);
+   double DoWarmCompileBenchmark(const std::string &sExpr, long iCount);
+   virtual std::size_t PrewarmExprCache(const std::vector<std::string> &vExpr);
+   virtual bool GetExprCacheStats(ExprCacheStats &stats) const;
+   virtual bool GetPoolStats(PoolStats &stats) const;
+   virtual StartupResult DoStartupBenchmark(const std::vector<std::string> &vExpr,
+                                            const std::string &sFile);
+   virtual FootprintResult DoFootprintBenchmark(const std::vector<std::string> &vExpr);
+   virtual GradientResult DoGradientBenchmark(const std::string &sExpr, long iCount);
    virtual void PreprocessExpr(std::string & /*vExpr*/) {};
    virtual std::string GetShortName() const;
    std::string GetName() const;
+   const std::string &GetInfo() const;
    std::string GetBaseType() const;
    void Reset();
 
@@ -59,8 +192,37 @@ public:
    double GetRate(const std::size_t& index) const;
    void IgnoreLastRate();
 
+   double GetCompileTime() const;
+   std::size_t GetCompileMemory() const;
+   bool CompileFailed() const;
+   const std::string &GetCompileFailReason() const;
+   void AddCompilePoints(int pt);
+   int GetCompilePoints() const;
+   void AddCompileScore(double sc);
+   double GetCompileScore() const;
+   double GetWarmCompileTime() const;
+
+   const std::vector<double> &GetSamples() const;
+   const SampleStats &GetStats() const;
+
+   std::size_t GetMemoHits() const;
+   std::size_t GetMemoMisses() const;
+   double GetMemoThroughput() const;
+
 protected:
 
+   typedef std::function<double (int nThread, StartGate &gate, double &fRes)> thread_worker_type;
+
+   double RunThreaded(int nThreads, long iCount, const thread_worker_type &worker);
+
+   virtual bool LookupCompiled(const std::string &sExpr);
+
+   void StartCompileTimer();
+   double StopCompileTimer(long iCount);
+   double StopCompileTimerAndReport(const std::string &msg);
+
+   void AddMemoStats(const MemoCache &cache);
+
    std::string m_sName;
    std::string m_sInfo;
    int m_nTotalBytecodeSize;
@@ -76,6 +238,20 @@ protected:
    EBaseType m_eBaseType;
    std::map<std::string, std::string> m_allFails;
    std::vector<double> rate_list;
+   std::vector<double> m_vSamples;
+   SampleStats m_stats;
+   Stopwatch m_compileTimer;
+   double m_fCompileTime;
+   std::size_t m_nCompileMemory;
+   bool m_bCountCompileMemory;
+   bool m_bCompileFail;
+   std::string m_sCompileFailReason;
+   int m_nCompilePoints;
+   double m_fCompileScore;
+   double m_fWarmCompileTime;
+   std::size_t m_nMemoHits;
+   std::size_t m_nMemoMisses;
+   double m_fMemoTime;
 };
 
 #endif
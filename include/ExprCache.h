@@ -0,0 +1,231 @@
+#ifndef EXPR_CACHE_H
+#define EXPR_CACHE_H
+
+#include <cstddef>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Counters of an ExprCache. */
+struct ExprCacheStats
+{
+   ExprCacheStats()
+     :hits(0)
+     ,misses(0)
+     ,evictions(0)
+     ,size(0)
+     ,capacity(0)
+   {}
+
+   std::size_t hits;
+   std::size_t misses;
+   std::size_t evictions;
+   std::size_t size;
+   std::size_t capacity;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Size bounded LRU cache of compiled expressions.
+
+  Entries are keyed on the normalized expression text plus a signature string describing
+  everything else the compiled form depends on (variable and constant names, parser options).
+  On a miss the compile function is called outside the lock, so a slow compilation does not
+  block lookups of other threads; if two threads miss on the same key the first insertion wins.
+
+  The cache hands out shared pointers, an evicted entry stays alive as long as someone uses it.
+  Compiled expressions bind their variables, so an entry must only be evaluated by one thread
+  at a time.
+*/
+template<typename TEntry>
+class ExprCache
+{
+public:
+
+   typedef std::shared_ptr<TEntry> entry_ptr;
+   typedef std::function<entry_ptr (const std::string &sExpr)> compile_fun;
+
+   ExprCache(std::size_t nCapacity = 1024)
+     :m_nCapacity(nCapacity ? nCapacity : 1)
+     ,m_lru()
+     ,m_index()
+     ,m_stats()
+     ,m_mtx()
+   {}
+
+   /** \brief Return the compiled form of sExpr, compiling and inserting it on a miss.
+
+     Returns an empty pointer if compile does, failures are not cached.
+   */
+   entry_ptr Get(const std::string &sExpr, const std::string &sSignature, const compile_fun &compile)
+   {
+      const std::string sKey = sSignature + '\n' + Normalize(sExpr);
+
+      {
+         std::lock_guard<std::mutex> lock(m_mtx);
+
+         typename index_type::iterator it = m_index.find(sKey);
+         if (it != m_index.end())
+         {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            ++m_stats.hits;
+            return it->second->second;
+         }
+
+         ++m_stats.misses;
+      }
+
+      entry_ptr pEntry = compile(sExpr);
+      if (!pEntry)
+         return pEntry;
+
+      std::lock_guard<std::mutex> lock(m_mtx);
+
+      typename index_type::iterator it = m_index.find(sKey);
+      if (it != m_index.end())
+         return it->second->second;
+
+      m_lru.push_front(std::make_pair(sKey, pEntry));
+      m_index[sKey] = m_lru.begin();
+
+      while (m_lru.size() > m_nCapacity)
+      {
+         m_index.erase(m_lru.back().first);
+         m_lru.pop_back();
+         ++m_stats.evictions;
+      }
+
+      return pEntry;
+   }
+
+   /** \brief Compile all expressions ahead of time.
+
+     Returns the number of expressions that are in the cache afterwards, which is less than
+     vExpr.size() if some failed to compile or the capacity is too small.
+   */
+   std::size_t Prewarm(const std::vector<std::string> &vExpr,
+                       const std::string &sSignature,
+                       const compile_fun &compile)
+   {
+      std::size_t nOk = 0;
+      for (std::size_t i = 0; i < vExpr.size(); ++i)
+      {
+         if (Get(vExpr[i], sSignature, compile))
+            ++nOk;
+      }
+
+      std::lock_guard<std::mutex> lock(m_mtx);
+      return std::min(nOk, m_lru.size());
+   }
+
+   ExprCacheStats GetStats() const
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      ExprCacheStats stats = m_stats;
+      stats.size     = m_lru.size();
+      stats.capacity = m_nCapacity;
+      return stats;
+   }
+
+   void Clear()
+   {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_lru.clear();
+      m_index.clear();
+      m_stats = ExprCacheStats();
+   }
+
+   /** \brief Drop whitespace outside of string literals unless it separates two tokens.
+
+     Expressions differing in spacing only ("a+b" and "a + b ") share one entry. A single
+     blank is kept where dropping it could join two tokens: "a and b", "a< =b", and the
+     sign of an exponent as in "1e -3".
+   */
+   static std::string Normalize(const std::string &sExpr)
+   {
+      std::string s;
+      s.reserve(sExpr.size());
+
+      char cQuote = 0;
+      bool bBlank = false;
+      for (std::size_t i = 0; i < sExpr.size(); ++i)
+      {
+         const char c = sExpr[i];
+
+         if (cQuote)
+         {
+            if (c == cQuote)
+               cQuote = 0;
+         }
+         else if (std::isspace((unsigned char)c))
+         {
+            bBlank = true;
+            continue;
+         }
+         else if (c == '"' || c == '\'')
+         {
+            cQuote = c;
+         }
+
+         if (bBlank && !s.empty() && IsJoinable(s, c))
+            s += ' ';
+
+         bBlank = false;
+         s += c;
+      }
+
+      return s;
+   }
+
+private:
+
+   static bool IsWordChar(char c)
+   {
+      return std::isalnum((unsigned char)c) || c == '_' || c == '.';
+   }
+
+   static bool IsSeparator(char c)
+   {
+      return std::strchr("()[]{},;", c) != 0;
+   }
+
+   /** \brief True if c directly after the text of s could form a token with its end. */
+   static bool IsJoinable(const std::string &s, char c)
+   {
+      const char cPrev = s[s.size() - 1];
+
+      if (IsSeparator(cPrev) || IsSeparator(c))
+         return false;
+
+      if (IsWordChar(cPrev) == IsWordChar(c))
+         return true;
+
+      // "1e -3" and "1e- 3" are not the number 1e-3
+      if ((cPrev == 'e' || cPrev == 'E') && (c == '+' || c == '-'))
+         return true;
+
+      return (cPrev == '+' || cPrev == '-') && IsWordChar(c) &&
+             s.size() >= 2 && (s[s.size() - 2] == 'e' || s[s.size() - 2] == 'E');
+   }
+
+   typedef std::list<std::pair<std::string, entry_ptr> > lru_type;   ///< front is the most recent
+   typedef std::unordered_map<std::string, typename lru_type::iterator> index_type;
+
+   std::size_t m_nCapacity;
+   lru_type m_lru;
+   index_type m_index;
+   ExprCacheStats m_stats;
+   mutable std::mutex m_mtx;
+};
+
+#endif
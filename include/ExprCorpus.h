@@ -0,0 +1,115 @@
+#ifndef EXPR_CORPUS_H
+#define EXPR_CORPUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Non owning reference to one expression of an ExprCorpus.
+
+  Points into the mapped file, so the text is not zero terminated. Print it with "%.*s" or
+  turn it into a string with str().
+*/
+struct ExprView
+{
+   ExprView()
+     :data(nullptr)
+     ,size(0)
+   {}
+
+   ExprView(const char *pData, std::size_t nSize)
+     :data(pData)
+     ,size(nSize)
+   {}
+
+   std::string str() const
+   {
+      return std::string(data, size);
+   }
+
+   int length() const
+   {
+      return (int)size;
+   }
+
+   const char *data;
+   std::size_t size;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Read only, memory mapped benchmark file.
+
+  The file is mapped as a whole and every expression is a view into the mapping, loading does
+  not copy any text. Blank lines and lines starting with '#' are skipped, a trailing '\r' is
+  not part of the expression.
+
+  Finding the lines needs a scan over the whole file. Its result, the offset and length of
+  every expression, is stored next to the file (<file>.idx) and reused as long as size and
+  modification time of the file match. If the index cannot be written the scan simply
+  happens again next time.
+*/
+class ExprCorpus
+{
+public:
+
+   ExprCorpus();
+   ~ExprCorpus();
+
+   bool Load(const std::string &sFile);
+   void Close();
+
+   std::size_t size() const
+   {
+      return m_vIndex.size();
+   }
+
+   bool empty() const
+   {
+      return m_vIndex.empty();
+   }
+
+   ExprView operator[](std::size_t i) const
+   {
+      return ExprView(m_pData + m_vIndex[i].offset, m_vIndex[i].length);
+   }
+
+   bool IndexFromCache() const
+   {
+      return m_bIndexFromCache;
+   }
+
+private:
+
+   ExprCorpus(const ExprCorpus&);
+   ExprCorpus& operator=(const ExprCorpus&);
+
+   struct Entry
+   {
+      unsigned long long offset;
+      unsigned int length;
+      unsigned int reserved;   ///< always 0, the entries are written to the index as they are
+   };
+
+   bool Map(const std::string &sFile);
+   void Scan();
+   bool ReadIndex(const std::string &sFile);
+   void WriteIndex(const std::string &sFile) const;
+
+   const char *m_pData;
+   std::size_t m_nSize;
+   long long m_nModified;     ///< modification time of the file, part of the index key
+   std::vector<Entry> m_vIndex;
+   bool m_bIndexFromCache;
+
+#ifdef WIN32
+   void *m_hFile;
+   void *m_hMapping;
+#else
+   int m_fd;
+#endif
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef MEMO_CACHE_H
+#define MEMO_CACHE_H
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Direct-mapped cache of expression results keyed on the values of its variables.
+
+  Bind() takes the addresses of the variables the expression actually references. Eval() hashes
+  their current values, and if the slot holds the same values (compared bitwise, so NaN and
+  -0 are handled) the stored result is returned instead of evaluating. A different key in the
+  slot is simply overwritten.
+
+  The cache is only correct for expressions without side effects whose functions depend on
+  their arguments alone.
+*/
+class MemoCache
+{
+public:
+
+   MemoCache(std::size_t nSlots = 64);
+
+   void Bind(const std::vector<const double*> &vVars);
+
+   std::size_t GetHits() const;
+   std::size_t GetMisses() const;
+   double GetHitRate() const;
+   void ResetStats();
+
+   template<typename TEval>
+   double Eval(TEval eval)
+   {
+      const std::size_t nVars = m_vVars.size();
+      const double* const *pVars = nVars ? &m_vVars[0] : 0;
+
+      uint64_t h = 14695981039346656037ULL;
+      for (std::size_t i = 0; i < nVars; ++i)
+      {
+         h = (h ^ Bits(pVars[i])) * 1099511628211ULL;
+      }
+
+      // Values often differ in the exponent only (a, 2a), fold the high bits into the index.
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+
+      const std::size_t slot = (std::size_t)h & m_nMask;
+      uint64_t *pKey = nVars ? &m_vSlotKey[slot * nVars] : 0;
+
+      if (m_vValid[slot])
+      {
+         std::size_t i = 0;
+         while (i < nVars && pKey[i] == Bits(pVars[i]))
+            ++i;
+
+         if (i == nVars)
+         {
+            ++m_nHits;
+            return m_vResult[slot];
+         }
+      }
+
+      ++m_nMisses;
+
+      for (std::size_t i = 0; i < nVars; ++i)
+      {
+         pKey[i] = Bits(pVars[i]);
+      }
+
+      const double fRes = eval();
+      m_vResult[slot] = fRes;
+      m_vValid[slot] = 1;
+      return fRes;
+   }
+
+private:
+
+   static uint64_t Bits(const double *pVal)
+   {
+      uint64_t n;
+      std::memcpy(&n, pVal, sizeof(n));
+      return n;
+   }
+
+   std::size_t m_nMask;
+   std::vector<const double*> m_vVars;
+   std::vector<uint64_t> m_vSlotKey;    ///< bit patterns of the values stored per slot
+   std::vector<double> m_vResult;
+   std::vector<unsigned char> m_vValid;
+   std::size_t m_nHits;
+   std::size_t m_nMisses;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MEMORY_COUNTER_H
+#define MEMORY_COUNTER_H
+
+#include <cstddef>
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Heap high-water mark of a code section.
+
+  The global operator new/delete are replaced to account the usable size of every block
+  allocated or freed between Start() and Stop(). Only blocks allocated inside the section
+  are subtracted when freed, blocks that existed before Start() do not lower the level.
+  Outside such a section the only overhead is a relaxed load of the enable flag per
+  allocation.
+*/
+class MemoryCounter
+{
+public:
+
+   static bool IsAvailable();
+   static void Start();
+   static std::size_t Current();
+   static std::size_t Stop();
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cstddef>
+#include <vector>
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Robust summary of the repeated timings of one parser on one expression. */
+struct SampleStats
+{
+   SampleStats();
+
+   bool Overlaps(const SampleStats &other) const;
+
+   std::size_t n;    ///< number of samples (warmup rounds excluded)
+   double median;
+   double mad;       ///< median absolute deviation from the median
+   double ci_lo;     ///< lower bound of the bootstrap confidence interval of the median
+   double ci_hi;     ///< upper bound of the bootstrap confidence interval of the median
+};
+
+double Median(std::vector<double> v);
+double MedianAbsDeviation(const std::vector<double> &v, double fMedian);
+SampleStats ComputeStats(const std::vector<double> &vSamples,
+                         double fConfidence = 0.95,
+                         int nResamples = 1000);
+
+#endif
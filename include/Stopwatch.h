@@ -17,99 +17,81 @@
 #   include <sys/types.h>
 #endif
 
+//-------------------------------------------------------------------------------------------------
+/** \brief Interval timer used by all benchmarks.
+
+  The clock source is selected once per process (see SelectBackend / SelectBestBackend) and
+  shared by every Stopwatch instance. Raw ticks are stored on Start/Stop, conversion to
+  seconds happens in time() using the calibrated tick period of the active backend.
+*/
 class Stopwatch
 {
 public:
 
-#ifdef WIN32
-   Stopwatch()
-   : in_use_(false)
+   enum EBackend
    {
-      QueryPerformanceFrequency(&clock_frequency_);
-   }
-
-   inline void Start()
-   {
-      in_use_ = true;
-      QueryPerformanceCounter(&start_time_);
-   }
-
-   inline double Stop()
-   {
-      QueryPerformanceCounter(&stop_time_);
-      in_use_ = false;
-      return (time() * 1000.0);
-   }
-
-   inline double time() const
-   {
-      return (1.0 * (stop_time_.QuadPart - start_time_.QuadPart)) / (1.0 * clock_frequency_.QuadPart);
-   }
-
-#else
+      GETTIMEOFDAY,     ///< POSIX gettimeofday, microsecond resolution, subject to NTP slews
+      MONOTONIC_RAW,    ///< clock_gettime(CLOCK_MONOTONIC_RAW), not slewed
+      TSC,              ///< invariant time stamp counter, calibrated against MONOTONIC_RAW
+      QPC               ///< QueryPerformanceCounter (Windows only)
+   };
 
    Stopwatch()
    : in_use_(false)
-   {
-      start_time_.tv_sec  = 0;
-      start_time_.tv_usec = 0;
-      stop_time_.tv_sec   = 0;
-      stop_time_.tv_usec  = 0;
-   }
+   , start_time_(0)
+   , stop_time_(0)
+   {}
 
    inline void Start()
    {
       in_use_ = true;
-      gettimeofday(&start_time_,0);
+      start_time_ = ticks();
    }
 
    inline double Stop()
    {
-      gettimeofday(&stop_time_, 0);
+      stop_time_ = ticks();
       in_use_ = false;
       return (time() * 1000.0);
    }
 
    inline unsigned long long int usec_time() const
    {
-      if (!in_use_)
-      {
-         if (stop_time_.tv_sec >= start_time_.tv_sec)
-         {
-            return 1000000 * (stop_time_.tv_sec  - start_time_.tv_sec ) +
-               (stop_time_.tv_usec - start_time_.tv_usec);
-         }
-         else
-            return std::numeric_limits<unsigned long long int>::max();
-      }
+      if (!in_use_ && (stop_time_ >= start_time_))
+         return (unsigned long long int)(time() * 1000000.0);
       else
          return std::numeric_limits<unsigned long long int>::max();
    }
 
    inline double time() const
    {
-      return usec_time() * 0.000001;
+      return (stop_time_ - start_time_) * s_fSecPerTick;
    }
 
-#endif
-
    inline bool in_use() const
    {
       return in_use_;
    }
 
+   static bool SelectBackend(EBackend eBackend);
+   static EBackend SelectBestBackend();
+   static EBackend GetBackend();
+   static const char* GetBackendName();
+   static double GetResolution();
+   static double GetOverhead();
+
 private:
 
-   bool in_use_;
+   static unsigned long long int ticks();
+   static double MeasureOverhead();
 
-#ifdef WIN32
-   LARGE_INTEGER start_time_;
-   LARGE_INTEGER stop_time_;
-   LARGE_INTEGER clock_frequency_;
-#else
-   struct timeval start_time_;
-   struct timeval stop_time_;
-#endif
+   static EBackend s_eBackend;
+   static double   s_fSecPerTick;
+   static double   s_fOverhead;
+
+   bool in_use_;
+   unsigned long long int start_time_;
+   unsigned long long int stop_time_;
 };
 
 #endif
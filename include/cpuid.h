@@ -4,6 +4,15 @@
 #include <cstdio>
 #include <fstream>
 
+enum simd_level_t
+{
+   SIMD_NONE,
+   SIMD_AVX2,
+   SIMD_AVX512
+};
+
 void dump_cpuid(FILE* file);
+simd_level_t detect_simd_level();
+const char* simd_level_str(simd_level_t level);
 
 #endif
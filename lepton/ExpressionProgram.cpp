@@ -32,16 +32,17 @@
 #include "ExpressionProgram.h"
 #include "Operation.h"
 #include "ParsedExpression.h"
+#include "MSVC_erfc.h"
 
 #include <algorithm>
 
 using namespace Lepton;
 using namespace std;
 
-ExpressionProgram::ExpressionProgram() : maxArgs(0), stackSize(0) {
+ExpressionProgram::ExpressionProgram() : maxArgs(0), stackSize(0), numSlots(0), hasSlots(false) {
 }
 
-ExpressionProgram::ExpressionProgram(const ParsedExpression& expression) : maxArgs(0), stackSize(0) {
+ExpressionProgram::ExpressionProgram(const ParsedExpression& expression) : maxArgs(0), stackSize(0), numSlots(0), hasSlots(false) {
     buildProgram(expression.getRootNode());
     int currentStackSize = 0;
     for (int i = 0; i < (int) operations.size(); i++) {
@@ -52,11 +53,14 @@ ExpressionProgram::ExpressionProgram(const ParsedExpression& expression) : maxAr
         if (currentStackSize > stackSize)
             stackSize = currentStackSize;
     }
+    buildInstructions();
 }
 
 ExpressionProgram::~ExpressionProgram() {
     for (int i = 0; i < (int) operations.size(); i++)
         delete operations[i];
+    for (int i = 0; i < (int) derivatives.size(); i++)
+        delete derivatives[i];
 }
 
 ExpressionProgram::ExpressionProgram(const ExpressionProgram& program) {
@@ -64,11 +68,20 @@ ExpressionProgram::ExpressionProgram(const ExpressionProgram& program) {
 }
 
 ExpressionProgram& ExpressionProgram::operator=(const ExpressionProgram& program) {
+    if (this == &program)
+        return *this;
     maxArgs = program.maxArgs;
     stackSize = program.stackSize;
+    numSlots = program.numSlots;
+    hasSlots = program.hasSlots;
+    for (int i = 0; i < (int) operations.size(); i++)
+        delete operations[i];
     operations.resize(program.operations.size());
     for (int i = 0; i < (int) operations.size(); i++)
         operations[i] = program.operations[i]->clone();
+    buildInstructions();
+    for (int i = 0; i < (int) instructions.size(); i++)
+        instructions[i].slot = program.instructions[i].slot;
     return *this;
 }
 
@@ -78,6 +91,52 @@ void ExpressionProgram::buildProgram(const ExpressionTreeNode& node) {
     operations.push_back(node.getOperation().clone());
 }
 
+void ExpressionProgram::buildInstructions() {
+    for (int i = 0; i < (int) derivatives.size(); i++)
+        delete derivatives[i];
+    derivatives.clear();
+    argIndex.clear();
+    argStart.resize(operations.size()+1);
+    instructions.resize(operations.size());
+    vector<int> producers;
+    for (int i = 0; i < (int) operations.size(); i++) {
+        const Operation& op = *operations[i];
+        Instruction& instr = instructions[i];
+        instr.op = op.getId();
+        instr.numArgs = op.getNumArguments();
+        instr.slot = -1;
+        instr.value = 0.0;
+        instr.operation = &op;
+        argStart[i] = argIndex.size();
+        for (int j = 0; j < instr.numArgs; j++) {
+            argIndex.push_back(producers.back());
+            producers.pop_back();
+            if (instr.op == Operation::CUSTOM)
+                derivatives.push_back(new Operation::Custom(static_cast<const Operation::Custom&>(op), j));
+            else
+                derivatives.push_back(NULL);
+        }
+        producers.push_back(i);
+        switch (instr.op) {
+            case Operation::CONSTANT:
+                instr.value = static_cast<const Operation::Constant&>(op).getValue();
+                break;
+            case Operation::ADD_CONSTANT:
+                instr.value = static_cast<const Operation::AddConstant&>(op).getValue();
+                break;
+            case Operation::MULTIPLY_CONSTANT:
+                instr.value = static_cast<const Operation::MultiplyConstant&>(op).getValue();
+                break;
+            case Operation::POWER_CONSTANT:
+                instr.value = static_cast<const Operation::PowerConstant&>(op).getValue();
+                break;
+            default:
+                break;
+        }
+    }
+    argStart[operations.size()] = argIndex.size();
+}
+
 int ExpressionProgram::getNumOperations() const {
     return operations.size();
 }
@@ -95,14 +154,430 @@ double ExpressionProgram::evaluate() const {
 }
 
 double ExpressionProgram::evaluate(const std::map<std::string, double>& variables) const {
-    vector<double> args(max(maxArgs, 1));
-    vector<double> stack(stackSize);
-    int stackPointer = 0;
-    for (int i = 0; i < (int) operations.size(); i++) {
-        int numArgs = operations[i]->getNumArguments();
-        for (int j = 0; j < numArgs; j++)
-            args[j] = stack[--stackPointer];
-        stack[stackPointer++] = operations[i]->evaluate(&args[0], variables);
+    vector<double> scratch(getScratchSize());
+    return execute(&scratch[0], NULL, variables);
+}
+
+void ExpressionProgram::setVariableSlots(const vector<string>& names) {
+    for (int i = 0; i < (int) instructions.size(); i++) {
+        if (instructions[i].op != Operation::VARIABLE)
+            continue;
+        const string& name = operations[i]->getName();
+        vector<string>::const_iterator iter = find(names.begin(), names.end(), name);
+        if (iter == names.end())
+            throw Exception("No slot specified for variable "+name);
+        instructions[i].slot = (int) (iter-names.begin());
+    }
+    numSlots = names.size();
+    hasSlots = true;
+}
+
+int ExpressionProgram::getScratchSize() const {
+    return stackSize+max(maxArgs, 1);
+}
+
+double ExpressionProgram::evaluate(const double* values, double* scratch) const {
+    static const map<string, double> noVariables;
+    if (!hasSlots)
+        throw Exception("setVariableSlots() has not been called");
+    return execute(scratch, values, noVariables);
+}
+
+double ExpressionProgram::evaluate(const double* values) const {
+    static thread_local vector<double> scratch;
+    if ((int) scratch.size() < getScratchSize())
+        scratch.resize(getScratchSize());
+    return evaluate(values, &scratch[0]);
+}
+
+int ExpressionProgram::getGradientScratchSize() const {
+    return 2*instructions.size()+max(maxArgs, 1);
+}
+
+double ExpressionProgram::evaluateGradient(const double* values, double* gradient, double* scratch) const {
+    static const map<string, double> noVariables;
+    if (!hasSlots)
+        throw Exception("setVariableSlots() has not been called");
+    int numInstructions = instructions.size();
+    double* value = scratch;
+    double* adjoint = scratch+numInstructions;
+    double* args = scratch+2*numInstructions;
+    const int* index = argIndex.data();
+
+    // Forward sweep, the value of every instruction is kept for the backward sweep.
+    for (int i = 0; i < numInstructions; i++) {
+        const Instruction& instr = instructions[i];
+        const int* arg = index+argStart[i];
+        double x = (instr.numArgs > 0 ? value[arg[0]] : 0.0);
+        switch (instr.op) {
+            case Operation::CONSTANT:
+                value[i] = instr.value;
+                break;
+            case Operation::VARIABLE:
+                value[i] = values[instr.slot];
+                break;
+            case Operation::ADD:
+                value[i] = x+value[arg[1]];
+                break;
+            case Operation::SUBTRACT:
+                value[i] = x-value[arg[1]];
+                break;
+            case Operation::MULTIPLY:
+                value[i] = x*value[arg[1]];
+                break;
+            case Operation::DIVIDE:
+                value[i] = x/value[arg[1]];
+                break;
+            case Operation::POWER:
+                value[i] = std::pow(x, value[arg[1]]);
+                break;
+            case Operation::NEGATE:
+                value[i] = -x;
+                break;
+            case Operation::ABS:
+                value[i] = std::abs(x);
+                break;
+            case Operation::SQRT:
+                value[i] = std::sqrt(x);
+                break;
+            case Operation::EXP:
+                value[i] = std::exp(x);
+                break;
+            case Operation::LOG:
+                value[i] = std::log(x);
+                break;
+            case Operation::SIN:
+                value[i] = std::sin(x);
+                break;
+            case Operation::COS:
+                value[i] = std::cos(x);
+                break;
+            case Operation::SEC:
+                value[i] = 1.0/std::cos(x);
+                break;
+            case Operation::CSC:
+                value[i] = 1.0/std::sin(x);
+                break;
+            case Operation::TAN:
+                value[i] = std::tan(x);
+                break;
+            case Operation::COT:
+                value[i] = 1.0/std::tan(x);
+                break;
+            case Operation::ASIN:
+                value[i] = std::asin(x);
+                break;
+            case Operation::ACOS:
+                value[i] = std::acos(x);
+                break;
+            case Operation::ATAN:
+                value[i] = std::atan(x);
+                break;
+            case Operation::SINH:
+                value[i] = std::sinh(x);
+                break;
+            case Operation::COSH:
+                value[i] = std::cosh(x);
+                break;
+            case Operation::TANH:
+                value[i] = std::tanh(x);
+                break;
+            case Operation::ERF:
+                value[i] = erf(x);
+                break;
+            case Operation::ERFC:
+                value[i] = erfc(x);
+                break;
+            case Operation::STEP:
+                value[i] = (x >= 0.0 ? 1.0 : 0.0);
+                break;
+            case Operation::SQUARE:
+                value[i] = x*x;
+                break;
+            case Operation::CUBE:
+                value[i] = x*x*x;
+                break;
+            case Operation::RECIPROCAL:
+                value[i] = 1.0/x;
+                break;
+            case Operation::ADD_CONSTANT:
+                value[i] = x+instr.value;
+                break;
+            case Operation::MULTIPLY_CONSTANT:
+                value[i] = x*instr.value;
+                break;
+            case Operation::POWER_CONSTANT:
+                value[i] = std::pow(x, instr.value);
+                break;
+            default:
+                for (int j = 0; j < instr.numArgs; j++)
+                    args[j] = value[arg[j]];
+                value[i] = instr.operation->evaluate(args, noVariables);
+                break;
+        }
+    }
+
+    // Backward sweep, adjoint[i] is the derivative of the result with respect to the value of instruction i.
+    for (int i = 0; i < numSlots; i++)
+        gradient[i] = 0.0;
+    for (int i = 0; i < numInstructions-1; i++)
+        adjoint[i] = 0.0;
+    adjoint[numInstructions-1] = 1.0;
+    for (int i = numInstructions-1; i >= 0; i--) {
+        const Instruction& instr = instructions[i];
+        const int* arg = index+argStart[i];
+        double a = adjoint[i];
+        double x = (instr.numArgs > 0 ? value[arg[0]] : 0.0);
+        double r = value[i];
+        switch (instr.op) {
+            case Operation::CONSTANT:
+                break;
+            case Operation::VARIABLE:
+                gradient[instr.slot] += a;
+                break;
+            case Operation::ADD:
+                adjoint[arg[0]] += a;
+                adjoint[arg[1]] += a;
+                break;
+            case Operation::SUBTRACT:
+                adjoint[arg[0]] += a;
+                adjoint[arg[1]] -= a;
+                break;
+            case Operation::MULTIPLY:
+                adjoint[arg[0]] += a*value[arg[1]];
+                adjoint[arg[1]] += a*x;
+                break;
+            case Operation::DIVIDE:
+                adjoint[arg[0]] += a/value[arg[1]];
+                adjoint[arg[1]] -= a*r/value[arg[1]];
+                break;
+            case Operation::POWER:
+                adjoint[arg[0]] += a*value[arg[1]]*std::pow(x, value[arg[1]]-1.0);
+                adjoint[arg[1]] += a*std::log(x)*r;
+                break;
+            case Operation::NEGATE:
+                adjoint[arg[0]] -= a;
+                break;
+            case Operation::ABS:
+                adjoint[arg[0]] += (x >= 0.0 ? a : -a);
+                break;
+            case Operation::SQRT:
+                adjoint[arg[0]] += a*0.5/r;
+                break;
+            case Operation::EXP:
+                adjoint[arg[0]] += a*r;
+                break;
+            case Operation::LOG:
+                adjoint[arg[0]] += a/x;
+                break;
+            case Operation::SIN:
+                adjoint[arg[0]] += a*std::cos(x);
+                break;
+            case Operation::COS:
+                adjoint[arg[0]] -= a*std::sin(x);
+                break;
+            case Operation::SEC:
+                adjoint[arg[0]] += a*r*std::tan(x);
+                break;
+            case Operation::CSC:
+                adjoint[arg[0]] -= a*r/std::tan(x);
+                break;
+            case Operation::TAN:
+                adjoint[arg[0]] += a*(1.0+r*r);
+                break;
+            case Operation::COT:
+                adjoint[arg[0]] -= a*(1.0+r*r);
+                break;
+            case Operation::ASIN:
+                adjoint[arg[0]] += a/std::sqrt(1.0-x*x);
+                break;
+            case Operation::ACOS:
+                adjoint[arg[0]] -= a/std::sqrt(1.0-x*x);
+                break;
+            case Operation::ATAN:
+                adjoint[arg[0]] += a/(1.0+x*x);
+                break;
+            case Operation::SINH:
+                adjoint[arg[0]] += a*std::cosh(x);
+                break;
+            case Operation::COSH:
+                adjoint[arg[0]] += a*std::sinh(x);
+                break;
+            case Operation::TANH:
+                adjoint[arg[0]] += a*(1.0-r*r);
+                break;
+            case Operation::ERF:
+                adjoint[arg[0]] += a*1.12837916709551257390*std::exp(-x*x);
+                break;
+            case Operation::ERFC:
+                adjoint[arg[0]] -= a*1.12837916709551257390*std::exp(-x*x);
+                break;
+            case Operation::STEP:
+                break;
+            case Operation::SQUARE:
+                adjoint[arg[0]] += a*2.0*x;
+                break;
+            case Operation::CUBE:
+                adjoint[arg[0]] += a*3.0*x*x;
+                break;
+            case Operation::RECIPROCAL:
+                adjoint[arg[0]] -= a*r*r;
+                break;
+            case Operation::ADD_CONSTANT:
+                adjoint[arg[0]] += a;
+                break;
+            case Operation::MULTIPLY_CONSTANT:
+                adjoint[arg[0]] += a*instr.value;
+                break;
+            case Operation::POWER_CONSTANT:
+                adjoint[arg[0]] += a*instr.value*std::pow(x, instr.value-1.0);
+                break;
+            default: {
+                // Custom functions supply their partial derivatives themselves.
+                for (int j = 0; j < instr.numArgs; j++)
+                    args[j] = value[arg[j]];
+                Operation* const* partial = derivatives.data()+argStart[i];
+                for (int j = 0; j < instr.numArgs; j++)
+                    adjoint[arg[j]] += a*partial[j]->evaluate(args, noVariables);
+                break;
+            }
+        }
+    }
+    return value[numInstructions-1];
+}
+
+double ExpressionProgram::evaluateGradient(const double* values, double* gradient) const {
+    static thread_local vector<double> scratch;
+    if ((int) scratch.size() < getGradientScratchSize())
+        scratch.resize(getGradientScratchSize());
+    return evaluateGradient(values, gradient, &scratch[0]);
+}
+
+double ExpressionProgram::execute(double* scratch, const double* values, const std::map<std::string, double>& variables) const {
+    // The first argument of an operation is on top of the stack, the second below it.
+    double* stack = scratch;
+    double* args = scratch+stackSize;
+    int top = -1;
+    const Instruction* instr = (instructions.empty() ? NULL : &instructions[0]);
+    const Instruction* end = instr+instructions.size();
+    for (; instr != end; ++instr) {
+        switch (instr->op) {
+            case Operation::CONSTANT:
+                stack[++top] = instr->value;
+                break;
+            case Operation::VARIABLE:
+                if (values != NULL)
+                    stack[++top] = values[instr->slot];
+                else
+                    stack[++top] = instr->operation->evaluate(args, variables);
+                break;
+            case Operation::ADD:
+                stack[top-1] = stack[top]+stack[top-1];
+                --top;
+                break;
+            case Operation::SUBTRACT:
+                stack[top-1] = stack[top]-stack[top-1];
+                --top;
+                break;
+            case Operation::MULTIPLY:
+                stack[top-1] = stack[top]*stack[top-1];
+                --top;
+                break;
+            case Operation::DIVIDE:
+                stack[top-1] = stack[top]/stack[top-1];
+                --top;
+                break;
+            case Operation::POWER:
+                stack[top-1] = std::pow(stack[top], stack[top-1]);
+                --top;
+                break;
+            case Operation::NEGATE:
+                stack[top] = -stack[top];
+                break;
+            case Operation::ABS:
+                stack[top] = std::abs(stack[top]);
+                break;
+            case Operation::SQRT:
+                stack[top] = std::sqrt(stack[top]);
+                break;
+            case Operation::EXP:
+                stack[top] = std::exp(stack[top]);
+                break;
+            case Operation::LOG:
+                stack[top] = std::log(stack[top]);
+                break;
+            case Operation::SIN:
+                stack[top] = std::sin(stack[top]);
+                break;
+            case Operation::COS:
+                stack[top] = std::cos(stack[top]);
+                break;
+            case Operation::SEC:
+                stack[top] = 1.0/std::cos(stack[top]);
+                break;
+            case Operation::CSC:
+                stack[top] = 1.0/std::sin(stack[top]);
+                break;
+            case Operation::TAN:
+                stack[top] = std::tan(stack[top]);
+                break;
+            case Operation::COT:
+                stack[top] = 1.0/std::tan(stack[top]);
+                break;
+            case Operation::ASIN:
+                stack[top] = std::asin(stack[top]);
+                break;
+            case Operation::ACOS:
+                stack[top] = std::acos(stack[top]);
+                break;
+            case Operation::ATAN:
+                stack[top] = std::atan(stack[top]);
+                break;
+            case Operation::SINH:
+                stack[top] = std::sinh(stack[top]);
+                break;
+            case Operation::COSH:
+                stack[top] = std::cosh(stack[top]);
+                break;
+            case Operation::TANH:
+                stack[top] = std::tanh(stack[top]);
+                break;
+            case Operation::ERF:
+                stack[top] = erf(stack[top]);
+                break;
+            case Operation::ERFC:
+                stack[top] = erfc(stack[top]);
+                break;
+            case Operation::STEP:
+                stack[top] = (stack[top] >= 0.0 ? 1.0 : 0.0);
+                break;
+            case Operation::SQUARE:
+                stack[top] = stack[top]*stack[top];
+                break;
+            case Operation::CUBE:
+                stack[top] = stack[top]*stack[top]*stack[top];
+                break;
+            case Operation::RECIPROCAL:
+                stack[top] = 1.0/stack[top];
+                break;
+            case Operation::ADD_CONSTANT:
+                stack[top] = stack[top]+instr->value;
+                break;
+            case Operation::MULTIPLY_CONSTANT:
+                stack[top] = stack[top]*instr->value;
+                break;
+            case Operation::POWER_CONSTANT:
+                stack[top] = std::pow(stack[top], instr->value);
+                break;
+            default: {
+                // Custom functions, and any operation without an opcode of its own.
+                int numArgs = instr->numArgs;
+                for (int j = 0; j < numArgs; j++)
+                    args[j] = stack[top--];
+                stack[++top] = instr->operation->evaluate(args, variables);
+                break;
+            }
+        }
     }
     return stack[0];
 }
@@ -84,12 +84,90 @@ public:
      *                     will be thrown.
      */
     double evaluate(const std::map<std::string, double>& variables) const;
+    /**
+     * Bind the variables of the expression to slots of a value array, so that the program can be evaluated
+     * without looking up names.  Afterward evaluate(const double*) reads the value of names[i] from values[i].
+     * If any variable appears in the expression but is not included in names, an exception will be thrown.
+     *
+     * @param names    the names of the variables, in the order their values will be passed
+     */
+    void setVariableSlots(const std::vector<std::string>& names);
+    /**
+     * Get the number of doubles the scratch buffer passed to evaluate(const double*, double*) must hold.
+     */
+    int getScratchSize() const;
+    /**
+     * Evaluate the expression using the slots assigned by setVariableSlots().  This does not allocate memory.
+     *
+     * @param values     the values of the variables, in the order of the names passed to setVariableSlots()
+     * @param scratch    a buffer of at least getScratchSize() elements used as evaluation stack
+     */
+    double evaluate(const double* values, double* scratch) const;
+    /**
+     * Evaluate the expression using the slots assigned by setVariableSlots() and a scratch buffer owned by
+     * the calling thread.  The buffer only grows, so repeated calls do not allocate memory.
+     *
+     * @param values     the values of the variables, in the order of the names passed to setVariableSlots()
+     */
+    double evaluate(const double* values) const;
+    /**
+     * Get the number of doubles the scratch buffer passed to evaluateGradient(const double*, double*, double*)
+     * must hold.
+     */
+    int getGradientScratchSize() const;
+    /**
+     * Evaluate the expression and its derivatives with respect to all variables in a single pass, using the
+     * slots assigned by setVariableSlots().  This is reverse mode automatic differentiation: a forward sweep
+     * records the value of every Operation, a backward sweep accumulates the partial derivatives.  It gives
+     * the same results as evaluating differentiate() for every variable, but at a cost of a small multiple of
+     * one evaluation independent of the number of variables.  This does not allocate memory.
+     *
+     * @param values     the values of the variables, in the order of the names passed to setVariableSlots()
+     * @param gradient   receives the partial derivative with respect to names[i] in gradient[i].  It must hold
+     *                   as many elements as names were passed to setVariableSlots().
+     * @param scratch    a buffer of at least getGradientScratchSize() elements
+     * @return the value of the expression
+     */
+    double evaluateGradient(const double* values, double* gradient, double* scratch) const;
+    /**
+     * Evaluate the expression and its derivatives with respect to all variables using a scratch buffer owned
+     * by the calling thread.  The buffer only grows, so repeated calls do not allocate memory.
+     *
+     * @param values     the values of the variables, in the order of the names passed to setVariableSlots()
+     * @param gradient   receives the partial derivative with respect to names[i] in gradient[i]
+     * @return the value of the expression
+     */
+    double evaluateGradient(const double* values, double* gradient) const;
 private:
     friend class ParsedExpression;
     ExpressionProgram(const ParsedExpression& expression);
+    /**
+     * One step of the flat form of the program.  Constants (also those of AddConstant, MultiplyConstant and
+     * PowerConstant) are stored inline, variables carry their slot.  Only operations without an opcode of their
+     * own, i.e. custom functions, are evaluated through the Operation.
+     */
+    struct Instruction {
+        int op;
+        int numArgs;
+        int slot;
+        double value;
+        const Operation* operation;
+    };
     void buildProgram(const ExpressionTreeNode& node);
+    void buildInstructions();
+    double execute(double* scratch, const double* values, const std::map<std::string, double>& variables) const;
     std::vector<Operation*> operations;
-    int maxArgs, stackSize;
+    std::vector<Instruction> instructions;
+    /**
+     * The arguments of instruction i, first argument first, are the results of the instructions
+     * argIndex[argStart[i]] to argIndex[argStart[i+1]-1].  For custom functions derivatives holds the
+     * Operation computing the partial derivative with respect to the matching argument, NULL otherwise.
+     */
+    std::vector<int> argStart;
+    std::vector<int> argIndex;
+    std::vector<Operation*> derivatives;
+    int maxArgs, stackSize, numSlots;
+    bool hasSlots;
 };
 
 } // namespace Lepton
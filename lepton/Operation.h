@@ -178,7 +178,10 @@ public:
     }
     bool operator!=(const Operation& op) const {
         const Constant* o = dynamic_cast<const Constant*>(&op);
-        return (o == NULL || o->value != value);
+        if (o == NULL)
+            return true;
+        // Two NaNs are the same constant, otherwise optimize() never reaches a fixed point on them.
+        return (o->value != value && !(o->value != o->value && value != value));
     }
 private:
     double value;
@@ -19,7 +19,10 @@ CONFIG -= qt
 INCLUDEPATH += muparser2
 
 
-QMAKE_CXXFLAGS += -std=c++11 -march=native -fopenmp
+# Fixed baseline ISA so the binary runs on every machine of a fleet. Wider instruction
+# sets are only used by functions marked MUP_TARGET_AVX2/MUP_TARGET_AVX512 and selected
+# at runtime.
+QMAKE_CXXFLAGS += -std=c++11 -march=x86-64-v2 -fopenmp
 QMAKE_LFLAGS += -fopenmp
 
 # remove possible other optimization flags
@@ -48,12 +51,20 @@ SOURCES += \
     FormelGenerator.cpp \
     ParserBench.cpp \
     Stopwatch.cpp \
+    Statistics.cpp \
+    MemoryCounter.cpp \
+    MemoCache.cpp \
+    BenchMuParserSSE.cpp \
+    ExprCorpus.cpp \
     muparser2/muParser.cpp \
     muparser2/muParserBase.cpp \
     muparser2/muParserBytecode.cpp \
     muparser2/muParserCallback.cpp \
     muparser2/muParserError.cpp \
     muparser2/muParserTokenReader.cpp \
+    muparser2/muParserSimd.cpp \
+    muparser2/muParserJit.cpp \
+    muparser2/muParserRegCode.cpp \
     lepton/Parser.cpp \
     lepton/ParsedExpression.cpp \
     lepton/Operation.cpp \
@@ -98,12 +109,14 @@ SOURCES += \
     muparserx/mpFuncCommon.cpp \
     muparserx/mpFuncCmplx.cpp \
     muparserx/mpError.cpp \
+    muparserx/mpValuePool.cpp \
     libcpuid/recog_intel.c \
     libcpuid/recog_amd.c \
     libcpuid/rdtsc.c \
     libcpuid/libcpuid_util.c \
     libcpuid/cpuid_main.c \
-    libcpuid/asm-bits.c
+    libcpuid/asm-bits.c \
+    muParserSSE/muParserSSE.cpp
 
 HEADERS += \
     BenchATMSP.h \
@@ -118,6 +131,12 @@ HEADERS += \
     cpuid.h \
     FormelGenerator.h \
     Stopwatch.h \
+    Statistics.h \
+    MemoryCounter.h \
+    MemoCache.h \
+    ExprCache.h \
+    BenchMuParserSSE.h \
+    ExprCorpus.h \
     muparser2/muParser.h \
     muparser2/muParserBase.h \
     muparser2/muParserBytecode.h \
@@ -129,6 +148,9 @@ HEADERS += \
     muparser2/muParserTemplateMagic.h \
     muparser2/muParserToken.h \
     muparser2/muParserTokenReader.h \
+    muparser2/muParserSimd.h \
+    muparser2/muParserJit.h \
+    muparser2/muParserRegCode.h \
     libcpuid/recog_intel.h \
     libcpuid/recog_amd.h \
     libcpuid/libcpuid.h \
@@ -195,5 +217,6 @@ HEADERS += \
     muparserx/mpFuncCommon.h \
     muparserx/mpFuncCmplx.h \
     muparserx/mpError.h \
-    muparserx/mpDefines.h
+    muparserx/mpDefines.h \
+    muparserx/mpValuePool.h
 
@@ -0,0 +1,2426 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "muParserSSE.h"
+
+/** \file
+    \brief Source implementation of the muParserSSE C interface.
+
+    Windows builds link the prebuilt muParserSSE.dll, this file provides the same
+    mec* functions elsewhere. Expressions are parsed with the muparser grammar and
+    translated into scalar single precision SSE code, or AVX code if the CPU
+    supports it. Native code generation requires the System V x86-64 ABI,
+    mecCompile reports an error on other platforms.
+*/
+
+#if !defined(_WIN32)
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <math.h>
+
+#if defined(__x86_64__)
+  #define MEC_JIT_SYSV_X64
+  #include <stdint.h>
+  #include <sys/mman.h>
+#endif
+
+
+namespace
+{
+  typedef mecFloat_t value_type;
+
+  // Callbacks of any arity are stored as this type and cast back to their
+  // mecFunN_t by the argument count. GCC does not warn on casts from and to it.
+  typedef void (*GenericFun_t)();
+
+  //---------------------------------------------------------------------------
+  enum EErrorCodes
+  {
+    ecUNEXPECTED_OPERATOR  = 0,
+    ecUNASSIGNABLE_TOKEN   = 1,
+    ecUNEXPECTED_EOF       = 2,
+    ecUNEXPECTED_ARG_SEP   = 3,
+    ecUNEXPECTED_ARG       = 4,
+    ecUNEXPECTED_VAL       = 5,
+    ecUNEXPECTED_VAR       = 6,
+    ecUNEXPECTED_PARENS    = 7,
+    ecUNEXPECTED_STR       = 8,
+    ecSTRING_EXPECTED      = 9,
+    ecVAL_EXPECTED         = 10,
+    ecMISSING_PARENS       = 11,
+    ecUNEXPECTED_FUN       = 12,
+    ecUNTERMINATED_STRING  = 13,
+    ecTOO_MANY_PARAMS      = 14,
+    ecTOO_FEW_PARAMS       = 15,
+    ecOPRT_TYPE_CONFLICT   = 16,
+    ecSTR_RESULT           = 17,
+    ecINVALID_NAME         = 18,
+    ecBUILTIN_OVERLOAD     = 19,
+    ecINVALID_FUN_PTR      = 20,
+    ecINVALID_VAR_PTR      = 21,
+    ecEMPTY_EXPRESSION     = 22,
+    ecNAME_CONFLICT        = 23,
+    ecOPT_PRI              = 24,
+    ecDOMAIN_ERROR         = 25,
+    ecDIV_BY_ZERO          = 26,
+    ecGENERIC              = 27,
+    ecLOCALE               = 28,
+    ecINTERNAL_ERROR       = 29,
+    ecCOUNT,
+    ecUNDEFINED            = -1
+  };
+
+  // operator precedences of muparser
+  enum EOprtPrecedence
+  {
+    prLOR     = 1,
+    prLAND    = 2,
+    prCMP     = 4,
+    prADD_SUB = 5,
+    prMUL_DIV = 6,
+    prPOW     = 7,
+    prINFIX   = 6
+  };
+
+  const char *g_szMsg[ecCOUNT] =
+  {
+    "Unexpected operator \"$TOK$\" found at position $POS$",
+    "Unexpected token \"$TOK$\" found at position $POS$.",
+    "Unexpected end of expression at position $POS$",
+    "Unexpected argument separator at position $POS$",
+    "Unexpected argument at position $POS$",
+    "Unexpected value \"$TOK$\" found at position $POS$",
+    "Unexpected variable \"$TOK$\" found at position $POS$",
+    "Unexpected parenthesis \"$TOK$\" at position $POS$",
+    "Unexpected string token found at position $POS$.",
+    "String function called with a non string type of argument.",
+    "Numerical function called with a non value type of argument.",
+    "Missing parenthesis",
+    "Unexpected function \"$TOK$\" at position $POS$",
+    "Unterminated string starting at position $POS$.",
+    "Too many parameters for function \"$TOK$\" at expression position $POS$",
+    "Too few parameters for function \"$TOK$\" at expression position $POS$",
+    "Binary operator operands must be of the same type.",
+    "String result",
+    "Invalid function-, variable- or constant name: \"$TOK$\".",
+    "Invalid operator, it conflicts with a built in operator: \"$TOK$\".",
+    "Invalid pointer to callback function.",
+    "Invalid pointer to variable.",
+    "Expression is empty.",
+    "Name conflict: \"$TOK$\" is already defined.",
+    "Invalid value for operator priority (must be greater or equal to zero).",
+    "Domain error",
+    "Divide by zero",
+    "Parser error.",
+    "Decimal separator is identical to the function argument separator.",
+    "Internal error: $TOK$"
+  };
+
+  bool g_bDumpCode  = false;
+  bool g_bDumpStack = false;
+
+  //---------------------------------------------------------------------------
+  /** \brief Error raised while defining symbols or compiling an expression. */
+  struct ParserError
+  {
+    ParserError(int a_iCode, const std::string &a_sTok = std::string(), int a_iPos = -1)
+      :m_iCode(a_iCode)
+      ,m_sTok(a_sTok)
+      ,m_iPos(a_iPos)
+    {}
+
+    std::string GetMsg() const
+    {
+      std::string sMsg = (m_iCode>=0 && m_iCode<ecCOUNT) ? g_szMsg[m_iCode] : "Undefined error";
+      Replace(sMsg, "$TOK$", m_sTok);
+      Replace(sMsg, "$POS$", std::to_string(m_iPos));
+      return sMsg;
+    }
+
+    int m_iCode;
+    std::string m_sTok;
+    int m_iPos;
+
+  private:
+
+    static void Replace(std::string &s, const std::string &a_sWhat, const std::string &a_sBy)
+    {
+      std::string::size_type i = s.find(a_sWhat);
+      if (i!=std::string::npos)
+        s.replace(i, a_sWhat.size(), a_sBy);
+    }
+  };
+
+  //---------------------------------------------------------------------------
+  value_type Sign(value_type v)
+  {
+    return (v>0) ? 1.f : ((v<0) ? -1.f : 0.f);
+  }
+
+  // Scalar operations with the same results as the generated code.
+  enum EBinOp
+  {
+    boADD, boSUB, boMUL, boDIV, boMIN, boMAX,
+    boLT,  boLE,  boGT,  boGE,  boEQ,  boNEQ,
+    boLAND, boLOR
+  };
+
+  value_type EvalBinary(int a_iOp, value_type a, value_type b)
+  {
+    switch(a_iOp)
+    {
+    case boADD:  return a + b;
+    case boSUB:  return a - b;
+    case boMUL:  return a * b;
+    case boDIV:  return a / b;
+    case boMIN:  return (a<b) ? a : b;
+    case boMAX:  return (a>b) ? a : b;
+    case boLT:   return a<b;
+    case boLE:   return a<=b;
+    case boGT:   return a>b;
+    case boGE:   return a>=b;
+    case boEQ:   return a==b;
+    case boNEQ:  return a!=b;
+    case boLAND: return (a!=0) && (b!=0);
+    case boLOR:  return (a!=0) || (b!=0);
+    default:     throw ParserError(ecINTERNAL_ERROR, "unknown binary operator");
+    }
+  }
+
+  value_type Call(GenericFun_t a_pFun, const value_type *v, int a_iArgc)
+  {
+    switch(a_iArgc)
+    {
+    case 0:  return reinterpret_cast<mecFun0_t>(a_pFun)();
+    case 1:  return reinterpret_cast<mecFun1_t>(a_pFun)(v[0]);
+    case 2:  return reinterpret_cast<mecFun2_t>(a_pFun)(v[0], v[1]);
+    case 3:  return reinterpret_cast<mecFun3_t>(a_pFun)(v[0], v[1], v[2]);
+    case 4:  return reinterpret_cast<mecFun4_t>(a_pFun)(v[0], v[1], v[2], v[3]);
+    case 5:  return reinterpret_cast<mecFun5_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4]);
+    case 6:  return reinterpret_cast<mecFun6_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4], v[5]);
+    case 7:  return reinterpret_cast<mecFun7_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4], v[5], v[6]);
+    case 8:  return reinterpret_cast<mecFun8_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+    case 9:  return reinterpret_cast<mecFun9_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+    case 10: return reinterpret_cast<mecFun10_t>(a_pFun)(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9]);
+    default: throw ParserError(ecINTERNAL_ERROR, "too many callback arguments");
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Node of the expression tree. */
+  struct Node
+  {
+    enum EType
+    {
+      ndVAL,    ///< constant m_fVal
+      ndVAR,    ///< variable at m_pVar
+      ndNEG,
+      ndABS,
+      ndSQRT,
+      ndPOWI,   ///< argument to the integer power m_iOp
+      ndBIN,    ///< binary operator m_iOp (EBinOp)
+      ndFUN,    ///< callback m_pFun
+      ndIF      ///< condition ? argument 1 : argument 2
+    };
+
+    Node(EType a_eType)
+      :m_eType(a_eType)
+      ,m_iOp(0)
+      ,m_fVal(0)
+      ,m_pVar(NULL)
+      ,m_pFun(NULL)
+      ,m_vArg()
+      ,m_iNeed(0)
+      ,m_bCall(false)
+    {}
+
+    EType m_eType;
+    int m_iOp;
+    value_type m_fVal;
+    value_type *m_pVar;
+    GenericFun_t m_pFun;
+    std::vector<Node*> m_vArg;
+
+    int m_iNeed;      ///< number of registers needed for the evaluation
+    bool m_bCall;     ///< true if the evaluation calls a function
+
+    bool IsLeaf() const
+    {
+      return m_eType==ndVAL || m_eType==ndVAR;
+    }
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Owner of the nodes of an expression. */
+  class Tree
+  {
+  public:
+
+    Node* New(Node::EType a_eType)
+    {
+      m_vNode.push_back(std::unique_ptr<Node>(new Node(a_eType)));
+      return m_vNode.back().get();
+    }
+
+    Node* Val(value_type a_fVal)
+    {
+      Node *pNode = New(Node::ndVAL);
+      pNode->m_fVal = a_fVal;
+      return pNode;
+    }
+
+    /** \brief Value of a subtree, used for folding constant subtrees. */
+    static value_type Eval(const Node *a_pNode)
+    {
+      const std::vector<Node*> &vArg = a_pNode->m_vArg;
+
+      switch(a_pNode->m_eType)
+      {
+      case Node::ndVAL:  return a_pNode->m_fVal;
+      case Node::ndVAR:  return *a_pNode->m_pVar;
+      case Node::ndNEG:  return -Eval(vArg[0]);
+      case Node::ndABS:  return std::fabs(Eval(vArg[0]));
+      case Node::ndSQRT: return std::sqrt(Eval(vArg[0]));
+      case Node::ndPOWI: return std::pow(Eval(vArg[0]), (value_type)a_pNode->m_iOp);
+      case Node::ndBIN:  return EvalBinary(a_pNode->m_iOp, Eval(vArg[0]), Eval(vArg[1]));
+      case Node::ndIF:   return (Eval(vArg[0])!=0) ? Eval(vArg[1]) : Eval(vArg[2]);
+      case Node::ndFUN:
+          {
+            value_type v[10];
+            for (std::size_t i=0; i<vArg.size(); ++i)
+              v[i] = Eval(vArg[i]);
+
+            return Call(a_pNode->m_pFun, v, (int)vArg.size());
+          }
+      default:
+          throw ParserError(ecINTERNAL_ERROR, "unknown node");
+      }
+    }
+
+    /** \brief Replace a node whose arguments are all constant by its value. */
+    Node* Fold(Node *a_pNode)
+    {
+      for (std::size_t i=0; i<a_pNode->m_vArg.size(); ++i)
+      {
+        if (a_pNode->m_vArg[i]->m_eType!=Node::ndVAL)
+          return a_pNode;
+      }
+
+      return Val(Eval(a_pNode));
+    }
+
+  private:
+    std::vector<std::unique_ptr<Node> > m_vNode;
+  };
+
+#if defined(MEC_JIT_SYSV_X64)
+
+  //---------------------------------------------------------------------------
+  /** \brief Minimal x86-64 encoder for scalar single precision SSE/AVX code.
+
+      Instructions are encoded in their legacy SSE form or, if AVX is enabled,
+      in the three operand VEX form. Constants are addressed RIP relative, their
+      displacements are resolved by Link once the size of the code is known.
+  */
+  class CodeBuffer
+  {
+  public:
+
+    // mandatory prefix, the values are the pp field of the VEX prefix
+    enum EPrefix
+    {
+      pfNONE = 0,
+      pf66   = 1,
+      pfF3   = 2,
+      pfF2   = 3
+    };
+
+    // opcodes of the 0F xx instructions
+    enum
+    {
+      opMOVSS_LOAD  = 0x10,   // F3
+      opMOVSS_STORE = 0x11,   // F3
+      opMOVAPS      = 0x28,
+      opUCOMISS     = 0x2E,
+      opSQRTSS      = 0x51,   // F3
+      opANDPS       = 0x54,
+      opANDNPS      = 0x55,
+      opORPS        = 0x56,
+      opXORPS       = 0x57,
+      opADDSS       = 0x58,   // F3
+      opMULSS       = 0x59,   // F3
+      opSUBSS       = 0x5C,   // F3
+      opMINSS       = 0x5D,   // F3
+      opDIVSS       = 0x5E,   // F3
+      opMAXSS       = 0x5F,   // F3
+      opCMPSS       = 0xC2    // F3
+    };
+
+    // cmpss predicates
+    enum
+    {
+      cmpEQ  = 0,
+      cmpLT  = 1,
+      cmpLE  = 2,
+      cmpNEQ = 4
+    };
+
+    /** \brief Register or memory operand. */
+    struct Operand
+    {
+      enum EKind
+      {
+        okREG,   ///< xmm<val>
+        okRAX,   ///< [rax]
+        okRIP,   ///< constant number <val>
+        okRSP    ///< [rsp + val]
+      };
+
+      Operand(EKind a_eKind, int a_iVal)
+        :m_eKind(a_eKind)
+        ,m_iVal(a_iVal)
+      {}
+
+      bool IsReg(int a_iReg) const
+      {
+        return m_eKind==okREG && m_iVal==a_iReg;
+      }
+
+      EKind m_eKind;
+      int m_iVal;
+    };
+
+    CodeBuffer(bool a_bAvx)
+      :m_bAvx(a_bAvx)
+      ,m_vCode()
+      ,m_vConst()
+      ,m_vFixup()
+    {}
+
+    void Byte(unsigned a_iByte)
+    {
+      m_vCode.push_back((unsigned char)a_iByte);
+    }
+
+    void Imm32(int a_iVal)
+    {
+      for (int i=0; i<4; ++i)
+        Byte((unsigned)(a_iVal >> (8*i)) & 0xFF);
+    }
+
+    void Imm64(uint64_t a_iVal)
+    {
+      for (int i=0; i<8; ++i)
+        Byte((unsigned)(a_iVal >> (8*i)) & 0xFF);
+    }
+
+    std::size_t Pos() const
+    {
+      return m_vCode.size();
+    }
+
+    /** \brief Emit an instruction, vvvv is the first source of the VEX form (0 if unused). */
+    void Instr(int a_iPrefix, unsigned a_iOp, int a_iReg, int a_iVvvv, const Operand &a_Rm, int a_iImm = -1)
+    {
+      int r = a_iReg >> 3;
+      int b = (a_Rm.m_eKind==Operand::okREG) ? (a_Rm.m_iVal >> 3) : 0;
+
+      if (m_bAvx)
+      {
+        if (b==0)
+        {
+          Byte(0xC5);
+          Byte(((~r & 1) << 7) | ((~a_iVvvv & 15) << 3) | a_iPrefix);
+        }
+        else
+        {
+          Byte(0xC4);
+          Byte(((~r & 1) << 7) | 0x40 | ((~b & 1) << 5) | 0x01);   // map 0F
+          Byte(((~a_iVvvv & 15) << 3) | a_iPrefix);
+        }
+      }
+      else
+      {
+        static const unsigned s_iPrefix[] = { 0, 0x66, 0xF3, 0xF2 };
+
+        if (a_iPrefix!=pfNONE)
+          Byte(s_iPrefix[a_iPrefix]);
+
+        if (r || b)
+          Byte(0x40 | (r << 2) | b);
+
+        Byte(0x0F);
+      }
+
+      Byte(a_iOp);
+
+      int iReg = (a_iReg & 7) << 3;
+      std::size_t iFixup = 0;
+
+      switch(a_Rm.m_eKind)
+      {
+      case Operand::okREG:
+           Byte(0xC0 | iReg | (a_Rm.m_iVal & 7));
+           break;
+
+      case Operand::okRAX:
+           Byte(iReg);
+           break;
+
+      case Operand::okRIP:
+           Byte(0x05 | iReg);
+           iFixup = Pos();
+           Imm32(0);
+           break;
+
+      case Operand::okRSP:
+           if (a_Rm.m_iVal<128)
+           {
+             Byte(0x44 | iReg); Byte(0x24); Byte(a_Rm.m_iVal);
+           }
+           else
+           {
+             Byte(0x84 | iReg); Byte(0x24); Imm32(a_Rm.m_iVal);
+           }
+           break;
+      }
+
+      if (a_iImm>=0)
+        Byte(a_iImm);
+
+      // the displacement is relative to the end of the instruction
+      if (a_Rm.m_eKind==Operand::okRIP)
+        m_vFixup.push_back(Fixup(iFixup, Pos(), a_Rm.m_iVal));
+    }
+
+    /** \brief Operand for a constant, stored 16 byte aligned and broadcast to all lanes. */
+    Operand Const(uint32_t a_iBits)
+    {
+      for (std::size_t i=0; i<m_vConst.size(); ++i)
+      {
+        if (m_vConst[i]==a_iBits)
+          return Operand(Operand::okRIP, (int)i);
+      }
+
+      m_vConst.push_back(a_iBits);
+      return Operand(Operand::okRIP, (int)m_vConst.size() - 1);
+    }
+
+    Operand Const(value_type a_fVal)
+    {
+      uint32_t iBits;
+      std::memcpy(&iBits, &a_fVal, sizeof(iBits));
+      return Const(iBits);
+    }
+
+    // mov rax, imm64
+    void MovRax(uint64_t a_iVal)
+    {
+      Byte(0x48); Byte(0xB8);
+      Imm64(a_iVal);
+    }
+
+    void Call(uint64_t a_iAddr)
+    {
+      MovRax(a_iAddr);
+      Byte(0xFF); Byte(0xD0);          // call rax
+    }
+
+    /** \brief Emit a jump with a rel32 operand and return the position behind it for PatchJump. */
+    std::size_t Jump(unsigned a_iCond)
+    {
+      if (a_iCond==0)
+      {
+        Byte(0xE9);                    // jmp rel32
+      }
+      else
+      {
+        Byte(0x0F); Byte(a_iCond);     // jcc rel32
+      }
+
+      Imm32(0);
+      return Pos();
+    }
+
+    /** \brief Set the rel32 operand ending at a_iEnd to jump to the current position. */
+    void PatchJump(std::size_t a_iEnd)
+    {
+      int iRel = (int)(Pos() - a_iEnd);
+      std::memcpy(&m_vCode[a_iEnd - 4], &iRel, 4);
+    }
+
+    /** \brief Assemble the function: stack frame setup, code, return and constants.
+        \param a_iFrame Size of the stack frame, 0 if none is needed.
+    */
+    void Link(int a_iFrame, std::vector<unsigned char> &a_vOut) const
+    {
+      a_vOut.clear();
+
+      if (a_iFrame)
+      {
+        a_vOut.push_back(0x48); a_vOut.push_back(0x81); a_vOut.push_back(0xEC);   // sub rsp, imm32
+        for (int i=0; i<4; ++i)
+          a_vOut.push_back((unsigned char)(a_iFrame >> (8*i)));
+      }
+
+      const std::size_t iOfs = a_vOut.size();
+      a_vOut.insert(a_vOut.end(), m_vCode.begin(), m_vCode.end());
+
+      if (a_iFrame)
+      {
+        a_vOut.push_back(0x48); a_vOut.push_back(0x81); a_vOut.push_back(0xC4);   // add rsp, imm32
+        for (int i=0; i<4; ++i)
+          a_vOut.push_back((unsigned char)(a_iFrame >> (8*i)));
+      }
+
+      a_vOut.push_back(0xC3);                                                     // ret
+
+      while (a_vOut.size() % 16)
+        a_vOut.push_back(0xCC);
+
+      const std::size_t iPool = a_vOut.size();
+      for (std::size_t i=0; i<m_vConst.size(); ++i)
+      {
+        for (int j=0; j<4; ++j)
+        {
+          const unsigned char *pBits = reinterpret_cast<const unsigned char*>(&m_vConst[i]);
+          a_vOut.insert(a_vOut.end(), pBits, pBits + 4);
+        }
+      }
+
+      for (std::size_t i=0; i<m_vFixup.size(); ++i)
+      {
+        const Fixup &fix = m_vFixup[i];
+        int iDisp = (int)(iPool + 16*fix.m_iConst) - (int)(iOfs + fix.m_iEnd);
+        std::memcpy(&a_vOut[iOfs + fix.m_iDisp], &iDisp, 4);
+      }
+    }
+
+  private:
+
+    struct Fixup
+    {
+      Fixup(std::size_t a_iDisp, std::size_t a_iEnd, int a_iConst)
+        :m_iDisp(a_iDisp)
+        ,m_iEnd(a_iEnd)
+        ,m_iConst(a_iConst)
+      {}
+
+      std::size_t m_iDisp;   ///< position of the disp32 field
+      std::size_t m_iEnd;    ///< end of the instruction
+      int m_iConst;
+    };
+
+    bool m_bAvx;
+    std::vector<unsigned char> m_vCode;
+    std::vector<uint32_t> m_vConst;
+    std::vector<Fixup> m_vFixup;
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Translates an expression tree into a function returning its value in xmm0.
+
+      A node evaluated at depth d leaves its value in xmm<d> and may use the
+      registers above it. Variables and constants are used as memory operands
+      where possible, subtrees are evaluated in the order that needs the least
+      registers (Sethi-Ullman). When the registers run out the left operand is
+      spilled to the stack frame. xmm15 is a scratch register of the code
+      emitted for single nodes.
+
+      All xmm registers are caller saved in the System V ABI, the registers
+      below the current depth are stored in the frame across function calls.
+      Frame layout: [rsp, rsp+16) stack arguments 9 and 10 of a call,
+      [rsp+16, rsp+80) saved registers, followed by the spill slots.
+  */
+  class Generator
+  {
+  public:
+
+    typedef CodeBuffer::Operand Operand;
+
+    Generator(bool a_bAvx, int a_iRegs)
+      :m_code(a_bAvx)
+      ,m_bAvx(a_bAvx)
+      ,m_iRegs(a_iRegs)
+      ,m_nSpill(0)
+      ,m_nMaxSpill(0)
+      ,m_bFrame(false)
+    {}
+
+    void Generate(Node *a_pRoot, std::vector<unsigned char> &a_vCode)
+    {
+      Annotate(a_pRoot);
+      Gen(a_pRoot, 0);
+
+      int iFrame = 0;
+      if (m_bFrame)
+      {
+        // rsp is 8 mod 16 on entry and must be 16 byte aligned at calls
+        iFrame = ofsSPILL + 4*m_nMaxSpill;
+        iFrame = (iFrame + 8 + 15) / 16 * 16 - 8;
+      }
+
+      m_code.Link(iFrame, a_vCode);
+
+      if (g_bDumpStack)
+      {
+        std::printf("registers: %d, spill slots: %d, stack frame: %d bytes\n",
+                    m_iRegs, m_nMaxSpill, iFrame);
+      }
+    }
+
+  private:
+
+    enum
+    {
+      regSCRATCH = 15,
+      regNONE    = 0,     // vvvv of instructions without a first source
+      ofsSAVE    = 16,
+      ofsSPILL   = 80
+    };
+
+    static Operand Reg(int a_iReg)
+    {
+      return Operand(Operand::okREG, a_iReg);
+    }
+
+    static Operand Rsp(int a_iOfs)
+    {
+      return Operand(Operand::okRSP, a_iOfs);
+    }
+
+    Operand Slot(int a_iSlot)
+    {
+      return Rsp(ofsSPILL + 4*a_iSlot);
+    }
+
+    int PushSpill()
+    {
+      m_bFrame = true;
+      m_nMaxSpill = std::max(m_nMaxSpill, m_nSpill + 1);
+      return m_nSpill++;
+    }
+
+    void PopSpill()
+    {
+      --m_nSpill;
+    }
+
+    /** \brief Compute register needs, the right operand of a binary node may be a memory operand. */
+    static void Annotate(Node *a_pNode)
+    {
+      std::vector<Node*> &vArg = a_pNode->m_vArg;
+
+      a_pNode->m_bCall = (a_pNode->m_eType==Node::ndFUN);
+      for (std::size_t i=0; i<vArg.size(); ++i)
+      {
+        Annotate(vArg[i]);
+        a_pNode->m_bCall |= vArg[i]->m_bCall;
+      }
+
+      switch(a_pNode->m_eType)
+      {
+      case Node::ndVAL:
+      case Node::ndVAR:
+           a_pNode->m_iNeed = 1;
+           break;
+
+      case Node::ndBIN:
+           {
+             int l = vArg[0]->m_iNeed;
+             int r = vArg[1]->IsLeaf() ? 0 : vArg[1]->m_iNeed;
+             a_pNode->m_iNeed = (l==r) ? l + 1 : std::max(l, r);
+           }
+           break;
+
+      default:
+           a_pNode->m_iNeed = 1;
+           for (std::size_t i=0; i<vArg.size(); ++i)
+             a_pNode->m_iNeed = std::max(a_pNode->m_iNeed, vArg[i]->m_iNeed + (int)i);
+           break;
+      }
+    }
+
+    static bool IsCommutative(unsigned a_iOp, int a_iImm)
+    {
+      switch(a_iOp)
+      {
+      case CodeBuffer::opADDSS:
+      case CodeBuffer::opMULSS:
+      case CodeBuffer::opANDPS:
+      case CodeBuffer::opORPS:
+      case CodeBuffer::opXORPS:
+           return true;
+
+      case CodeBuffer::opCMPSS:
+           return a_iImm==CodeBuffer::cmpEQ || a_iImm==CodeBuffer::cmpNEQ;
+
+      default:
+           return false;
+      }
+    }
+
+    void Movaps(int a_iDst, int a_iSrc)
+    {
+      if (a_iDst!=a_iSrc)
+        m_code.Instr(CodeBuffer::pfNONE, CodeBuffer::opMOVAPS, a_iDst, regNONE, Reg(a_iSrc));
+    }
+
+    void Load(int a_iDst, const Operand &a_Src)
+    {
+      if (a_Src.m_eKind==Operand::okREG)
+        Movaps(a_iDst, a_Src.m_iVal);
+      else
+        m_code.Instr(CodeBuffer::pfF3, CodeBuffer::opMOVSS_LOAD, a_iDst, regNONE, a_Src);
+    }
+
+    void Store(const Operand &a_Dst, int a_iSrc)
+    {
+      m_code.Instr(CodeBuffer::pfF3, CodeBuffer::opMOVSS_STORE, a_iSrc, regNONE, a_Dst);
+    }
+
+    void LoadConst(int a_iDst, value_type a_fVal)
+    {
+      if (a_fVal==0 && !std::signbit(a_fVal))
+        Arith(CodeBuffer::opXORPS, CodeBuffer::pfNONE, a_iDst, a_iDst, Reg(a_iDst));
+      else
+        Load(a_iDst, m_code.Const(a_fVal));
+    }
+
+    /** \brief Operand of a variable or constant, variables are addressed through rax. */
+    Operand Mem(const Node *a_pNode)
+    {
+      if (a_pNode->m_eType==Node::ndVAL)
+        return m_code.Const(a_pNode->m_fVal);
+
+      m_code.MovRax(reinterpret_cast<uint64_t>(a_pNode->m_pVar));
+      return Operand(Operand::okRAX, 0);
+    }
+
+    /** \brief xmm<dst> = xmm<a> op b
+
+        The legacy SSE form overwrites its first operand, a copy of a or the
+        scratch register is used if dst is not a.
+    */
+    void Arith(unsigned a_iOp, int a_iPrefix, int a_iDst, int a, const Operand &b, int a_iImm = -1)
+    {
+      if (m_bAvx)
+      {
+        m_code.Instr(a_iPrefix, a_iOp, a_iDst, a, b, a_iImm);
+      }
+      else if (a_iDst==a)
+      {
+        m_code.Instr(a_iPrefix, a_iOp, a_iDst, regNONE, b, a_iImm);
+      }
+      else if (!b.IsReg(a_iDst))
+      {
+        Movaps(a_iDst, a);
+        m_code.Instr(a_iPrefix, a_iOp, a_iDst, regNONE, b, a_iImm);
+      }
+      else if (IsCommutative(a_iOp, a_iImm))
+      {
+        m_code.Instr(a_iPrefix, a_iOp, a_iDst, regNONE, Reg(a), a_iImm);
+      }
+      else
+      {
+        Movaps(regSCRATCH, a);
+        m_code.Instr(a_iPrefix, a_iOp, regSCRATCH, regNONE, b, a_iImm);
+        Movaps(a_iDst, regSCRATCH);
+      }
+    }
+
+    /** \brief xmm<d> = xmm<d> op b, or b op xmm<d> if swapped. */
+    void Combine(unsigned a_iOp, int a_iPrefix, int d, const Operand &b, bool a_bSwapped, int a_iImm = -1)
+    {
+      if (!a_bSwapped)
+      {
+        Arith(a_iOp, a_iPrefix, d, d, b, a_iImm);
+      }
+      else if (b.m_eKind==Operand::okREG)
+      {
+        Arith(a_iOp, a_iPrefix, d, b.m_iVal, Reg(d), a_iImm);
+      }
+      else if (IsCommutative(a_iOp, a_iImm))
+      {
+        Arith(a_iOp, a_iPrefix, d, d, b, a_iImm);
+      }
+      else
+      {
+        Load(regSCRATCH, b);
+        Arith(a_iOp, a_iPrefix, d, regSCRATCH, Reg(d), a_iImm);
+      }
+    }
+
+    void Gen(Node *a_pNode, int d)
+    {
+      switch(a_pNode->m_eType)
+      {
+      case Node::ndVAL:
+           LoadConst(d, a_pNode->m_fVal);
+           break;
+
+      case Node::ndVAR:
+           Load(d, Mem(a_pNode));
+           break;
+
+      case Node::ndNEG:
+           Gen(a_pNode->m_vArg[0], d);
+           Arith(CodeBuffer::opXORPS, CodeBuffer::pfNONE, d, d, m_code.Const((uint32_t)0x80000000));
+           break;
+
+      case Node::ndABS:
+           Gen(a_pNode->m_vArg[0], d);
+           Arith(CodeBuffer::opANDPS, CodeBuffer::pfNONE, d, d, m_code.Const((uint32_t)0x7FFFFFFF));
+           break;
+
+      case Node::ndSQRT:
+           Gen(a_pNode->m_vArg[0], d);
+           Arith(CodeBuffer::opSQRTSS, CodeBuffer::pfF3, d, d, Reg(d));
+           break;
+
+      case Node::ndPOWI: GenPowInt(a_pNode, d);  break;
+      case Node::ndBIN:  GenBinary(a_pNode, d);  break;
+      case Node::ndFUN:  GenCall(a_pNode, d);    break;
+      case Node::ndIF:   GenIf(a_pNode, d);      break;
+      }
+    }
+
+    /** \brief Evaluate both operands, the left one into xmm<d>.
+        \return The right operand, if a_bSwapped is set the returned operand is
+                the left one and xmm<d> holds the right one.
+    */
+    Operand GenOperands(Node *a_pNode, int d, bool &a_bSwapped)
+    {
+      Node *l = a_pNode->m_vArg[0],
+           *r = a_pNode->m_vArg[1];
+
+      if (r->IsLeaf())
+      {
+        a_bSwapped = false;
+        Gen(l, d);
+        return Mem(r);
+      }
+
+      if (l->IsLeaf())
+      {
+        a_bSwapped = true;
+        Gen(r, d);
+        return Mem(l);
+      }
+
+      if (d + 1 < m_iRegs)
+      {
+        // Calls clobber all registers, evaluating them first saves reloads.
+        a_bSwapped = (r->m_iNeed > l->m_iNeed) || (r->m_bCall && !l->m_bCall);
+        Gen(a_bSwapped ? r : l, d);
+        Gen(a_bSwapped ? l : r, d + 1);
+        return Reg(d + 1);
+      }
+
+      Gen(l, d);
+      int iSlot = PushSpill();
+      Store(Slot(iSlot), d);
+      Gen(r, d);
+      PopSpill();
+
+      a_bSwapped = true;
+      return Slot(iSlot);
+    }
+
+    void GenBinary(Node *a_pNode, int d)
+    {
+      bool bSwapped = false;
+      Operand b = GenOperands(a_pNode, d, bSwapped);
+
+      int iCmp = -1;
+      switch(a_pNode->m_iOp)
+      {
+      case boADD: Combine(CodeBuffer::opADDSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+      case boSUB: Combine(CodeBuffer::opSUBSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+      case boMUL: Combine(CodeBuffer::opMULSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+      case boDIV: Combine(CodeBuffer::opDIVSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+      case boMIN: Combine(CodeBuffer::opMINSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+      case boMAX: Combine(CodeBuffer::opMAXSS, CodeBuffer::pfF3, d, b, bSwapped); return;
+
+      // a>b and a>=b are evaluated as b<a and b<=a
+      case boLT:  iCmp = CodeBuffer::cmpLT;  break;
+      case boLE:  iCmp = CodeBuffer::cmpLE;  break;
+      case boGT:  iCmp = CodeBuffer::cmpLT;  bSwapped = !bSwapped; break;
+      case boGE:  iCmp = CodeBuffer::cmpLE;  bSwapped = !bSwapped; break;
+      case boEQ:  iCmp = CodeBuffer::cmpEQ;  break;
+      case boNEQ: iCmp = CodeBuffer::cmpNEQ; break;
+
+      case boLAND:
+      case boLOR:
+           {
+             int iReg = regSCRATCH;
+             if (b.m_eKind==Operand::okREG)
+               iReg = b.m_iVal;
+             else
+               Load(iReg, b);
+
+             Operand zero = m_code.Const((value_type)0);
+             Arith(CodeBuffer::opCMPSS, CodeBuffer::pfF3, d, d, zero, CodeBuffer::cmpNEQ);
+             Arith(CodeBuffer::opCMPSS, CodeBuffer::pfF3, iReg, iReg, zero, CodeBuffer::cmpNEQ);
+             Arith((a_pNode->m_iOp==boLAND) ? CodeBuffer::opANDPS : CodeBuffer::opORPS,
+                   CodeBuffer::pfNONE, d, d, Reg(iReg));
+           }
+           break;
+
+      default:
+           throw ParserError(ecINTERNAL_ERROR, "unknown binary operator");
+      }
+
+      // comparisons yield an all ones mask which is and-ed with 1.0
+      if (iCmp>=0)
+        Combine(CodeBuffer::opCMPSS, CodeBuffer::pfF3, d, b, bSwapped, iCmp);
+
+      Arith(CodeBuffer::opANDPS, CodeBuffer::pfNONE, d, d, m_code.Const((value_type)1));
+    }
+
+    /** \brief Integer powers by square and multiply. */
+    void GenPowInt(Node *a_pNode, int d)
+    {
+      int iExp = a_pNode->m_iOp;
+      if (iExp==0)
+      {
+        LoadConst(d, 1);
+        return;
+      }
+
+      Gen(a_pNode->m_vArg[0], d);
+
+      unsigned n = (unsigned)std::abs(iExp);
+      int iBase = (d + 1 < m_iRegs) ? d + 1 : regSCRATCH;
+      int iBit = 31;
+      while (!(n & (1u << iBit)))
+        --iBit;
+
+      if (n & (n - 1))
+        Movaps(iBase, d);
+
+      for (--iBit; iBit>=0; --iBit)
+      {
+        Arith(CodeBuffer::opMULSS, CodeBuffer::pfF3, d, d, Reg(d));
+        if (n & (1u << iBit))
+          Arith(CodeBuffer::opMULSS, CodeBuffer::pfF3, d, d, Reg(iBase));
+      }
+
+      if (iExp<0)
+      {
+        LoadConst(regSCRATCH, 1);
+        Arith(CodeBuffer::opDIVSS, CodeBuffer::pfF3, d, regSCRATCH, Reg(d));
+      }
+    }
+
+    /** \brief Call a callback, arguments are passed in xmm0..xmm7 and on the stack. */
+    void GenCall(Node *a_pNode, int d)
+    {
+      const std::vector<Node*> &vArg = a_pNode->m_vArg;
+      const int iArgc = (int)vArg.size();
+
+      m_bFrame = true;
+
+      if (iArgc<=8 && d + iArgc<=m_iRegs)
+      {
+        for (int i=0; i<iArgc; ++i)
+          Gen(vArg[i], d + i);
+
+        for (int i=0; i<d; ++i)
+          Store(Rsp(ofsSAVE + 4*i), i);
+
+        // xmm<d+i> is not overwritten before it is moved to xmm<i>
+        for (int i=0; i<iArgc; ++i)
+          Movaps(i, d + i);
+      }
+      else
+      {
+        const int iFirst = m_nSpill;
+        for (int i=0; i<iArgc; ++i)
+        {
+          Gen(vArg[i], d);
+          Store(Slot(PushSpill()), d);
+        }
+
+        for (int i=0; i<d; ++i)
+          Store(Rsp(ofsSAVE + 4*i), i);
+
+        for (int i=0; i<iArgc; ++i)
+        {
+          if (i<8)
+          {
+            Load(i, Slot(iFirst + i));
+          }
+          else
+          {
+            Load(regSCRATCH, Slot(iFirst + i));
+            Store(Rsp(8*(i - 8)), regSCRATCH);
+          }
+        }
+
+        for (int i=0; i<iArgc; ++i)
+          PopSpill();
+      }
+
+      m_code.Call(reinterpret_cast<uint64_t>(a_pNode->m_pFun));
+
+      Movaps(d, 0);
+      for (int i=0; i<d; ++i)
+        Load(i, Rsp(ofsSAVE + 4*i));
+    }
+
+    /** \brief Branch on the condition, NaN counts as true. */
+    void GenIf(Node *a_pNode, int d)
+    {
+      const unsigned jcJE = 0x84;
+      const unsigned jcJP = 0x8A;
+
+      Gen(a_pNode->m_vArg[0], d);
+      Arith(CodeBuffer::opXORPS, CodeBuffer::pfNONE, regSCRATCH, regSCRATCH, Reg(regSCRATCH));
+      m_code.Instr(CodeBuffer::pfNONE, CodeBuffer::opUCOMISS, d, regNONE, Reg(regSCRATCH));
+
+      std::size_t iSkip = m_code.Jump(jcJP);
+      std::size_t iElse = m_code.Jump(jcJE);
+      m_code.PatchJump(iSkip);
+
+      Gen(a_pNode->m_vArg[1], d);
+      std::size_t iEnd = m_code.Jump(0);
+
+      m_code.PatchJump(iElse);
+      Gen(a_pNode->m_vArg[2], d);
+      m_code.PatchJump(iEnd);
+    }
+
+    CodeBuffer m_code;
+    bool m_bAvx;
+    int m_iRegs;
+    int m_nSpill;
+    int m_nMaxSpill;
+    bool m_bFrame;
+  };
+
+  bool HasAvx()
+  {
+  #if defined(__GNUC__)
+    return __builtin_cpu_supports("avx");
+  #else
+    return false;
+  #endif
+  }
+
+#endif // MEC_JIT_SYSV_X64
+
+  //---------------------------------------------------------------------------
+  /** \brief Executable memory holding the compiled function. */
+  class JitCode
+  {
+  public:
+
+    JitCode()
+      :m_pMem(NULL)
+      ,m_nSize(0)
+    {}
+
+   ~JitCode()
+    {
+      Reset();
+    }
+
+    bool Assign(const std::vector<unsigned char> &a_vCode)
+    {
+      Reset();
+
+  #if defined(MEC_JIT_SYSV_X64)
+      void *pMem = mmap(NULL, a_vCode.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (pMem==MAP_FAILED)
+        return false;
+
+      std::memcpy(pMem, &a_vCode[0], a_vCode.size());
+
+      // never writable and executable at the same time
+      if (mprotect(pMem, a_vCode.size(), PROT_READ | PROT_EXEC)!=0)
+      {
+        munmap(pMem, a_vCode.size());
+        return false;
+      }
+
+      m_pMem = pMem;
+      m_nSize = a_vCode.size();
+      return true;
+  #else
+      (void)a_vCode;
+      return false;
+  #endif
+    }
+
+    void Reset()
+    {
+  #if defined(MEC_JIT_SYSV_X64)
+      if (m_pMem)
+        munmap(m_pMem, m_nSize);
+  #endif
+
+      m_pMem = NULL;
+      m_nSize = 0;
+    }
+
+    mecEvalFun_t GetFun() const
+    {
+      return reinterpret_cast<mecEvalFun_t>(m_pMem);
+    }
+
+  private:
+
+    JitCode(const JitCode&);
+    JitCode& operator=(const JitCode&);
+
+    void *m_pMem;
+    std::size_t m_nSize;
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Parser state behind a mecParserHandle_t. */
+  class ParserSSE
+  {
+  public:
+
+    ParserSSE()
+      :m_sExpr()
+      ,m_vVar()
+      ,m_vConst()
+      ,m_vFun()
+      ,m_vOprt()
+      ,m_vInfixOprt()
+      ,m_vPostfixOprt()
+      ,m_vValIdent()
+      ,m_vExprVar()
+      ,m_sNameChars("0123456789_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ")
+      ,m_sOprtChars("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+-*^/?<>=#!$%&|~'_{}")
+      ,m_sInfixOprtChars("/+-*^?<>=#!$%&|~'_")
+      ,m_cArgSep(',')
+      ,m_cDecSep('.')
+      ,m_cThousandsSep(0)
+      ,m_Code()
+      ,m_bDirty(true)
+      ,m_bError(false)
+      ,m_Error(ecUNDEFINED)
+      ,m_sErrorMsg()
+      ,m_pErrHandler(NULL)
+      ,m_pTree()
+      ,m_iPos(0)
+    {
+      InitFun();
+      InitOprt();
+    }
+
+    //---------------------------------------------------------------------------
+    // symbol definition
+
+    void DefineFun(const std::string &a_sName, GenericFun_t a_pFun, int a_iArgc, bool a_bOptimize)
+    {
+      CheckName(a_sName, m_sNameChars);
+      if (!a_pFun)
+        throw ParserError(ecINVALID_FUN_PTR);
+
+      m_vFun[a_sName] = FunDef(a_pFun, a_iArgc, a_bOptimize, fkCALL);
+      m_bDirty = true;
+    }
+
+    void DefineOprt(const std::string &a_sName, mecFun2_t a_pFun, int a_iPrec, int a_iAsct, bool a_bOptimize)
+    {
+      CheckName(a_sName, m_sOprtChars);
+      if (!a_pFun)
+        throw ParserError(ecINVALID_FUN_PTR);
+
+      if (a_iPrec<0)
+        throw ParserError(ecOPT_PRI);
+
+      for (std::size_t i=0; i<m_vOprt.size(); ++i)
+      {
+        if (m_vOprt[i].m_sName==a_sName && m_vOprt[i].m_iBuiltin>=0)
+          throw ParserError(ecBUILTIN_OVERLOAD, a_sName);
+      }
+
+      RemoveOprt(m_vOprt, a_sName);
+      m_vOprt.push_back(OprtDef(a_sName, reinterpret_cast<GenericFun_t>(a_pFun), a_iPrec,
+                                a_iAsct==mecOPRT_ASCT_RIGHT, a_bOptimize, -1));
+      m_bDirty = true;
+    }
+
+    void DefineInfixOprt(const std::string &a_sName, mecFun1_t a_pFun, bool a_bOptimize)
+    {
+      CheckName(a_sName, m_sInfixOprtChars);
+      if (!a_pFun)
+        throw ParserError(ecINVALID_FUN_PTR);
+
+      RemoveOprt(m_vInfixOprt, a_sName);
+      m_vInfixOprt.push_back(OprtDef(a_sName, reinterpret_cast<GenericFun_t>(a_pFun), prINFIX, false, a_bOptimize, -1));
+      m_bDirty = true;
+    }
+
+    void DefinePostfixOprt(const std::string &a_sName, mecFun1_t a_pFun, bool a_bOptimize)
+    {
+      CheckName(a_sName, m_sOprtChars);
+      if (!a_pFun)
+        throw ParserError(ecINVALID_FUN_PTR);
+
+      RemoveOprt(m_vPostfixOprt, a_sName);
+      m_vPostfixOprt.push_back(OprtDef(a_sName, reinterpret_cast<GenericFun_t>(a_pFun), 0, false, a_bOptimize, -1));
+      m_bDirty = true;
+    }
+
+    void DefineConst(const std::string &a_sName, value_type a_fVal)
+    {
+      CheckName(a_sName, m_sNameChars);
+      if (m_vVar.find(a_sName)!=m_vVar.end())
+        throw ParserError(ecNAME_CONFLICT, a_sName);
+
+      m_vConst[a_sName] = a_fVal;
+      m_bDirty = true;
+    }
+
+    void DefineVar(const std::string &a_sName, value_type *a_pVar)
+    {
+      CheckName(a_sName, m_sNameChars);
+      if (!a_pVar)
+        throw ParserError(ecINVALID_VAR_PTR);
+
+      if (m_vConst.find(a_sName)!=m_vConst.end())
+        throw ParserError(ecNAME_CONFLICT, a_sName);
+
+      m_vVar[a_sName] = a_pVar;
+      m_bDirty = true;
+    }
+
+    void RemoveVar(const std::string &a_sName) { m_vVar.erase(a_sName); m_bDirty = true; }
+    void ClearVar()                           { m_vVar.clear();         m_bDirty = true; }
+    void ClearConst()                         { m_vConst.clear();       m_bDirty = true; }
+    void ClearFun()                           { m_vFun.clear();         m_bDirty = true; }
+
+    void ClearOprt()
+    {
+      m_vOprt.clear();
+      m_vInfixOprt.clear();
+      m_vPostfixOprt.clear();
+      InitOprt();
+      m_bDirty = true;
+    }
+
+    void AddValIdent(mecIdentFun_t a_pFun)
+    {
+      m_vValIdent.push_back(a_pFun);
+      m_bDirty = true;
+    }
+
+    void SetNameChars(const char *a_szCharset)      { m_sNameChars = a_szCharset;      }
+    void SetOprtChars(const char *a_szCharset)      { m_sOprtChars = a_szCharset;      }
+    void SetInfixOprtChars(const char *a_szCharset) { m_sInfixOprtChars = a_szCharset; }
+
+    void SetArgSep(char c)       { m_cArgSep = c;       m_bDirty = true; }
+    void SetDecSep(char c)       { m_cDecSep = c;       m_bDirty = true; }
+    void SetThousandsSep(char c) { m_cThousandsSep = c; m_bDirty = true; }
+
+    void ResetLocale()
+    {
+      m_cArgSep = ',';
+      m_cDecSep = '.';
+      m_cThousandsSep = 0;
+      m_bDirty = true;
+    }
+
+    //---------------------------------------------------------------------------
+    // expression
+
+    void SetExpr(const std::string &a_sExpr)
+    {
+      if (m_cDecSep==m_cArgSep)
+        throw ParserError(ecLOCALE);
+
+      m_sExpr = a_sExpr;
+      m_Code.Reset();
+      m_bDirty = true;
+    }
+
+    const std::string& GetExpr() const
+    {
+      return m_sExpr;
+    }
+
+    /** \brief Parse the expression and generate its code.
+        \param a_iRegs Number of xmm registers available to the code generator.
+    */
+    mecEvalFun_t Compile(int a_iRegs)
+    {
+  #if defined(MEC_JIT_SYSV_X64)
+      Tree tree;
+      Node *pRoot = Parse(tree);
+
+      Generator gen(HasAvx(), std::max(1, std::min(a_iRegs, 15)));
+      std::vector<unsigned char> vCode;
+      gen.Generate(pRoot, vCode);
+
+      if (g_bDumpCode)
+      {
+        std::printf("%s: %d bytes\n", m_sExpr.c_str(), (int)vCode.size());
+        for (std::size_t i=0; i<vCode.size(); ++i)
+          std::printf("%02x%c", vCode[i], ((i + 1) % 16) ? ' ' : '\n');
+        std::printf("\n");
+      }
+
+      if (!m_Code.Assign(vCode))
+        throw ParserError(ecINTERNAL_ERROR, "can't allocate executable memory");
+
+      m_bDirty = false;
+      return m_Code.GetFun();
+  #else
+      (void)a_iRegs;
+      throw ParserError(ecINTERNAL_ERROR, "native code generation is not supported on this platform");
+  #endif
+    }
+
+    value_type Eval()
+    {
+      if (m_bDirty || !m_Code.GetFun())
+        Compile(15);
+
+      return m_Code.GetFun()();
+    }
+
+    //---------------------------------------------------------------------------
+    // queries
+
+    typedef std::map<std::string, value_type*> varmap_type;
+    typedef std::map<std::string, value_type> constmap_type;
+
+    const varmap_type& GetVar() const      { return m_vVar;     }
+    const varmap_type& GetExprVar() const  { return m_vExprVar; }
+    const constmap_type& GetConst() const  { return m_vConst;   }
+
+    //---------------------------------------------------------------------------
+    // error handling
+
+    void SetError(const ParserError &a_Error)
+    {
+      m_bError = true;
+      m_Error = a_Error;
+      m_sErrorMsg = a_Error.GetMsg();
+
+      if (m_pErrHandler)
+        m_pErrHandler(reinterpret_cast<mecParserHandle_t>(this));
+    }
+
+    void ErrorReset()
+    {
+      m_bError = false;
+      m_Error = ParserError(ecUNDEFINED);
+      m_sErrorMsg.clear();
+    }
+
+    bool HasError() const                       { return m_bError;            }
+    const ParserError& GetError() const         { return m_Error;             }
+    const std::string& GetErrorMsg() const      { return m_sErrorMsg;         }
+    void SetErrorHandler(mecErrorHandler_t pFun) { m_pErrHandler = pFun;       }
+
+  private:
+
+    enum EFunKind
+    {
+      fkCALL,
+      fkSQRT,
+      fkABS,
+      fkMIN,
+      fkMAX,
+      fkSUM,
+      fkAVG
+    };
+
+    struct FunDef
+    {
+      FunDef(GenericFun_t a_pFun = NULL, int a_iArgc = 0, bool a_bOptimize = true, EFunKind a_eKind = fkCALL)
+        :m_pFun(a_pFun)
+        ,m_iArgc(a_iArgc)
+        ,m_bOptimize(a_bOptimize)
+        ,m_eKind(a_eKind)
+      {}
+
+      GenericFun_t m_pFun;
+      int m_iArgc;          ///< -1 for any number of arguments
+      bool m_bOptimize;
+      EFunKind m_eKind;
+    };
+
+    struct OprtDef
+    {
+      OprtDef(const std::string &a_sName, GenericFun_t a_pFun, int a_iPrec, bool a_bRight, bool a_bOptimize, int a_iBuiltin)
+        :m_sName(a_sName)
+        ,m_pFun(a_pFun)
+        ,m_iPrec(a_iPrec)
+        ,m_bRight(a_bRight)
+        ,m_bOptimize(a_bOptimize)
+        ,m_iBuiltin(a_iBuiltin)
+      {}
+
+      std::string m_sName;
+      GenericFun_t m_pFun;
+      int m_iPrec;
+      bool m_bRight;
+      bool m_bOptimize;
+      int m_iBuiltin;       ///< EBinOp, boPOW or boNEG/boPLUS of builtin operators, -1 for callbacks
+    };
+
+    // builtin operators that are no EBinOp
+    enum
+    {
+      boPOW = 100,
+      boNEG,
+      boPLUS
+    };
+
+    template<typename TFun>
+    void AddFun(const char *a_szName, TFun a_pFun, int a_iArgc, EFunKind a_eKind = fkCALL)
+    {
+      m_vFun[a_szName] = FunDef(reinterpret_cast<GenericFun_t>(a_pFun), a_iArgc, true, a_eKind);
+    }
+
+    void InitFun()
+    {
+      AddFun("sin",   ::sinf,   1);
+      AddFun("cos",   ::cosf,   1);
+      AddFun("tan",   ::tanf,   1);
+      AddFun("asin",  ::asinf,  1);
+      AddFun("acos",  ::acosf,  1);
+      AddFun("atan",  ::atanf,  1);
+      AddFun("sinh",  ::sinhf,  1);
+      AddFun("cosh",  ::coshf,  1);
+      AddFun("tanh",  ::tanhf,  1);
+      AddFun("asinh", ::asinhf, 1);
+      AddFun("acosh", ::acoshf, 1);
+      AddFun("atanh", ::atanhf, 1);
+      AddFun("log2",  ::log2f,  1);
+      AddFun("log10", ::log10f, 1);
+      AddFun("log",   ::logf,   1);
+      AddFun("ln",    ::logf,   1);
+      AddFun("exp",   ::expf,   1);
+      AddFun("rint",  ::rintf,  1);
+      AddFun("sign",  Sign,     1);
+      AddFun("sqrt",  ::sqrtf,  1, fkSQRT);
+      AddFun("abs",   ::fabsf,  1, fkABS);
+      AddFun("min",   (GenericFun_t)NULL, -1, fkMIN);
+      AddFun("max",   (GenericFun_t)NULL, -1, fkMAX);
+      AddFun("sum",   (GenericFun_t)NULL, -1, fkSUM);
+      AddFun("avg",   (GenericFun_t)NULL, -1, fkAVG);
+    }
+
+    void InitOprt()
+    {
+      static const struct { const char *szName; int iPrec; int iOp; } s_Oprt[] =
+      {
+        { "||", prLOR,     boLOR  },
+        { "&&", prLAND,    boLAND },
+        { "<=", prCMP,     boLE   },
+        { ">=", prCMP,     boGE   },
+        { "!=", prCMP,     boNEQ  },
+        { "==", prCMP,     boEQ   },
+        { "<",  prCMP,     boLT   },
+        { ">",  prCMP,     boGT   },
+        { "+",  prADD_SUB, boADD  },
+        { "-",  prADD_SUB, boSUB  },
+        { "*",  prMUL_DIV, boMUL  },
+        { "/",  prMUL_DIV, boDIV  },
+        { "^",  prPOW,     boPOW  }
+      };
+
+      for (std::size_t i=0; i<sizeof(s_Oprt)/sizeof(s_Oprt[0]); ++i)
+        m_vOprt.push_back(OprtDef(s_Oprt[i].szName, NULL, s_Oprt[i].iPrec, s_Oprt[i].iOp==boPOW, true, s_Oprt[i].iOp));
+
+      m_vInfixOprt.push_back(OprtDef("-", NULL, prINFIX, false, true, boNEG));
+      m_vInfixOprt.push_back(OprtDef("+", NULL, prINFIX, false, true, boPLUS));
+    }
+
+    static void RemoveOprt(std::vector<OprtDef> &a_vOprt, const std::string &a_sName)
+    {
+      for (std::size_t i=0; i<a_vOprt.size(); ++i)
+      {
+        if (a_vOprt[i].m_sName==a_sName)
+        {
+          a_vOprt.erase(a_vOprt.begin() + i);
+          return;
+        }
+      }
+    }
+
+    static void CheckName(const std::string &a_sName, const std::string &a_sCharset)
+    {
+      if (a_sName.empty() ||
+          a_sName.find_first_not_of(a_sCharset)!=std::string::npos ||
+          (a_sName[0]>='0' && a_sName[0]<='9'))
+      {
+        throw ParserError(ecINVALID_NAME, a_sName);
+      }
+    }
+
+    //---------------------------------------------------------------------------
+    // parser
+    //
+    // ternary := binary ['?' ternary ':' ternary]
+    // binary  := unary {oprt binary}            precedence climbing
+    // unary   := infix_oprt binary(prINFIX + 1) | postfix
+    // postfix := primary {postfix_oprt}
+    // primary := '(' ternary ')' | function '(' args ')' | constant | value | variable
+
+    Node* Parse(Tree &a_Tree)
+    {
+      m_pTree = &a_Tree;
+      m_iPos = 0;
+      m_vExprVar.clear();
+
+      SkipSpace();
+      if (m_iPos==(int)m_sExpr.size())
+        throw ParserError(ecEMPTY_EXPRESSION);
+
+      Node *pRoot = ParseTernary();
+
+      SkipSpace();
+      if (m_iPos<(int)m_sExpr.size())
+      {
+        char c = m_sExpr[m_iPos];
+        if (c==')')
+          throw ParserError(ecUNEXPECTED_PARENS, ")", m_iPos);
+        else if (c==m_cArgSep)
+          throw ParserError(ecUNEXPECTED_ARG_SEP, std::string(1, c), m_iPos);
+        else
+          throw ParserError(ecUNASSIGNABLE_TOKEN, m_sExpr.substr(m_iPos), m_iPos);
+      }
+
+      m_pTree = NULL;
+      return pRoot;
+    }
+
+    void SkipSpace()
+    {
+      while (m_iPos<(int)m_sExpr.size() && std::strchr(" \t\r\n", m_sExpr[m_iPos]) && m_sExpr[m_iPos])
+        ++m_iPos;
+    }
+
+    bool IsChar(char c)
+    {
+      SkipSpace();
+      if (m_iPos<(int)m_sExpr.size() && m_sExpr[m_iPos]==c)
+      {
+        ++m_iPos;
+        return true;
+      }
+
+      return false;
+    }
+
+    /** \brief Longest operator of the list matching at the current position. */
+    const OprtDef* MatchOprt(const std::vector<OprtDef> &a_vOprt)
+    {
+      SkipSpace();
+
+      const OprtDef *pBest = NULL;
+      for (std::size_t i=0; i<a_vOprt.size(); ++i)
+      {
+        const std::string &sName = a_vOprt[i].m_sName;
+        if (m_sExpr.compare(m_iPos, sName.size(), sName)==0 &&
+            (!pBest || sName.size()>pBest->m_sName.size()))
+        {
+          pBest = &a_vOprt[i];
+        }
+      }
+
+      return pBest;
+    }
+
+    Node* ParseTernary()
+    {
+      Node *pCond = ParseBinary(prLOR);
+
+      if (!IsChar('?'))
+        return pCond;
+
+      Node *pIf = m_pTree->New(Node::ndIF);
+      pIf->m_vArg.push_back(pCond);
+      pIf->m_vArg.push_back(ParseTernary());
+
+      if (!IsChar(':'))
+        throw ParserError(ecMISSING_PARENS, ":", m_iPos);
+
+      pIf->m_vArg.push_back(ParseTernary());
+
+      if (pCond->m_eType==Node::ndVAL)
+        return (pCond->m_fVal!=0) ? pIf->m_vArg[1] : pIf->m_vArg[2];
+
+      return pIf;
+    }
+
+    Node* ParseBinary(int a_iMinPrec)
+    {
+      Node *pLeft = ParseUnary();
+
+      for (;;)
+      {
+        const OprtDef *pOprt = MatchOprt(m_vOprt);
+        if (!pOprt || pOprt->m_iPrec<a_iMinPrec)
+          return pLeft;
+
+        m_iPos += (int)pOprt->m_sName.size();
+        Node *pRight = ParseBinary(pOprt->m_bRight ? pOprt->m_iPrec : pOprt->m_iPrec + 1);
+
+        if (pOprt->m_iBuiltin==boPOW)
+          pLeft = MakePow(pLeft, pRight);
+        else if (pOprt->m_iBuiltin>=0)
+          pLeft = MakeBinary(pOprt->m_iBuiltin, pLeft, pRight);
+        else
+          pLeft = MakeCall(pOprt->m_pFun, pOprt->m_bOptimize, pLeft, pRight);
+      }
+    }
+
+    Node* ParseUnary()
+    {
+      const OprtDef *pOprt = MatchOprt(m_vInfixOprt);
+      if (!pOprt)
+        return ParsePostfix(ParsePrimary());
+
+      m_iPos += (int)pOprt->m_sName.size();
+      Node *pArg = ParseBinary(prINFIX + 1);
+
+      switch(pOprt->m_iBuiltin)
+      {
+      case boPLUS: return pArg;
+      case boNEG:  return MakeUnary(Node::ndNEG, pArg);
+      default:     return MakeCall(pOprt->m_pFun, pOprt->m_bOptimize, pArg);
+      }
+    }
+
+    Node* ParsePostfix(Node *a_pArg)
+    {
+      while (const OprtDef *pOprt = MatchOprt(m_vPostfixOprt))
+      {
+        m_iPos += (int)pOprt->m_sName.size();
+        a_pArg = MakeCall(pOprt->m_pFun, pOprt->m_bOptimize, a_pArg);
+      }
+
+      return a_pArg;
+    }
+
+    Node* ParsePrimary()
+    {
+      SkipSpace();
+
+      if (m_iPos>=(int)m_sExpr.size())
+        throw ParserError(ecUNEXPECTED_EOF, "", m_iPos);
+
+      if (IsChar('('))
+      {
+        Node *pNode = ParseTernary();
+        if (!IsChar(')'))
+          throw ParserError(ecMISSING_PARENS, ")", m_iPos);
+
+        return pNode;
+      }
+
+      const int iStart = m_iPos;
+      std::string::size_type iEnd = m_sExpr.find_first_not_of(m_sNameChars, m_iPos);
+      if (iEnd==std::string::npos)
+        iEnd = m_sExpr.size();
+
+      const std::string sName = m_sExpr.substr(m_iPos, iEnd - m_iPos);
+
+      if (!sName.empty())
+      {
+        std::map<std::string, FunDef>::const_iterator itFun = m_vFun.find(sName);
+        if (itFun!=m_vFun.end())
+        {
+          m_iPos = (int)iEnd;
+          return ParseFunction(sName, itFun->second, iStart);
+        }
+
+        constmap_type::const_iterator itConst = m_vConst.find(sName);
+        if (itConst!=m_vConst.end())
+        {
+          m_iPos = (int)iEnd;
+          return m_pTree->Val(itConst->second);
+        }
+      }
+
+      value_type fVal = 0;
+      for (std::size_t i=0; i<m_vValIdent.size(); ++i)
+      {
+        int iLen = 0;
+        if (m_vValIdent[i](m_sExpr.c_str() + m_iPos, &iLen, &fVal) && iLen>0)
+        {
+          m_iPos += iLen;
+          return m_pTree->Val(fVal);
+        }
+      }
+
+      if (ParseNumber(fVal))
+        return m_pTree->Val(fVal);
+
+      if (!sName.empty())
+      {
+        varmap_type::const_iterator itVar = m_vVar.find(sName);
+        if (itVar!=m_vVar.end())
+        {
+          m_iPos = (int)iEnd;
+          m_vExprVar[sName] = itVar->second;
+
+          Node *pNode = m_pTree->New(Node::ndVAR);
+          pNode->m_pVar = itVar->second;
+          return pNode;
+        }
+
+        throw ParserError(ecUNASSIGNABLE_TOKEN, sName, iStart);
+      }
+
+      char c = m_sExpr[m_iPos];
+      if (c==')')
+        throw ParserError(ecUNEXPECTED_PARENS, ")", m_iPos);
+      else if (c==m_cArgSep)
+        throw ParserError(ecUNEXPECTED_ARG_SEP, std::string(1, c), m_iPos);
+      else if (MatchOprt(m_vOprt))
+        throw ParserError(ecUNEXPECTED_OPERATOR, MatchOprt(m_vOprt)->m_sName, m_iPos);
+
+      throw ParserError(ecUNASSIGNABLE_TOKEN, m_sExpr.substr(m_iPos, 1), m_iPos);
+    }
+
+    /** \brief Numbers with the configured decimal and thousands separators. */
+    bool ParseNumber(value_type &a_fVal)
+    {
+      const std::string &s = m_sExpr;
+      int i = m_iPos;
+      std::string sNum;
+
+      while (i<(int)s.size())
+      {
+        if (s[i]>='0' && s[i]<='9')
+          sNum += s[i];
+        else if (m_cThousandsSep==0 || s[i]!=m_cThousandsSep || sNum.empty())
+          break;
+
+        ++i;
+      }
+
+      if (i<(int)s.size() && s[i]==m_cDecSep)
+      {
+        sNum += '.';
+        for (++i; i<(int)s.size() && s[i]>='0' && s[i]<='9'; ++i)
+          sNum += s[i];
+      }
+
+      if (sNum.empty() || sNum==".")
+        return false;
+
+      // an exponent needs at least one digit
+      if (i<(int)s.size() && (s[i]=='e' || s[i]=='E'))
+      {
+        int j = i + 1;
+        if (j<(int)s.size() && (s[j]=='+' || s[j]=='-'))
+          ++j;
+
+        if (j<(int)s.size() && s[j]>='0' && s[j]<='9')
+        {
+          sNum += s.substr(i, j - i);
+          for (i=j; i<(int)s.size() && s[i]>='0' && s[i]<='9'; ++i)
+            sNum += s[i];
+        }
+      }
+
+      a_fVal = (value_type)std::strtod(sNum.c_str(), NULL);
+      m_iPos = i;
+      return true;
+    }
+
+    Node* ParseFunction(const std::string &a_sName, const FunDef &a_Fun, int a_iPos)
+    {
+      if (!IsChar('('))
+        throw ParserError(ecUNEXPECTED_FUN, a_sName, a_iPos);
+
+      std::vector<Node*> vArg;
+      if (!IsChar(')'))
+      {
+        do
+        {
+          vArg.push_back(ParseTernary());
+        }
+        while (IsChar(m_cArgSep));
+
+        if (!IsChar(')'))
+          throw ParserError(ecMISSING_PARENS, a_sName, m_iPos);
+      }
+
+      const int iArgc = (int)vArg.size();
+      if (a_Fun.m_iArgc>=0 && iArgc>a_Fun.m_iArgc)
+        throw ParserError(ecTOO_MANY_PARAMS, a_sName, a_iPos);
+
+      if ((a_Fun.m_iArgc>=0 && iArgc<a_Fun.m_iArgc) || (a_Fun.m_iArgc<0 && iArgc==0))
+        throw ParserError(ecTOO_FEW_PARAMS, a_sName, a_iPos);
+
+      switch(a_Fun.m_eKind)
+      {
+      case fkSQRT: return MakeUnary(Node::ndSQRT, vArg[0]);
+      case fkABS:  return MakeUnary(Node::ndABS, vArg[0]);
+
+      case fkMIN:
+      case fkMAX:
+      case fkSUM:
+      case fkAVG:
+           {
+             int iOp = (a_Fun.m_eKind==fkMIN) ? boMIN : ((a_Fun.m_eKind==fkMAX) ? boMAX : boADD);
+             Node *pNode = vArg[0];
+             for (int i=1; i<iArgc; ++i)
+               pNode = MakeBinary(iOp, pNode, vArg[i]);
+
+             if (a_Fun.m_eKind==fkAVG)
+               pNode = MakeBinary(boDIV, pNode, m_pTree->Val((value_type)iArgc));
+
+             return pNode;
+           }
+
+      default:
+           {
+             Node *pNode = m_pTree->New(Node::ndFUN);
+             pNode->m_pFun = a_Fun.m_pFun;
+             pNode->m_vArg = vArg;
+             return a_Fun.m_bOptimize ? m_pTree->Fold(pNode) : pNode;
+           }
+      }
+    }
+
+    //---------------------------------------------------------------------------
+    // tree construction with constant folding
+
+    Node* MakeUnary(Node::EType a_eType, Node *a_pArg)
+    {
+      Node *pNode = m_pTree->New(a_eType);
+      pNode->m_vArg.push_back(a_pArg);
+      return m_pTree->Fold(pNode);
+    }
+
+    Node* MakeBinary(int a_iOp, Node *a_pLeft, Node *a_pRight)
+    {
+      Node *pNode = m_pTree->New(Node::ndBIN);
+      pNode->m_iOp = a_iOp;
+      pNode->m_vArg.push_back(a_pLeft);
+      pNode->m_vArg.push_back(a_pRight);
+      return m_pTree->Fold(pNode);
+    }
+
+    Node* MakeCall(GenericFun_t a_pFun, bool a_bOptimize, Node *a_pArg1, Node *a_pArg2 = NULL)
+    {
+      Node *pNode = m_pTree->New(Node::ndFUN);
+      pNode->m_pFun = a_pFun;
+      pNode->m_vArg.push_back(a_pArg1);
+      if (a_pArg2)
+        pNode->m_vArg.push_back(a_pArg2);
+
+      return a_bOptimize ? m_pTree->Fold(pNode) : pNode;
+    }
+
+    /** \brief Small integer exponents are multiplied out, x^0.5 is a square root. */
+    Node* MakePow(Node *a_pBase, Node *a_pExp)
+    {
+      if (a_pExp->m_eType==Node::ndVAL && a_pBase->m_eType!=Node::ndVAL)
+      {
+        value_type fExp = a_pExp->m_fVal;
+
+        if (fExp==(int)fExp && std::fabs(fExp)<=64)
+        {
+          Node *pNode = m_pTree->New(Node::ndPOWI);
+          pNode->m_iOp = (int)fExp;
+          pNode->m_vArg.push_back(a_pBase);
+          return pNode;
+        }
+
+        if (fExp==0.5f)
+          return MakeUnary(Node::ndSQRT, a_pBase);
+      }
+
+      return MakeCall(reinterpret_cast<GenericFun_t>(::powf), true, a_pBase, a_pExp);
+    }
+
+    std::string m_sExpr;
+    varmap_type m_vVar;
+    constmap_type m_vConst;
+    std::map<std::string, FunDef> m_vFun;
+    std::vector<OprtDef> m_vOprt;
+    std::vector<OprtDef> m_vInfixOprt;
+    std::vector<OprtDef> m_vPostfixOprt;
+    std::vector<mecIdentFun_t> m_vValIdent;
+    varmap_type m_vExprVar;             ///< variables used by the last compiled expression
+
+    std::string m_sNameChars;
+    std::string m_sOprtChars;
+    std::string m_sInfixOprtChars;
+    char m_cArgSep;
+    char m_cDecSep;
+    char m_cThousandsSep;
+
+    JitCode m_Code;
+    bool m_bDirty;                      ///< definitions changed since the last compilation
+
+    bool m_bError;
+    ParserError m_Error;
+    std::string m_sErrorMsg;
+    mecErrorHandler_t m_pErrHandler;
+
+    Tree *m_pTree;                      ///< tree under construction while parsing
+    int m_iPos;
+  };
+
+  //---------------------------------------------------------------------------
+  ParserSSE* AsParser(mecParserHandle_t a_hParser)
+  {
+    return reinterpret_cast<ParserSSE*>(a_hParser);
+  }
+
+  template<typename TMap>
+  typename TMap::const_iterator Nth(const TMap &a_Map, unsigned a_iIdx)
+  {
+    typename TMap::const_iterator it = a_Map.begin();
+    for (unsigned i=0; i<a_iIdx && it!=a_Map.end(); ++i)
+      ++it;
+
+    return it;
+  }
+} // anonymous namespace
+
+// Run the statement and report parser errors through the handle
+#define MEC_TRY(STMT)                  \
+  try                                  \
+  {                                    \
+    STMT;                              \
+  }                                    \
+  catch(ParserError &e)                \
+  {                                    \
+    AsParser(a_hParser)->SetError(e);  \
+  }
+
+//---------------------------------------------------------------------------
+// Constants
+
+int mecOPRT_ASCT_LEFT       = 0;
+int mecOPRT_ASCT_RIGHT      = 1;
+
+int mecUNEXPECTED_OPERATOR  = ecUNEXPECTED_OPERATOR;
+int mecUNASSIGNABLE_TOKEN   = ecUNASSIGNABLE_TOKEN;
+int mecUNEXPECTED_EOF       = ecUNEXPECTED_EOF;
+int mecUNEXPECTED_ARG_SEP   = ecUNEXPECTED_ARG_SEP;
+int mecUNEXPECTED_ARG       = ecUNEXPECTED_ARG;
+int mecUNEXPECTED_VAL       = ecUNEXPECTED_VAL;
+int mecUNEXPECTED_VAR       = ecUNEXPECTED_VAR;
+int mecUNEXPECTED_PARENS    = ecUNEXPECTED_PARENS;
+int mecUNEXPECTED_STR       = ecUNEXPECTED_STR;
+int mecSTRING_EXPECTED      = ecSTRING_EXPECTED;
+int mecVAL_EXPECTED         = ecVAL_EXPECTED;
+int mecMISSING_PARENS       = ecMISSING_PARENS;
+int mecUNEXPECTED_FUN       = ecUNEXPECTED_FUN;
+int mecUNTERMINATED_STRING  = ecUNTERMINATED_STRING;
+int mecTOO_MANY_PARAMS      = ecTOO_MANY_PARAMS;
+int mecTOO_FEW_PARAMS       = ecTOO_FEW_PARAMS;
+int mecOPRT_TYPE_CONFLICT   = ecOPRT_TYPE_CONFLICT;
+int mecSTR_RESULT           = ecSTR_RESULT;
+int mecINVALID_NAME         = ecINVALID_NAME;
+int mecBUILTIN_OVERLOAD     = ecBUILTIN_OVERLOAD;
+int mecINVALID_FUN_PTR      = ecINVALID_FUN_PTR;
+int mecINVALID_VAR_PTR      = ecINVALID_VAR_PTR;
+int mecEMPTY_EXPRESSION     = ecEMPTY_EXPRESSION;
+int mecNAME_CONFLICT        = ecNAME_CONFLICT;
+int mecOPT_PRI              = ecOPT_PRI;
+int mecDOMAIN_ERROR         = ecDOMAIN_ERROR;
+int mecDIV_BY_ZERO          = ecDIV_BY_ZERO;
+int mecGENERIC              = ecGENERIC;
+int mecLOCALE               = ecLOCALE;
+int mecINTERNAL_ERROR       = ecINTERNAL_ERROR;
+int mecUNDEFINED            = ecUNDEFINED;
+
+//---------------------------------------------------------------------------
+// Basic operations / initialization
+
+API_EXPORT(void) mecDebugDump(int nDumpCmd, int nDumpStack)
+{
+  g_bDumpCode = nDumpCmd!=0;
+  g_bDumpStack = nDumpStack!=0;
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecSelfTest()
+{
+  static const struct { const char *szExpr; float fRes; } s_Test[] =
+  {
+    { "1+2*3",                7       },
+    { "-2^2",                 -4      },
+    { "2^-2",                 0.25f   },
+    { "2^3^2",                512     },
+    { "a*(b+3)-b/a",          3       },
+    { "a^3+b^0.5",            3       },
+    { "sin(a-1)+cos(0)",      1       },
+    { "min(b,a,3)+max(a,b)",  5       },
+    { "sum(a,b,3)/avg(a,b)",  3.2f    },
+    { "(a<b)+(a>b)+(a==1)",   2       },
+    { "a<b && b<a || 1",      1       },
+    { "a>b ? 10 : b<5 ? 20 : 30", 20  },
+    { "sqrt(b*b)+abs(-a)",    5       },
+    { "1-2-3-(4-5)",          -3      },
+    { "2*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)*(a+b)", 1.52587890625e12f }
+  };
+
+  float a = 1, b = 4;
+  int iFail = 0;
+  const int iCount = (int)(sizeof(s_Test)/sizeof(s_Test[0]));
+
+  mecParserHandle_t hParser = mecCreate();
+  mecDefineVar(hParser, "a", &a);
+  mecDefineVar(hParser, "b", &b);
+
+  for (int iRegs=15; iRegs>=1; iRegs-=7)
+  {
+    for (int i=0; i<iCount; ++i)
+    {
+      mecSetExpr(hParser, s_Test[i].szExpr);
+      mecEvalFun_t pFun = mecDbgCompile(hParser, iRegs);
+      float fRes = pFun ? pFun() : 0;
+
+      if (!pFun || std::fabs(fRes - s_Test[i].fRes)>1e-5f*std::max(1.f, std::fabs(s_Test[i].fRes)))
+      {
+        std::printf("  fail: %s = %g (expected %g, %d registers)%s%s\n",
+                    s_Test[i].szExpr, fRes, s_Test[i].fRes, iRegs,
+                    pFun ? "" : " ", pFun ? "" : mecGetErrorMsg(hParser));
+        mecErrorReset(hParser);
+        ++iFail;
+      }
+    }
+  }
+
+  mecRelease(hParser);
+
+  if (iFail)
+    std::printf("muParserSSE self test: %d test(s) failed\n", iFail);
+  else
+    std::printf("muParserSSE self test: all tests passed\n");
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(mecParserHandle_t) mecCreate()
+{
+  return reinterpret_cast<mecParserHandle_t>(new ParserSSE());
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(float) mecEval(mecParserHandle_t a_hParser)
+{
+  MEC_TRY(return AsParser(a_hParser)->Eval())
+  return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compile the expression, the function stays valid until the expression is changed. */
+API_EXPORT(mecEvalFun_t) mecCompile(mecParserHandle_t a_hParser)
+{
+  MEC_TRY(return AsParser(a_hParser)->Compile(15))
+  return NULL;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compile using only nRegNum xmm registers, for testing the spill code. */
+API_EXPORT(mecEvalFun_t) mecDbgCompile(mecParserHandle_t a_hParser, int nRegNum)
+{
+  MEC_TRY(return AsParser(a_hParser)->Compile(nRegNum))
+  return NULL;
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecRelease(mecParserHandle_t a_hParser)
+{
+  delete AsParser(a_hParser);
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(const mecChar_t*) mecGetExpr(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->GetExpr().c_str();
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecSetExpr(mecParserHandle_t a_hParser, const mecChar_t *a_szExpr)
+{
+  MEC_TRY(AsParser(a_hParser)->SetExpr(a_szExpr))
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(const mecChar_t*) mecGetVersion(mecParserHandle_t)
+{
+  return "1.0.0 (x86-64 SSE/AVX)";
+}
+
+//---------------------------------------------------------------------------
+// Defining callbacks / variables / constants
+
+#define MEC_DEFINE_FUN(N, TYPE)                                                                              \
+API_EXPORT(void) mecDefineFun##N(mecParserHandle_t a_hParser, const mecChar_t *a_szName, TYPE a_pFun, mecBool_t a_bOptimize) \
+{                                                                                                            \
+  MEC_TRY(AsParser(a_hParser)->DefineFun(a_szName, reinterpret_cast<GenericFun_t>(a_pFun), N, a_bOptimize!=0))   \
+}
+
+MEC_DEFINE_FUN(0,  mecFun0_t)
+MEC_DEFINE_FUN(1,  mecFun1_t)
+MEC_DEFINE_FUN(2,  mecFun2_t)
+MEC_DEFINE_FUN(3,  mecFun3_t)
+MEC_DEFINE_FUN(4,  mecFun4_t)
+MEC_DEFINE_FUN(5,  mecFun5_t)
+
+// declared with mecFun5_t in muParserSSE.h, the callbacks take N arguments
+MEC_DEFINE_FUN(6,  mecFun5_t)
+MEC_DEFINE_FUN(7,  mecFun5_t)
+MEC_DEFINE_FUN(8,  mecFun5_t)
+MEC_DEFINE_FUN(9,  mecFun5_t)
+MEC_DEFINE_FUN(10, mecFun5_t)
+
+#undef MEC_DEFINE_FUN
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecDefineOprt( mecParserHandle_t a_hParser,
+                                const mecChar_t* a_szName,
+                                mecFun2_t a_pFun,
+                                mecInt_t a_nPrec,
+                                mecInt_t a_nOprtAsct,
+                                mecBool_t a_bOptimize)
+{
+  MEC_TRY(AsParser(a_hParser)->DefineOprt(a_szName, a_pFun, a_nPrec, a_nOprtAsct, a_bOptimize!=0))
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecDefineConst( mecParserHandle_t a_hParser,
+                                 const mecChar_t* a_szName,
+                                 mecFloat_t a_fVal )
+{
+  MEC_TRY(AsParser(a_hParser)->DefineConst(a_szName, a_fVal))
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecDefineVar( mecParserHandle_t a_hParser,
+                               const mecChar_t* a_szName,
+                               mecFloat_t *a_fVar)
+{
+  MEC_TRY(AsParser(a_hParser)->DefineVar(a_szName, a_fVar))
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecDefinePostfixOprt( mecParserHandle_t a_hParser,
+                                       const mecChar_t* a_szName,
+                                       mecFun1_t a_pOprt,
+                                       mecBool_t a_bOptimize)
+{
+  MEC_TRY(AsParser(a_hParser)->DefinePostfixOprt(a_szName, a_pOprt, a_bOptimize!=0))
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(void) mecDefineInfixOprt( mecParserHandle_t a_hParser,
+                                     const mecChar_t* a_szName,
+                                     mecFun1_t a_pOprt,
+                                     mecBool_t a_bOptimize)
+{
+  MEC_TRY(AsParser(a_hParser)->DefineInfixOprt(a_szName, a_pOprt, a_bOptimize!=0))
+}
+
+//---------------------------------------------------------------------------
+// Define character sets for identifiers
+
+API_EXPORT(void) mecDefineNameChars(mecParserHandle_t a_hParser, const mecChar_t* a_szCharset)
+{
+  AsParser(a_hParser)->SetNameChars(a_szCharset);
+}
+
+API_EXPORT(void) mecDefineOprtChars(mecParserHandle_t a_hParser, const mecChar_t* a_szCharset)
+{
+  AsParser(a_hParser)->SetOprtChars(a_szCharset);
+}
+
+API_EXPORT(void) mecDefineInfixOprtChars(mecParserHandle_t a_hParser, const mecChar_t* a_szCharset)
+{
+  AsParser(a_hParser)->SetInfixOprtChars(a_szCharset);
+}
+
+//---------------------------------------------------------------------------
+// Remove all / single variables
+
+API_EXPORT(void) mecRemoveVar(mecParserHandle_t a_hParser, const mecChar_t* a_szName)
+{
+  AsParser(a_hParser)->RemoveVar(a_szName);
+}
+
+API_EXPORT(void) mecClearVar(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ClearVar();
+}
+
+API_EXPORT(void) mecClearConst(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ClearConst();
+}
+
+API_EXPORT(void) mecClearOprt(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ClearOprt();
+}
+
+API_EXPORT(void) mecClearFun(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ClearFun();
+}
+
+//---------------------------------------------------------------------------
+// Querying variables / expression variables / constants
+
+API_EXPORT(int) mecGetExprVarNum(mecParserHandle_t a_hParser)
+{
+  return (int)AsParser(a_hParser)->GetExprVar().size();
+}
+
+API_EXPORT(int) mecGetVarNum(mecParserHandle_t a_hParser)
+{
+  return (int)AsParser(a_hParser)->GetVar().size();
+}
+
+API_EXPORT(int) mecGetConstNum(mecParserHandle_t a_hParser)
+{
+  return (int)AsParser(a_hParser)->GetConst().size();
+}
+
+API_EXPORT(void) mecGetExprVar(mecParserHandle_t a_hParser, unsigned a_iVar, const mecChar_t** a_pszName, mecFloat_t** a_pVar)
+{
+  const ParserSSE::varmap_type &vVar = AsParser(a_hParser)->GetExprVar();
+  ParserSSE::varmap_type::const_iterator it = Nth(vVar, a_iVar);
+
+  *a_pszName = (it!=vVar.end()) ? it->first.c_str() : "";
+  *a_pVar    = (it!=vVar.end()) ? it->second : NULL;
+}
+
+API_EXPORT(void) mecGetVar(mecParserHandle_t a_hParser, unsigned a_iVar, const mecChar_t** a_pszName, mecFloat_t** a_pVar)
+{
+  const ParserSSE::varmap_type &vVar = AsParser(a_hParser)->GetVar();
+  ParserSSE::varmap_type::const_iterator it = Nth(vVar, a_iVar);
+
+  *a_pszName = (it!=vVar.end()) ? it->first.c_str() : "";
+  *a_pVar    = (it!=vVar.end()) ? it->second : NULL;
+}
+
+API_EXPORT(void) mecGetConst(mecParserHandle_t a_hParser, unsigned a_iVar, const mecChar_t** a_pszName, mecFloat_t* a_pVar)
+{
+  const ParserSSE::constmap_type &vConst = AsParser(a_hParser)->GetConst();
+  ParserSSE::constmap_type::const_iterator it = Nth(vConst, a_iVar);
+
+  *a_pszName = (it!=vConst.end()) ? it->first.c_str() : "";
+  *a_pVar    = (it!=vConst.end()) ? it->second : 0;
+}
+
+API_EXPORT(void) mecSetArgSep(mecParserHandle_t a_hParser, const mecChar_t cArgSep)
+{
+  AsParser(a_hParser)->SetArgSep(cArgSep);
+}
+
+API_EXPORT(void) mecSetDecSep(mecParserHandle_t a_hParser, const mecChar_t cDecSep)
+{
+  AsParser(a_hParser)->SetDecSep(cDecSep);
+}
+
+API_EXPORT(void) mecSetThousandsSep(mecParserHandle_t a_hParser, const mecChar_t cThousandsSep)
+{
+  AsParser(a_hParser)->SetThousandsSep(cThousandsSep);
+}
+
+API_EXPORT(void) mecResetLocale(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ResetLocale();
+}
+
+//---------------------------------------------------------------------------
+// Add value recognition callbacks
+
+API_EXPORT(void) mecAddValIdent(mecParserHandle_t a_hParser, mecIdentFun_t a_pFun)
+{
+  AsParser(a_hParser)->AddValIdent(a_pFun);
+}
+
+//---------------------------------------------------------------------------
+// Error handling
+
+API_EXPORT(mecBool_t) mecError(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->HasError() ? 1 : 0;
+}
+
+API_EXPORT(void) mecErrorReset(mecParserHandle_t a_hParser)
+{
+  AsParser(a_hParser)->ErrorReset();
+}
+
+API_EXPORT(void) mecSetErrorHandler(mecParserHandle_t a_hParser, mecErrorHandler_t a_pErrHandler)
+{
+  AsParser(a_hParser)->SetErrorHandler(a_pErrHandler);
+}
+
+API_EXPORT(const mecChar_t*) mecGetErrorMsg(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->GetErrorMsg().c_str();
+}
+
+API_EXPORT(mecInt_t) mecGetErrorCode(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->GetError().m_iCode;
+}
+
+API_EXPORT(mecInt_t) mecGetErrorPos(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->GetError().m_iPos;
+}
+
+API_EXPORT(const mecChar_t*) mecGetErrorToken(mecParserHandle_t a_hParser)
+{
+  return AsParser(a_hParser)->GetError().m_sTok.c_str();
+}
+
+//---------------------------------------------------------------------------
+API_EXPORT(mecFloat_t*) mecCreateVar()
+{
+  return new mecFloat_t(0);
+}
+
+API_EXPORT(void) mecReleaseVar(mecFloat_t *a_pVar)
+{
+  delete a_pVar;
+}
+
+#undef MEC_TRY
+
+#endif // !_WIN32
@@ -28,11 +28,14 @@
 #if defined(WIN32) || defined(_WIN32)
     #ifdef MUPARSERLIB_EXPORTS
         #define API_EXPORT(TYPE) __declspec(dllexport) TYPE __cdecl
+        #define API_EXPORT_DATA(TYPE) __declspec(dllexport) extern TYPE
     #else
         #define API_EXPORT(TYPE) __declspec(dllimport) TYPE __cdecl
+        #define API_EXPORT_DATA(TYPE) __declspec(dllimport) extern TYPE
     #endif
 #else
     #define API_EXPORT(TYPE) TYPE
+    #define API_EXPORT_DATA(TYPE) extern TYPE
 #endif
 
 #ifdef __cplusplus
@@ -73,80 +76,42 @@ typedef mecInt_t    (*mecIdentFun_t)(const mecChar_t*, mecInt_t*, mecFloat_t*);
 
 //-----------------------------------------------------------------------------------------------------
 // Constants
-#ifdef MUPARSERLIB_EXPORTS
-__declspec(dllexport) extern int mecOPRT_ASCT_LEFT;
-__declspec(dllexport) extern int mecOPRT_ASCT_RIGHT;
+API_EXPORT_DATA(int) mecOPRT_ASCT_LEFT;
+API_EXPORT_DATA(int) mecOPRT_ASCT_RIGHT;
 
   // Error codes
-__declspec(dllexport) extern int mecUNEXPECTED_OPERATOR;
-__declspec(dllexport) extern int mecUNASSIGNABLE_TOKEN;
-__declspec(dllexport) extern int mecUNEXPECTED_EOF;
-__declspec(dllexport) extern int mecUNEXPECTED_ARG_SEP;
-__declspec(dllexport) extern int mecUNEXPECTED_ARG;
-__declspec(dllexport) extern int mecUNEXPECTED_VAL;
-__declspec(dllexport) extern int mecUNEXPECTED_VAR;
-__declspec(dllexport) extern int mecUNEXPECTED_PARENS;
-__declspec(dllexport) extern int mecUNEXPECTED_STR;
-__declspec(dllexport) extern int mecSTRING_EXPECTED;
-__declspec(dllexport) extern int mecVAL_EXPECTED;
-__declspec(dllexport) extern int mecMISSING_PARENS;
-__declspec(dllexport) extern int mecUNEXPECTED_FUN;
-__declspec(dllexport) extern int mecUNTERMINATED_STRING;
-__declspec(dllexport) extern int mecTOO_MANY_PARAMS;
-__declspec(dllexport) extern int mecTOO_FEW_PARAMS;
-__declspec(dllexport) extern int mecOPRT_TYPE_CONFLICT;
-__declspec(dllexport) extern int mecSTR_RESULT;
-__declspec(dllexport) extern int mecINVALID_NAME;
-__declspec(dllexport) extern int mecBUILTIN_OVERLOAD;
-__declspec(dllexport) extern int mecINVALID_FUN_PTR;
-__declspec(dllexport) extern int mecINVALID_VAR_PTR;
-__declspec(dllexport) extern int mecEMPTY_EXPRESSION;
-__declspec(dllexport) extern int mecNAME_CONFLICT;
-__declspec(dllexport) extern int mecOPT_PRI;
-__declspec(dllexport) extern int mecDOMAIN_ERROR;
-__declspec(dllexport) extern int mecDIV_BY_ZERO;
-__declspec(dllexport) extern int mecGENERIC;
-__declspec(dllexport) extern int mecLOCALE;
-__declspec(dllexport) extern int mecINTERNAL_ERROR;
-__declspec(dllexport) extern int mecUNDEFINED;
+API_EXPORT_DATA(int) mecUNEXPECTED_OPERATOR;
+API_EXPORT_DATA(int) mecUNASSIGNABLE_TOKEN;
+API_EXPORT_DATA(int) mecUNEXPECTED_EOF;
+API_EXPORT_DATA(int) mecUNEXPECTED_ARG_SEP;
+API_EXPORT_DATA(int) mecUNEXPECTED_ARG;
+API_EXPORT_DATA(int) mecUNEXPECTED_VAL;
+API_EXPORT_DATA(int) mecUNEXPECTED_VAR;
+API_EXPORT_DATA(int) mecUNEXPECTED_PARENS;
+API_EXPORT_DATA(int) mecUNEXPECTED_STR;
+API_EXPORT_DATA(int) mecSTRING_EXPECTED;
+API_EXPORT_DATA(int) mecVAL_EXPECTED;
+API_EXPORT_DATA(int) mecMISSING_PARENS;
+API_EXPORT_DATA(int) mecUNEXPECTED_FUN;
+API_EXPORT_DATA(int) mecUNTERMINATED_STRING;
+API_EXPORT_DATA(int) mecTOO_MANY_PARAMS;
+API_EXPORT_DATA(int) mecTOO_FEW_PARAMS;
+API_EXPORT_DATA(int) mecOPRT_TYPE_CONFLICT;
+API_EXPORT_DATA(int) mecSTR_RESULT;
+API_EXPORT_DATA(int) mecINVALID_NAME;
+API_EXPORT_DATA(int) mecBUILTIN_OVERLOAD;
+API_EXPORT_DATA(int) mecINVALID_FUN_PTR;
+API_EXPORT_DATA(int) mecINVALID_VAR_PTR;
+API_EXPORT_DATA(int) mecEMPTY_EXPRESSION;
+API_EXPORT_DATA(int) mecNAME_CONFLICT;
+API_EXPORT_DATA(int) mecOPT_PRI;
+API_EXPORT_DATA(int) mecDOMAIN_ERROR;
+API_EXPORT_DATA(int) mecDIV_BY_ZERO;
+API_EXPORT_DATA(int) mecGENERIC;
+API_EXPORT_DATA(int) mecLOCALE;
+API_EXPORT_DATA(int) mecINTERNAL_ERROR;
+API_EXPORT_DATA(int) mecUNDEFINED;
 
-#else
-__declspec(dllimport) extern int mecOPRT_ASCT_LEFT;
-__declspec(dllimport) extern int mecOPRT_ASCT_RIGHT;
-
-  // Error codes
-__declspec(dllimport) extern int mecUNEXPECTED_OPERATOR;
-__declspec(dllimport) extern int mecUNASSIGNABLE_TOKEN;
-__declspec(dllimport) extern int mecUNEXPECTED_EOF;
-__declspec(dllimport) extern int mecUNEXPECTED_ARG_SEP;
-__declspec(dllimport) extern int mecUNEXPECTED_ARG;
-__declspec(dllimport) extern int mecUNEXPECTED_VAL;
-__declspec(dllimport) extern int mecUNEXPECTED_VAR;
-__declspec(dllimport) extern int mecUNEXPECTED_PARENS;
-__declspec(dllimport) extern int mecUNEXPECTED_STR;
-__declspec(dllimport) extern int mecSTRING_EXPECTED;
-__declspec(dllimport) extern int mecVAL_EXPECTED;
-__declspec(dllimport) extern int mecMISSING_PARENS;
-__declspec(dllimport) extern int mecUNEXPECTED_FUN;
-__declspec(dllimport) extern int mecUNTERMINATED_STRING;
-__declspec(dllimport) extern int mecTOO_MANY_PARAMS;
-__declspec(dllimport) extern int mecTOO_FEW_PARAMS;
-__declspec(dllimport) extern int mecOPRT_TYPE_CONFLICT;
-__declspec(dllimport) extern int mecSTR_RESULT;
-__declspec(dllimport) extern int mecINVALID_NAME;
-__declspec(dllimport) extern int mecBUILTIN_OVERLOAD;
-__declspec(dllimport) extern int mecINVALID_FUN_PTR;
-__declspec(dllimport) extern int mecINVALID_VAR_PTR;
-__declspec(dllimport) extern int mecEMPTY_EXPRESSION;
-__declspec(dllimport) extern int mecNAME_CONFLICT;
-__declspec(dllimport) extern int mecOPT_PRI;
-__declspec(dllimport) extern int mecDOMAIN_ERROR;
-__declspec(dllimport) extern int mecDIV_BY_ZERO;
-__declspec(dllimport) extern int mecGENERIC;
-__declspec(dllimport) extern int mecLOCALE;
-__declspec(dllimport) extern int mecINTERNAL_ERROR;
-__declspec(dllimport) extern int mecUNDEFINED;
-#endif
 
 //-----------------------------------------------------------------------------------------------------
 //
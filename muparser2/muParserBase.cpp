@@ -25,6 +25,7 @@
 
 #include "muParserBase.h"
 #include "muParserTemplateMagic.h"
+#include "muParserSimd.h"
 
 //--- Standard includes ------------------------------------------------------------------------
 #include <cassert>
@@ -87,6 +88,8 @@ namespace mu
     ,m_StrVarDef()
     ,m_VarDef()
     ,m_bBuiltInOp(true)
+    ,m_bEnableJit(false)
+    ,m_bEnableRegCode(false)
     ,m_sNameChars()
     ,m_sOprtChars()
     ,m_sInfixOprtChars()
@@ -116,6 +119,8 @@ namespace mu
     ,m_StrVarDef()
     ,m_VarDef()
     ,m_bBuiltInOp(true)
+    ,m_bEnableJit(false)
+    ,m_bEnableRegCode(false)
     ,m_sNameChars()
     ,m_sOprtChars()
     ,m_sInfixOprtChars()
@@ -164,6 +169,8 @@ namespace mu
     m_ConstDef        = a_Parser.m_ConstDef;         // Copy user define constants
     m_VarDef          = a_Parser.m_VarDef;           // Copy user defined variables
     m_bBuiltInOp      = a_Parser.m_bBuiltInOp;
+    m_bEnableJit      = a_Parser.m_bEnableJit;
+    m_bEnableRegCode  = a_Parser.m_bEnableRegCode;
     m_vStringBuf      = a_Parser.m_vStringBuf;
     m_vStackBuffer    = a_Parser.m_vStackBuffer;
     m_nFinalResultIdx = a_Parser.m_nFinalResultIdx;
@@ -246,6 +253,8 @@ namespace mu
   void ParserBase::ReInit() const
   {
     m_pParseFormula = &ParserBase::ParseString;
+    m_Jit.Reset();
+    m_RegCode.Reset();
     m_vStringBuf.clear();
     m_vRPN.clear();
     m_pTokenReader->ReInit();
@@ -997,6 +1006,24 @@ namespace mu
     return ParseCmdCodeBulk(0, 0);
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the native code created from the RPN.
+      \sa EnableJit
+  */
+  value_type ParserBase::ParseCmdCodeJit() const
+  {
+    return m_Jit.Eval(&m_vStackBuffer[0]);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the register code created from the RPN.
+      \sa EnableRegCode
+  */
+  value_type ParserBase::ParseCmdCodeReg() const
+  {
+    return m_RegCode.Eval(&m_vStackBuffer[0]);
+  }
+
   //---------------------------------------------------------------------------
   /** \brief Evaluate the RPN. 
       \param nOffset The offset added to variable addresses (for bulk mode)
@@ -1170,12 +1197,228 @@ namespace mu
     return Stack[m_nFinalResultIdx];  
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the RPN for a block of consecutive rows.
+      \param nOffset Index of the first row of the block (added to variable addresses)
+      \param nRows Number of rows in the block, at most s_BlockSize
+      \param Stack Stack buffer, every stack position holds s_BlockSize values
+      \param results Receives the result of each row of the block
+
+      Each token is dispatched once and then applied to all rows of the block. Operators,
+      variables and the if-then-else selection use the column kernels chosen with
+      SetSimdLevel(), the remaining tokens are computed in plain loops. Both branches of
+      an if-then-else clause are computed: the condition stays on the stack until cmENDIF
+      selects the value of the matching branch for each row.
+  */
+  void ParserBase::ParseCmdCodeBlock(int nOffset, int nRows, value_type *Stack, value_type *results) const
+  {
+    // Value of row i at stack position k relative to the current top
+    #define MUP_BLOCK_ARG(k) Stack[(sidx + (k)) * s_BlockSize + i]
+
+    #define MUP_BLOCK_BINARY(EXPR)                                 \
+            {                                                      \
+              --sidx;                                              \
+              value_type *lhs = &Stack[sidx * s_BlockSize];        \
+              const value_type *rhs = lhs + s_BlockSize;           \
+              for (int i=0; i<nRows; ++i)                          \
+                lhs[i] = EXPR;                                     \
+            }                                                      \
+            continue;
+
+    #define MUP_BLOCK_KERNEL(FUN)                                  \
+            {                                                      \
+              --sidx;                                              \
+              value_type *lhs = &Stack[sidx * s_BlockSize];        \
+              FUN(lhs, lhs + s_BlockSize, nRows);                  \
+            }                                                      \
+            continue;
+
+    #define MUP_BLOCK_VAR(FUN)                                     \
+            FUN(&Stack[++sidx * s_BlockSize], pTok->Val.ptr + nOffset, nRows); \
+            continue;
+
+    #define MUP_BLOCK_CALL(EXPR)                                   \
+            for (int i=0; i<nRows; ++i)                            \
+              MUP_BLOCK_ARG(0) = EXPR;                             \
+            continue;
+
+    const SimdKernels &kernel = GetSimdKernels();
+
+    int sidx(0);
+    for (const SToken *pTok = m_vRPN.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      switch (pTok->Cmd)
+      {
+      // built in binary operators
+      case  cmLE:   MUP_BLOCK_KERNEL(kernel.le)
+      case  cmGE:   MUP_BLOCK_KERNEL(kernel.ge)
+      case  cmNEQ:  MUP_BLOCK_KERNEL(kernel.neq)
+      case  cmEQ:   MUP_BLOCK_KERNEL(kernel.eq)
+      case  cmLT:   MUP_BLOCK_KERNEL(kernel.lt)
+      case  cmGT:   MUP_BLOCK_KERNEL(kernel.gt)
+      case  cmADD:  MUP_BLOCK_KERNEL(kernel.add)
+      case  cmSUB:  MUP_BLOCK_KERNEL(kernel.sub)
+      case  cmMUL:  MUP_BLOCK_KERNEL(kernel.mul)
+      case  cmDIV:
+
+  #if defined(MUP_MATH_EXCEPTIONS)
+                  for (int i=0; i<nRows; ++i)
+                  {
+                    if (Stack[sidx * s_BlockSize + i]==0)
+                      Error(ecDIV_BY_ZERO);
+                  }
+  #endif
+                    MUP_BLOCK_KERNEL(kernel.div)
+
+      case  cmPOW:  MUP_BLOCK_BINARY(MathImpl<value_type>::Pow(lhs[i], rhs[i]))
+      case  cmLAND: MUP_BLOCK_BINARY(lhs[i] && rhs[i])
+      case  cmLOR:  MUP_BLOCK_BINARY(lhs[i] || rhs[i])
+
+      // The condition remains on the stack, the "then" value is pushed on top of it
+      // and the "else" value on top of that.
+      case  cmIF:
+      case  cmELSE:
+            continue;
+
+      case  cmENDIF:
+            {
+              sidx -= 2;
+              value_type *cond = &Stack[sidx * s_BlockSize];
+              kernel.ifelse(cond, cond + s_BlockSize, cond + 2*s_BlockSize, nRows);
+            }
+            continue;
+
+      // value and variable tokens
+      case  cmVAR:     MUP_BLOCK_VAR(kernel.var)
+      case  cmVARPOW2: MUP_BLOCK_VAR(kernel.varpow2)
+      case  cmVARPOW3: MUP_BLOCK_VAR(kernel.varpow3)
+      case  cmVARPOW4: MUP_BLOCK_VAR(kernel.varpow4)
+
+      case  cmVAL:
+            kernel.val(&Stack[++sidx * s_BlockSize], pTok->Val.data2, nRows);
+            continue;
+
+      case  cmVARMUL:
+            kernel.varmul(&Stack[++sidx * s_BlockSize], pTok->Val.ptr + nOffset, pTok->Val.data, pTok->Val.data2, nRows);
+            continue;
+
+      // Next is treatment of numeric functions
+      case  cmFUNC:
+            {
+              int iArgCount = pTok->Fun.argc;
+
+              // switch according to argument count
+              switch(iArgCount)  
+              {
+              case 0: sidx += 1; MUP_BLOCK_CALL((*(fun_type0)pTok->Fun.ptr)())
+              case 1:            MUP_BLOCK_CALL((*(fun_type1)pTok->Fun.ptr)(MUP_BLOCK_ARG(0)))
+              case 2: sidx -= 1; MUP_BLOCK_CALL((*(fun_type2)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1)))
+              case 3: sidx -= 2; MUP_BLOCK_CALL((*(fun_type3)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2)))
+              case 4: sidx -= 3; MUP_BLOCK_CALL((*(fun_type4)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3)))
+              case 5: sidx -= 4; MUP_BLOCK_CALL((*(fun_type5)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4)))
+              case 6: sidx -= 5; MUP_BLOCK_CALL((*(fun_type6)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5)))
+              case 7: sidx -= 6; MUP_BLOCK_CALL((*(fun_type7)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6)))
+              case 8: sidx -= 7; MUP_BLOCK_CALL((*(fun_type8)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7)))
+              case 9: sidx -= 8; MUP_BLOCK_CALL((*(fun_type9)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7), MUP_BLOCK_ARG(8)))
+              case 10:sidx -= 9; MUP_BLOCK_CALL((*(fun_type10)pTok->Fun.ptr)(MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7), MUP_BLOCK_ARG(8), MUP_BLOCK_ARG(9)))
+              default:
+                {
+                  if (iArgCount>0) // function with variable arguments store the number as a negative value
+                    Error(ecINTERNAL_ERROR, 1);
+
+                  sidx -= -iArgCount - 1;
+
+                  // The arguments of a row are not adjacent in the block layout, gather them.
+                  valbuf_type vArg(-iArgCount);
+                  for (int i=0; i<nRows; ++i)
+                  {
+                    for (int k=0; k<-iArgCount; ++k)
+                      vArg[k] = MUP_BLOCK_ARG(k);
+
+                    MUP_BLOCK_ARG(0) = (*(multfun_type)pTok->Fun.ptr)(&vArg[0], -iArgCount);
+                  }
+                }
+                continue;
+              }
+            }
+
+      // Next is treatment of string functions
+      case  cmFUNC_STR:
+            {
+              sidx -= pTok->Fun.argc -1;
+
+              // The index of the string argument in the string table
+              int iIdxStack = pTok->Fun.idx;  
+              MUP_ASSERT( iIdxStack>=0 && iIdxStack<(int)m_vStringBuf.size() );
+
+              switch(pTok->Fun.argc)  // switch according to argument count
+              {
+              case 0: MUP_BLOCK_CALL((*(strfun_type1)pTok->Fun.ptr)(m_vStringBuf[iIdxStack].c_str()))
+              case 1: MUP_BLOCK_CALL((*(strfun_type2)pTok->Fun.ptr)(m_vStringBuf[iIdxStack].c_str(), MUP_BLOCK_ARG(0)))
+              case 2: MUP_BLOCK_CALL((*(strfun_type3)pTok->Fun.ptr)(m_vStringBuf[iIdxStack].c_str(), MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1)))
+              }
+
+              continue;
+            }
+
+        // Bulk functions receive the index of the row, block mode does not use threads.
+        case  cmFUNC_BULK:
+              {
+                int iArgCount = pTok->Fun.argc;
+
+                // switch according to argument count
+                switch(iArgCount)  
+                {
+                case 0: sidx += 1; MUP_BLOCK_CALL((*(bulkfun_type0 )pTok->Fun.ptr)(nOffset+i, 0))
+                case 1:            MUP_BLOCK_CALL((*(bulkfun_type1 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0)))
+                case 2: sidx -= 1; MUP_BLOCK_CALL((*(bulkfun_type2 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1)))
+                case 3: sidx -= 2; MUP_BLOCK_CALL((*(bulkfun_type3 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2)))
+                case 4: sidx -= 3; MUP_BLOCK_CALL((*(bulkfun_type4 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3)))
+                case 5: sidx -= 4; MUP_BLOCK_CALL((*(bulkfun_type5 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4)))
+                case 6: sidx -= 5; MUP_BLOCK_CALL((*(bulkfun_type6 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5)))
+                case 7: sidx -= 6; MUP_BLOCK_CALL((*(bulkfun_type7 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6)))
+                case 8: sidx -= 7; MUP_BLOCK_CALL((*(bulkfun_type8 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7)))
+                case 9: sidx -= 8; MUP_BLOCK_CALL((*(bulkfun_type9 )pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7), MUP_BLOCK_ARG(8)))
+                case 10:sidx -= 9; MUP_BLOCK_CALL((*(bulkfun_type10)pTok->Fun.ptr)(nOffset+i, 0, MUP_BLOCK_ARG(0), MUP_BLOCK_ARG(1), MUP_BLOCK_ARG(2), MUP_BLOCK_ARG(3), MUP_BLOCK_ARG(4), MUP_BLOCK_ARG(5), MUP_BLOCK_ARG(6), MUP_BLOCK_ARG(7), MUP_BLOCK_ARG(8), MUP_BLOCK_ARG(9)))
+                default:
+                  Error(ecINTERNAL_ERROR, 2);
+                  continue;
+                }
+              }
+
+        // cmASSIGN is not supported, EvalBlocked falls back to row wise evaluation
+        default:
+              Error(ecINTERNAL_ERROR, 3);
+              return;
+      } // switch CmdCode
+    } // for all bytecode tokens
+
+    const value_type *pFinal = &Stack[m_nFinalResultIdx * s_BlockSize];
+    for (int i=0; i<nRows; ++i)
+      results[i] = pFinal[i];
+
+    #undef MUP_BLOCK_ARG
+    #undef MUP_BLOCK_BINARY
+    #undef MUP_BLOCK_KERNEL
+    #undef MUP_BLOCK_VAR
+    #undef MUP_BLOCK_CALL
+  }
+
   //---------------------------------------------------------------------------
   void ParserBase::CreateRPN() const
   {
     if (!m_pTokenReader->GetExpr().length())
       Error(ecUNEXPECTED_EOF, 0);
 
+    // Native code and register code refer to the old bytecode and string 
+    // buffer, they are recreated by ParseString.
+    if (m_Jit.IsCompiled() || m_RegCode.IsCompiled())
+    {
+      m_Jit.Reset();
+      m_RegCode.Reset();
+      m_pParseFormula = &ParserBase::ParseString;
+    }
+
     ParserStack<token_type> stOpt, stVal;
     ParserStack<int> stArgCount;
     token_type opta, opt;  // for storing operators
@@ -1416,7 +1659,15 @@ namespace mu
     try
     {
       CreateRPN();
-      m_pParseFormula = &ParserBase::ParseCmdCode;
+
+      // Use native code or register code if the bytecode can be translated, 
+      // the interpreter otherwise
+      if (m_bEnableJit && m_Jit.Compile(m_vRPN, m_nFinalResultIdx, m_vStringBuf))
+        m_pParseFormula = &ParserBase::ParseCmdCodeJit;
+      else if (m_bEnableRegCode && m_RegCode.Compile(m_vRPN, m_nFinalResultIdx, m_vStringBuf))
+        m_pParseFormula = &ParserBase::ParseCmdCodeReg;
+      else
+        m_pParseFormula = &ParserBase::ParseCmdCode;
       return (this->*m_pParseFormula)(); 
     }
     catch(ParserError &exc)
@@ -1539,6 +1790,37 @@ namespace mu
     ReInit();
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Enable or disable the translation of the bytecode into native code. 
+      \post Resets the parser to string parser mode.
+      \throw nothrow
+
+    The code is generated when the expression is parsed. If native code is not 
+    supported on this platform or for the given expression the bytecode 
+    interpreter is used. Bulk mode always uses the interpreter.
+  */
+  void ParserBase::EnableJit(bool a_bIsOn)
+  {
+    m_bEnableJit = a_bIsOn;
+    ReInit();
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Enable or disable the translation of the bytecode into register code. 
+      \post Resets the parser to string parser mode.
+      \throw nothrow
+
+    The register code addresses stack positions directly instead of 
+    maintaining a stack index and takes variables and constants as operands 
+    of binary operators. Native code takes precedence if it is enabled too.
+    Bulk mode always uses the interpreter.
+  */
+  void ParserBase::EnableRegCode(bool a_bIsOn)
+  {
+    m_bEnableRegCode = a_bIsOn;
+    ReInit();
+  }
+
   //---------------------------------------------------------------------------
   /** \brief Enable the dumping of bytecode and stack content on the console. 
       \param bDumpCmd Flag to enable dumping of the current bytecode to the console.
@@ -1775,4 +2057,43 @@ namespace mu
 #endif
 
   }
+  //---------------------------------------------------------------------------
+  /** \brief Calculate the results of a bulk of rows block by block.
+
+    Uses the same variable layout as Eval(value_type*, int) but executes the bytecode once per
+    block of s_BlockSize rows instead of once per row. No OpenMP threads are used. Expressions
+    with assignments are computed row by row since a row may read a value written by the
+    previous one.
+  */
+  void ParserBase::EvalBlocked(value_type *results, int nBulkSize)
+  {
+    CreateRPN();
+
+    int nIfElse = 0;
+    bool bAssign = false;
+    for (const SToken *pTok = m_vRPN.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      if (pTok->Cmd==cmIF)
+        ++nIfElse;
+      else if (pTok->Cmd==cmASSIGN)
+        bAssign = true;
+    }
+
+    if (bAssign)
+    {
+      for (int i=0; i<nBulkSize; ++i)
+        results[i] = ParseCmdCodeBulk(i, 0);
+
+      return;
+    }
+
+    // Every if-then-else clause keeps its condition and both branch values on the stack.
+    valbuf_type vStack((m_vRPN.GetMaxStackSize() + 2*nIfElse) * s_BlockSize);
+    for (int i=0; i<nBulkSize; i+=s_BlockSize)
+    {
+      int nRows = (nBulkSize - i < s_BlockSize) ? nBulkSize - i : s_BlockSize;
+      ParseCmdCodeBlock(i, nRows, &vStack[0], &results[i]);
+    }
+  }
+
 } // namespace mu
@@ -40,6 +40,8 @@
 #include "muParserTokenReader.h"
 #include "muParserBytecode.h"
 #include "muParserError.h"
+#include "muParserJit.h"
+#include "muParserRegCode.h"
 
 
 namespace mu
@@ -88,6 +90,9 @@ private:
     /** \brief Maximum number of threads spawned by OpenMP when using the bulk mode. */
     static const int s_MaxNumOpenMPThreads = 16;
 
+    /** \brief Number of rows processed per bytecode token in block mode. */
+    static const int s_BlockSize = 256;
+
  public:
 
     /** \brief Type of the error class. 
@@ -107,6 +112,7 @@ private:
 	  value_type  Eval() const;
     value_type* Eval(int &nStackSize) const;
     void Eval(value_type *results, int nBulkSize);
+    void EvalBlocked(value_type *results, int nBulkSize);
 
     int GetNumResults() const;
 
@@ -118,6 +124,8 @@ private:
     void ResetLocale();
 
     void EnableOptimizer(bool a_bIsOn=true);
+    void EnableJit(bool a_bIsOn=true);
+    void EnableRegCode(bool a_bIsOn=true);
     void EnableBuiltInOprt(bool a_bIsOn=true);
 
     bool HasBuiltInOprt() const;
@@ -269,7 +277,10 @@ private:
 
     value_type ParseString() const; 
     value_type ParseCmdCode() const;
+    value_type ParseCmdCodeJit() const;
+    value_type ParseCmdCodeReg() const;
     value_type ParseCmdCodeBulk(int nOffset, int nThreadID) const;
+    void ParseCmdCodeBlock(int nOffset, int nRows, value_type *Stack, value_type *results) const;
 
     void  CheckName(const string_type &a_strName, const string_type &a_CharSet) const;
     void  CheckOprt(const string_type &a_sName,
@@ -299,6 +310,8 @@ private:
     varmap_type  m_VarDef;         ///< user defind variables.
 
     bool m_bBuiltInOp;             ///< Flag that can be used for switching built in operators on and off
+    bool m_bEnableJit;             ///< Flag for translating the bytecode into native code
+    bool m_bEnableRegCode;         ///< Flag for translating the bytecode into register code
 
     string_type m_sNameChars;      ///< Charset for names
     string_type m_sOprtChars;      ///< Charset for postfix/ binary operator tokens
@@ -309,6 +322,8 @@ private:
     // items merely used for caching state information
     mutable valbuf_type m_vStackBuffer; ///< This is merely a buffer used for the stack in the cmd parsing routine
     mutable int m_nFinalResultIdx;
+    mutable ParserJit m_Jit;        ///< Native code of the bytecode, if enabled and supported
+    mutable ParserRegCode m_RegCode; ///< Register code of the bytecode, if enabled and supported
 };
 
 } // namespace mu
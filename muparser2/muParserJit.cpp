@@ -0,0 +1,595 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+#include "muParserJit.h"
+
+#include <cstring>
+
+#include "muParserTemplateMagic.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+  #define MUP_JIT_SYSV_X64
+  #include <stdint.h>
+  #include <sys/mman.h>
+#endif
+
+/** \file
+    \brief Implementation of the native code generator for the parser bytecode.
+*/
+
+
+namespace mu
+{
+#if defined(MUP_JIT_SYSV_X64)
+
+namespace
+{
+  //---------------------------------------------------------------------------
+  /** \brief Minimal x86-64 instruction encoder.
+
+      Only scalar double SSE2 instructions on xmm0..xmm7 are needed. Memory
+      operands address the parser stack as [rbx + 8*slot], rbx holds the stack
+      pointer passed to the generated function and is preserved across calls.
+  */
+  class CodeBuffer
+  {
+  public:
+
+    // opcodes of the F2 0F xx (scalar double) instructions
+    enum
+    {
+      opMOVSD_LOAD  = 0x10,
+      opMOVSD_STORE = 0x11,
+      opADDSD       = 0x58,
+      opMULSD       = 0x59,
+      opSUBSD       = 0x5C,
+      opDIVSD       = 0x5E,
+      opCMPSD       = 0xC2
+    };
+
+    // opcodes of the 66 0F xx (packed double) instructions
+    enum
+    {
+      opUCOMISD = 0x2E,
+      opMOVAPD  = 0x28,
+      opANDPD   = 0x54,
+      opORPD    = 0x56,
+      opXORPD   = 0x57
+    };
+
+    // cmpsd predicates
+    enum
+    {
+      cmpEQ  = 0,
+      cmpLT  = 1,
+      cmpLE  = 2,
+      cmpNEQ = 4
+    };
+
+    void Byte(unsigned a_iByte)
+    {
+      m_vCode.push_back((unsigned char)a_iByte);
+    }
+
+    void Imm32(int a_iVal)
+    {
+      for (int i=0; i<4; ++i)
+        Byte((unsigned)(a_iVal >> (8*i)) & 0xFF);
+    }
+
+    void Imm64(uint64_t a_iVal)
+    {
+      for (int i=0; i<8; ++i)
+        Byte((unsigned)(a_iVal >> (8*i)) & 0xFF);
+    }
+
+    std::size_t Pos() const
+    {
+      return m_vCode.size();
+    }
+
+    /** \brief Set the rel32 operand ending at a_iEnd to jump to the current position. */
+    void PatchJump(std::size_t a_iEnd)
+    {
+      int iRel = (int)(Pos() - a_iEnd);
+      std::memcpy(&m_vCode[a_iEnd - 4], &iRel, 4);
+    }
+
+    const std::vector<unsigned char>& GetCode() const
+    {
+      return m_vCode;
+    }
+
+    // xmm<reg> op= [rbx + 8*slot]
+    void SdMem(unsigned a_iOp, int a_iReg, int a_iSlot)
+    {
+      Byte(0xF2); Byte(0x0F); Byte(a_iOp);
+      Byte(0x80 | (a_iReg << 3) | 3);
+      Imm32(a_iSlot * (int)sizeof(value_type));
+    }
+
+    // xmm<dst> op= xmm<src>
+    void SdReg(unsigned a_iOp, int a_iDst, int a_iSrc)
+    {
+      Byte(0xF2); Byte(0x0F); Byte(a_iOp);
+      Byte(0xC0 | (a_iDst << 3) | a_iSrc);
+    }
+
+    void PdReg(unsigned a_iOp, int a_iDst, int a_iSrc)
+    {
+      Byte(0x66); Byte(0x0F); Byte(a_iOp);
+      Byte(0xC0 | (a_iDst << 3) | a_iSrc);
+    }
+
+    void CmpSd(int a_iDst, int a_iSrc, int a_iPred)
+    {
+      SdReg(opCMPSD, a_iDst, a_iSrc);
+      Byte(a_iPred);
+    }
+
+    void CmpSdMem(int a_iDst, int a_iSlot, int a_iPred)
+    {
+      SdMem(opCMPSD, a_iDst, a_iSlot);
+      Byte(a_iPred);
+    }
+
+    // mov rax, imm64
+    void MovRax(uint64_t a_iVal)
+    {
+      Byte(0x48); Byte(0xB8);
+      Imm64(a_iVal);
+    }
+
+    void LoadConst(int a_iReg, value_type a_fVal)
+    {
+      uint64_t iBits;
+      std::memcpy(&iBits, &a_fVal, sizeof(iBits));
+      MovRax(iBits);
+      Byte(0x66); Byte(0x48); Byte(0x0F); Byte(0x6E);  // movq xmm<reg>, rax
+      Byte(0xC0 | (a_iReg << 3));
+    }
+
+    void LoadVar(int a_iReg, const value_type *a_pVar)
+    {
+      MovRax((uint64_t)a_pVar);
+      Byte(0xF2); Byte(0x0F); Byte(opMOVSD_LOAD); Byte(a_iReg << 3);   // movsd xmm<reg>, [rax]
+    }
+
+    void StoreVar(const value_type *a_pVar, int a_iReg)
+    {
+      MovRax((uint64_t)a_pVar);
+      Byte(0xF2); Byte(0x0F); Byte(opMOVSD_STORE); Byte(a_iReg << 3);  // movsd [rax], xmm<reg>
+    }
+
+    void Call(uint64_t a_iAddr)
+    {
+      MovRax(a_iAddr);
+      Byte(0xFF); Byte(0xD0);                                           // call rax
+    }
+
+    // mov edi/esi, imm32
+    void MovEdi(int a_iVal) { Byte(0xBF); Imm32(a_iVal); }
+    void MovEsi(int a_iVal) { Byte(0xBE); Imm32(a_iVal); }
+
+    // mov rdi, imm64
+    void MovRdi(uint64_t a_iVal)
+    {
+      Byte(0x48); Byte(0xBF);
+      Imm64(a_iVal);
+    }
+
+    // mov rsi, imm64
+    void MovRsi(uint64_t a_iVal)
+    {
+      Byte(0x48); Byte(0xBE);
+      Imm64(a_iVal);
+    }
+
+    // lea rdi, [rbx + 8*slot]
+    void LeaRdiSlot(int a_iSlot)
+    {
+      Byte(0x48); Byte(0x8D); Byte(0xBB);
+      Imm32(a_iSlot * (int)sizeof(value_type));
+    }
+
+    /** \brief Emit a jump with a rel32 operand and return the position behind it for PatchJump. */
+    std::size_t Jump(unsigned a_iCond)
+    {
+      if (a_iCond==0)
+      {
+        Byte(0xE9);                    // jmp rel32
+      }
+      else
+      {
+        Byte(0x0F); Byte(a_iCond);     // jcc rel32
+      }
+
+      Imm32(0);
+      return Pos();
+    }
+
+  private:
+    std::vector<unsigned char> m_vCode;
+  };
+
+  //---------------------------------------------------------------------------
+  value_type JitPow(value_type a_fBase, value_type a_fExp)
+  {
+    return MathImpl<value_type>::Pow(a_fBase, a_fExp);
+  }
+
+  template<typename T>
+  uint64_t Addr(T a_pFun)
+  {
+    return reinterpret_cast<uint64_t>(a_pFun);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Translate the bytecode, returns false for unsupported tokens.
+
+      Code generation tracks the stack index of the interpreter. The value at
+      index sidx is held in xmm0, values at lower indices are stored at their
+      slot of the stack buffer.
+  */
+  bool Generate(const ParserByteCode &a_ByteCode,
+                int a_iFinalResultIdx,
+                const ParserJit::stringbuf_type &a_vStringBuf,
+                CodeBuffer &code)
+  {
+    const unsigned jcJE = 0x84;
+    const unsigned jcJP = 0x8A;
+
+    std::vector<std::size_t> stIfJump, stElseJump;
+    std::vector<int> stIfSidx;
+    int sidx = 0;
+
+    code.Byte(0x53);                                       // push rbx
+    code.Byte(0x48); code.Byte(0x89); code.Byte(0xFB);     // mov rbx, rdi
+
+    for (const SToken *pTok = a_ByteCode.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      switch (pTok->Cmd)
+      {
+      // xmm0 = [sidx-1] op xmm0
+      case  cmADD: --sidx; code.SdMem(CodeBuffer::opADDSD, 0, sidx); continue;
+      case  cmMUL: --sidx; code.SdMem(CodeBuffer::opMULSD, 0, sidx); continue;
+      case  cmSUB:
+      case  cmDIV:
+            --sidx;
+            code.PdReg(CodeBuffer::opMOVAPD, 1, 0);
+            code.SdMem(CodeBuffer::opMOVSD_LOAD, 0, sidx);
+            code.SdReg((pTok->Cmd==cmSUB) ? CodeBuffer::opSUBSD : CodeBuffer::opDIVSD, 0, 1);
+            continue;
+
+      case  cmPOW:
+            --sidx;
+            code.PdReg(CodeBuffer::opMOVAPD, 1, 0);
+            code.SdMem(CodeBuffer::opMOVSD_LOAD, 0, sidx);
+            code.Call(Addr(&JitPow));
+            continue;
+
+      // comparisons yield an all ones mask which is and-ed with 1.0
+      case  cmLE:
+      case  cmLT:
+            --sidx;
+            code.SdMem(CodeBuffer::opMOVSD_LOAD, 1, sidx);
+            code.CmpSd(1, 0, (pTok->Cmd==cmLE) ? CodeBuffer::cmpLE : CodeBuffer::cmpLT);
+            code.PdReg(CodeBuffer::opMOVAPD, 0, 1);
+            code.LoadConst(1, 1);
+            code.PdReg(CodeBuffer::opANDPD, 0, 1);
+            continue;
+
+      // a>=b and a>b are evaluated as b<=a and b<a
+      case  cmGE:
+      case  cmGT:
+      case  cmEQ:
+      case  cmNEQ:
+            {
+              int iPred = CodeBuffer::cmpEQ;
+              switch(pTok->Cmd)
+              {
+              case cmGE:  iPred = CodeBuffer::cmpLE;  break;
+              case cmGT:  iPred = CodeBuffer::cmpLT;  break;
+              case cmNEQ: iPred = CodeBuffer::cmpNEQ; break;
+              default:    break;
+              }
+
+              --sidx;
+              code.CmpSdMem(0, sidx, iPred);
+              code.LoadConst(1, 1);
+              code.PdReg(CodeBuffer::opANDPD, 0, 1);
+            }
+            continue;
+
+      case  cmLAND:
+      case  cmLOR:
+            --sidx;
+            code.SdMem(CodeBuffer::opMOVSD_LOAD, 1, sidx);
+            code.PdReg(CodeBuffer::opXORPD, 2, 2);
+            code.CmpSd(0, 2, CodeBuffer::cmpNEQ);
+            code.CmpSd(1, 2, CodeBuffer::cmpNEQ);
+            code.PdReg((pTok->Cmd==cmLAND) ? CodeBuffer::opANDPD : CodeBuffer::opORPD, 0, 1);
+            code.LoadConst(1, 1);
+            code.PdReg(CodeBuffer::opANDPD, 0, 1);
+            continue;
+
+      case  cmASSIGN:
+            --sidx;
+            code.StoreVar(pTok->Oprt.ptr, 0);
+            continue;
+
+      // The condition is popped, the new top of stack is reloaded before the jump
+      // so that both branches start in the same state. NaN counts as true.
+      case  cmIF:
+            --sidx;
+            code.PdReg(CodeBuffer::opXORPD, 1, 1);
+            code.Byte(0x66); code.Byte(0x0F); code.Byte(CodeBuffer::opUCOMISD); code.Byte(0xC1);
+            if (sidx>0)
+              code.SdMem(CodeBuffer::opMOVSD_LOAD, 0, sidx);
+            {
+              std::size_t iSkip = code.Jump(jcJP);
+              stIfJump.push_back(code.Jump(jcJE));
+              code.PatchJump(iSkip);
+            }
+            stIfSidx.push_back(sidx);
+            continue;
+
+      case  cmELSE:
+            stElseJump.push_back(code.Jump(0));
+            code.PatchJump(stIfJump.back());
+            stIfJump.pop_back();
+            sidx = stIfSidx.back();
+            stIfSidx.pop_back();
+            continue;
+
+      case  cmENDIF:
+            code.PatchJump(stElseJump.back());
+            stElseJump.pop_back();
+            continue;
+
+      // value and variable tokens, the old top of stack is spilled first
+      case  cmVAR:
+      case  cmVAL:
+      case  cmVARPOW2:
+      case  cmVARPOW3:
+      case  cmVARPOW4:
+      case  cmVARMUL:
+            if (sidx>0)
+              code.SdMem(CodeBuffer::opMOVSD_STORE, 0, sidx);
+            ++sidx;
+
+            if (pTok->Cmd==cmVAL)
+            {
+              code.LoadConst(0, pTok->Val.data2);
+              continue;
+            }
+
+            code.LoadVar(0, pTok->Val.ptr);
+
+            switch(pTok->Cmd)
+            {
+            case cmVARPOW2:
+                 code.SdReg(CodeBuffer::opMULSD, 0, 0);
+                 break;
+
+            case cmVARPOW3:
+                 code.PdReg(CodeBuffer::opMOVAPD, 1, 0);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 0);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 1);
+                 break;
+
+            case cmVARPOW4:
+                 code.PdReg(CodeBuffer::opMOVAPD, 1, 0);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 0);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 1);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 1);
+                 break;
+
+            case cmVARMUL:
+                 code.LoadConst(1, pTok->Val.data);
+                 code.SdReg(CodeBuffer::opMULSD, 0, 1);
+                 code.LoadConst(1, pTok->Val.data2);
+                 code.SdReg(CodeBuffer::opADDSD, 0, 1);
+                 break;
+
+            default:
+                 break;
+            }
+            continue;
+
+      // Callbacks take their numeric arguments in xmm0..xmm7. Functions with a
+      // variable number of arguments receive a pointer to the stack slots.
+      case  cmFUNC:
+      case  cmFUNC_STR:
+      case  cmFUNC_BULK:
+            {
+              int iArgCount = pTok->Fun.argc;
+
+              if (pTok->Cmd==cmFUNC && iArgCount<0)
+              {
+                code.SdMem(CodeBuffer::opMOVSD_STORE, 0, sidx);
+                sidx -= -iArgCount - 1;
+                code.LeaRdiSlot(sidx);
+                code.MovEsi(-iArgCount);
+                code.Call(Addr(pTok->Fun.ptr));
+                continue;
+              }
+
+              if (iArgCount>8)
+                return false;
+
+              if (iArgCount==0)
+              {
+                if (sidx>0)
+                  code.SdMem(CodeBuffer::opMOVSD_STORE, 0, sidx);
+              }
+              else
+              {
+                // the last argument is the top of stack
+                if (iArgCount>1)
+                  code.PdReg(CodeBuffer::opMOVAPD, iArgCount-1, 0);
+
+                for (int i=0; i<iArgCount-1; ++i)
+                  code.SdMem(CodeBuffer::opMOVSD_LOAD, i, sidx - iArgCount + 1 + i);
+              }
+
+              sidx -= iArgCount - 1;
+
+              if (pTok->Cmd==cmFUNC_STR)
+              {
+                if (iArgCount>2 || pTok->Fun.idx<0 || pTok->Fun.idx>=(int)a_vStringBuf.size())
+                  return false;
+
+                code.MovRdi(Addr(a_vStringBuf[pTok->Fun.idx].c_str()));
+              }
+              else if (pTok->Cmd==cmFUNC_BULK)
+              {
+                // Outside of bulk mode the bulk index and thread id are zero.
+                code.MovEdi(0);
+                code.MovEsi(0);
+              }
+
+              code.Call(Addr(pTok->Fun.ptr));
+            }
+            continue;
+
+      default:
+            return false;
+      } // switch CmdCode
+    } // for all bytecode tokens
+
+    // Leave all results in the stack buffer like the interpreter does, they are
+    // accessed by Eval(int&).
+    if (sidx>0)
+      code.SdMem(CodeBuffer::opMOVSD_STORE, 0, sidx);
+
+    if (a_iFinalResultIdx!=sidx)
+      code.SdMem(CodeBuffer::opMOVSD_LOAD, 0, a_iFinalResultIdx);
+
+    code.Byte(0x5B);    // pop rbx
+    code.Byte(0xC3);    // ret
+
+    return true;
+  }
+} // anonymous namespace
+
+#endif // MUP_JIT_SYSV_X64
+
+  //---------------------------------------------------------------------------
+  ParserJit::ParserJit()
+    :m_pFun(NULL)
+    ,m_pCode(NULL)
+    ,m_nCodeSize(0)
+  {}
+
+  //---------------------------------------------------------------------------
+  ParserJit::~ParserJit()
+  {
+    Reset();
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Returns true if native code can be generated on this platform. */
+  bool ParserJit::IsAvailable()
+  {
+#if defined(MUP_JIT_SYSV_X64)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Generate native code for the given bytecode.
+      \param a_ByteCode The finalized bytecode
+      \param a_iFinalResultIdx Stack index of the result
+      \param a_vStringBuf String arguments referenced by cmFUNC_STR tokens, must
+                          not be modified while the code is in use.
+      \return false if the bytecode can not be translated, the interpreter must be used then.
+  */
+  bool ParserJit::Compile(const ParserByteCode &a_ByteCode,
+                          int a_iFinalResultIdx,
+                          const stringbuf_type &a_vStringBuf)
+  {
+    Reset();
+
+#if defined(MUP_JIT_SYSV_X64)
+    CodeBuffer code;
+    if (!Generate(a_ByteCode, a_iFinalResultIdx, a_vStringBuf, code))
+      return false;
+
+    std::size_t nSize = code.GetCode().size();
+    void *pMem = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pMem==MAP_FAILED)
+      return false;
+
+    std::memcpy(pMem, &code.GetCode()[0], nSize);
+
+    // never writable and executable at the same time
+    if (mprotect(pMem, nSize, PROT_READ | PROT_EXEC)!=0)
+    {
+      munmap(pMem, nSize);
+      return false;
+    }
+
+    m_pCode = pMem;
+    m_nCodeSize = nSize;
+    m_pFun = reinterpret_cast<jit_fun_type>(pMem);
+    return true;
+#else
+    (void)a_ByteCode;
+    (void)a_iFinalResultIdx;
+    (void)a_vStringBuf;
+    return false;
+#endif
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Release the generated code. */
+  void ParserJit::Reset()
+  {
+#if defined(MUP_JIT_SYSV_X64)
+    if (m_pCode)
+      munmap(m_pCode, m_nCodeSize);
+#endif
+
+    m_pFun = NULL;
+    m_pCode = NULL;
+    m_nCodeSize = 0;
+  }
+
+  //---------------------------------------------------------------------------
+  bool ParserJit::IsCompiled() const
+  {
+    return m_pFun!=NULL;
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Size of the generated machine code in bytes. */
+  std::size_t ParserJit::GetCodeSize() const
+  {
+    return m_nCodeSize;
+  }
+} // namespace mu
@@ -0,0 +1,92 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+#ifndef MU_PARSER_JIT_H
+#define MU_PARSER_JIT_H
+
+#include <string>
+#include <vector>
+
+#include "muParserDef.h"
+#include "muParserBytecode.h"
+
+/** \file
+    \brief Definition of the native code generator for the parser bytecode.
+*/
+
+
+namespace mu
+{
+  //---------------------------------------------------------------------------
+  /** \brief Translates the bytecode of an expression into x86-64 machine code.
+
+      The generated function takes the parser's stack buffer and returns the
+      value at the final result index, just like ParserBase::ParseCmdCode. The
+      value on top of the stack is kept in xmm0, the values below it live in the
+      stack buffer. Variables are loaded directly from their addresses and
+      callbacks are called directly.
+
+      Code generation is supported for the System V x86-64 ABI only, Compile()
+      returns false on other platforms and for bytecode containing tokens
+      that are not supported (callbacks with more than 8 numeric arguments). The
+      parser keeps using the interpreter then.
+  */
+  class ParserJit
+  {
+  public:
+
+    typedef std::vector<string_type> stringbuf_type;
+
+    ParserJit();
+   ~ParserJit();
+
+    static bool IsAvailable();
+
+    bool Compile(const ParserByteCode &a_ByteCode,
+                 int a_iFinalResultIdx,
+                 const stringbuf_type &a_vStringBuf);
+    void Reset();
+    bool IsCompiled() const;
+    std::size_t GetCodeSize() const;
+
+    /** \brief Run the generated code, Compile() must have succeeded. */
+    value_type Eval(value_type *a_pStack) const
+    {
+      return m_pFun(a_pStack);
+    }
+
+  private:
+
+    typedef value_type (*jit_fun_type)(value_type*);
+
+    ParserJit(const ParserJit&);
+    ParserJit& operator=(const ParserJit&);
+
+    jit_fun_type m_pFun;
+    void *m_pCode;
+    std::size_t m_nCodeSize;
+  };
+} // namespace mu
+
+#endif
@@ -0,0 +1,566 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+#include "muParserRegCode.h"
+
+#include <cassert>
+
+#include "muParserTemplateMagic.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define MUP_REGCODE_COMPUTED_GOTO
+#endif
+
+/** \file
+    \brief Implementation of the register code.
+*/
+
+
+namespace mu
+{
+  //---------------------------------------------------------------------------
+  ParserRegCode::ParserRegCode()
+    :m_vCode()
+    ,m_vConst()
+    ,m_vStr()
+    ,m_iFinalResultIdx(0)
+  {}
+
+  //---------------------------------------------------------------------------
+  void ParserRegCode::Emit(unsigned a_iOp, int a_iDst, int a_iA, int a_iB)
+  {
+    SRegInstr instr;
+    instr.Op  = (unsigned char)a_iOp;
+    instr.Dst = (unsigned char)a_iDst;
+    instr.A   = (unsigned char)a_iA;
+    instr.B   = (unsigned char)a_iB;
+    instr.Aux = 0;
+    instr.Val = 0;
+    m_vCode.push_back(instr);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Load a pending value or variable into the register of its stack position. */
+  void ParserRegCode::Materialize(std::vector<SOperand> &a_vStack, int a_iPos)
+  {
+    SOperand &op = a_vStack[a_iPos];
+    switch(op.Kind)
+    {
+    case SOperand::okVAR:  
+         Emit(rcLOAD, a_iPos);
+         m_vCode.back().Ptr = op.Ptr;
+         break;
+
+    case SOperand::okVAL:  
+         Emit(rcLOADC, a_iPos);
+         m_vCode.back().Val = op.Val;
+         break;
+
+    default: 
+         break;
+    }
+
+    op.Kind = SOperand::okREG;
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Load all pending values into registers.
+  
+      Required before jumps, so that both branches leave the same state, and
+      before anything that could modify a variable which has not been read yet.
+  */
+  void ParserRegCode::MaterializeAll(std::vector<SOperand> &a_vStack)
+  {
+    for (std::size_t i=1; i<a_vStack.size(); ++i)
+      Materialize(a_vStack, (int)i);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Emit the binary operator consuming the stack positions a_iPos and a_iPos+1. 
+  
+      The opcodes of the built in binary operators are in the order of
+      their ECmdCode values, each with three variants.
+  */
+  void ParserRegCode::EmitBinary(std::vector<SOperand> &a_vStack, int a_iPos, ECmdCode a_eCmd)
+  {
+    int iCmd = a_eCmd;
+    int iRegA = a_iPos;
+    SOperand opB = a_vStack[a_iPos+1];
+
+    if (a_vStack[a_iPos].Kind!=SOperand::okREG)
+    {
+      bool bSwap = (opB.Kind==SOperand::okREG);
+      switch(a_eCmd)
+      {
+      case cmLE: iCmd = cmGE; break;
+      case cmGE: iCmd = cmLE; break;
+      case cmLT: iCmd = cmGT; break;
+      case cmGT: iCmd = cmLT; break;
+      case cmSUB:
+      case cmDIV:
+      case cmPOW: bSwap = false; break;
+      default:    break;
+      }
+
+      if (bSwap)
+      {
+        // a op b is evaluated as b op' a, the first operand does not need to be loaded
+        iRegA = a_iPos + 1;
+        opB = a_vStack[a_iPos];
+      }
+      else
+      {
+        iCmd = a_eCmd;
+        Materialize(a_vStack, a_iPos);
+      }
+    }
+
+    switch(opB.Kind)
+    {
+    case SOperand::okREG:
+         Emit(3*iCmd, a_iPos, iRegA, a_iPos+1);
+         break;
+
+    case SOperand::okVAR:
+         Emit(3*iCmd + 1, a_iPos, iRegA);
+         m_vCode.back().Ptr = opB.Ptr;
+         break;
+
+    case SOperand::okVAL:
+         Emit(3*iCmd + 2, a_iPos, iRegA);
+         m_vCode.back().Val = opB.Val;
+         break;
+    }
+
+    a_vStack[a_iPos].Kind = SOperand::okREG;
+    a_vStack[a_iPos+1].Kind = SOperand::okREG;
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Create the register code for the given bytecode.
+      \param a_ByteCode The finalized bytecode
+      \param a_iFinalResultIdx Stack index of the result
+      \param a_vStringBuf String arguments referenced by cmFUNC_STR tokens, must 
+                          not be modified while the code is in use.
+      \return false if the bytecode can not be translated, the interpreter must be used then.
+
+      SToken::StackPos is not maintained by ParserByteCode, the stack positions
+      are tracked here the same way the interpreter does.
+  */
+  bool ParserRegCode::Compile(const ParserByteCode &a_ByteCode, 
+                              int a_iFinalResultIdx, 
+                              const stringbuf_type &a_vStringBuf)
+  {
+    Reset();
+
+    const int iMaxReg = 255;
+    std::vector<SOperand> vStack(1);
+    std::vector<int> stJump, stIfSidx;
+    int sidx = 0;
+
+    for (const SToken *pTok = a_ByteCode.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      switch (pTok->Cmd)
+      {
+      case  cmLE:
+      case  cmGE:
+      case  cmNEQ:
+      case  cmEQ:
+      case  cmLT:
+      case  cmGT:
+      case  cmADD:
+      case  cmSUB:
+      case  cmMUL:
+      case  cmDIV:
+      case  cmPOW:
+      case  cmLAND:
+      case  cmLOR:
+            --sidx;
+            EmitBinary(vStack, sidx, pTok->Cmd);
+            vStack.resize(sidx + 1);
+            continue;
+
+      case  cmASSIGN:
+            --sidx;
+            MaterializeAll(vStack);
+            Emit(rcASSIGN, sidx, sidx + 1);
+            m_vCode.back().Ptr = pTok->Oprt.ptr;
+            vStack.resize(sidx + 1);
+            continue;
+
+      case  cmIF:
+            MaterializeAll(vStack);
+            --sidx;
+            Emit(rcJZ, 0, sidx + 1);
+            stJump.push_back((int)m_vCode.size() - 1);
+            stIfSidx.push_back(sidx);
+            vStack.resize(sidx + 1);
+            continue;
+
+      case  cmELSE:
+            MaterializeAll(vStack);
+            Emit(rcJMP, 0);
+            m_vCode[stJump.back()].Aux = (int)m_vCode.size();
+            stJump.back() = (int)m_vCode.size() - 1;
+            sidx = stIfSidx.back();
+            stIfSidx.pop_back();
+            vStack.resize(sidx + 1);
+            continue;
+
+      case  cmENDIF:
+            MaterializeAll(vStack);
+            m_vCode[stJump.back()].Aux = (int)m_vCode.size();
+            stJump.pop_back();
+            continue;
+
+      case  cmVAR:
+      case  cmVAL:
+            if (++sidx>iMaxReg)
+              break;
+
+            {
+              SOperand op;
+              op.Kind = (pTok->Cmd==cmVAR) ? SOperand::okVAR : SOperand::okVAL;
+              op.Ptr  = pTok->Val.ptr;
+              op.Val  = pTok->Val.data2;
+              vStack.push_back(op);
+            }
+            continue;
+
+      case  cmVARPOW2:
+      case  cmVARPOW3:
+      case  cmVARPOW4:
+      case  cmVARMUL:
+            if (++sidx>iMaxReg)
+              break;
+
+            switch(pTok->Cmd)
+            {
+            case cmVARPOW2: Emit(rcVARPOW2, sidx); break;
+            case cmVARPOW3: Emit(rcVARPOW3, sidx); break;
+            case cmVARPOW4: Emit(rcVARPOW4, sidx); break;
+            default:
+                 Emit(rcVARMUL, sidx); 
+                 m_vCode.back().Aux = (int)m_vConst.size();
+                 m_vConst.push_back(pTok->Val.data);
+                 m_vConst.push_back(pTok->Val.data2);
+                 break;
+            }
+
+            m_vCode.back().Ptr = pTok->Val.ptr;
+            vStack.push_back(SOperand());
+            vStack.back().Kind = SOperand::okREG;
+            continue;
+
+      // Arguments are passed in consecutive registers. Callbacks may have 
+      // side effects on variables, so pending variables are loaded first.
+      case  cmFUNC:
+      case  cmFUNC_STR:
+      case  cmFUNC_BULK:
+            {
+              int iArgCount = pTok->Fun.argc;
+              if (pTok->Cmd==cmFUNC && iArgCount<0)
+                iArgCount = -iArgCount;
+
+              if (iArgCount>iMaxReg || sidx - iArgCount + 1>iMaxReg)
+                break;
+
+              MaterializeAll(vStack);
+              sidx -= iArgCount - 1;
+
+              if (pTok->Cmd==cmFUNC_STR)
+              {
+                if (iArgCount>2 || pTok->Fun.idx<0 || pTok->Fun.idx>=(int)a_vStringBuf.size())
+                  break;
+
+                Emit(rcFUNC_STR, sidx, sidx, iArgCount);
+                m_vCode.back().Aux = (int)m_vStr.size();
+                m_vStr.push_back(a_vStringBuf[pTok->Fun.idx].c_str());
+              }
+              else if (pTok->Cmd==cmFUNC_BULK)
+              {
+                Emit(rcFUNC_BULK, sidx, sidx, iArgCount);
+              }
+              else if (pTok->Fun.argc<0)
+              {
+                Emit(rcFUNC_MULTI, sidx, sidx, iArgCount);
+              }
+              else
+              {
+                switch(iArgCount)
+                {
+                case 1:  Emit(rcFUNC1, sidx, sidx); break;
+                case 2:  Emit(rcFUNC2, sidx, sidx); break;
+                default: Emit(rcFUNC, sidx, sidx, iArgCount); break;
+                }
+              }
+
+              m_vCode.back().Fun = pTok->Fun.ptr;
+
+              vStack.resize(sidx + 1);
+              vStack.back().Kind = SOperand::okREG;
+            }
+            continue;
+
+      default:
+            break;
+      } // switch CmdCode
+
+      // unsupported token or too many registers
+      Reset();
+      return false;
+    } // for all bytecode tokens
+
+    // All results must be in the stack like after the interpreter ran, they are
+    // accessed by Eval(int&).
+    MaterializeAll(vStack);
+    Emit(rcEND, 0);
+
+    m_iFinalResultIdx = a_iFinalResultIdx;
+    return true;
+  }
+
+  //---------------------------------------------------------------------------
+  void ParserRegCode::Reset()
+  {
+    m_vCode.clear();
+    m_vConst.clear();
+    m_vStr.clear();
+    m_iFinalResultIdx = 0;
+  }
+
+  //---------------------------------------------------------------------------
+  bool ParserRegCode::IsCompiled() const
+  {
+    return !m_vCode.empty();
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Number of instructions. */
+  std::size_t ParserRegCode::GetSize() const
+  {
+    return m_vCode.size();
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the register code.
+      \param a_pReg The register file, the parser's stack buffer
+  */
+  value_type ParserRegCode::Eval(value_type *a_pReg) const
+  {
+    value_type *Reg = a_pReg;
+    const SRegInstr *pBase = &m_vCode[0];
+    const SRegInstr *pInstr = pBase;
+    value_type buf;
+
+#if defined(MUP_REGCODE_COMPUTED_GOTO)
+
+    // must be in the order of ERegOp
+    static void* const s_pLabel[rcCOUNT] = 
+    {
+      &&L_rcLE,   &&L_rcLE_V,   &&L_rcLE_C,
+      &&L_rcGE,   &&L_rcGE_V,   &&L_rcGE_C,
+      &&L_rcNEQ,  &&L_rcNEQ_V,  &&L_rcNEQ_C,
+      &&L_rcEQ,   &&L_rcEQ_V,   &&L_rcEQ_C,
+      &&L_rcLT,   &&L_rcLT_V,   &&L_rcLT_C,
+      &&L_rcGT,   &&L_rcGT_V,   &&L_rcGT_C,
+      &&L_rcADD,  &&L_rcADD_V,  &&L_rcADD_C,
+      &&L_rcSUB,  &&L_rcSUB_V,  &&L_rcSUB_C,
+      &&L_rcMUL,  &&L_rcMUL_V,  &&L_rcMUL_C,
+      &&L_rcDIV,  &&L_rcDIV_V,  &&L_rcDIV_C,
+      &&L_rcPOW,  &&L_rcPOW_V,  &&L_rcPOW_C,
+      &&L_rcLAND, &&L_rcLAND_V, &&L_rcLAND_C,
+      &&L_rcLOR,  &&L_rcLOR_V,  &&L_rcLOR_C,
+      &&L_rcLOAD,
+      &&L_rcLOADC,
+      &&L_rcVARPOW2,
+      &&L_rcVARPOW3,
+      &&L_rcVARPOW4,
+      &&L_rcVARMUL,
+      &&L_rcASSIGN,
+      &&L_rcJZ,
+      &&L_rcJMP,
+      &&L_rcFUNC1,
+      &&L_rcFUNC2,
+      &&L_rcFUNC,
+      &&L_rcFUNC_MULTI,
+      &&L_rcFUNC_STR,
+      &&L_rcFUNC_BULK,
+      &&L_rcEND
+    };
+
+    #define MUP_REG_OP(OP) L_##OP:
+    #define MUP_REG_DISPATCH goto *s_pLabel[pInstr->Op]
+    #define MUP_REG_NEXT ++pInstr; MUP_REG_DISPATCH
+
+    MUP_REG_DISPATCH;
+
+#else
+
+    #define MUP_REG_OP(OP) case OP:
+    #define MUP_REG_DISPATCH continue
+    #define MUP_REG_NEXT ++pInstr; continue
+
+    for (;;)
+    {
+      switch (pInstr->Op)
+      {
+#endif
+
+    #define MUP_REG_BINARY(OP, EXPR)                                                                        \
+      MUP_REG_OP(OP)     { value_type a = Reg[pInstr->A], b = Reg[pInstr->B]; Reg[pInstr->Dst] = EXPR; }  \
+      MUP_REG_NEXT;                                                                                        \
+      MUP_REG_OP(OP##_V) { value_type a = Reg[pInstr->A], b = *pInstr->Ptr;   Reg[pInstr->Dst] = EXPR; }  \
+      MUP_REG_NEXT;                                                                                        \
+      MUP_REG_OP(OP##_C) { value_type a = Reg[pInstr->A], b = pInstr->Val;    Reg[pInstr->Dst] = EXPR; }  \
+      MUP_REG_NEXT;
+
+      MUP_REG_BINARY(rcLE,   a <= b)
+      MUP_REG_BINARY(rcGE,   a >= b)
+      MUP_REG_BINARY(rcNEQ,  a != b)
+      MUP_REG_BINARY(rcEQ,   a == b)
+      MUP_REG_BINARY(rcLT,   a < b)
+      MUP_REG_BINARY(rcGT,   a > b)
+      MUP_REG_BINARY(rcADD,  a + b)
+      MUP_REG_BINARY(rcSUB,  a - b)
+      MUP_REG_BINARY(rcMUL,  a * b)
+      MUP_REG_BINARY(rcDIV,  a / b)
+      MUP_REG_BINARY(rcPOW,  MathImpl<value_type>::Pow(a, b))
+      MUP_REG_BINARY(rcLAND, a && b)
+      MUP_REG_BINARY(rcLOR,  a || b)
+
+    #undef MUP_REG_BINARY
+
+      MUP_REG_OP(rcLOAD)    Reg[pInstr->Dst] = *pInstr->Ptr;  MUP_REG_NEXT;
+      MUP_REG_OP(rcLOADC)   Reg[pInstr->Dst] = pInstr->Val;   MUP_REG_NEXT;
+
+      MUP_REG_OP(rcVARPOW2) buf = *pInstr->Ptr;
+                            Reg[pInstr->Dst] = buf*buf;
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcVARPOW3) buf = *pInstr->Ptr;
+                            Reg[pInstr->Dst] = buf*buf*buf;
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcVARPOW4) buf = *pInstr->Ptr;
+                            Reg[pInstr->Dst] = buf*buf*buf*buf;
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcVARMUL)  Reg[pInstr->Dst] = *pInstr->Ptr * m_vConst[pInstr->Aux] + m_vConst[pInstr->Aux+1];
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcASSIGN)  Reg[pInstr->Dst] = *pInstr->Ptr = Reg[pInstr->A];
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcJZ)      if (Reg[pInstr->A]==0)
+                            {
+                              pInstr = pBase + pInstr->Aux;
+                              MUP_REG_DISPATCH;
+                            }
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcJMP)     pInstr = pBase + pInstr->Aux;
+                            MUP_REG_DISPATCH;
+
+      MUP_REG_OP(rcFUNC1)   Reg[pInstr->Dst] = (*(fun_type1)pInstr->Fun)(Reg[pInstr->A]);
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcFUNC2)   Reg[pInstr->Dst] = (*(fun_type2)pInstr->Fun)(Reg[pInstr->A], Reg[pInstr->A+1]);
+                            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcFUNC)
+            {
+              value_type *Arg = &Reg[pInstr->A];
+              switch(pInstr->B)  
+              {
+              case 0: Reg[pInstr->Dst] = (*(fun_type0)pInstr->Fun)(); break;
+              case 3: Reg[pInstr->Dst] = (*(fun_type3)pInstr->Fun)(Arg[0], Arg[1], Arg[2]); break;
+              case 4: Reg[pInstr->Dst] = (*(fun_type4)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3]); break;
+              case 5: Reg[pInstr->Dst] = (*(fun_type5)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4]); break;
+              case 6: Reg[pInstr->Dst] = (*(fun_type6)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5]); break;
+              case 7: Reg[pInstr->Dst] = (*(fun_type7)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6]); break;
+              case 8: Reg[pInstr->Dst] = (*(fun_type8)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7]); break;
+              case 9: Reg[pInstr->Dst] = (*(fun_type9)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7], Arg[8]); break;
+              case 10:Reg[pInstr->Dst] = (*(fun_type10)pInstr->Fun)(Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7], Arg[8], Arg[9]); break;
+              default: assert(false); break;
+              }
+            }
+            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcFUNC_MULTI)  
+            Reg[pInstr->Dst] = (*(multfun_type)pInstr->Fun)(&Reg[pInstr->A], pInstr->B);
+            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcFUNC_STR)
+            {
+              value_type *Arg = &Reg[pInstr->A];
+              const char_type *Str = m_vStr[pInstr->Aux];
+              switch(pInstr->B)
+              {
+              case 0: Reg[pInstr->Dst] = (*(strfun_type1)pInstr->Fun)(Str); break;
+              case 1: Reg[pInstr->Dst] = (*(strfun_type2)pInstr->Fun)(Str, Arg[0]); break;
+              case 2: Reg[pInstr->Dst] = (*(strfun_type3)pInstr->Fun)(Str, Arg[0], Arg[1]); break;
+              }
+            }
+            MUP_REG_NEXT;
+
+      // Outside of bulk mode the bulk index and thread id are zero.
+      MUP_REG_OP(rcFUNC_BULK)
+            {
+              value_type *Arg = &Reg[pInstr->A];
+              switch(pInstr->B)  
+              {
+              case 0: Reg[pInstr->Dst] = (*(bulkfun_type0 )pInstr->Fun)(0, 0); break;
+              case 1: Reg[pInstr->Dst] = (*(bulkfun_type1 )pInstr->Fun)(0, 0, Arg[0]); break;
+              case 2: Reg[pInstr->Dst] = (*(bulkfun_type2 )pInstr->Fun)(0, 0, Arg[0], Arg[1]); break;
+              case 3: Reg[pInstr->Dst] = (*(bulkfun_type3 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2]); break;
+              case 4: Reg[pInstr->Dst] = (*(bulkfun_type4 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3]); break;
+              case 5: Reg[pInstr->Dst] = (*(bulkfun_type5 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4]); break;
+              case 6: Reg[pInstr->Dst] = (*(bulkfun_type6 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5]); break;
+              case 7: Reg[pInstr->Dst] = (*(bulkfun_type7 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6]); break;
+              case 8: Reg[pInstr->Dst] = (*(bulkfun_type8 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7]); break;
+              case 9: Reg[pInstr->Dst] = (*(bulkfun_type9 )pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7], Arg[8]); break;
+              case 10:Reg[pInstr->Dst] = (*(bulkfun_type10)pInstr->Fun)(0, 0, Arg[0], Arg[1], Arg[2], Arg[3], Arg[4], Arg[5], Arg[6], Arg[7], Arg[8], Arg[9]); break;
+              default: assert(false); break;
+              }
+            }
+            MUP_REG_NEXT;
+
+      MUP_REG_OP(rcEND)
+            return Reg[m_iFinalResultIdx];
+
+#if !defined(MUP_REGCODE_COMPUTED_GOTO)
+      default:
+            assert(false);
+            return 0;
+      } // switch Op
+    } // for all instructions
+#endif
+
+    #undef MUP_REG_OP
+    #undef MUP_REG_DISPATCH
+    #undef MUP_REG_NEXT
+  }
+} // namespace mu
@@ -0,0 +1,151 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+#ifndef MU_PARSER_REGCODE_H
+#define MU_PARSER_REGCODE_H
+
+#include <string>
+#include <vector>
+
+#include "muParserDef.h"
+#include "muParserBytecode.h"
+
+/** \file
+    \brief Definition of the register code, a three address form of the parser bytecode.
+*/
+
+
+namespace mu
+{
+  //---------------------------------------------------------------------------
+  /** \brief Instruction of the register code.
+
+      Registers are the positions of the parser stack. The destination of an
+      instruction is the stack position of its result, so no stack index
+      needs to be maintained during evaluation. The second operand of a binary
+      operator may be a register, a variable or a constant.
+  */
+  struct SRegInstr
+  {
+    unsigned char Op;   ///< Opcode, one of ParserRegCode::ERegOp
+    unsigned char Dst;  ///< Destination register
+    unsigned char A;    ///< First operand register
+    unsigned char B;    ///< Second operand register or argument count
+    int Aux;            ///< Jump target, string argument index or constant pool index
+
+    union
+    {
+      value_type *Ptr;        ///< Variable address
+      value_type  Val;        ///< Constant operand
+      generic_fun_type Fun;   ///< Callback
+    };
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Register code created from the finalized bytecode.
+
+      Values and variables are not pushed, they are folded into the binary
+      operator consuming them. The evaluation loop uses computed gotos when
+      compiled with gcc or clang and a switch statement otherwise.
+      
+      Compile() fails if the expression needs more than 255 stack positions,
+      the parser keeps using the bytecode interpreter then.
+  */
+  class ParserRegCode
+  {
+  public:
+
+    typedef std::vector<string_type> stringbuf_type;
+
+    enum ERegOp
+    {
+      // Binary operators, each with a register, variable and constant second operand
+      rcLE, rcLE_V, rcLE_C,
+      rcGE, rcGE_V, rcGE_C,
+      rcNEQ, rcNEQ_V, rcNEQ_C,
+      rcEQ, rcEQ_V, rcEQ_C,
+      rcLT, rcLT_V, rcLT_C,
+      rcGT, rcGT_V, rcGT_C,
+      rcADD, rcADD_V, rcADD_C,
+      rcSUB, rcSUB_V, rcSUB_C,
+      rcMUL, rcMUL_V, rcMUL_C,
+      rcDIV, rcDIV_V, rcDIV_C,
+      rcPOW, rcPOW_V, rcPOW_C,
+      rcLAND, rcLAND_V, rcLAND_C,
+      rcLOR, rcLOR_V, rcLOR_C,
+
+      rcLOAD,       ///< Dst = *Ptr
+      rcLOADC,      ///< Dst = Val
+      rcVARPOW2,    ///< Dst = (*Ptr)^2
+      rcVARPOW3,    ///< Dst = (*Ptr)^3
+      rcVARPOW4,    ///< Dst = (*Ptr)^4
+      rcVARMUL,     ///< Dst = *Ptr * Const[Aux] + Const[Aux+1]
+      rcASSIGN,     ///< Dst = *Ptr = A
+      rcJZ,         ///< Jump to Aux if A==0
+      rcJMP,        ///< Jump to Aux
+      rcFUNC1,      ///< Dst = Fun(A)
+      rcFUNC2,      ///< Dst = Fun(A, A+1)
+      rcFUNC,       ///< Dst = Fun(Dst, ..., Dst+B-1)
+      rcFUNC_MULTI, ///< Dst = Fun(&Dst, B)
+      rcFUNC_STR,   ///< Dst = Fun(Str[Aux], Dst, ..., Dst+B-1)
+      rcFUNC_BULK,  ///< Dst = Fun(0, 0, Dst, ..., Dst+B-1)
+      rcEND,
+
+      rcCOUNT
+    };
+
+    ParserRegCode();
+
+    bool Compile(const ParserByteCode &a_ByteCode, 
+                 int a_iFinalResultIdx, 
+                 const stringbuf_type &a_vStringBuf);
+    void Reset();
+    bool IsCompiled() const;
+    std::size_t GetSize() const;
+
+    value_type Eval(value_type *a_pReg) const;
+
+  private:
+
+    /** \brief Compile time state of a stack position. */
+    struct SOperand
+    {
+      enum EKind { okREG, okVAR, okVAL } Kind;
+      value_type *Ptr;
+      value_type  Val;
+    };
+
+    void Emit(unsigned a_iOp, int a_iDst, int a_iA = 0, int a_iB = 0);
+    void Materialize(std::vector<SOperand> &a_vStack, int a_iPos);
+    void MaterializeAll(std::vector<SOperand> &a_vStack);
+    void EmitBinary(std::vector<SOperand> &a_vStack, int a_iPos, ECmdCode a_eCmd);
+
+    std::vector<SRegInstr> m_vCode;
+    std::vector<value_type> m_vConst;
+    std::vector<const char_type*> m_vStr;
+    int m_iFinalResultIdx;
+  };
+} // namespace mu
+
+#endif
@@ -0,0 +1,375 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+#include "muParserSimd.h"
+
+/** \file
+    \brief Implementation of the column kernels of the block evaluation mode.
+
+    The AVX2 and AVX-512 kernels are compiled for their instruction set regardless
+    of the compiler flags and must only be selected if the CPU supports it. They
+    require MUP_BASETYPE to be double, define MUP_NO_SIMD_KERNELS otherwise.
+*/
+
+#if !defined(MUP_NO_SIMD_KERNELS) && \
+    (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+
+  #if defined(_MSC_VER)
+    #include <immintrin.h>
+    #define MUP_SIMD_KERNELS
+    #define MUP_TARGET_AVX2
+    #define MUP_TARGET_AVX512
+  #elif defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+    #include <immintrin.h>
+    #define MUP_SIMD_KERNELS
+    #define MUP_TARGET_AVX2   __attribute__((target("avx2")))
+    #define MUP_TARGET_AVX512 __attribute__((target("avx512f")))
+  #endif
+
+#endif
+
+
+namespace mu
+{
+namespace
+{
+  //---------------------------------------------------------------------------
+  // Portable kernels
+
+  #define MUP_SCALAR_BINARY(NAME, EXPR)                               \
+    void NAME(value_type *lhs, const value_type *rhs, int n)          \
+    {                                                                 \
+      for (int i=0; i<n; ++i)                                         \
+        lhs[i] = EXPR;                                                \
+    }
+
+  #define MUP_SCALAR_VAR(NAME, EXPR)                                  \
+    void NAME(value_type *dst, const value_type *var, int n)          \
+    {                                                                 \
+      for (int i=0; i<n; ++i)                                         \
+        dst[i] = EXPR;                                                \
+    }
+
+  MUP_SCALAR_BINARY(ScalarAdd, lhs[i] +  rhs[i])
+  MUP_SCALAR_BINARY(ScalarSub, lhs[i] -  rhs[i])
+  MUP_SCALAR_BINARY(ScalarMul, lhs[i] *  rhs[i])
+  MUP_SCALAR_BINARY(ScalarDiv, lhs[i] /  rhs[i])
+  MUP_SCALAR_BINARY(ScalarLE,  lhs[i] <= rhs[i])
+  MUP_SCALAR_BINARY(ScalarGE,  lhs[i] >= rhs[i])
+  MUP_SCALAR_BINARY(ScalarNEQ, lhs[i] != rhs[i])
+  MUP_SCALAR_BINARY(ScalarEQ,  lhs[i] == rhs[i])
+  MUP_SCALAR_BINARY(ScalarLT,  lhs[i] <  rhs[i])
+  MUP_SCALAR_BINARY(ScalarGT,  lhs[i] >  rhs[i])
+
+  MUP_SCALAR_VAR(ScalarVar,     var[i])
+  MUP_SCALAR_VAR(ScalarVarPow2, var[i]*var[i])
+  MUP_SCALAR_VAR(ScalarVarPow3, var[i]*var[i]*var[i])
+  MUP_SCALAR_VAR(ScalarVarPow4, var[i]*var[i]*var[i]*var[i])
+
+  void ScalarVarMul(value_type *dst, const value_type *var, value_type fMul, value_type fAdd, int n)
+  {
+    for (int i=0; i<n; ++i)
+      dst[i] = var[i] * fMul + fAdd;
+  }
+
+  void ScalarVal(value_type *dst, value_type fVal, int n)
+  {
+    for (int i=0; i<n; ++i)
+      dst[i] = fVal;
+  }
+
+  void ScalarIfElse(value_type *cond, const value_type *vThen, const value_type *vElse, int n)
+  {
+    for (int i=0; i<n; ++i)
+      cond[i] = (cond[i]!=0) ? vThen[i] : vElse[i];
+  }
+
+  const SimdKernels s_ScalarKernels =
+  {
+    ScalarAdd, ScalarSub, ScalarMul, ScalarDiv,
+    ScalarLE, ScalarGE, ScalarNEQ, ScalarEQ, ScalarLT, ScalarGT,
+    ScalarVar, ScalarVarPow2, ScalarVarPow3, ScalarVarPow4, ScalarVarMul, ScalarVal,
+    ScalarIfElse
+  };
+
+  #undef MUP_SCALAR_BINARY
+  #undef MUP_SCALAR_VAR
+
+#if defined(MUP_SIMD_KERNELS)
+
+  //---------------------------------------------------------------------------
+  // AVX2 kernels, the remaining n%4 rows are computed by scalar code
+
+  #define MUP_AVX2_BINARY(NAME, VEXPR, SEXPR)                          \
+    MUP_TARGET_AVX2 void NAME(double *lhs, const double *rhs, int n)   \
+    {                                                                  \
+      int i=0;                                                         \
+      for (; i+4<=n; i+=4)                                             \
+      {                                                                \
+        __m256d l = _mm256_loadu_pd(lhs+i);                            \
+        __m256d r = _mm256_loadu_pd(rhs+i);                            \
+        _mm256_storeu_pd(lhs+i, VEXPR);                                \
+      }                                                                \
+      for (; i<n; ++i)                                                 \
+        lhs[i] = SEXPR;                                                \
+    }
+
+  // Comparison results are all-ones masks, and-ing them with 1.0 gives 1 or 0.
+  #define MUP_AVX2_COMPARE(NAME, PRED, SEXPR) \
+    MUP_AVX2_BINARY(NAME, _mm256_and_pd(_mm256_cmp_pd(l, r, PRED), _mm256_set1_pd(1.0)), SEXPR)
+
+  #define MUP_AVX2_VAR(NAME, VEXPR, SEXPR)                             \
+    MUP_TARGET_AVX2 void NAME(double *dst, const double *var, int n)   \
+    {                                                                  \
+      int i=0;                                                         \
+      for (; i+4<=n; i+=4)                                             \
+      {                                                                \
+        __m256d v = _mm256_loadu_pd(var+i);                            \
+        _mm256_storeu_pd(dst+i, VEXPR);                                \
+      }                                                                \
+      for (; i<n; ++i)                                                 \
+        dst[i] = SEXPR;                                                \
+    }
+
+  MUP_AVX2_BINARY(Avx2Add, _mm256_add_pd(l, r), lhs[i] + rhs[i])
+  MUP_AVX2_BINARY(Avx2Sub, _mm256_sub_pd(l, r), lhs[i] - rhs[i])
+  MUP_AVX2_BINARY(Avx2Mul, _mm256_mul_pd(l, r), lhs[i] * rhs[i])
+  MUP_AVX2_BINARY(Avx2Div, _mm256_div_pd(l, r), lhs[i] / rhs[i])
+
+  MUP_AVX2_COMPARE(Avx2LE,  _CMP_LE_OQ,  lhs[i] <= rhs[i])
+  MUP_AVX2_COMPARE(Avx2GE,  _CMP_GE_OQ,  lhs[i] >= rhs[i])
+  MUP_AVX2_COMPARE(Avx2NEQ, _CMP_NEQ_UQ, lhs[i] != rhs[i])
+  MUP_AVX2_COMPARE(Avx2EQ,  _CMP_EQ_OQ,  lhs[i] == rhs[i])
+  MUP_AVX2_COMPARE(Avx2LT,  _CMP_LT_OQ,  lhs[i] <  rhs[i])
+  MUP_AVX2_COMPARE(Avx2GT,  _CMP_GT_OQ,  lhs[i] >  rhs[i])
+
+  MUP_AVX2_VAR(Avx2Var,     v, var[i])
+  MUP_AVX2_VAR(Avx2VarPow2, _mm256_mul_pd(v, v), var[i]*var[i])
+  MUP_AVX2_VAR(Avx2VarPow3, _mm256_mul_pd(_mm256_mul_pd(v, v), v), var[i]*var[i]*var[i])
+  MUP_AVX2_VAR(Avx2VarPow4, _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(v, v), v), v), var[i]*var[i]*var[i]*var[i])
+
+  MUP_TARGET_AVX2 void Avx2VarMul(double *dst, const double *var, double fMul, double fAdd, int n)
+  {
+    const __m256d vMul = _mm256_set1_pd(fMul);
+    const __m256d vAdd = _mm256_set1_pd(fAdd);
+
+    int i=0;
+    for (; i+4<=n; i+=4)
+      _mm256_storeu_pd(dst+i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(var+i), vMul), vAdd));
+
+    for (; i<n; ++i)
+      dst[i] = var[i] * fMul + fAdd;
+  }
+
+  MUP_TARGET_AVX2 void Avx2Val(double *dst, double fVal, int n)
+  {
+    const __m256d v = _mm256_set1_pd(fVal);
+
+    int i=0;
+    for (; i+4<=n; i+=4)
+      _mm256_storeu_pd(dst+i, v);
+
+    for (; i<n; ++i)
+      dst[i] = fVal;
+  }
+
+  // NaN counts as true like in the scalar "cond!=0"
+  MUP_TARGET_AVX2 void Avx2IfElse(double *cond, const double *vThen, const double *vElse, int n)
+  {
+    const __m256d zero = _mm256_setzero_pd();
+
+    int i=0;
+    for (; i+4<=n; i+=4)
+    {
+      __m256d mask = _mm256_cmp_pd(_mm256_loadu_pd(cond+i), zero, _CMP_NEQ_UQ);
+      _mm256_storeu_pd(cond+i, _mm256_blendv_pd(_mm256_loadu_pd(vElse+i), _mm256_loadu_pd(vThen+i), mask));
+    }
+
+    for (; i<n; ++i)
+      cond[i] = (cond[i]!=0) ? vThen[i] : vElse[i];
+  }
+
+  const SimdKernels s_Avx2Kernels =
+  {
+    Avx2Add, Avx2Sub, Avx2Mul, Avx2Div,
+    Avx2LE, Avx2GE, Avx2NEQ, Avx2EQ, Avx2LT, Avx2GT,
+    Avx2Var, Avx2VarPow2, Avx2VarPow3, Avx2VarPow4, Avx2VarMul, Avx2Val,
+    Avx2IfElse
+  };
+
+  #undef MUP_AVX2_BINARY
+  #undef MUP_AVX2_COMPARE
+  #undef MUP_AVX2_VAR
+
+  //---------------------------------------------------------------------------
+  // AVX-512 kernels, the remaining n%8 rows are computed with masked loads and stores
+
+  #define MUP_AVX512_BINARY(NAME, VEXPR)                                  \
+    MUP_TARGET_AVX512 void NAME(double *lhs, const double *rhs, int n)    \
+    {                                                                     \
+      for (int i=0; i<n; i+=8)                                            \
+      {                                                                   \
+        __mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (n-i)) - 1); \
+        __m512d l = _mm512_maskz_loadu_pd(m, lhs+i);                      \
+        __m512d r = _mm512_maskz_loadu_pd(m, rhs+i);                      \
+        _mm512_mask_storeu_pd(lhs+i, m, VEXPR);                           \
+      }                                                                   \
+    }
+
+  #define MUP_AVX512_COMPARE(NAME, PRED) \
+    MUP_AVX512_BINARY(NAME, _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(l, r, PRED), _mm512_set1_pd(1.0)))
+
+  #define MUP_AVX512_VAR(NAME, VEXPR)                                     \
+    MUP_TARGET_AVX512 void NAME(double *dst, const double *var, int n)    \
+    {                                                                     \
+      for (int i=0; i<n; i+=8)                                            \
+      {                                                                   \
+        __mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (n-i)) - 1); \
+        __m512d v = _mm512_maskz_loadu_pd(m, var+i);                      \
+        _mm512_mask_storeu_pd(dst+i, m, VEXPR);                           \
+      }                                                                   \
+    }
+
+  MUP_AVX512_BINARY(Avx512Add, _mm512_add_pd(l, r))
+  MUP_AVX512_BINARY(Avx512Sub, _mm512_sub_pd(l, r))
+  MUP_AVX512_BINARY(Avx512Mul, _mm512_mul_pd(l, r))
+  MUP_AVX512_BINARY(Avx512Div, _mm512_div_pd(l, r))
+
+  MUP_AVX512_COMPARE(Avx512LE,  _CMP_LE_OQ)
+  MUP_AVX512_COMPARE(Avx512GE,  _CMP_GE_OQ)
+  MUP_AVX512_COMPARE(Avx512NEQ, _CMP_NEQ_UQ)
+  MUP_AVX512_COMPARE(Avx512EQ,  _CMP_EQ_OQ)
+  MUP_AVX512_COMPARE(Avx512LT,  _CMP_LT_OQ)
+  MUP_AVX512_COMPARE(Avx512GT,  _CMP_GT_OQ)
+
+  MUP_AVX512_VAR(Avx512Var,     v)
+  MUP_AVX512_VAR(Avx512VarPow2, _mm512_mul_pd(v, v))
+  MUP_AVX512_VAR(Avx512VarPow3, _mm512_mul_pd(_mm512_mul_pd(v, v), v))
+  MUP_AVX512_VAR(Avx512VarPow4, _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(v, v), v), v))
+
+  MUP_TARGET_AVX512 void Avx512VarMul(double *dst, const double *var, double fMul, double fAdd, int n)
+  {
+    const __m512d vMul = _mm512_set1_pd(fMul);
+    const __m512d vAdd = _mm512_set1_pd(fAdd);
+
+    for (int i=0; i<n; i+=8)
+    {
+      __mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (n-i)) - 1);
+      __m512d v = _mm512_maskz_loadu_pd(m, var+i);
+      _mm512_mask_storeu_pd(dst+i, m, _mm512_add_pd(_mm512_mul_pd(v, vMul), vAdd));
+    }
+  }
+
+  MUP_TARGET_AVX512 void Avx512Val(double *dst, double fVal, int n)
+  {
+    const __m512d v = _mm512_set1_pd(fVal);
+
+    for (int i=0; i<n; i+=8)
+    {
+      __mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (n-i)) - 1);
+      _mm512_mask_storeu_pd(dst+i, m, v);
+    }
+  }
+
+  MUP_TARGET_AVX512 void Avx512IfElse(double *cond, const double *vThen, const double *vElse, int n)
+  {
+    const __m512d zero = _mm512_setzero_pd();
+
+    for (int i=0; i<n; i+=8)
+    {
+      __mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (n-i)) - 1);
+      __mmask8 c = _mm512_cmp_pd_mask(_mm512_maskz_loadu_pd(m, cond+i), zero, _CMP_NEQ_UQ);
+      __m512d v = _mm512_mask_blend_pd(c, _mm512_maskz_loadu_pd(m, vElse+i), _mm512_maskz_loadu_pd(m, vThen+i));
+      _mm512_mask_storeu_pd(cond+i, m, v);
+    }
+  }
+
+  const SimdKernels s_Avx512Kernels =
+  {
+    Avx512Add, Avx512Sub, Avx512Mul, Avx512Div,
+    Avx512LE, Avx512GE, Avx512NEQ, Avx512EQ, Avx512LT, Avx512GT,
+    Avx512Var, Avx512VarPow2, Avx512VarPow3, Avx512VarPow4, Avx512VarMul, Avx512Val,
+    Avx512IfElse
+  };
+
+  #undef MUP_AVX512_BINARY
+  #undef MUP_AVX512_COMPARE
+  #undef MUP_AVX512_VAR
+
+#endif // MUP_SIMD_KERNELS
+
+  ESimdLevel s_eSimdLevel = simdNONE;
+  const SimdKernels *s_pKernels = &s_ScalarKernels;
+
+} // anonymous namespace
+
+  //---------------------------------------------------------------------------
+  /** \brief Select the kernels used by ParserBase::EvalBlocked.
+
+      The caller is responsible for checking that the CPU supports the instruction set,
+      this function only checks whether the kernels were compiled in. Must not be
+      called while a block evaluation is running.
+
+      \return false if the kernels of eLevel are not available, the selection is unchanged then.
+  */
+  bool SetSimdLevel(ESimdLevel eLevel)
+  {
+    switch(eLevel)
+    {
+    case simdNONE:
+          s_pKernels = &s_ScalarKernels;
+          break;
+
+#if defined(MUP_SIMD_KERNELS)
+    case simdAVX2:
+          s_pKernels = &s_Avx2Kernels;
+          break;
+
+    case simdAVX512:
+          s_pKernels = &s_Avx512Kernels;
+          break;
+#endif
+
+    default:
+          return false;
+    }
+
+    s_eSimdLevel = eLevel;
+    return true;
+  }
+
+  //---------------------------------------------------------------------------
+  ESimdLevel GetSimdLevel()
+  {
+    return s_eSimdLevel;
+  }
+
+  //---------------------------------------------------------------------------
+  const SimdKernels& GetSimdKernels()
+  {
+    return *s_pKernels;
+  }
+
+} // namespace mu
@@ -0,0 +1,84 @@
+/*
+                 __________
+    _____   __ __\______   \_____  _______  ______  ____ _______
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|
+        \/                       \/            \/      \/
+  Copyright (C) 2004-2013 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify,
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+#ifndef MU_PARSER_SIMD_H
+#define MU_PARSER_SIMD_H
+
+#include "muParserDef.h"
+
+/** \file
+    \brief Column kernels of the block evaluation mode.
+*/
+
+
+namespace mu
+{
+  /** \brief Instruction sets the column kernels are available for. */
+  enum ESimdLevel
+  {
+    simdNONE   = 0,  ///< Portable loops, vectorized by the compiler according to its flags
+    simdAVX2   = 1,  ///< 256 bit kernels, 4 rows per instruction
+    simdAVX512 = 2   ///< 512 bit AVX-512F kernels, 8 rows per instruction
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Table of kernels applying a bytecode operation to n rows.
+
+      Binary kernels overwrite lhs with "lhs op rhs", comparisons store 1 or 0.
+      The variable kernels write the (transformed) variable values to dst and
+      ifelse stores vThen where cond is nonzero and vElse otherwise in cond.
+  */
+  struct SimdKernels
+  {
+    typedef void (*binary_type)(value_type *lhs, const value_type *rhs, int n);
+    typedef void (*var_type)(value_type *dst, const value_type *var, int n);
+
+    binary_type add;
+    binary_type sub;
+    binary_type mul;
+    binary_type div;
+    binary_type le;
+    binary_type ge;
+    binary_type neq;
+    binary_type eq;
+    binary_type lt;
+    binary_type gt;
+
+    var_type var;
+    var_type varpow2;
+    var_type varpow3;
+    var_type varpow4;
+    void (*varmul)(value_type *dst, const value_type *var, value_type fMul, value_type fAdd, int n);
+    void (*val)(value_type *dst, value_type fVal, int n);
+
+    void (*ifelse)(value_type *cond, const value_type *vThen, const value_type *vElse, int n);
+  };
+
+  bool SetSimdLevel(ESimdLevel eLevel);
+  ESimdLevel GetSimdLevel();
+  const SimdKernels& GetSimdKernels();
+
+} // namespace mu
+
+#endif
@@ -38,11 +38,17 @@
 #include <memory>
 #include <vector>
 #include <sstream>
+#include <typeinfo>
+#include <algorithm>
 
 #include "utGeneric.h"
 #include "mpDefines.h"
 #include "mpIfThenElse.h"
 #include "mpScriptTokens.h"
+#include "mpOprtNonCmplx.h"
+#include "mpOprtBinCommon.h"
+#include "mpFuncNonCmplx.h"
+#include "mpFuncCommon.h"
 
 using namespace std;
 
@@ -123,6 +129,13 @@ ParserXBase::ParserXBase()
     , m_bAutoCreateVar(false)
     , m_rpn()
     , m_vStackBuffer()
+    , m_bFastPath(true)
+    , m_vFastCode()
+    , m_vFastVar()
+    , m_vFastVarVal()
+    , m_vFastStack()
+    , m_valFastResult()
+    , m_bFastResultIsBool(false)
 {
     InitTokenReader();
 }
@@ -149,6 +162,13 @@ ParserXBase::ParserXBase(const ParserXBase &a_Parser)
     , m_bAutoCreateVar()
     , m_rpn()
     , m_vStackBuffer()
+    , m_bFastPath(true)
+    , m_vFastCode()
+    , m_vFastVar()
+    , m_vFastVarVal()
+    , m_vFastStack()
+    , m_valFastResult()
+    , m_bFastResultIsBool(false)
 {
     m_pTokenReader.reset(new TokenReader(this));
     Assign(a_Parser);
@@ -160,11 +180,7 @@ ParserXBase::ParserXBase(const ParserXBase &a_Parser)
       */
 ParserXBase::~ParserXBase()
 {
-    // It is important to release the stack buffer before
-    // releasing the value cache. Since it may contain
-    // Values referencing the cache.
     m_vStackBuffer.clear();
-    m_cache.ReleaseAll();
 }
 
 //---------------------------------------------------------------------------
@@ -214,11 +230,12 @@ void ParserXBase::Assign(const ParserXBase &ref)
     m_sInfixOprtChars = ref.m_sInfixOprtChars;
 
     m_bAutoCreateVar = ref.m_bAutoCreateVar;
+    m_bFastPath = ref.m_bFastPath;
 
     // Things that should not be copied:
     // - m_vStackBuffer
-    // - m_cache
     // - m_rpn
+    // - m_vFastCode (it references the values bound to the variables of ref)
 }
 
 //---------------------------------------------------------------------------
@@ -339,6 +356,8 @@ void ParserXBase::ReInit() const
     m_pTokenReader->ReInit();
     m_rpn.Reset();
     m_vStackBuffer.clear();
+    m_vFastCode.clear();
+    m_vFastVar.clear();
     m_nPos = 0;
 }
 
@@ -990,15 +1009,419 @@ const IValue& ParserXBase::ParseFromString() const
     // Umsachalten auf RPN
     m_vStackBuffer.assign(m_rpn.GetRequiredStackSize(), ptr_val_type());
     for (std::size_t i = 0; i < m_vStackBuffer.size(); ++i)
+        m_vStackBuffer[i].Reset(new Value);
+
+    m_pParserEngine = (m_bFastPath && CreateFastCode()) ? &ParserXBase::ParseFromFastCode
+                                                         : &ParserXBase::ParseFromRPN;
+
+    return (this->*m_pParserEngine)();
+}
+
+//---------------------------------------------------------------------------
+namespace
+{
+    /** \brief Instruction codes of the real valued fast path. */
+    enum EFastCode
+    {
+        fcVAL,    ///< Push a constant
+        fcVAR,    ///< Push a variable value
+        fcADD,
+        fcSUB,
+        fcMUL,
+        fcDIV,
+        fcPOW,
+        fcNEG,
+        fcLT,
+        fcGT,
+        fcLE,
+        fcGE,
+        fcEQ,
+        fcNEQ,
+        fcLAND,
+        fcLOR,
+        fcFUN,    ///< Unary function called through a function pointer
+        fcMIN,
+        fcMAX,
+        fcSUM,
+        fcIF,
+        fcJMP,
+        fcNOP
+    };
+
+    typedef float_type (*fun_ptr_type)(float_type);
+
+    /** \brief Static types of the fast path. */
+    enum EFastType
+    {
+        ftFLOAT,
+        ftBOOL
+    };
+
+    // Wrappers of the functions defined by PackageNonCmplx. They must compute 
+    // exactly what the callbacks compute, note that FunTan is "sin" and FunSin is "tan".
+    float_type FastSin(float_type v)   { return std::sin(v); }
+    float_type FastCos(float_type v)   { return std::cos(v); }
+    float_type FastTan(float_type v)   { return std::tan(v); }
+    float_type FastASin(float_type v)  { return std::asin(v); }
+    float_type FastACos(float_type v)  { return std::acos(v); }
+    float_type FastATan(float_type v)  { return std::atan(v); }
+    float_type FastSinH(float_type v)  { return std::sinh(v); }
+    float_type FastCosH(float_type v)  { return std::cosh(v); }
+    float_type FastTanH(float_type v)  { return std::tanh(v); }
+    float_type FastASinH(float_type v) { return std::log(v + std::sqrt(v * v + 1)); }
+    float_type FastACosH(float_type v) { return std::log(v + std::sqrt(v * v - 1)); }
+    float_type FastATanH(float_type v) { return (0.5 * std::log((1 + v) / (1 - v))); }
+    float_type FastLog(float_type v)   { return std::log(v); }
+    float_type FastLog10(float_type v) { return std::log10(v); }
+    float_type FastLog2(float_type v)  { return std::log(v) * 1.0 / std::log(2.0); }
+    float_type FastSqrt(float_type v)  { return std::sqrt(v); }
+    float_type FastExp(float_type v)   { return std::exp(v); }
+    float_type FastAbs(float_type v)   { return std::fabs(v); }
+
+    /** \brief Same computation as OprtPow::Eval. */
+    float_type FastPow(float_type a, float_type b)
     {
-        Value *pValue = new Value;
-        pValue->BindToCache(&m_cache);
-        m_vStackBuffer[i].Reset(pValue);
+        int ib = (int)b;
+        if (b - ib == 0)
+        {
+            switch (ib)
+            {
+            case 1:  return a;
+            case 2:  return a*a;
+            case 3:  return a*a*a;
+            case 4:  return a*a*a*a;
+            case 5:  return a*a*a*a*a;
+            default: return std::pow(a, ib);
+            }
+        }
+        else
+            return std::pow(a, b);
     }
 
-    m_pParserEngine = &ParserXBase::ParseFromRPN;
+    /** \brief Find the function pointer of a unary callback or return 0. 
+    
+      The callbacks are matched by their exact type, a class derived from 
+      one of them may compute something else.
+    */
+    fun_ptr_type FindFastFun(const IToken *pTok)
+    {
+        static const struct
+        {
+            const std::type_info *Type;
+            float_type (*Fun)(float_type);
+        } s_funTab[] = 
+        {
+            { &typeid(FunTan),   FastSin },
+            { &typeid(FunCos),   FastCos },
+            { &typeid(FunSin),   FastTan },
+            { &typeid(FunASin),  FastASin },
+            { &typeid(FunACos),  FastACos },
+            { &typeid(FunATan),  FastATan },
+            { &typeid(FunSinH),  FastSinH },
+            { &typeid(FunCosH),  FastCosH },
+            { &typeid(FunTanH),  FastTanH },
+            { &typeid(FunASinH), FastASinH },
+            { &typeid(FunACosH), FastACosH },
+            { &typeid(FunATanH), FastATanH },
+            { &typeid(FunLog),   FastLog },
+            { &typeid(FunLn),    FastLog },
+            { &typeid(FunLog10), FastLog10 },
+            { &typeid(FunLog2),  FastLog2 },
+            { &typeid(FunSqrt),  FastSqrt },
+            { &typeid(FunExp),   FastExp },
+            { &typeid(FunAbs),   FastAbs }
+        };
+
+        const std::type_info &type = typeid(*pTok);
+        for (std::size_t i = 0; i < sizeof(s_funTab) / sizeof(s_funTab[0]); ++i)
+        {
+            if (*s_funTab[i].Type == type)
+                return s_funTab[i].Fun;
+        }
 
-    return (this->*m_pParserEngine)();
+        return 0;
+    }
+
+    /** \brief Find the instruction code of a binary or infix operator or 
+               multi argument function or return -1. 
+    */
+    int FindFastOprt(const IToken *pTok, EFastType &eArgType, EFastType &eRetType)
+    {
+        const std::type_info &type = typeid(*pTok);
+
+        eArgType = ftFLOAT;
+        eRetType = ftFLOAT;
+        if (type == typeid(OprtAdd))     return fcADD;
+        if (type == typeid(OprtSub))     return fcSUB;
+        if (type == typeid(OprtMul))     return fcMUL;
+        if (type == typeid(OprtDiv))     return fcDIV;
+        if (type == typeid(OprtPow))     return fcPOW;
+        if (type == typeid(OprtSign))    return fcNEG;
+        if (type == typeid(OprtSignPos)) return fcNOP;
+        if (type == typeid(FunMin))      return fcMIN;
+        if (type == typeid(FunMax))      return fcMAX;
+        if (type == typeid(FunSum))      return fcSUM;
+
+        eRetType = ftBOOL;
+        if (type == typeid(OprtLT))      return fcLT;
+        if (type == typeid(OprtGT))      return fcGT;
+        if (type == typeid(OprtLE))      return fcLE;
+        if (type == typeid(OprtGE))      return fcGE;
+        if (type == typeid(OprtEQ))      return fcEQ;
+        if (type == typeid(OprtNEQ))     return fcNEQ;
+
+        eArgType = ftBOOL;
+        if (type == typeid(OprtLAnd))    return fcLAND;
+        if (type == typeid(OprtLOr))     return fcLOR;
+
+        return -1;
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+/** \brief Translate the RPN into a program working on plain doubles.
+      \return true if the expression is provably real valued.
+
+      A type inference pass over the RPN assigns either float or boolean to 
+      every stack entry. Only constants and variables currently holding 
+      noncomplex scalars, the arithmetic operators and functions of 
+      PackageNonCmplx, min/max/sum and the comparison and logical operators 
+      of PackageCommon are supported. Anything else (strings, matrices, 
+      complex values, assignments, user defined callbacks, multiple 
+      comma separated expressions) keeps the generic RPN engine.
+      */
+bool ParserXBase::CreateFastCode() const
+{
+    m_vFastCode.clear();
+    m_vFastVar.clear();
+
+    const token_vec_type &rpn = m_rpn.GetData();
+    if (rpn.empty())
+        return false;
+
+    std::vector<EFastType> stType;    // static type of each stack entry
+    std::vector<EFastType> stIfType;  // type of the pending if branches
+    std::vector<SFastInstr> vCode(rpn.size());
+    for (std::size_t i = 0; i < rpn.size(); ++i)
+    {
+        const IToken *pTok = rpn[i].Get();
+        SFastInstr &instr = vCode[i];
+        instr.Code = fcNOP;
+        instr.Argc = 0;
+        instr.Offset = 0;
+        instr.Val = 0;
+        instr.Fun = 0;
+
+        switch (pTok->GetCode())
+        {
+        case cmVAL:
+        {
+            const IValue *pVal = static_cast<const IValue*>(pTok);
+            if (pVal->IsVariable())
+            {
+                const IValue *pVar = static_cast<const Variable*>(pVal)->GetPtr();
+                if (pVar == 0 || !pVar->IsNonComplexScalar())
+                    return false;
+
+                std::size_t idx = std::find(m_vFastVar.begin(), m_vFastVar.end(), pVar) - m_vFastVar.begin();
+                if (idx == m_vFastVar.size())
+                    m_vFastVar.push_back(pVar);
+
+                instr.Code = fcVAR;
+                instr.Offset = (int)idx;
+                stType.push_back(ftFLOAT);
+            }
+            else if (pVal->IsNonComplexScalar())
+            {
+                instr.Code = fcVAL;
+                instr.Val = pVal->GetFloat();
+                stType.push_back(ftFLOAT);
+            }
+            else if (pVal->GetType() == 'b')
+            {
+                instr.Code = fcVAL;
+                instr.Val = pVal->GetBool() ? 1 : 0;
+                stType.push_back(ftBOOL);
+            }
+            else
+                return false;
+        }
+        continue;
+
+        case cmOPRT_BIN:
+        case cmOPRT_INFIX:
+        case cmFUNC:
+        {
+            const ICallback *pFun = static_cast<const ICallback*>(pTok);
+            int nArgs = pFun->GetArgsPresent();
+            if (nArgs < 1 || nArgs > (int)stType.size())
+                return false;
+
+            EFastType eArgType = ftFLOAT, 
+                      eRetType = ftFLOAT;
+            fun_ptr_type pFastFun = (nArgs == 1) ? FindFastFun(pTok) : 0;
+            if (pFastFun)
+            {
+                instr.Code = fcFUN;
+                instr.Fun = pFastFun;
+            }
+            else
+            {
+                int nCode = FindFastOprt(pTok, eArgType, eRetType);
+                if (nCode < 0)
+                    return false;
+
+                instr.Code = nCode;
+            }
+
+            instr.Argc = nArgs;
+            for (int j = 0; j < nArgs; ++j)
+            {
+                if (stType.back() != eArgType)
+                    return false;
+
+                stType.pop_back();
+            }
+
+            stType.push_back(eRetType);
+        }
+        continue;
+
+        case cmIF:
+            if (stType.empty() || stType.back() != ftBOOL)
+                return false;
+
+            stType.pop_back();
+            instr.Code = fcIF;
+            instr.Offset = static_cast<const TokenIfThenElse*>(pTok)->GetOffset();
+            continue;
+
+        case cmELSE:
+            if (stType.empty())
+                return false;
+
+            stIfType.push_back(stType.back());
+            stType.pop_back();
+            instr.Code = fcJMP;
+            instr.Offset = static_cast<const TokenIfThenElse*>(pTok)->GetOffset();
+            continue;
+
+        case cmENDIF:
+            if (stIfType.empty() || stType.empty() || stIfType.back() != stType.back())
+                return false;
+
+            stIfType.pop_back();
+            continue;
+
+        default:
+            return false;
+        }
+    }
+
+    if (stType.size() != 1 || !stIfType.empty())
+        return false;
+
+    m_bFastResultIsBool = stType.back() == ftBOOL;
+    m_vFastCode.swap(vCode);
+    m_vFastVarVal.assign(m_vFastVar.size(), 0);
+    m_vFastStack.assign(std::max(m_rpn.GetRequiredStackSize(), 1), 0);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the real valued fast path.
+
+      The variable types were checked when the program was created. Since a 
+      variable may have been assigned a value of a different type since then, 
+      they are checked again and the generic engine is used if one of them 
+      no longer holds a noncomplex scalar.
+      */
+const IValue& ParserXBase::ParseFromFastCode() const
+{
+    for (std::size_t i = 0; i < m_vFastVar.size(); ++i)
+    {
+        const IValue *pVar = m_vFastVar[i];
+        if (!pVar->IsNonComplexScalar())
+            return ParseFromRPN();
+
+        m_vFastVarVal[i] = pVar->GetFloat();
+    }
+
+    const SFastInstr *pCode = &m_vFastCode[0];
+    const float_type *pVar = m_vFastVarVal.empty() ? 0 : &m_vFastVarVal[0];
+    float_type *pStack = &m_vFastStack[0];
+
+    int sidx = -1;
+    std::size_t lenCode = m_vFastCode.size();
+    for (std::size_t i = 0; i < lenCode; ++i)
+    {
+        const SFastInstr &instr = pCode[i];
+        switch (instr.Code)
+        {
+        case fcVAL:  pStack[++sidx] = instr.Val; continue;
+        case fcVAR:  pStack[++sidx] = pVar[instr.Offset]; continue;
+        case fcADD:  --sidx; pStack[sidx] = pStack[sidx] + pStack[sidx + 1]; continue;
+        case fcSUB:  --sidx; pStack[sidx] = pStack[sidx] - pStack[sidx + 1]; continue;
+        case fcMUL:  --sidx; pStack[sidx] = pStack[sidx] * pStack[sidx + 1]; continue;
+        case fcDIV:  --sidx; pStack[sidx] = pStack[sidx] / pStack[sidx + 1]; continue;
+        case fcPOW:  --sidx; pStack[sidx] = FastPow(pStack[sidx], pStack[sidx + 1]); continue;
+        case fcNEG:  pStack[sidx] = -pStack[sidx]; continue;
+        case fcLT:   --sidx; pStack[sidx] = pStack[sidx] <  pStack[sidx + 1]; continue;
+        case fcGT:   --sidx; pStack[sidx] = pStack[sidx] >  pStack[sidx + 1]; continue;
+        case fcLE:   --sidx; pStack[sidx] = pStack[sidx] <= pStack[sidx + 1]; continue;
+        case fcGE:   --sidx; pStack[sidx] = pStack[sidx] >= pStack[sidx + 1]; continue;
+        case fcEQ:   --sidx; pStack[sidx] = pStack[sidx] == pStack[sidx + 1]; continue;
+        case fcNEQ:  --sidx; pStack[sidx] = pStack[sidx] != pStack[sidx + 1]; continue;
+        case fcLAND: --sidx; pStack[sidx] = (pStack[sidx] != 0) && (pStack[sidx + 1] != 0); continue;
+        case fcLOR:  --sidx; pStack[sidx] = (pStack[sidx] != 0) || (pStack[sidx + 1] != 0); continue;
+        case fcFUN:  pStack[sidx] = instr.Fun(pStack[sidx]); continue;
+
+        case fcMIN:
+        case fcMAX:
+        case fcSUM:
+        {
+            sidx -= instr.Argc - 1;
+            const float_type *pArg = &pStack[sidx];
+
+            // Same start values as FunMin, FunMax and FunSum
+            float_type val = (instr.Code == fcMIN) ? 1e30 : (instr.Code == fcMAX) ? -1e30 : 0;
+            for (int j = 0; j < instr.Argc; ++j)
+            {
+                switch (instr.Code)
+                {
+                case fcMIN: val = std::min(val, pArg[j]); break;
+                case fcMAX: val = std::max(val, pArg[j]); break;
+                default:    val += pArg[j]; break;
+                }
+            }
+
+            pStack[sidx] = val;
+        }
+        continue;
+
+        case fcIF:
+            if (pStack[sidx--] == 0)
+                i += instr.Offset;
+            continue;
+
+        case fcJMP:
+            i += instr.Offset;
+            continue;
+
+        case fcNOP:
+            continue;
+
+        default:
+            Error(ecINTERNAL_ERROR);
+        } // switch instruction
+    } // for all instructions
+
+    if (m_bFastResultIsBool)
+        m_valFastResult = (pStack[0] != 0);
+    else
+        m_valFastResult = pStack[0];
+
+    return m_valFastResult;
 }
 
 //---------------------------------------------------------------------------
@@ -1044,7 +1467,7 @@ const IValue& ParserXBase::ParseFromRPN() const
             {
                 ptr_val_type &val = pStack[sidx];
                 if (val->IsVariable())
-                    val.Reset(m_cache.CreateFromCache());
+                    val.Reset(new Value);
 
                 *val = *(static_cast<IValue*>(pTok));
             }
@@ -1064,7 +1487,7 @@ const IValue& ParserXBase::ParseFromRPN() const
       ptr_val_type &val = pStack[sidx];   // Pointer to the variable or value beeing indexed
       if (val->IsVariable())
       {
-      ptr_val_type buf(m_cache.CreateFromCache());
+      ptr_val_type buf(new Value);
       pFun->Eval(buf, &val, nArgs);
       val = buf;
       }
@@ -1104,7 +1527,7 @@ const IValue& ParserXBase::ParseFromRPN() const
             {
                 if (val->IsVariable())
                 {
-                    ptr_val_type buf(m_cache.CreateFromCache());
+                    ptr_val_type buf(new Value);
                     pFun->Eval(buf, &val, nArgs);
                     val = buf;
                 }
@@ -1276,6 +1699,19 @@ void ParserXBase::EnableOptimizer(bool bStat)
     m_rpn.EnableOptimizer(bStat);
 }
 
+//------------------------------------------------------------------------------
+/** \brief Enable or disable the real valued fast path.
+
+      If enabled (the default) expressions that only involve noncomplex 
+      scalars are translated into a program working on plain doubles instead
+      of being evaluated by the generic engine.
+      */
+void ParserXBase::EnableFastPath(bool bStat)
+{
+    m_bFastPath = bStat;
+    ReInit();
+}
+
 //---------------------------------------------------------------------------
 /** \brief Enable the dumping of bytecode amd stack content on the console.
       \param bDumpCmd Flag to enable dumping of the current bytecode to the console.
@@ -1295,6 +1731,12 @@ bool ParserXBase::IsAutoCreateVarEnabled() const
     return m_bAutoCreateVar;
 }
 
+//------------------------------------------------------------------------------
+bool ParserXBase::IsFastPathEnabled() const
+{
+    return m_bFastPath;
+}
+
 //------------------------------------------------------------------------------
 /** \brief Dump stack content.
 
@@ -45,6 +45,7 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "mpIOprt.h"
 #include "mpIValReader.h"
@@ -56,7 +57,6 @@
 #include "mpVariable.h"
 #include "mpTypes.h"
 #include "mpRPN.h"
-#include "mpValueCache.h"
 
 MUP_NAMESPACE_START
   
@@ -74,6 +74,21 @@ MUP_NAMESPACE_START
   private:
 
     typedef const IValue& (ParserXBase::*parse_function_type)() const;  
+    typedef float_type (*fast_fun_type)(float_type);
+
+    /** \brief A single instruction of the real valued fast path.
+    
+      The instructions map one to one onto the RPN tokens so the jump offsets
+      of if-then-else tokens can be taken over unchanged.
+    */
+    struct SFastInstr
+    {
+      int Code;           ///< The instruction code
+      int Argc;           ///< Number of arguments of multi argument functions
+      int Offset;         ///< Jump offset of if-then-else tokens, index of variables
+      float_type Val;     ///< Value of constants
+      fast_fun_type Fun;  ///< Function pointer of unary functions
+    };
     static const char_type *c_DefaultOprt[]; 
     static bool s_bDumpStack;
     static bool s_bDumpRPN;
@@ -138,7 +153,9 @@ MUP_NAMESPACE_START
     
     void EnableAutoCreateVar(bool bStat);
     void EnableOptimizer(bool bStat);
+    void EnableFastPath(bool bStat);
     bool IsAutoCreateVarEnabled() const;
+    bool IsFastPathEnabled() const;
 
     const char_type* ValidNameChars() const;
     const char_type* ValidOprtChars() const;
@@ -179,6 +196,8 @@ MUP_NAMESPACE_START
     void ApplyRemainingOprt(Stack<ptr_tok_type> &a_stOpt) const;
     const IValue& ParseFromString() const; 
     const IValue& ParseFromRPN() const; 
+    const IValue& ParseFromFastCode() const;
+    bool CreateFastCode() const;
 
     /** \brief Pointer to the parser function. 
     
@@ -220,7 +239,14 @@ MUP_NAMESPACE_START
 
     mutable RPN m_rpn;                  ///< reverse polish notation
     mutable val_vec_type m_vStackBuffer;
-    mutable ValueCache m_cache;         ///< A cache for recycling value items instead of deleting them
+
+    bool m_bFastPath;                                 ///< If this flag is set real valued expressions are evaluated by the fast path
+    mutable std::vector<SFastInstr> m_vFastCode;      ///< Double only program created from the RPN
+    mutable std::vector<const IValue*> m_vFastVar;    ///< Values bound to the variables used by the fast path
+    mutable std::vector<float_type> m_vFastVarVal;    ///< Variable values of the current evaluation
+    mutable std::vector<float_type> m_vFastStack;     ///< Stack of the fast path
+    mutable Value m_valFastResult;                    ///< Result of the fast path
+    mutable bool m_bFastResultIsBool;                 ///< True if the fast path computes a boolean
 
   };
 } // namespace mu
@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "mpValue.h"
 #include "mpError.h"
 #include "mpValueCache.h"
+#include "mpValuePool.h"
 
 
 MUP_NAMESPACE_START
@@ -776,6 +777,18 @@ void Value::BindToCache(ValueCache *pCache)
     m_pCache = pCache;
 }
 
+//-----------------------------------------------------------------------------------------------
+void* Value::operator new(std::size_t size)
+{
+    return ValuePool::Allocate(size);
+}
+
+//-----------------------------------------------------------------------------------------------
+void Value::operator delete(void *p)
+{
+    ValuePool::Deallocate(p);
+}
+
 //-----------------------------------------------------------------------------------------------
 Value::operator cmplx_type ()
 {
@@ -112,6 +112,10 @@ MUP_NAMESPACE_START
 
     virtual string_type AsciiDump() const;
     void BindToCache(ValueCache *pCache);
+
+    // Value items are allocated from the thread local ValuePool
+    static void* operator new(std::size_t size);
+    static void operator delete(void *p);
 	
     // Conversion operators
     operator cmplx_type();
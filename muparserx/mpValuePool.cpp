@@ -0,0 +1,323 @@
+/** \file
+    \brief Definition of a thread local allocator for value items.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2013 Ingo Berg
+                                       All rights reserved.
+
+  muParserX - A C++ math parser library with array and string support
+  Copyright (c) 2013, Ingo Berg
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpValuePool.h"
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+
+MUP_NAMESPACE_START
+
+  namespace
+  {
+    class ThreadPool;
+
+    //------------------------------------------------------------------------------
+    /** \brief Header in front of every block handed out by the pool. 
+    
+      The next pointer is only used while the block is free, it overlays
+      the first bytes of the block.
+    */
+    struct Block
+    {
+      ThreadPool *Owner;   ///< Pool the block is returned to, nullptr for unpooled blocks
+      std::size_t Class;   ///< Size class of the block
+      Block *Next;         ///< Next free block
+    };
+
+    const std::size_t c_nHeader      = offsetof(Block, Next);
+    const std::size_t c_nGranularity = 16;  ///< Step between the size classes
+    const std::size_t c_nClasses     = 16;  ///< Number of size classes, larger blocks are not pooled
+
+    //------------------------------------------------------------------------------
+    /** \brief Increment a counter that is only written by the owning thread. 
+    
+      The counters are atomic only so that GetStats may read them while
+      they are modified. There is a single writer, a relaxed load and store 
+      avoids the cost of a locked read-modify-write.
+    */
+    inline void Add(std::atomic<std::size_t> &counter, std::size_t n)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------------
+    /** \brief The pool of a single thread. */
+    class ThreadPool
+    {
+    public:
+      ThreadPool()
+        :m_pRemote(nullptr)
+        ,m_nHits(0)
+        ,m_nMisses(0)
+        ,m_nRemoteFrees(0)
+        ,m_nLive(0)
+        ,m_nPeakLive(0)
+        ,m_nBytes(0)
+      {
+        std::fill(m_pFree, m_pFree + c_nClasses, (Block*)nullptr);
+      }
+
+      void* Allocate(std::size_t nClass)
+      {
+        if (m_pFree[nClass] == nullptr)
+          CollectRemote();
+
+        Block *pBlock = m_pFree[nClass];
+        if (pBlock)
+        {
+          m_pFree[nClass] = pBlock->Next;
+          Add(m_nHits, 1);
+        }
+        else
+        {
+          std::size_t nBytes = c_nHeader + (nClass + 1) * c_nGranularity;
+          pBlock = static_cast<Block*>(::operator new(nBytes));
+          pBlock->Owner = this;
+          pBlock->Class = nClass;
+          Add(m_nMisses, 1);
+          Add(m_nBytes, nBytes);
+        }
+
+        Add(m_nLive, 1);
+        if (m_nLive.load(std::memory_order_relaxed) > m_nPeakLive.load(std::memory_order_relaxed))
+          m_nPeakLive.store(m_nLive.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        return reinterpret_cast<char*>(pBlock) + c_nHeader;
+      }
+
+      /** \brief Return a block, must only be called by the owning thread. */
+      void Free(Block *pBlock)
+      {
+        pBlock->Next = m_pFree[pBlock->Class];
+        m_pFree[pBlock->Class] = pBlock;
+        Add(m_nLive, (std::size_t)-1);
+      }
+
+      /** \brief Return a block from any other thread. 
+      
+        Only the owner takes blocks from the list and it always takes all 
+        of them at once, so the push can't suffer from the ABA problem.
+      */
+      void FreeRemote(Block *pBlock)
+      {
+        Block *pHead = m_pRemote.load(std::memory_order_relaxed);
+        do
+        {
+          pBlock->Next = pHead;
+        } 
+        while (!m_pRemote.compare_exchange_weak(pHead, pBlock, std::memory_order_release, std::memory_order_relaxed));
+      }
+
+      void AddStats(ValuePoolStats &stats) const
+      {
+        stats.hits        += m_nHits.load(std::memory_order_relaxed);
+        stats.misses      += m_nMisses.load(std::memory_order_relaxed);
+        stats.remoteFrees += m_nRemoteFrees.load(std::memory_order_relaxed);
+        stats.live        += m_nLive.load(std::memory_order_relaxed);
+        stats.peakLive    += m_nPeakLive.load(std::memory_order_relaxed);
+        stats.bytes       += m_nBytes.load(std::memory_order_relaxed);
+        stats.pools       += 1;
+      }
+
+    private:
+      void CollectRemote()
+      {
+        Block *pBlock = m_pRemote.exchange(nullptr, std::memory_order_acquire);
+        while (pBlock)
+        {
+          Block *pNext = pBlock->Next;
+          Free(pBlock);
+          Add(m_nRemoteFrees, 1);
+          pBlock = pNext;
+        }
+      }
+
+      Block *m_pFree[c_nClasses];             ///< Free lists, one per size class
+      std::atomic<Block*> m_pRemote;          ///< Blocks freed by other threads
+      std::atomic<std::size_t> m_nHits;
+      std::atomic<std::size_t> m_nMisses;
+      std::atomic<std::size_t> m_nRemoteFrees;
+      std::atomic<std::size_t> m_nLive;
+      std::atomic<std::size_t> m_nPeakLive;
+      std::atomic<std::size_t> m_nBytes;
+    };
+
+    //------------------------------------------------------------------------------
+    /** \brief All pools ever created and the ones no thread is using. */
+    struct Registry
+    {
+      std::mutex Mtx;
+      std::vector<ThreadPool*> All;
+      std::vector<ThreadPool*> Idle;
+    };
+
+    /** \brief The registry is intentionally never destroyed, values may be
+               released during the destruction of static objects. 
+    */
+    Registry& GetRegistry()
+    {
+      static Registry *pRegistry = new Registry;
+      return *pRegistry;
+    }
+
+    // Trivially destructible, so they remain accessible while the thread exits.
+    thread_local ThreadPool *t_pPool = nullptr;
+    thread_local bool t_bExited = false;
+
+    //------------------------------------------------------------------------------
+    /** \brief Hands the pool of a finishing thread to the registry. */
+    struct ThreadExit
+    {
+      void Register() {}
+
+      ~ThreadExit()
+      {
+        if (t_pPool)
+        {
+          Registry &reg = GetRegistry();
+          std::lock_guard<std::mutex> lock(reg.Mtx);
+          reg.Idle.push_back(t_pPool);
+        }
+
+        t_pPool = nullptr;
+        t_bExited = true;
+      }
+    };
+
+    thread_local ThreadExit t_exit;
+
+    //------------------------------------------------------------------------------
+    /** \brief Return the pool of the calling thread, nullptr if the thread is exiting. */
+    ThreadPool* GetThreadPool()
+    {
+      if (t_pPool || t_bExited)
+        return t_pPool;
+
+      Registry &reg = GetRegistry();
+      {
+        std::lock_guard<std::mutex> lock(reg.Mtx);
+        if (reg.Idle.size())
+        {
+          t_pPool = reg.Idle.back();
+          reg.Idle.pop_back();
+        }
+        else
+        {
+          t_pPool = new ThreadPool;
+          reg.All.push_back(t_pPool);
+        }
+      }
+
+      t_exit.Register();
+      return t_pPool;
+    }
+  } // anonymous namespace
+
+  //------------------------------------------------------------------------------
+  ValuePoolStats::ValuePoolStats()
+    :hits(0)
+    ,misses(0)
+    ,remoteFrees(0)
+    ,live(0)
+    ,peakLive(0)
+    ,bytes(0)
+    ,pools(0)
+  {}
+
+  //------------------------------------------------------------------------------
+  /** \brief Allocate a block of memory from the pool of the calling thread. 
+  
+    Blocks larger than the biggest size class and blocks requested by
+    an exiting thread come directly from operator new.
+  */
+  void* ValuePool::Allocate(std::size_t size)
+  {
+    std::size_t nClass = (std::max(size, (std::size_t)1) + c_nGranularity - 1) / c_nGranularity - 1;
+
+    ThreadPool *pPool = (nClass < c_nClasses) ? GetThreadPool() : nullptr;
+    if (pPool)
+      return pPool->Allocate(nClass);
+
+    Block *pBlock = static_cast<Block*>(::operator new(c_nHeader + size));
+    pBlock->Owner = nullptr;
+    pBlock->Class = c_nClasses;
+    return reinterpret_cast<char*>(pBlock) + c_nHeader;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Return a block to the pool that allocated it. */
+  void ValuePool::Deallocate(void *p)
+  {
+    if (p == nullptr)
+      return;
+
+    Block *pBlock = reinterpret_cast<Block*>(static_cast<char*>(p) - c_nHeader);
+    ThreadPool *pOwner = pBlock->Owner;
+    if (pOwner == nullptr)
+      ::operator delete(pBlock);
+    else if (pOwner == t_pPool)
+      pOwner->Free(pBlock);
+    else
+      pOwner->FreeRemote(pBlock);
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Return the counters summed over all thread pools. 
+  
+    The counters are read while other threads may be allocating, the 
+    result is a consistent snapshot of each single counter only.
+  */
+  ValuePoolStats ValuePool::GetStats()
+  {
+    ValuePoolStats stats;
+
+    Registry &reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.Mtx);
+    for (std::size_t i = 0; i < reg.All.size(); ++i)
+      reg.All[i]->AddStats(stats);
+
+    return stats;
+  }
+
+MUP_NAMESPACE_END
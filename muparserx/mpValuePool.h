@@ -0,0 +1,93 @@
+#ifndef MUP_VALUE_POOL_H
+#define MUP_VALUE_POOL_H
+
+/** \file
+    \brief Implementation of a thread local allocator for value items.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2013 Ingo Berg
+                                       All rights reserved.
+
+  muParserX - A C++ math parser library with array and string support
+  Copyright (c) 2013, Ingo Berg
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include <cstddef>
+
+#include "mpFwdDecl.h"
+
+
+MUP_NAMESPACE_START
+
+  //------------------------------------------------------------------------------
+  /** \brief Counters of the value pools of all threads. */
+  struct ValuePoolStats
+  {
+    ValuePoolStats();
+
+    std::size_t hits;         ///< Allocations served from a free list
+    std::size_t misses;       ///< Allocations that requested memory from the system
+    std::size_t remoteFrees;  ///< Blocks released by a thread other than the one that allocated them
+    std::size_t live;         ///< Blocks in use (remote frees count once their owner has collected them)
+    std::size_t peakLive;     ///< Sum of the peak number of live blocks of each pool
+    std::size_t bytes;        ///< Memory requested from the system including the block headers
+    std::size_t pools;        ///< Number of thread pools
+  };
+
+  //------------------------------------------------------------------------------
+  /** \brief A thread local allocator with size classes for value items.
+
+    Value objects are allocated from this pool. Each thread allocates from
+    a pool of its own without any locking, so all parser instances of a 
+    thread share their memory instead of each keeping a cache of its own.
+    
+    A freed block goes back to the pool that allocated it. If another thread 
+    frees it, the block is pushed onto a lock free list of the owning pool, 
+    which the owner collects once it runs out of blocks. Hence values may
+    be created in one thread and released in another.
+
+    Memory is never returned to the system. The pool of a finished thread
+    is handed over to the next thread asking for one, so the memory held is
+    bounded by the peak usage of the threads running at the same time.
+  */
+  class ValuePool
+  {
+  public:
+    static void* Allocate(std::size_t size);
+    static void Deallocate(void *p);
+    static ValuePoolStats GetStats();
+
+  private:
+    ValuePool();
+  };
+
+MUP_NAMESPACE_END
+
+#endif // include guard
@@ -2,16 +2,26 @@
 
 //#include <windows.h>
 #include <cmath>
+#include <memory>
+#include <stdexcept>
+
+#include "MemoryCounter.h"
+#include "Stopwatch.h"
 
 // atmsp
 #include "atmsp/atmsp.h"
 
 
 //-------------------------------------------------------------------------------------------------
-BenchATMSP::BenchATMSP()
+/** \brief Create the benchmark.
+    \param bFused Evaluate with ATMSB_FUSED, the superinstruction engine, instead of the
+                  member function pointers of ATMSB.
+*/
+BenchATMSP::BenchATMSP(bool bFused)
 : Benchmark()
+, m_bFused(bFused)
 {
-   m_sName = "atmsp 1.0.4";
+   m_sName = (bFused) ? "atmsp 1.0.4 (fused)" : "atmsp 1.0.4";
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -33,19 +43,10 @@ std::string BenchATMSP::replaceAll(std::string result,
    return result;
 }
 
-//-------------------------------------------------------------------------------------------------
-void BenchATMSP::PreprocessExpr(std::vector<std::string>& vExpr)
-{
-   // atmsp is using $ to mark a constant
-   for (std::size_t i = 0; i < vExpr.size(); ++i)
-   {
-      PreprocessExpr(vExpr[i]);
-   }
-}
-
 //-------------------------------------------------------------------------------------------------
 void BenchATMSP::PreprocessExpr(std::string& s)
 {
+   // atmsp is using $ to mark a constant
    s = replaceAll(s, std::string("pi"),  std::string("$pi"));
    s = replaceAll(s, std::string("-e*"), std::string("-$e*"));
    s = replaceAll(s, std::string("/e*"), std::string("/$e*"));
@@ -69,6 +70,9 @@ void BenchATMSP::PreprocessExpr(std::string& s)
 //-------------------------------------------------------------------------------------------------
 double BenchATMSP::DoBenchmark(const std::string& sExpr, long iCount)
 {
+   if (m_bFused)
+      return DoBenchmarkFused(sExpr, iCount);
+
    ATMSB<double> bc;
 
    // Parsing/bytecode generation with error check. In a scope here JUST to
@@ -112,3 +116,362 @@ double BenchATMSP::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Parse with the unchanged ATMSP front end and run the fused form of the bytecode. */
+double BenchATMSP::DoBenchmarkFused(const std::string& sExpr, long iCount)
+{
+   ATMSB_FUSED<double> prog;
+   ATMSP<double> p;
+
+   unsigned int err = p.parse(prog, sExpr, "a, b, c, x, y, z, w");
+
+   if (err)
+   {
+      StopTimerAndReport(p.errMessage(err));
+   }
+   else
+   {
+      double var[7] = { 1.1, 2.2, 3.3, 2.123456, 3.123456, 4.123456, 5.123456 };
+      ATMSP_CONTEXT<double> ctx;
+
+      double fRes (0);
+      double fSum (0);
+
+      fRes = prog.run(var, ctx);
+
+      StartTimer();
+
+      for (int j = 0; j < iCount; ++j)
+      {
+         fSum += prog.run(var, ctx);
+         std::swap(var[0], var[1]);
+         std::swap(var[3], var[4]);
+      }
+
+      StopTimer(fRes, fSum, iCount);
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief The fused program evaluates rows of variables in one call, the columns are
+           interleaved into rows before the timer starts. ATMSB has no bulk interface,
+           every row is copied into the bytecode's variables.
+*/
+double BenchATMSP::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   if (m_bFused)
+      return DoBenchmarkBatchFused(sExpr, cols);
+
+   ATMSB<double> bc;
+   ATMSP<double> p;
+
+   unsigned int err = p.parse(bc, sExpr, "a, b, c, x, y, z, w");
+
+   if (err)
+   {
+      StopTimerAndReport(p.errMessage(err));
+   }
+   else
+   {
+      bc.var[0] = cols.a[0];
+      bc.var[1] = cols.b[0];
+      bc.var[2] = cols.c[0];
+      bc.var[3] = cols.x[0];
+      bc.var[4] = cols.y[0];
+      bc.var[5] = cols.z[0];
+      bc.var[6] = cols.w[0];
+
+      double fRes (0);
+      double fSum (0);
+
+      fRes = bc.run();
+
+      StartTimer();
+
+      for (long i = 0; i < cols.rows; ++i)
+      {
+         bc.var[0] = cols.a[i];
+         bc.var[1] = cols.b[i];
+         bc.var[2] = cols.c[i];
+         bc.var[3] = cols.x[i];
+         bc.var[4] = cols.y[i];
+         bc.var[5] = cols.z[i];
+         bc.var[6] = cols.w[i];
+         fSum += bc.run();
+      }
+
+      StopTimer(fRes, fSum, cols.rows);
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchATMSP::DoBenchmarkBatchFused(const std::string& sExpr, const BatchColumns &cols)
+{
+   ATMSB_FUSED<double> prog;
+   ATMSP<double> p;
+
+   unsigned int err = p.parse(prog, sExpr, "a, b, c, x, y, z, w");
+
+   if (err)
+   {
+      StopTimerAndReport(p.errMessage(err));
+      return m_fTime1;
+   }
+
+   const long nRows = cols.rows;
+   std::vector<double> vRows(nRows * 7);
+   std::vector<double> vResult(nRows);
+
+   for (long i = 0; i < nRows; ++i)
+   {
+      double *pRow = &vRows[i * 7];
+      pRow[0] = cols.a[i];
+      pRow[1] = cols.b[i];
+      pRow[2] = cols.c[i];
+      pRow[3] = cols.x[i];
+      pRow[4] = cols.y[i];
+      pRow[5] = cols.z[i];
+      pRow[6] = cols.w[i];
+   }
+
+   StartTimer();
+
+   prog.run(&vRows[0], nRows, &vResult[0]);
+
+   double fSum(0);
+   for (long i = 0; i < nRows; ++i)
+   {
+      fSum += vResult[i];
+   }
+
+   StopTimer(vResult[0], fSum, nRows);
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchATMSP::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   if (m_bFused)
+   {
+      // The fused program is immutable: all threads share one, each with its own
+      // variables and execution context.
+      ATMSB_FUSED<double> prog;
+      ATMSP<double> p;
+
+      unsigned int err = p.parse(prog, sExpr, "a, b, c, x, y, z, w");
+
+      if (err)
+      {
+         StopTimerAndReport(p.errMessage(err));
+         return m_fTime1;
+      }
+
+      return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+      {
+         double var[7] = { 1.1, 2.2, 3.3, 2.123456, 3.123456, 4.123456, 5.123456 };
+         ATMSP_CONTEXT<double> ctx;
+
+         double fSum = 0;
+
+         fRes = prog.run(var, ctx);
+
+         gate.Arrive();
+
+         for (long j = 0; j < iCount; ++j)
+         {
+            fSum += prog.run(var, ctx);
+            std::swap(var[0], var[1]);
+            std::swap(var[3], var[4]);
+         }
+
+         return fSum;
+      });
+   }
+
+   // The bytecode object holds variables and stack, and its value table points into the
+   // object itself, so it can neither be shared nor copied: every thread parses its own.
+   return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+   {
+      ATMSB<double> bc;
+      ATMSP<double> p;
+
+      unsigned int err = p.parse(bc, sExpr, "a, b, c, x, y, z, w");
+
+      if (err)
+         throw std::runtime_error(p.errMessage(err));
+
+      bc.var[0] = 1.1;
+      bc.var[1] = 2.2;
+      bc.var[2] = 3.3;
+      bc.var[3] = 2.123456;
+      bc.var[4] = 3.123456;
+      bc.var[5] = 4.123456;
+      bc.var[6] = 5.123456;
+
+      double fSum = 0;
+
+      fRes = bc.run();
+
+      gate.Arrive();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += bc.run();
+         std::swap(bc.var[0], bc.var[1]);
+         std::swap(bc.var[3], bc.var[4]);
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchATMSP::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   ATMSB<double> bc;
+   ATMSB_FUSED<double> prog;
+   ATMSP<double> p;
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      unsigned int err = (m_bFused) ? p.parse(prog, sExpr, "a, b, c, x, y, z, w")
+                                    : p.parse(bc, sExpr, "a, b, c, x, y, z, w");
+
+      if (err)
+         return StopCompileTimerAndReport(p.errMessage(err));
+   }
+
+   return StopCompileTimer(iCount);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Hold all formulas of vExpr compiled at the same time.
+
+  An ATMSB carries fixed size operator, value and stack arrays plus its variables, so every
+  formula is a separate heap object of several KB. A fused program only holds its
+  instructions; variables and stack live in an ATMSP_CONTEXT per thread, counted once here.
+
+  Compiling is timed with the heap counter off. The formulas are then compiled a second time
+  with the counter on, and the bytes still held afterwards are reported; allocations of the
+  parser that are freed again are not part of the footprint.
+*/
+FootprintResult BenchATMSP::DoFootprintBenchmark(const std::vector<std::string>& vExpr)
+{
+   FootprintResult res;
+   res.supported = true;
+   res.formulas  = vExpr.size();
+
+   const double var[7] = { 1.1, 2.2, 3.3, 2.123456, 3.123456, 4.123456, 5.123456 };
+
+   ATMSP<double> p;
+   Stopwatch timer;
+
+   if (m_bFused)
+   {
+      auto compile = [&](std::vector<ATMSB_FUSED<double>> &vProg)
+      {
+         std::size_t nFailed = 0;
+         vProg.reserve(vExpr.size());
+
+         for (std::size_t i = 0; i < vExpr.size(); ++i)
+         {
+            vProg.push_back(ATMSB_FUSED<double>());
+
+            if (p.parse(vProg.back(), vExpr[i], "a, b, c, x, y, z, w"))
+            {
+               vProg.pop_back();
+               ++nFailed;
+            }
+         }
+
+         return nFailed;
+      };
+
+      timer.Start();
+
+      std::unique_ptr<ATMSP_CONTEXT<double>> pCtx(new ATMSP_CONTEXT<double>);
+      std::vector<ATMSB_FUSED<double>> vProg;
+      res.failed = compile(vProg);
+
+      res.compileTime = timer.Stop();
+
+      timer.Start();
+
+      for (std::size_t i = 0; i < vProg.size(); ++i)
+      {
+         res.sum += vProg[i].run(var, *pCtx);
+      }
+
+      res.evalTime = timer.Stop();
+
+      MemoryCounter::Start();
+      {
+         std::unique_ptr<ATMSP_CONTEXT<double>> pCountedCtx(new ATMSP_CONTEXT<double>);
+         std::vector<ATMSB_FUSED<double>> vCounted;
+         compile(vCounted);
+         res.bytes = MemoryCounter::Current();
+      }
+      MemoryCounter::Stop();
+   }
+   else
+   {
+      auto compile = [&](std::vector<std::unique_ptr<ATMSB<double>>> &vByteCode)
+      {
+         std::size_t nFailed = 0;
+         vByteCode.reserve(vExpr.size());
+
+         for (std::size_t i = 0; i < vExpr.size(); ++i)
+         {
+            vByteCode.emplace_back(new ATMSB<double>);
+
+            if (p.parse(*vByteCode.back(), vExpr[i], "a, b, c, x, y, z, w"))
+            {
+               vByteCode.pop_back();
+               ++nFailed;
+            }
+         }
+
+         return nFailed;
+      };
+
+      timer.Start();
+
+      std::vector<std::unique_ptr<ATMSB<double>>> vByteCode;
+      res.failed = compile(vByteCode);
+
+      res.compileTime = timer.Stop();
+
+      timer.Start();
+
+      for (std::size_t i = 0; i < vByteCode.size(); ++i)
+      {
+         ATMSB<double> &bc = *vByteCode[i];
+         for (int j = 0; j < 7; ++j)
+         {
+            bc.var[j] = var[j];
+         }
+
+         res.sum += bc.run();
+      }
+
+      res.evalTime = timer.Stop();
+
+      MemoryCounter::Start();
+      {
+         std::vector<std::unique_ptr<ATMSB<double>>> vCounted;
+         compile(vCounted);
+         res.bytes = MemoryCounter::Current();
+      }
+      MemoryCounter::Stop();
+   }
+
+   return res;
+}
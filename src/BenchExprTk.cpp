@@ -1,20 +1,66 @@
 #include "BenchExprTk.h"
 
 #include <cmath>
+#include <stdexcept>
+
+#include "MemoryCounter.h"
+#include "Stopwatch.h"
 
 #include "exprtk/exprtk.hpp"
 
 
+namespace
+{
+   typedef exprtk::parser<double> parser_t;
+
+   parser_t::settings_t ParserSettings(BenchExprTk::EMode eMode)
+   {
+      parser_t::settings_t settings;
+
+      if (eMode == BenchExprTk::ARENA)
+         settings.enable_node_arena();
+
+      return settings;
+   }
+
+   /** \brief In FLAT and BATCH mode evaluate through the linear program instead of the node tree. */
+   void Prepare(BenchExprTk::EMode eMode, exprtk::expression<double> &expression)
+   {
+      if (eMode == BenchExprTk::FLAT || eMode == BenchExprTk::BATCH)
+         expression.flatten();
+   }
+}
+
+
 //-------------------------------------------------------------------------------------------------
-BenchExprTk::BenchExprTk()
+/** \brief Create the benchmark.
+
+  With MEMO the evaluation loop goes through a MemoCache, with ARENA the parser allocates
+  all nodes of an expression from one arena owned by the expression. FLAT evaluates the
+  expressions ExprTk can linearize as a register program, the others as a tree. BATCH
+  evaluates all rows in one call like the muparser bulk mode, see DoBenchmarkBatch.
+*/
+BenchExprTk::BenchExprTk(EMode eMode)
 : Benchmark()
+, m_eMode(eMode)
 {
-   m_sName = "ExprTk";
+   switch (eMode)
+   {
+      case MEMO:  m_sName = "ExprTk (memo)";  break;
+      case ARENA: m_sName = "ExprTk (arena)"; break;
+      case FLAT:  m_sName = "ExprTk (flat)";  break;
+      case BATCH: m_sName = "ExprTk (batch)"; break;
+      default:    m_sName = "ExprTk";         break;
+   }
 }
 
 //-------------------------------------------------------------------------------------------------
 double BenchExprTk::DoBenchmark(const std::string& sExpr, long iCount)
 {
+   // The rows of the batch are the values the loop below would use.
+   if (m_eMode == BATCH)
+      return DoBenchmarkBatch(sExpr, BatchColumns(iCount));
+
    double a = 1.1;
    double b = 2.2;
    double c = 3.3;
@@ -42,8 +88,14 @@ double BenchExprTk::DoBenchmark(const std::string& sExpr, long iCount)
 
    expression.register_symbol_table(symbol_table);
 
+   MemoCache cache;
+
+   const bool bMemo = (m_eMode == MEMO);
+
    {
-      exprtk::parser<double> parser;
+      parser_t parser(ParserSettings(m_eMode));
+      parser.dec().collect_variables() = bMemo;
+
       if (!parser.compile(sExpr,expression))
       {
          StopTimer(std::numeric_limits<double>::quiet_NaN(),
@@ -51,6 +103,24 @@ double BenchExprTk::DoBenchmark(const std::string& sExpr, long iCount)
                    1);
          return std::numeric_limits<double>::quiet_NaN();
       }
+
+      if (bMemo)
+      {
+         // The cache key consists of the variables the expression references.
+         std::vector<parser_t::dependent_entity_collector::symbol_t> vSymbols;
+         parser.dec().symbols(vSymbols);
+
+         std::vector<const double*> vVars;
+         for (std::size_t i = 0; i < vSymbols.size(); ++i)
+         {
+            if (vSymbols[i].second == parser_t::e_st_variable)
+               vVars.push_back(&symbol_table.get_variable(vSymbols[i].first)->ref());
+         }
+
+         cache.Bind(vVars);
+      }
+
+      Prepare(m_eMode, expression);
    }
 
    // Calculate/bench and show result finally
@@ -59,6 +129,23 @@ double BenchExprTk::DoBenchmark(const std::string& sExpr, long iCount)
 
    fRes = expression.value();
 
+   if (bMemo)
+   {
+      StartTimer();
+
+      for (int j = 0; j < iCount; ++j)
+      {
+         fSum += cache.Eval([&]() { return expression.value(); });
+         std::swap(a,b);
+         std::swap(x,y);
+      }
+
+      StopTimer(fRes, fSum, iCount);
+      AddMemoStats(cache);
+
+      return m_fTime1;
+   }
+
    StartTimer();
 
    for (int j = 0; j < iCount; ++j)
@@ -72,3 +159,386 @@ double BenchExprTk::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluate all rows of cols.
+
+  In BATCH mode the variables are bound to the columns and expression.value(columns, ...)
+  evaluates the rows in tiles. The other modes copy every row into the bound variables.
+*/
+double BenchExprTk::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   double a = cols.a[0];
+   double b = cols.b[0];
+   double c = cols.c[0];
+   double x = cols.x[0];
+   double y = cols.y[0];
+   double z = cols.z[0];
+   double w = cols.w[0];
+
+   exprtk::symbol_table<double> symbol_table;
+   exprtk::expression<double> expression;
+
+   symbol_table.add_variable("a", a);
+   symbol_table.add_variable("b", b);
+   symbol_table.add_variable("c", c);
+
+   symbol_table.add_variable("x", x);
+   symbol_table.add_variable("y", y);
+   symbol_table.add_variable("z", z);
+   symbol_table.add_variable("w", w);
+
+   static double e = exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   expression.register_symbol_table(symbol_table);
+
+   {
+      parser_t parser(ParserSettings(m_eMode));
+      if (!parser.compile(sExpr,expression))
+      {
+         StopTimerAndReport(parser.error());
+         return std::numeric_limits<double>::quiet_NaN();
+      }
+
+      Prepare(m_eMode, expression);
+   }
+
+   double fRes = expression.value();
+   double fSum = 0;
+
+   if (m_eMode == BATCH)
+   {
+      std::vector<double*> vVars = { &a, &b, &c, &x, &y, &z, &w };
+      const double *pCols[]      = { &cols.a[0], &cols.b[0], &cols.c[0], &cols.x[0],
+                                     &cols.y[0], &cols.z[0], &cols.w[0] };
+
+      std::vector<double> vResult(cols.rows);
+      expression.bind_columns(vVars);
+
+      StartTimer();
+
+      expression.value(pCols, &vResult[0], (std::size_t)cols.rows);
+
+      for (long i = 0; i < cols.rows; ++i)
+      {
+         fSum += vResult[i];
+      }
+
+      StopTimer(fRes, fSum, cols.rows);
+
+      return m_fTime1;
+   }
+
+   StartTimer();
+
+   for (long i = 0; i < cols.rows; ++i)
+   {
+      a = cols.a[i];
+      b = cols.b[i];
+      c = cols.c[i];
+      x = cols.x[i];
+      y = cols.y[i];
+      z = cols.z[i];
+      w = cols.w[i];
+      fSum += expression.value();
+   }
+
+   StopTimer(fRes, fSum, cols.rows);
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchExprTk::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   // In batch mode all threads read the same columns.
+   const BatchColumns cols(m_eMode == BATCH ? iCount : 0);
+
+   // An expression is bound to the variables of its symbol table, so every thread
+   // compiles its own expression against its own variables.
+   return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+   {
+      double a = 1.1;
+      double b = 2.2;
+      double c = 3.3;
+      double x = 2.123456;
+      double y = 3.123456;
+      double z = 4.123456;
+      double w = 5.123456;
+      double e = exprtk::details::numeric::constant::e;
+
+      exprtk::symbol_table<double> symbol_table;
+      exprtk::expression<double> expression;
+
+      symbol_table.add_variable("a", a);
+      symbol_table.add_variable("b", b);
+      symbol_table.add_variable("c", c);
+
+      symbol_table.add_variable("x", x);
+      symbol_table.add_variable("y", y);
+      symbol_table.add_variable("z", z);
+      symbol_table.add_variable("w", w);
+
+      symbol_table.add_variable("e", e, true);
+
+      symbol_table.add_constants();
+
+      expression.register_symbol_table(symbol_table);
+
+      {
+         parser_t parser(ParserSettings(m_eMode));
+         if (!parser.compile(sExpr,expression))
+            throw std::runtime_error(parser.error());
+
+         Prepare(m_eMode, expression);
+      }
+
+      double fSum = 0;
+
+      fRes = expression.value();
+
+      if (m_eMode == BATCH)
+      {
+         std::vector<double*> vVars = { &a, &b, &c, &x, &y, &z, &w };
+         const double *pCols[]      = { &cols.a[0], &cols.b[0], &cols.c[0], &cols.x[0],
+                                        &cols.y[0], &cols.z[0], &cols.w[0] };
+
+         std::vector<double> vResult(cols.rows);
+         expression.bind_columns(vVars);
+
+         gate.Arrive();
+
+         expression.value(pCols, &vResult[0], (std::size_t)cols.rows);
+
+         for (long j = 0; j < cols.rows; ++j)
+         {
+            fSum += vResult[j];
+         }
+
+         return fSum;
+      }
+
+      gate.Arrive();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += expression.value();
+         std::swap(a,b);
+         std::swap(x,y);
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchExprTk::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   double a = 1.1;
+   double b = 2.2;
+   double c = 3.3;
+   double x = 2.123456;
+   double y = 3.123456;
+   double z = 4.123456;
+   double w = 5.123456;
+
+   exprtk::symbol_table<double> symbol_table;
+
+   symbol_table.add_variable("a", a);
+   symbol_table.add_variable("b", b);
+   symbol_table.add_variable("c", c);
+
+   symbol_table.add_variable("x", x);
+   symbol_table.add_variable("y", y);
+   symbol_table.add_variable("z", z);
+   symbol_table.add_variable("w", w);
+
+   static double e = exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   // The parser is reused, as an application compiling many formulas would do.
+   parser_t parser(ParserSettings(m_eMode));
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      exprtk::expression<double> expression;
+      expression.register_symbol_table(symbol_table);
+
+      if (!parser.compile(sExpr,expression))
+         return StopCompileTimerAndReport(parser.error());
+
+      Prepare(m_eMode, expression);
+   }
+
+   return StopCompileTimer(iCount);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compiled expression owning the variables it is bound to. */
+struct BenchExprTk::CachedExpr
+{
+   double a, b, c, x, y, z, w;
+   exprtk::symbol_table<double> symbol_table;
+   exprtk::expression<double> expression;
+};
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compile function of the expression cache, runs outside the cache lock. */
+std::shared_ptr<BenchExprTk::CachedExpr> BenchExprTk::CompileCached(const std::string& sExpr) const
+{
+   std::shared_ptr<CachedExpr> pEntry = std::make_shared<CachedExpr>();
+   pEntry->a = 1.1;
+   pEntry->b = 2.2;
+   pEntry->c = 3.3;
+   pEntry->x = 2.123456;
+   pEntry->y = 3.123456;
+   pEntry->z = 4.123456;
+   pEntry->w = 5.123456;
+
+   exprtk::symbol_table<double> &symbol_table = pEntry->symbol_table;
+   symbol_table.add_variable("a", pEntry->a);
+   symbol_table.add_variable("b", pEntry->b);
+   symbol_table.add_variable("c", pEntry->c);
+
+   symbol_table.add_variable("x", pEntry->x);
+   symbol_table.add_variable("y", pEntry->y);
+   symbol_table.add_variable("z", pEntry->z);
+   symbol_table.add_variable("w", pEntry->w);
+
+   static double e = exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   pEntry->expression.register_symbol_table(symbol_table);
+
+   // A parser per compilation, concurrent misses must not share one.
+   parser_t parser(ParserSettings(m_eMode));
+   if (!parser.compile(sExpr, pEntry->expression))
+      return std::shared_ptr<CachedExpr>();
+
+   Prepare(m_eMode, pEntry->expression);
+
+   return pEntry;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchExprTk::LookupCompiled(const std::string& sExpr)
+{
+   return (bool)m_cache.Get(sExpr,
+                            "a,b,c,x,y,z,w;e;constants",
+                            [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t BenchExprTk::PrewarmExprCache(const std::vector<std::string> &vExpr)
+{
+   return m_cache.Prewarm(vExpr,
+                          "a,b,c,x,y,z,w;e;constants",
+                          [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchExprTk::GetExprCacheStats(ExprCacheStats &stats) const
+{
+   stats = m_cache.GetStats();
+   return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Hold all formulas of vExpr compiled at the same time.
+
+  All expressions share one symbol table. Without the arena every node is a heap block of
+  its own, with it the nodes of an expression are packed into a few chunks.
+
+  Compiling is timed with the heap counter off. The formulas are then compiled a second time
+  by the same parser with the counter on, and the bytes still held afterwards are reported.
+*/
+FootprintResult BenchExprTk::DoFootprintBenchmark(const std::vector<std::string>& vExpr)
+{
+   FootprintResult res;
+   res.supported = true;
+   res.formulas  = vExpr.size();
+
+   double a = 1.1;
+   double b = 2.2;
+   double c = 3.3;
+   double x = 2.123456;
+   double y = 3.123456;
+   double z = 4.123456;
+   double w = 5.123456;
+
+   exprtk::symbol_table<double> symbol_table;
+
+   symbol_table.add_variable("a", a);
+   symbol_table.add_variable("b", b);
+   symbol_table.add_variable("c", c);
+
+   symbol_table.add_variable("x", x);
+   symbol_table.add_variable("y", y);
+   symbol_table.add_variable("z", z);
+   symbol_table.add_variable("w", w);
+
+   static double e = exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   parser_t parser(ParserSettings(m_eMode));
+   Stopwatch timer;
+
+   auto compile = [&](std::vector<exprtk::expression<double>> &vExpression)
+   {
+      std::size_t nFailed = 0;
+      vExpression.reserve(vExpr.size());
+
+      for (std::size_t i = 0; i < vExpr.size(); ++i)
+      {
+         vExpression.push_back(exprtk::expression<double>());
+         vExpression.back().register_symbol_table(symbol_table);
+
+         if (!parser.compile(vExpr[i], vExpression.back()))
+         {
+            vExpression.pop_back();
+            ++nFailed;
+         }
+         else
+            Prepare(m_eMode, vExpression.back());
+      }
+
+      return nFailed;
+   };
+
+   timer.Start();
+
+   std::vector<exprtk::expression<double>> vExpression;
+   res.failed = compile(vExpression);
+
+   res.compileTime = timer.Stop();
+
+   timer.Start();
+
+   for (std::size_t i = 0; i < vExpression.size(); ++i)
+   {
+      res.sum += vExpression[i].value();
+   }
+
+   res.evalTime = timer.Stop();
+
+   MemoryCounter::Start();
+   {
+      std::vector<exprtk::expression<double>> vCounted;
+      compile(vCounted);
+      res.bytes = MemoryCounter::Current();
+   }
+   MemoryCounter::Stop();
+
+   return res;
+}
@@ -71,3 +71,108 @@ double BenchExprTkFloat::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+/** \brief ExprTk has no bulk interface, every row is copied into the bound variables. */
+double BenchExprTkFloat::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   float a = (float)cols.a[0];
+   float b = (float)cols.b[0];
+   float c = (float)cols.c[0];
+   float x = (float)cols.x[0];
+   float y = (float)cols.y[0];
+   float z = (float)cols.z[0];
+   float w = (float)cols.w[0];
+
+   exprtk::symbol_table<float> symbol_table;
+   exprtk::expression<float> expression;
+
+   symbol_table.add_variable("a", a);
+   symbol_table.add_variable("b", b);
+   symbol_table.add_variable("c", c);
+
+   symbol_table.add_variable("x", x);
+   symbol_table.add_variable("y", y);
+   symbol_table.add_variable("z", z);
+   symbol_table.add_variable("w", w);
+
+   static float e = (float)exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   expression.register_symbol_table(symbol_table);
+
+   {
+      exprtk::parser<float> parser;
+      if (!parser.compile(sExpr,expression))
+      {
+         StopTimerAndReport(parser.error());
+         return std::numeric_limits<double>::quiet_NaN();
+      }
+   }
+
+   float  fRes = expression.value();
+   double fSum = 0;
+
+   StartTimer();
+
+   for (long i = 0; i < cols.rows; ++i)
+   {
+      a = (float)cols.a[i];
+      b = (float)cols.b[i];
+      c = (float)cols.c[i];
+      x = (float)cols.x[i];
+      y = (float)cols.y[i];
+      z = (float)cols.z[i];
+      w = (float)cols.w[i];
+      fSum += expression.value();
+   }
+
+   StopTimer(fRes, fSum, cols.rows);
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchExprTkFloat::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   float a = 1.1f;
+   float b = 2.2f;
+   float c = 3.3f;
+   float x = 2.123456f;
+   float y = 3.123456f;
+   float z = 4.123456f;
+   float w = 5.123456f;
+
+   exprtk::symbol_table<float> symbol_table;
+
+   symbol_table.add_variable("a", a);
+   symbol_table.add_variable("b", b);
+   symbol_table.add_variable("c", c);
+
+   symbol_table.add_variable("x", x);
+   symbol_table.add_variable("y", y);
+   symbol_table.add_variable("z", z);
+   symbol_table.add_variable("w", w);
+
+   static float e = (float)exprtk::details::numeric::constant::e;
+   symbol_table.add_variable("e", e, true);
+
+   symbol_table.add_constants();
+
+   exprtk::parser<float> parser;
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      exprtk::expression<float> expression;
+      expression.register_symbol_table(symbol_table);
+
+      if (!parser.compile(sExpr,expression))
+         return StopCompileTimerAndReport(parser.error());
+   }
+
+   return StopCompileTimer(iCount);
+}
@@ -1,15 +1,24 @@
 #include "BenchFParser.h"
 
 #include <cmath>
+#include <vector>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
 
 // fparser includes
 #include "fparser/fparser.hh"
 
 //-------------------------------------------------------------------------------------------------
-BenchFParser::BenchFParser()
+/** \brief Create the benchmark, with bShared the reentrant Eval(vars, scratch) and EvalBatch
+           are used and all threads evaluate one parser instance.
+*/
+BenchFParser::BenchFParser(bool bShared)
 : Benchmark()
+, m_bShared(bShared)
 {
-   m_sName = "FParser 4.5";
+   m_sName = (bShared) ? "FParser 4.5 (shared)" : "FParser 4.5";
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -39,19 +48,366 @@ double BenchFParser::DoBenchmark(const std::string& sExpr, long iCount)
                        5.123456
                      };
 
-     fRes = Parser.Eval(vals);
+     if (m_bShared)
+     {
+        std::vector<double> vScratch(Parser.GetStackSize());
+
+        fRes = Parser.Eval(vals, &vScratch[0]);
+
+        StartTimer();
 
-     StartTimer();
+        for (int j = 0; j < iCount; ++j)
+        {
+           fSum += Parser.Eval(vals, &vScratch[0]);
+           std::swap(vals[0], vals[1]);
+           std::swap(vals[3], vals[4]);
+        }
 
-     for (int j = 0; j < iCount; ++j)
+        StopTimer(fRes, fSum, iCount);
+     }
+     else
      {
-        fSum += Parser.Eval(vals);
-        std::swap(vals[0], vals[1]);
-        std::swap(vals[3], vals[4]);
+        fRes = Parser.Eval(vals);
+
+        StartTimer();
+
+        for (int j = 0; j < iCount; ++j)
+        {
+           fSum += Parser.Eval(vals);
+           std::swap(vals[0], vals[1]);
+           std::swap(vals[3], vals[4]);
+        }
+
+        StopTimer(fRes, fSum, iCount);
      }
+   }
+
+   return m_fTime1;
+}
 
-     StopTimer(fRes, fSum, iCount);
+//-------------------------------------------------------------------------------------------------
+/** \brief fparser takes its variables as an array, every row is gathered into it.
+
+  The shared variant hands all rows to EvalBatch at once. Its input is one block holding the
+  columns back to back, which is built before the timer starts.
+*/
+double BenchFParser::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   double fRes (0);
+   double fSum (0);
+
+   FunctionParser Parser;
+   Parser.AddConstant("pi", (double)M_PI);
+   Parser.AddConstant("e", (double)M_E);
+
+   if (Parser.Parse(sExpr.c_str(), "a,b,c,x,y,z,w") >= 0)
+   {
+      StopTimerAndReport(Parser.ErrorMsg());
+      return m_fTime1;
    }
 
+   double vals[] = {
+                     cols.a[0],
+                     cols.b[0],
+                     cols.c[0],
+                     cols.x[0],
+                     cols.y[0],
+                     cols.z[0],
+                     cols.w[0]
+                   };
+
+   if (m_bShared)
+   {
+      const std::size_t n = (std::size_t)cols.rows;
+      const std::vector<double> *vCols[] = { &cols.a, &cols.b, &cols.c, &cols.x, &cols.y, &cols.z, &cols.w };
+
+      std::vector<double> vSoA(7 * n);
+      for (std::size_t k = 0; k < 7; ++k)
+         std::copy(vCols[k]->begin(), vCols[k]->begin() + n, vSoA.begin() + k * n);
+
+      std::vector<double> vOut(n);
+
+      Parser.EvalBatch(&vSoA[0], n, 1, &vOut[0]);
+      fRes = vOut[0];
+
+      StartTimer();
+
+      Parser.EvalBatch(&vSoA[0], n, n, &vOut[0]);
+
+      for (std::size_t i = 0; i < n; ++i)
+         fSum += vOut[i];
+
+      StopTimer(fRes, fSum, cols.rows);
+
+      return m_fTime1;
+   }
+
+   fRes = Parser.Eval(vals);
+
+   StartTimer();
+
+   for (long i = 0; i < cols.rows; ++i)
+   {
+      vals[0] = cols.a[i];
+      vals[1] = cols.b[i];
+      vals[2] = cols.c[i];
+      vals[3] = cols.x[i];
+      vals[4] = cols.y[i];
+      vals[5] = cols.z[i];
+      vals[6] = cols.w[i];
+      fSum += Parser.Eval(vals);
+   }
+
+   StopTimer(fRes, fSum, cols.rows);
+
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+double BenchFParser::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   if (m_bShared)
+   {
+      // One parser for all threads, Eval(vals, scratch) leaves the parser data untouched.
+      FunctionParser Parser;
+      Parser.AddConstant("pi", (double)M_PI);
+      Parser.AddConstant("e", (double)M_E);
+
+      if (Parser.Parse(sExpr.c_str(), "a,b,c,x,y,z,w") >= 0)
+      {
+         StopTimerAndReport(Parser.ErrorMsg());
+         return std::numeric_limits<double>::quiet_NaN();
+      }
+
+      const FunctionParser &SharedParser = Parser;
+
+      return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+      {
+         double vals[] = {
+                           1.1,
+                           2.2,
+                           3.3,
+                           2.123456,
+                           3.123456,
+                           4.123456,
+                           5.123456
+                         };
+
+         std::vector<double> vScratch(SharedParser.GetStackSize());
+
+         double fSum = 0;
+
+         fRes = SharedParser.Eval(vals, &vScratch[0]);
+
+         gate.Arrive();
+
+         for (long j = 0; j < iCount; ++j)
+         {
+            fSum += SharedParser.Eval(vals, &vScratch[0]);
+            std::swap(vals[0], vals[1]);
+            std::swap(vals[3], vals[4]);
+         }
+
+         return fSum;
+      });
+   }
+
+   // Eval() uses the stack stored in the parser data, and copies of a FunctionParser share
+   // that data until modified. Hence every thread parses into its own instance.
+   return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+   {
+      FunctionParser Parser;
+      Parser.AddConstant("pi", (double)M_PI);
+      Parser.AddConstant("e", (double)M_E);
+
+      if (Parser.Parse(sExpr.c_str(), "a,b,c,x,y,z,w") >= 0)
+         throw std::runtime_error(Parser.ErrorMsg());
+
+      double vals[] = {
+                        1.1,
+                        2.2,
+                        3.3,
+                        2.123456,
+                        3.123456,
+                        4.123456,
+                        5.123456
+                      };
+
+      double fSum = 0;
+
+      fRes = Parser.Eval(vals);
+
+      gate.Arrive();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += Parser.Eval(vals);
+         std::swap(vals[0], vals[1]);
+         std::swap(vals[3], vals[4]);
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchFParser::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   FunctionParser Parser;
+   Parser.AddConstant("pi", (double)M_PI);
+   Parser.AddConstant("e", (double)M_E);
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      if (Parser.Parse(sExpr.c_str(), "a,b,c,x,y,z,w") >= 0)
+         return StopCompileTimerAndReport(Parser.ErrorMsg());
+
+      Parser.Optimize();
+   }
+
+   return StopCompileTimer(iCount);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compiled expression, fparser takes the variables as an array on Eval. */
+struct BenchFParser::CachedExpr
+{
+   FunctionParser Parser;
+};
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compile function of the expression cache, runs outside the cache lock. */
+std::shared_ptr<BenchFParser::CachedExpr> BenchFParser::CompileCached(const std::string& sExpr) const
+{
+   std::shared_ptr<CachedExpr> pEntry = std::make_shared<CachedExpr>();
+   pEntry->Parser.AddConstant("pi", (double)M_PI);
+   pEntry->Parser.AddConstant("e", (double)M_E);
+
+   if (pEntry->Parser.Parse(sExpr.c_str(), "a,b,c,x,y,z,w") >= 0)
+      return std::shared_ptr<CachedExpr>();
+
+   pEntry->Parser.Optimize();
+   return pEntry;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchFParser::LookupCompiled(const std::string& sExpr)
+{
+   return (bool)m_cache.Get(sExpr,
+                            "a,b,c,x,y,z,w;pi,e;optimized",
+                            [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t BenchFParser::PrewarmExprCache(const std::vector<std::string> &vExpr)
+{
+   return m_cache.Prewarm(vExpr,
+                          "a,b,c,x,y,z,w;pi,e;optimized",
+                          [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Parse and optimize all formulas, versus LoadBytecode of what SaveBytecode stored. */
+StartupResult BenchFParser::DoStartupBenchmark(const std::vector<std::string> &vExpr,
+                                               const std::string &sFile)
+{
+   // The shared entry runs the same library code, timing it twice adds nothing.
+   if (m_bShared)
+      return Benchmark::DoStartupBenchmark(vExpr, sFile);
+
+   StartupResult res;
+   res.supported = true;
+   res.formulas  = vExpr.size();
+
+   Stopwatch timer;
+
+   std::vector<FunctionParser> vParsed;
+   vParsed.reserve(vExpr.size());
+
+   timer.Start();
+
+   for (std::size_t i = 0; i < vExpr.size(); ++i)
+   {
+      vParsed.push_back(FunctionParser());
+
+      FunctionParser &Parser = vParsed.back();
+      Parser.AddConstant("pi", (double)M_PI);
+      Parser.AddConstant("e", (double)M_E);
+
+      if (Parser.Parse(vExpr[i].c_str(), "a,b,c,x,y,z,w") >= 0)
+      {
+         vParsed.pop_back();
+         ++res.failed;
+         continue;
+      }
+
+      Parser.Optimize();
+   }
+
+   res.coldTime = timer.Stop();
+
+   {
+      timer.Start();
+
+      std::ofstream os(sFile.c_str(), std::ios::binary);
+      for (std::size_t i = 0; i < vParsed.size() && os; ++i)
+      {
+         vParsed[i].SaveBytecode(os);
+      }
+
+      os.flush();
+      res.bytes    = (std::size_t)os.tellp();
+      res.saveTime = timer.Stop();
+
+      if (!os)
+      {
+         res.supported  = false;
+         res.failReason = "could not write " + sFile;
+         return res;
+      }
+   }
+
+   std::vector<FunctionParser> vLoaded;
+   vLoaded.reserve(vParsed.size());
+
+   timer.Start();
+
+   {
+      std::ifstream is(sFile.c_str(), std::ios::binary);
+      for (std::size_t i = 0; i < vParsed.size(); ++i)
+      {
+         vLoaded.push_back(FunctionParser());
+
+         if (!vLoaded.back().LoadBytecode(is))
+         {
+            res.supported  = false;
+            res.failReason = "LoadBytecode failed";
+            return res;
+         }
+      }
+   }
+
+   res.warmTime = timer.Stop();
+
+   double vals[] = { 1.1, 2.2, 3.3, 2.123456, 3.123456, 4.123456, 5.123456 };
+
+   for (std::size_t i = 0; i < vParsed.size(); ++i)
+   {
+      const double fParsed = vParsed[i].Eval(vals);
+      const double fLoaded = vLoaded[i].Eval(vals);
+
+      if (fParsed != fLoaded && (fParsed == fParsed || fLoaded == fLoaded))
+         ++res.mismatches;
+   }
+
+   return res;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchFParser::GetExprCacheStats(ExprCacheStats &stats) const
+{
+   stats = m_cache.GetStats();
+   return true;
+}
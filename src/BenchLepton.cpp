@@ -2,26 +2,74 @@
 
 #include <string>
 #include <map>
+#include <algorithm>
 
 //#include <windows.h>
 #include <cmath>
 
+#include "Stopwatch.h"
+
 #define LEPTON_BUILDING_STATIC_LIBRARY
 #include "lepton/Lepton.h"
 
 using namespace std;
 
 
+namespace
+{
+   // Slot order of the value arrays used with ExpressionProgram::setVariableSlots.
+   enum ESlot { SLOT_A, SLOT_B, SLOT_C, SLOT_X, SLOT_Y, SLOT_Z, SLOT_W, SLOT_E, SLOT_PI, SLOT_COUNT };
+
+   const std::vector<std::string> &SlotNames()
+   {
+      static const std::vector<std::string> vNames = { "a", "b", "c", "x", "y", "z", "w", "e", "pi" };
+      return vNames;
+   }
+
+   void InitSlots(double *v)
+   {
+      v[SLOT_A ] = 1.1;
+      v[SLOT_B ] = 2.2;
+      v[SLOT_C ] = 3.3;
+      v[SLOT_X ] = 2.123456;
+      v[SLOT_Y ] = 3.123456;
+      v[SLOT_Z ] = 4.123456;
+      v[SLOT_W ] = 5.123456;
+      v[SLOT_E ] = 2.718281828459045235360;
+      v[SLOT_PI] = 3.141592653589793238462;
+   }
+
+   // Relative difference with an absolute floor near zero, two NaNs count as equal.
+   double Deviation(double fVal, double fRef)
+   {
+      if (fVal != fVal || fRef != fRef)
+         return (fVal != fVal && fRef != fRef) ? 0 : std::numeric_limits<double>::infinity();
+
+      if (fVal == fRef)
+         return 0;
+
+      return std::fabs(fVal - fRef) / std::max(std::fabs(fRef), 1.0);
+   }
+}
+
+
 //-------------------------------------------------------------------------------------------------
-BenchLepton::BenchLepton()
+/** \brief Create the benchmark, with bSlots variables are bound to array slots instead of
+           being looked up in a std::map on every evaluation.
+*/
+BenchLepton::BenchLepton(bool bSlots)
 : Benchmark()
+, m_bSlots(bSlots)
 {
-  m_sName = "Lepton";
+  m_sName = (bSlots) ? "Lepton (slots)" : "Lepton";
 }
 
 //-------------------------------------------------------------------------------------------------
 double BenchLepton::DoBenchmark(const std::string& sExpr, long iCount)
 {
+   if (m_bSlots)
+      return DoBenchmarkSlots(sExpr, iCount);
+
    std::map<std::string,double> var_list;
 
    var_list["a" ] = 1.1;
@@ -75,3 +123,344 @@ double BenchLepton::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluate against a value array through the slots bound once after compilation.
+
+  The evaluation uses the thread local scratch stack of the program, so no memory is
+  allocated inside the timed loop.
+*/
+double BenchLepton::DoBenchmarkSlots(const std::string& sExpr, long iCount)
+{
+   double v[SLOT_COUNT];
+   InitSlots(v);
+
+   try
+   {
+      Lepton::ExpressionProgram program = Lepton::Parser::parse(sExpr).optimize().createProgram();
+      program.setVariableSlots(SlotNames());
+
+      double fRes = program.evaluate(v);
+      double fSum = 0;
+
+      StartTimer();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += program.evaluate(v);
+         std::swap(v[SLOT_A], v[SLOT_B]);
+         std::swap(v[SLOT_X], v[SLOT_Y]);
+      }
+
+      StopTimer(fRes, fSum, iCount);
+   }
+   catch (std::exception& e)
+   {
+      StopTimerAndReport(e.what());
+      return std::numeric_limits<double>::quiet_NaN();
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Lepton has no bulk interface, every row is copied into the variable map (or the
+           slot array).
+*/
+double BenchLepton::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   if (m_bSlots)
+   {
+      double v[SLOT_COUNT];
+      InitSlots(v);
+
+      try
+      {
+         Lepton::ExpressionProgram program = Lepton::Parser::parse(sExpr).optimize().createProgram();
+         program.setVariableSlots(SlotNames());
+
+         std::vector<double> vScratch(program.getScratchSize());
+
+         v[SLOT_A] = cols.a[0];
+         v[SLOT_B] = cols.b[0];
+         v[SLOT_C] = cols.c[0];
+         v[SLOT_X] = cols.x[0];
+         v[SLOT_Y] = cols.y[0];
+         v[SLOT_Z] = cols.z[0];
+         v[SLOT_W] = cols.w[0];
+
+         double fRes = program.evaluate(v, &vScratch[0]);
+         double fSum = 0;
+
+         StartTimer();
+
+         for (long i = 0; i < cols.rows; ++i)
+         {
+            v[SLOT_A] = cols.a[i];
+            v[SLOT_B] = cols.b[i];
+            v[SLOT_C] = cols.c[i];
+            v[SLOT_X] = cols.x[i];
+            v[SLOT_Y] = cols.y[i];
+            v[SLOT_Z] = cols.z[i];
+            v[SLOT_W] = cols.w[i];
+            fSum += program.evaluate(v, &vScratch[0]);
+         }
+
+         StopTimer(fRes, fSum, cols.rows);
+      }
+      catch (std::exception& e)
+      {
+         StopTimerAndReport(e.what());
+         return std::numeric_limits<double>::quiet_NaN();
+      }
+
+      return m_fTime1;
+   }
+
+   std::map<std::string,double> var_list;
+
+   var_list["a" ] = cols.a[0];
+   var_list["b" ] = cols.b[0];
+   var_list["c" ] = cols.c[0];
+   var_list["x" ] = cols.x[0];
+   var_list["y" ] = cols.y[0];
+   var_list["z" ] = cols.z[0];
+   var_list["w" ] = cols.w[0];
+
+   var_list["e" ] = 2.718281828459045235360;
+   var_list["pi"] = 3.141592653589793238462;
+
+   double& a = var_list["a"];
+   double& b = var_list["b"];
+   double& c = var_list["c"];
+
+   double& x = var_list["x"];
+   double& y = var_list["y"];
+   double& z = var_list["z"];
+   double& w = var_list["w"];
+
+   try
+   {
+      Lepton::ExpressionProgram program = Lepton::Parser::parse(sExpr).optimize().createProgram();
+
+      double fRes = program.evaluate(var_list);
+      double fSum = 0;
+
+      StartTimer();
+
+      for (long i = 0; i < cols.rows; ++i)
+      {
+         a = cols.a[i];
+         b = cols.b[i];
+         c = cols.c[i];
+         x = cols.x[i];
+         y = cols.y[i];
+         z = cols.z[i];
+         w = cols.w[i];
+         fSum += program.evaluate(var_list);
+      }
+
+      StopTimer(fRes, fSum, cols.rows);
+   }
+   catch (std::exception& e)
+   {
+      StopTimerAndReport(e.what());
+      return std::numeric_limits<double>::quiet_NaN();
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchLepton::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   Lepton::ExpressionProgram program;
+
+   try
+   {
+      program = Lepton::Parser::parse(sExpr).optimize().createProgram();
+
+      if (m_bSlots)
+         program.setVariableSlots(SlotNames());
+   }
+   catch (std::exception& e)
+   {
+      StopTimerAndReport(e.what());
+      return std::numeric_limits<double>::quiet_NaN();
+   }
+
+   if (m_bSlots)
+   {
+      // The slots are part of the shared program, values and scratch stack are per thread.
+      return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+      {
+         double v[SLOT_COUNT];
+         InitSlots(v);
+
+         std::vector<double> vScratch(program.getScratchSize());
+
+         double fSum = 0;
+
+         fRes = program.evaluate(v, &vScratch[0]);
+
+         gate.Arrive();
+
+         for (long j = 0; j < iCount; ++j)
+         {
+            fSum += program.evaluate(v, &vScratch[0]);
+            std::swap(v[SLOT_A], v[SLOT_B]);
+            std::swap(v[SLOT_X], v[SLOT_Y]);
+         }
+
+         return fSum;
+      });
+   }
+
+   // ExpressionProgram::evaluate is const and keeps its stack in locals, so one program is
+   // shared by all threads. Only the variable map is per thread.
+   return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+   {
+      std::map<std::string,double> var_list;
+
+      var_list["a" ] = 1.1;
+      var_list["b" ] = 2.2;
+      var_list["c" ] = 3.3;
+      var_list["x" ] = 2.123456;
+      var_list["y" ] = 3.123456;
+      var_list["z" ] = 4.123456;
+      var_list["w" ] = 5.123456;
+
+      var_list["e" ] = 2.718281828459045235360;
+      var_list["pi"] = 3.141592653589793238462;
+
+      double& a = var_list["a"];
+      double& b = var_list["b"];
+      double& x = var_list["x"];
+      double& y = var_list["y"];
+
+      double fSum = 0;
+
+      fRes = program.evaluate(var_list);
+
+      gate.Arrive();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += program.evaluate(var_list);
+         std::swap(a,b);
+         std::swap(x,y);
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchLepton::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   StartCompileTimer();
+
+   try
+   {
+      for (long j = 0; j < iCount; ++j)
+      {
+         Lepton::ExpressionProgram program = Lepton::Parser::parse(sExpr).optimize().createProgram();
+      }
+   }
+   catch (std::exception& e)
+   {
+      return StopCompileTimerAndReport(e.what());
+   }
+
+   return StopCompileTimer(iCount);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time ExpressionProgram::evaluateGradient against the symbolic derivatives.
+
+  The symbolic side is what Lepton offered before: one differentiated and optimized program
+  per variable, each evaluated on its own after the program of the expression itself.
+*/
+GradientResult BenchLepton::DoGradientBenchmark(const std::string& sExpr, long iCount)
+{
+   const int nVar = SLOT_W + 1;
+
+   GradientResult res;
+   res.supported = true;
+   res.variables = nVar;
+
+   double v[SLOT_COUNT];
+   InitSlots(v);
+
+   try
+   {
+      Lepton::ParsedExpression expr = Lepton::Parser::parse(sExpr).optimize();
+
+      Lepton::ExpressionProgram program = expr.createProgram();
+      program.setVariableSlots(SlotNames());
+
+      std::vector<Lepton::ExpressionProgram> vDeriv(nVar);
+      int nScratch = program.getGradientScratchSize();
+      for (int i = 0; i < nVar; ++i)
+      {
+         vDeriv[i] = expr.differentiate(SlotNames()[i]).optimize().createProgram();
+         vDeriv[i].setVariableSlots(SlotNames());
+         nScratch = std::max(nScratch, vDeriv[i].getScratchSize());
+      }
+
+      std::vector<double> vScratch(nScratch);
+      double *pScratch = &vScratch[0];
+
+      double vGrad[SLOT_COUNT];
+
+      res.value = program.evaluateGradient(v, vGrad, pScratch);
+      for (int i = 0; i < nVar; ++i)
+      {
+         res.gradientSum += vGrad[i];
+         res.deviation = std::max(res.deviation, Deviation(vGrad[i], vDeriv[i].evaluate(v, pScratch)));
+      }
+
+      Stopwatch timer;
+      double fSumAD = 0;
+
+      timer.Start();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSumAD += program.evaluateGradient(v, vGrad, pScratch);
+         for (int i = 0; i < nVar; ++i)
+            fSumAD += vGrad[i];
+
+         std::swap(v[SLOT_A], v[SLOT_B]);
+         std::swap(v[SLOT_X], v[SLOT_Y]);
+      }
+
+      res.adTime = timer.Stop();
+
+      InitSlots(v);
+      double fSumSym = 0;
+
+      timer.Start();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSumSym += program.evaluate(v, pScratch);
+         for (int i = 0; i < nVar; ++i)
+            fSumSym += vDeriv[i].evaluate(v, pScratch);
+
+         std::swap(v[SLOT_A], v[SLOT_B]);
+         std::swap(v[SLOT_X], v[SLOT_Y]);
+      }
+
+      res.symbolicTime = timer.Stop();
+
+      // Also covers the swapped variable values of the timed loops.
+      res.deviation = std::max(res.deviation, Deviation(fSumAD, fSumSym));
+   }
+   catch (std::exception& e)
+   {
+      res.failReason = e.what();
+   }
+
+   return res;
+}
@@ -69,3 +69,44 @@ double BenchMTParser::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+double BenchMTParser::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   double a = 1.1;
+   double b = 2.2;
+   double c = 3.3;
+   double x = 2.123456;
+   double y = 3.123456;
+   double z = 4.123456;
+   double w = 5.123456;
+
+   MTParser p;
+   p.defineVar("a", &a);
+   p.defineVar("b", &b);
+   p.defineVar("c", &c);
+
+   p.defineVar("x", &x);
+   p.defineVar("y", &y);
+   p.defineVar("z", &z);
+   p.defineVar("w", &w);
+
+   p.defineConst("e", M_E);
+   p.defineConst("pi", M_PI);
+
+   try
+   {
+      StartCompileTimer();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         p.compile(sExpr.c_str());
+      }
+
+      return StopCompileTimer(iCount);
+   }
+   catch(MTParserException &e)
+   {
+      return StopCompileTimerAndReport(e.getDesc(0).c_str());
+   }
+}
@@ -8,10 +8,15 @@ using namespace std;
 
 
 //-------------------------------------------------------------------------------------------------
-BenchMathExpr::BenchMathExpr()
+/** \brief Create the benchmark.
+    \param bFlat Evaluate the RProgram compiled from the operation tree instead of
+                 ROperation::Val().
+*/
+BenchMathExpr::BenchMathExpr(bool bFlat)
 : Benchmark()
+, m_bFlat(bFlat)
 {
-   m_sName = "MathExpr";
+   m_sName = (bFlat) ? "MathExpr (flat)" : "MathExpr";
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -64,15 +69,33 @@ double BenchMathExpr::DoBenchmark(const std::string& sExpr, long iCount)
       double fRes  = 0;
       double fSum  = 0;
 
-      fRes = op.Val();
+      if (m_bFlat)
+      {
+         RProgram prog(op);
 
-      StartTimer();
+         fRes = prog.Val();
 
-      for (int j = 0; j < iCount; ++j)
+         StartTimer();
+
+         for (int j = 0; j < iCount; ++j)
+         {
+            fSum += prog.Val();
+            std::swap(a,b);
+            std::swap(x,y);
+         }
+      }
+      else
       {
-         fSum += op.Val();
-         std::swap(a,b);
-         std::swap(x,y);
+         fRes = op.Val();
+
+         StartTimer();
+
+         for (int j = 0; j < iCount; ++j)
+         {
+            fSum += op.Val();
+            std::swap(a,b);
+            std::swap(x,y);
+         }
       }
 
       StopTimer(fRes, fSum, iCount);
@@ -80,3 +103,130 @@ double BenchMathExpr::DoBenchmark(const std::string& sExpr, long iCount)
 
    return m_fTime1;
 }
+
+//-------------------------------------------------------------------------------------------------
+/** \brief MathExpr has no bulk interface, every row is copied into the bound variables. */
+double BenchMathExpr::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   double a = cols.a[0];
+   double b = cols.b[0];
+   double c = cols.c[0];
+   double x = cols.x[0];
+   double y = cols.y[0];
+   double z = cols.z[0];
+   double w = cols.w[0];
+
+   double e  = 2.718281828459045235360;
+   double pi = 3.141592653589793238462;
+
+   RVar var_a ( "a"  , &a );
+   RVar var_b ( "b"  , &b );
+   RVar var_c ( "c"  , &c );
+   RVar var_x ( "x"  , &x );
+   RVar var_y ( "y"  , &y );
+   RVar var_z ( "z"  , &z );
+   RVar var_w ( "w"  , &w );
+   RVar var_e ( "e"  , &e );
+   RVar var_pi( "pi" , &pi);
+
+   RVar* var_array[9];
+
+   var_array[0] = &var_a;
+   var_array[1] = &var_b;
+   var_array[2] = &var_c;
+   var_array[3] = &var_x;
+   var_array[4] = &var_y;
+   var_array[5] = &var_z;
+   var_array[6] = &var_w;
+
+   var_array[7] = &var_e;
+   var_array[8] = &var_pi;
+
+   ROperation op (const_cast<char*>(sExpr.c_str()), 9, var_array);
+
+   if (op.HasError(&op))
+   {
+      StopTimerAndReport("parsing error");
+   }
+   else
+   {
+      RProgram prog;
+      if (m_bFlat)
+         prog.Compile(op);
+
+      double fRes = (m_bFlat) ? prog.Val() : op.Val();
+      double fSum = 0;
+
+      StartTimer();
+
+      for (long i = 0; i < cols.rows; ++i)
+      {
+         a = cols.a[i];
+         b = cols.b[i];
+         c = cols.c[i];
+         x = cols.x[i];
+         y = cols.y[i];
+         z = cols.z[i];
+         w = cols.w[i];
+         fSum += (m_bFlat) ? prog.Val() : op.Val();
+      }
+
+      StopTimer(fRes, fSum, cols.rows);
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+double BenchMathExpr::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   double a = 1.1;
+   double b = 2.2;
+   double c = 3.3;
+   double x = 2.123456;
+   double y = 3.123456;
+   double z = 4.123456;
+   double w = 5.123456;
+
+   double e  = 2.718281828459045235360;
+   double pi = 3.141592653589793238462;
+
+   RVar var_a ( "a"  , &a );
+   RVar var_b ( "b"  , &b );
+   RVar var_c ( "c"  , &c );
+   RVar var_x ( "x"  , &x );
+   RVar var_y ( "y"  , &y );
+   RVar var_z ( "z"  , &z );
+   RVar var_w ( "w"  , &w );
+   RVar var_e ( "e"  , &e );
+   RVar var_pi( "pi" , &pi);
+
+   RVar* var_array[9];
+
+   var_array[0] = &var_a;
+   var_array[1] = &var_b;
+   var_array[2] = &var_c;
+   var_array[3] = &var_x;
+   var_array[4] = &var_y;
+   var_array[5] = &var_z;
+   var_array[6] = &var_w;
+
+   var_array[7] = &var_e;
+   var_array[8] = &var_pi;
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      ROperation op (const_cast<char*>(sExpr.c_str()), 9, var_array);
+
+      if (op.HasError(&op))
+         return StopCompileTimerAndReport("parsing error");
+
+      RProgram prog;
+      if (m_bFlat)
+         prog.Compile(op);
+   }
+
+   return StopCompileTimer(iCount);
+}
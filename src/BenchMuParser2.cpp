@@ -1,24 +1,62 @@
 #include "BenchMuParser2.h"
 
 #include <cmath>
+#include <stdexcept>
 //#include <windows.h>
 
+#ifdef MUP_USE_OPENMP
+#include <omp.h>
+#endif
+
 //-------------------------------------------------------------------------------------------------
 #include "muparser2/muParser.h"
+#include "muparser2/muParserSimd.h"
 
 using namespace mu;
 
 
 //-------------------------------------------------------------------------------------------------
-BenchMuParser2::BenchMuParser2(bool bUseBulkMode)
+/** \brief Create the benchmark for the given evaluation mode.
+
+  In block mode eSimd selects the column kernels, it must not exceed what detect_simd_level()
+  reports for this CPU. The kernels are global to muparser, so only one instruction set can be
+  benchmarked per run.
+*/
+BenchMuParser2::BenchMuParser2(EMode eMode, simd_level_t eSimd)
 : Benchmark()
 {
    m_sName = "muparser2 V" + mu::Parser().GetVersion();
-   m_bUseBulkMode = bUseBulkMode;
+   m_eMode = eMode;
+
+   if (m_eMode == BLOCK)
+   {
+      mu::ESimdLevel eLevel = mu::simdNONE;
+
+      switch (eSimd)
+      {
+         case SIMD_AVX2:   eLevel = mu::simdAVX2;   break;
+         case SIMD_AVX512: eLevel = mu::simdAVX512; break;
+         default:          break;
+      }
+
+      // Fall back to the portable kernels if the requested ones were not compiled in.
+      if (!mu::SetSimdLevel(eLevel))
+      {
+         mu::SetSimdLevel(mu::simdNONE);
+         eSimd = SIMD_NONE;
+      }
+
+      m_sInfo = std::string("SIMD ") + simd_level_str(eSimd);
+   }
+
+   if (m_eMode == JIT && !mu::ParserJit::IsAvailable())
+   {
+      m_sInfo = "native code not supported on this platform, bytecode interpreter used";
+   }
 
    // Evaluating a single function will force OpenMP to create its threads
    // here and not during the first expression of the benchmark set.
-   if (m_bUseBulkMode)
+   if (m_eMode == BULK)
    {
       DoBenchmarkBulk("1", 2001);
    }
@@ -41,6 +79,8 @@ double BenchMuParser2::DoBenchmarkStd(const std::string &sExpr, long iCount)
 
    try
    {
+      p.EnableJit(m_eMode == JIT);
+      p.EnableRegCode(m_eMode == REGCODE);
       p.SetExpr(sExpr.c_str());
       p.DefineVar("a", &a);
       p.DefineVar("b", &b);
@@ -58,6 +98,37 @@ double BenchMuParser2::DoBenchmarkStd(const std::string &sExpr, long iCount)
                        // since fparser does it in Parse(...) wich is outside too
                        // (Speed of bytecode creation is irrelevant)
 
+      if (m_eMode == MEMO)
+      {
+         // GetUsedVar reparses the expression, create the bytecode again afterwards.
+         const varmap_type &vUsed = p.GetUsedVar();
+
+         std::vector<const double*> vVars;
+         for (varmap_type::const_iterator it = vUsed.begin(); it != vUsed.end(); ++it)
+         {
+            vVars.push_back(it->second);
+         }
+
+         MemoCache cache;
+         cache.Bind(vVars);
+
+         fRes = p.Eval();
+
+         StartTimer();
+
+         for (int j = 0; j < iCount; ++j)
+         {
+            fSum += cache.Eval([&]() { return p.Eval(); });
+            std::swap(a,b);
+            std::swap(x,y);
+         }
+
+         StopTimer(fRes, fSum, iCount);
+         AddMemoStats(cache);
+
+         return m_fTime1;
+      }
+
       StartTimer();
 
       for (int j = 0; j < iCount; ++j)
@@ -81,15 +152,6 @@ double BenchMuParser2::DoBenchmarkStd(const std::string &sExpr, long iCount)
    return m_fTime1;
 }
 
-//-------------------------------------------------------------------------------------------------
-void BenchMuParser2::PreprocessExpr(std::vector<std::string> &vExpr)
-{
-   for (std::size_t i = 0; i < vExpr.size(); ++i)
-   {
-      PreprocessExpr(vExpr[i]);
-   }
-}
-
 //-------------------------------------------------------------------------------------------------
 void BenchMuParser2::PreprocessExpr(std::string&)
 {
@@ -158,7 +220,10 @@ double BenchMuParser2::DoBenchmarkBulk(const std::string &sExpr, long iCount)
          std::swap(xx,yy);
       }
 
-      p.Eval(result, nBulkSize);
+      if (m_eMode == BLOCK)
+         p.EvalBlocked(result, nBulkSize);
+      else
+         p.Eval(result, nBulkSize);
 
       // Note: Performing the addition inside the timed section is done
       //       because all other parsers do it in their main loop too.
@@ -198,7 +263,7 @@ double BenchMuParser2::DoBenchmarkBulk(const std::string &sExpr, long iCount)
 //-------------------------------------------------------------------------------------------------
 double BenchMuParser2::DoBenchmark(const std::string& sExpr, long iCount)
 {
-   if (m_bUseBulkMode)
+   if (m_eMode == BULK || m_eMode == BLOCK)
    {
       return DoBenchmarkBulk(sExpr, iCount);
    }
@@ -208,11 +273,362 @@ double BenchMuParser2::DoBenchmark(const std::string& sExpr, long iCount)
    }
 }
 
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluate all rows of cols.
+
+  Bulk and block mode bind the variables directly to the columns. The other modes have no bulk
+  interface and copy every row into the bound variables before calling Eval().
+*/
+double BenchMuParser2::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   const int nRows = (int)cols.rows;
+   std::vector<double> vResult(nRows);
+
+   double a = 0;
+   double b = 0;
+   double c = 0;
+   double x = 0;
+   double y = 0;
+   double z = 0;
+   double w = 0;
+
+   try
+   {
+      Parser p;
+      p.EnableJit(m_eMode == JIT);
+      p.EnableRegCode(m_eMode == REGCODE);
+      p.SetExpr(sExpr.c_str());
+
+      if (m_eMode != BULK && m_eMode != BLOCK)
+      {
+         p.DefineVar("a", &a);
+         p.DefineVar("b", &b);
+         p.DefineVar("c", &c);
+         p.DefineVar("x", &x);
+         p.DefineVar("y", &y);
+         p.DefineVar("z", &z);
+         p.DefineVar("w", &w);
+      }
+      else
+      {
+         // muparser only writes to variables in expressions with an assignment operator,
+         // the benchmark expressions have none.
+         p.DefineVar("a", const_cast<double*>(&cols.a[0]));
+         p.DefineVar("b", const_cast<double*>(&cols.b[0]));
+         p.DefineVar("c", const_cast<double*>(&cols.c[0]));
+         p.DefineVar("x", const_cast<double*>(&cols.x[0]));
+         p.DefineVar("y", const_cast<double*>(&cols.y[0]));
+         p.DefineVar("z", const_cast<double*>(&cols.z[0]));
+         p.DefineVar("w", const_cast<double*>(&cols.w[0]));
+      }
+
+      p.DefineConst("pi", (double)M_PI);
+      p.DefineConst("e", (double)M_E);
+
+      StartTimer();
+
+      switch (m_eMode)
+      {
+         case BULK:
+              p.Eval(&vResult[0], nRows);
+              break;
+
+         case BLOCK:
+              p.EvalBlocked(&vResult[0], nRows);
+              break;
+
+         default:
+              for (int i = 0; i < nRows; ++i)
+              {
+                 a = cols.a[i];
+                 b = cols.b[i];
+                 c = cols.c[i];
+                 x = cols.x[i];
+                 y = cols.y[i];
+                 z = cols.z[i];
+                 w = cols.w[i];
+                 vResult[i] = p.Eval();
+              }
+              break;
+      }
+
+      double fSum(0);
+      for (int i = 0; i < nRows; ++i)
+      {
+         fSum += vResult[i];
+      }
+
+      StopTimer(vResult[0], fSum, nRows);
+   }
+   catch(ParserError &exc)
+   {
+      StopTimerAndReport(exc.GetMsg());
+   }
+   catch(...)
+   {
+      StopTimerAndReport("unexpected exception");
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Concurrent evaluation on nThreads threads.
+
+  In standard mode every thread owns a parser, the bytecode evaluation writes to the parser's
+  stack buffer and is not reentrant. In bulk mode a single parser is shared and the rows are
+  split among nThreads OpenMP threads, each working on its own partition of m_vStackBuffer.
+  Those partitions are adjacent and only a few values wide, so the threads share cache lines.
+  In block mode every thread owns a parser and runs EvalBlocked over its own iCount rows. JIT
+  and register code mode behave like standard mode, both use the parser's stack buffer too.
+*/
+double BenchMuParser2::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   if (m_eMode == BLOCK)
+   {
+      const BatchColumns cols(iCount);
+
+      return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+      {
+         std::vector<double> vResult(cols.rows);
+         double fSum = 0;
+
+         Parser p;
+
+         try
+         {
+            p.SetExpr(sExpr.c_str());
+            p.DefineVar("a", const_cast<double*>(&cols.a[0]));
+            p.DefineVar("b", const_cast<double*>(&cols.b[0]));
+            p.DefineVar("c", const_cast<double*>(&cols.c[0]));
+            p.DefineVar("x", const_cast<double*>(&cols.x[0]));
+            p.DefineVar("y", const_cast<double*>(&cols.y[0]));
+            p.DefineVar("z", const_cast<double*>(&cols.z[0]));
+            p.DefineVar("w", const_cast<double*>(&cols.w[0]));
+
+            p.DefineConst("pi", (double)M_PI);
+            p.DefineConst("e", (double)M_E);
+
+            fRes = p.Eval();
+         }
+         catch(ParserError &exc)
+         {
+            throw std::runtime_error(exc.GetMsg());
+         }
+
+         gate.Arrive();
+
+         p.EvalBlocked(&vResult[0], (int)cols.rows);
+
+         for (long j = 0; j < cols.rows; ++j)
+         {
+            fSum += vResult[j];
+         }
+
+         return fSum;
+      });
+   }
+
+   if (m_eMode == BULK)
+   {
+#ifdef MUP_USE_OPENMP
+      // The bulk already holds iCount rows, they are spread over the threads instead of
+      // giving each thread iCount rows of its own.
+      const int nMaxThreads = omp_get_max_threads();
+      omp_set_num_threads(nThreads);
+      DoBenchmarkBulk(sExpr, iCount);
+      omp_set_num_threads(nMaxThreads);
+      return m_fTime1;
+#else
+      return Benchmark::DoBenchmarkThreaded(sExpr, iCount, nThreads);
+#endif
+   }
+
+   return RunThreaded(nThreads, iCount, [&](int, StartGate &gate, double &fRes) -> double
+   {
+      double a = 1.1;
+      double b = 2.2;
+      double c = 3.3;
+      double x = 2.123456;
+      double y = 3.123456;
+      double z = 4.123456;
+      double w = 5.123456;
+      double fSum = 0;
+
+      Parser p;
+
+      try
+      {
+         p.EnableJit(m_eMode == JIT);
+         p.EnableRegCode(m_eMode == REGCODE);
+         p.SetExpr(sExpr.c_str());
+         p.DefineVar("a", &a);
+         p.DefineVar("b", &b);
+         p.DefineVar("c", &c);
+
+         p.DefineVar("x", &x);
+         p.DefineVar("y", &y);
+         p.DefineVar("z", &z);
+         p.DefineVar("w", &w);
+
+         p.DefineConst("pi", (double)M_PI);
+         p.DefineConst("e", (double)M_E);
+
+         fRes = p.Eval();
+      }
+      catch(ParserError &exc)
+      {
+         throw std::runtime_error(exc.GetMsg());
+      }
+
+      gate.Arrive();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         fSum += p.Eval();
+         std::swap(a,b);
+         std::swap(x,y);
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time SetExpr and the first Eval, which is where muparser creates its bytecode. */
+double BenchMuParser2::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   Parser p;
+
+   double a = 1.1;
+   double b = 2.2;
+   double c = 3.3;
+   double x = 2.123456;
+   double y = 3.123456;
+   double z = 4.123456;
+   double w = 5.123456;
+
+   try
+   {
+      p.EnableJit(m_eMode == JIT);
+      p.EnableRegCode(m_eMode == REGCODE);
+      p.DefineVar("a", &a);
+      p.DefineVar("b", &b);
+      p.DefineVar("c", &c);
+
+      p.DefineVar("x", &x);
+      p.DefineVar("y", &y);
+      p.DefineVar("z", &z);
+      p.DefineVar("w", &w);
+
+      p.DefineConst("pi", (double)M_PI);
+      p.DefineConst("e", (double)M_E);
+
+      StartCompileTimer();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         p.SetExpr(sExpr.c_str());
+         p.Eval();
+      }
+
+      return StopCompileTimer(iCount);
+   }
+   catch(ParserError &exc)
+   {
+      return StopCompileTimerAndReport(exc.GetMsg());
+   }
+   catch(...)
+   {
+      return StopCompileTimerAndReport("unexpected exception");
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compiled expression owning the variables it is bound to. */
+struct BenchMuParser2::CachedExpr
+{
+   double a, b, c, x, y, z, w;
+   Parser p;
+};
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compile function of the expression cache, runs outside the cache lock.
+
+  The bytecode (and native or register code) is created by the first Eval.
+*/
+std::shared_ptr<BenchMuParser2::CachedExpr> BenchMuParser2::CompileCached(const std::string& sExpr) const
+{
+   std::shared_ptr<CachedExpr> pEntry = std::make_shared<CachedExpr>();
+   pEntry->a = 1.1;
+   pEntry->b = 2.2;
+   pEntry->c = 3.3;
+   pEntry->x = 2.123456;
+   pEntry->y = 3.123456;
+   pEntry->z = 4.123456;
+   pEntry->w = 5.123456;
+
+   try
+   {
+      Parser &p = pEntry->p;
+      p.EnableJit(m_eMode == JIT);
+      p.EnableRegCode(m_eMode == REGCODE);
+      p.DefineVar("a", &pEntry->a);
+      p.DefineVar("b", &pEntry->b);
+      p.DefineVar("c", &pEntry->c);
+
+      p.DefineVar("x", &pEntry->x);
+      p.DefineVar("y", &pEntry->y);
+      p.DefineVar("z", &pEntry->z);
+      p.DefineVar("w", &pEntry->w);
+
+      p.DefineConst("pi", (double)M_PI);
+      p.DefineConst("e", (double)M_E);
+
+      p.SetExpr(sExpr.c_str());
+      p.Eval();
+   }
+   catch(...)
+   {
+      return std::shared_ptr<CachedExpr>();
+   }
+
+   return pEntry;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchMuParser2::LookupCompiled(const std::string& sExpr)
+{
+   return (bool)m_cache.Get(sExpr,
+                            GetShortName() + ";a,b,c,x,y,z,w;pi,e",
+                            [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t BenchMuParser2::PrewarmExprCache(const std::vector<std::string> &vExpr)
+{
+   return m_cache.Prewarm(vExpr,
+                          GetShortName() + ";a,b,c,x,y,z,w;pi,e",
+                          [this](const std::string &s) { return CompileCached(s); });
+}
+
+//-------------------------------------------------------------------------------------------------
+bool BenchMuParser2::GetExprCacheStats(ExprCacheStats &stats) const
+{
+   stats = m_cache.GetStats();
+   return true;
+}
+
 //-------------------------------------------------------------------------------------------------
 std::string BenchMuParser2::GetShortName() const
 {
-   if (m_bUseBulkMode)
-      return "muparser 2.2.4 (omp)";
-   else
-      return "muparser 2.2.4";
+   switch (m_eMode)
+   {
+      case BULK:    return "muparser 2.2.4 (omp)";
+      case BLOCK:   return "muparser 2.2.4 (blk)";
+      case JIT:     return "muparser 2.2.4 (jit)";
+      case REGCODE: return "muparser 2.2.4 (reg)";
+      case MEMO:    return "muparser 2.2.4 (mem)";
+      default:      return "muparser 2.2.4";
+   }
 }
@@ -1,11 +1,17 @@
 #include "BenchMuParserSSE.h"
 
+#ifdef _MSC_VER
 #include <windows.h>
+#endif
 #include <cmath>
 #include <cassert>
 
 #include "muParserSSE/muParserSSE.h"
+
+// Windows links the prebuilt dll, other platforms compile muParserSSE/muParserSSE.cpp
+#ifdef _MSC_VER
 #pragma comment(lib, "muParserSSE.lib")
+#endif
 
 using namespace std;
 
@@ -23,12 +29,10 @@ double BenchMuParserSSE::DoBenchmark(const std::string& sExpr, long iCount)
    mecFloat_t a    = mecFloat_t(1.1);
    mecFloat_t b    = mecFloat_t(2.2);
    mecFloat_t c    = mecFloat_t(3.3);
-   mecFloat_t d    = mecFloat_t(4.4);
    mecFloat_t x    = mecFloat_t(2.123456);
    mecFloat_t y    = mecFloat_t(3.123456);
    mecFloat_t z    = mecFloat_t(4.123456);
    mecFloat_t w    = mecFloat_t(5.123456);
-   mecFloat_t buf  = mecFloat_t(0.0);
    double     fSum = mecFloat_t(0.0);
 
    mecParserHandle_t hParser = mecCreate();
@@ -75,6 +79,57 @@ double BenchMuParserSSE::DoBenchmark(const std::string& sExpr, long iCount)
    return m_fTime1;
 }
 
+//-------------------------------------------------------------------------------------------------
+double BenchMuParserSSE::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   mecFloat_t a    = mecFloat_t(1.1);
+   mecFloat_t b    = mecFloat_t(2.2);
+   mecFloat_t c    = mecFloat_t(3.3);
+   mecFloat_t x    = mecFloat_t(2.123456);
+   mecFloat_t y    = mecFloat_t(3.123456);
+   mecFloat_t z    = mecFloat_t(4.123456);
+   mecFloat_t w    = mecFloat_t(5.123456);
+   double     fRes = 0;
+   bool       bErr = false;
+
+   mecParserHandle_t hParser = mecCreate();
+
+   mecDefineVar(hParser, "a", &a);
+   mecDefineVar(hParser, "b", &b);
+   mecDefineVar(hParser, "c", &c);
+
+   mecDefineVar(hParser, "x", &x);
+   mecDefineVar(hParser, "y", &y);
+   mecDefineVar(hParser, "z", &z);
+   mecDefineVar(hParser, "w", &w);
+
+   mecDefineConst(hParser, "pi", (mecFloat_t)M_PI);
+   mecDefineConst(hParser, "e",  (mecFloat_t)M_E);
+
+   StartCompileTimer();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      mecSetExpr(hParser, sExpr.c_str());
+      mecCompile(hParser);
+
+      if (mecError(hParser))
+      {
+         fRes = StopCompileTimerAndReport(mecGetErrorMsg(hParser));
+         bErr = true;
+         break;
+      }
+   }
+
+   if (!bErr)
+      fRes = StopCompileTimer(iCount);
+
+   mecRelease(hParser);
+
+   return fRes;
+}
+
+//-------------------------------------------------------------------------------------------------
 std::string BenchMuParserSSE::GetShortName() const
 {
    return "muparserSSE";
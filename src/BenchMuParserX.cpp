@@ -1,15 +1,24 @@
 #include "BenchMuParserX.h"
 
 #include <cmath>
+#include <memory>
+#include <vector>
+#include <stdexcept>
 //#include <windows.h>
 
 #include "muparserx/mpParser.h"
+#include "muparserx/mpValuePool.h"
 
 //-------------------------------------------------------------------------------------------------
-BenchMuParserX::BenchMuParserX()
+/** \brief Create the benchmark.
+    \param bFastPath Use the real valued fast path of muparserx. Without it the generic
+                     engine working on Value objects is measured.
+*/
+BenchMuParserX::BenchMuParserX(bool bFastPath)
 : Benchmark()
+, m_bFastPath(bFastPath)
 {
-   m_sName = "muparserx" + mup::ParserX().GetVersion();
+   m_sName = "muparserx" + mup::ParserX().GetVersion() + ((bFastPath) ? " (real)" : "");
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -18,6 +27,7 @@ double BenchMuParserX::DoBenchmark(const std::string& sExpr, long iCount)
    using namespace mup;
 
    ParserX p(pckALL_NON_COMPLEX);
+   p.EnableFastPath(m_bFastPath);
 
    Value fRes((float_type)0);
    Value a((float_type)1.1);
@@ -75,8 +85,216 @@ double BenchMuParserX::DoBenchmark(const std::string& sExpr, long iCount)
   return m_fTime1;
 }
 
+//-------------------------------------------------------------------------------------------------
+/** \brief muparserx has no bulk interface, every row is copied into the bound variables. */
+double BenchMuParserX::DoBenchmarkBatch(const std::string& sExpr, const BatchColumns &cols)
+{
+   using namespace mup;
+
+   ParserX p(pckALL_NON_COMPLEX);
+   p.EnableFastPath(m_bFastPath);
+
+   Value fRes((float_type)0);
+   Value a((float_type)cols.a[0]);
+   Value b((float_type)cols.b[0]);
+   Value c((float_type)cols.c[0]);
+   Value x((float_type)cols.x[0]);
+   Value y((float_type)cols.y[0]);
+   Value z((float_type)cols.z[0]);
+   Value w((float_type)cols.w[0]);
+
+   try
+   {
+      p.SetExpr(sExpr.c_str());
+      p.DefineVar("a", Variable(&a));
+      p.DefineVar("b", Variable(&b));
+      p.DefineVar("c", Variable(&c));
+
+      p.DefineVar("x", Variable(&x));
+      p.DefineVar("y", Variable(&y));
+      p.DefineVar("z", Variable(&z));
+      p.DefineVar("w", Variable(&w));
+
+      double fSum = 0;
+      fRes = p.Eval();
+
+      StartTimer();
+
+      for (long i = 0; i < cols.rows; ++i)
+      {
+         a = (float_type)cols.a[i];
+         b = (float_type)cols.b[i];
+         c = (float_type)cols.c[i];
+         x = (float_type)cols.x[i];
+         y = (float_type)cols.y[i];
+         z = (float_type)cols.z[i];
+         w = (float_type)cols.w[i];
+         fSum += p.Eval().GetFloat();
+      }
+
+      StopTimer(fRes.GetFloat(), fSum, cols.rows);
+   }
+   catch(mup::ParserError &exc)
+   {
+      StopTimerAndReport(exc.GetMsg());
+   }
+   catch(...)
+   {
+      StopTimerAndReport("unexpected exception");
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Every thread evaluates a parser of its own.
+
+  The parsers are set up and destroyed by the calling thread while the RPN, the evaluation
+  stack and all temporary values are created by the workers. Destroying the parsers hence
+  returns values to the pools of the worker threads from another thread.
+*/
+double BenchMuParserX::DoBenchmarkThreaded(const std::string& sExpr, long iCount, int nThreads)
+{
+   using namespace mup;
+
+   struct ThreadParser
+   {
+      ThreadParser()
+        :p(pckALL_NON_COMPLEX)
+        ,a((float_type)1.1)
+        ,b((float_type)2.2)
+        ,c((float_type)3.3)
+        ,x((float_type)2.123456)
+        ,y((float_type)3.123456)
+        ,z((float_type)4.123456)
+        ,w((float_type)5.123456)
+      {}
+
+      ParserX p;
+      Value a, b, c, x, y, z, w;
+   };
+
+   std::vector<std::unique_ptr<ThreadParser>> vParser;
+
+   try
+   {
+      for (int t = 0; t < nThreads; ++t)
+      {
+         vParser.emplace_back(new ThreadParser);
+
+         ThreadParser &tp = *vParser.back();
+         tp.p.EnableFastPath(m_bFastPath);
+         tp.p.SetExpr(sExpr.c_str());
+         tp.p.DefineVar("a", Variable(&tp.a));
+         tp.p.DefineVar("b", Variable(&tp.b));
+         tp.p.DefineVar("c", Variable(&tp.c));
+
+         tp.p.DefineVar("x", Variable(&tp.x));
+         tp.p.DefineVar("y", Variable(&tp.y));
+         tp.p.DefineVar("z", Variable(&tp.z));
+         tp.p.DefineVar("w", Variable(&tp.w));
+      }
+   }
+   catch(mup::ParserError &exc)
+   {
+      StopTimerAndReport(exc.GetMsg());
+      return m_fTime1;
+   }
+
+   return RunThreaded(nThreads, iCount, [&](int nThread, StartGate &gate, double &fRes) -> double
+   {
+      ThreadParser &tp = *vParser[nThread];
+
+      double fSum = 0;
+
+      try
+      {
+         fRes = tp.p.Eval().GetFloat();
+
+         gate.Arrive();
+
+         for (long j = 0; j < iCount; ++j)
+         {
+            fSum += tp.p.Eval().GetFloat();
+            std::swap(tp.a, tp.b);
+            std::swap(tp.x, tp.y);
+         }
+      }
+      catch(mup::ParserError &exc)
+      {
+         throw std::runtime_error(exc.GetMsg());
+      }
+
+      return fSum;
+   });
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time SetExpr and the first Eval, which is where muparserx creates its RPN. */
+double BenchMuParserX::DoCompileBenchmark(const std::string& sExpr, long iCount)
+{
+   using namespace mup;
+
+   ParserX p(pckALL_NON_COMPLEX);
+   p.EnableFastPath(m_bFastPath);
+
+   Value a((float_type)1.1);
+   Value b((float_type)2.2);
+   Value c((float_type)3.3);
+   Value x((float_type)2.123456);
+   Value y((float_type)3.123456);
+   Value z((float_type)4.123456);
+   Value w((float_type)5.123456);
+
+   try
+   {
+      p.DefineVar("a", Variable(&a));
+      p.DefineVar("b", Variable(&b));
+      p.DefineVar("c", Variable(&c));
+
+      p.DefineVar("x", Variable(&x));
+      p.DefineVar("y", Variable(&y));
+      p.DefineVar("z", Variable(&z));
+      p.DefineVar("w", Variable(&w));
+
+      StartCompileTimer();
+
+      for (long j = 0; j < iCount; ++j)
+      {
+         p.SetExpr(sExpr.c_str());
+         p.Eval();
+      }
+
+      return StopCompileTimer(iCount);
+   }
+   catch(mup::ParserError &exc)
+   {
+      return StopCompileTimerAndReport(exc.GetMsg());
+   }
+   catch(...)
+   {
+      return StopCompileTimerAndReport("unexpected exception");
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Counters of the thread local pools muparserx allocates its values from. */
+bool BenchMuParserX::GetPoolStats(PoolStats &stats) const
+{
+   const mup::ValuePoolStats pool = mup::ValuePool::GetStats();
+
+   stats.hits        = pool.hits;
+   stats.misses      = pool.misses;
+   stats.remoteFrees = pool.remoteFrees;
+   stats.live        = pool.live;
+   stats.peakLive    = pool.peakLive;
+   stats.bytes       = pool.bytes;
+   stats.pools       = pool.pools;
+   return true;
+}
+
 //-------------------------------------------------------------------------------------------------
 std::string BenchMuParserX::GetShortName() const
 {
-   return "muparserx";
+   return (m_bFastPath) ? "muparserx (real)" : "muparserx";
 }
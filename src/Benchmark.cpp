@@ -1,13 +1,82 @@
 #include "Benchmark.h"
+#include "MemoryCounter.h"
 
 #include <cassert>
 #include <cstdio>
 #include <ctime>
 #include <algorithm>
+#include <stdexcept>
+#include <thread>
 
 using namespace std;
 
 
+//-------------------------------------------------------------------------------------------------
+BatchColumns::BatchColumns(long nRows)
+: rows(nRows),
+  a(nRows),
+  b(nRows),
+  c(nRows, 3.3),
+  x(nRows),
+  y(nRows),
+  z(nRows, 4.123456),
+  w(nRows, 5.123456)
+{
+   double aa = 1.1;
+   double bb = 2.2;
+   double xx = 2.123456;
+   double yy = 3.123456;
+
+   for (long i = 0; i < nRows; ++i)
+   {
+      a[i] = aa;
+      b[i] = bb;
+      x[i] = xx;
+      y[i] = yy;
+
+      std::swap(aa, bb);
+      std::swap(xx, yy);
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+StartGate::StartGate(int nThreads)
+: m_nThreads(nThreads),
+  m_nArrived(0),
+  m_bOpen(false)
+{}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Signal that the calling worker is ready and block until the gate is opened. */
+void StartGate::Arrive()
+{
+   ++m_nArrived;
+
+   while (!m_bOpen.load(std::memory_order_acquire))
+      std::this_thread::yield();
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Called instead of Arrive() by a worker that failed during setup. */
+void StartGate::Abandon()
+{
+   ++m_nArrived;
+}
+
+//-------------------------------------------------------------------------------------------------
+void StartGate::WaitForAll() const
+{
+   while (m_nArrived.load(std::memory_order_acquire) < m_nThreads)
+      std::this_thread::yield();
+}
+
+//-------------------------------------------------------------------------------------------------
+void StartGate::Open()
+{
+   m_bOpen.store(true, std::memory_order_release);
+}
+
+
 //-------------------------------------------------------------------------------------------------
 Benchmark::Benchmark(EBaseType eBaseType)
 : m_sName(),
@@ -22,7 +91,21 @@ Benchmark::Benchmark(EBaseType eBaseType)
   m_bFail(false),
   m_sFailReason(),
   m_eBaseType(eBaseType),
-  m_allFails()
+  m_allFails(),
+  m_vSamples(),
+  m_stats(),
+  m_compileTimer(),
+  m_fCompileTime(0),
+  m_nCompileMemory(0),
+  m_bCountCompileMemory(false),
+  m_bCompileFail(false),
+  m_sCompileFailReason(),
+  m_nCompilePoints(0),
+  m_fCompileScore(0),
+  m_fWarmCompileTime(std::numeric_limits<double>::quiet_NaN()),
+  m_nMemoHits(0),
+  m_nMemoMisses(0),
+  m_fMemoTime(0)
 {
    rate_list.reserve(36000);
 }
@@ -67,16 +150,10 @@ std::string Benchmark::GetBaseType() const
   }
 }
 //-------------------------------------------------------------------------------------------------
-void Benchmark::PreprocessExpr(std::vector<std::string>&)
-{}
-
-//-------------------------------------------------------------------------------------------------
-void Benchmark::DoAll(std::vector<string> vExpr, long num)
+void Benchmark::DoAll(const ExprCorpus &vExpr, long num)
 {
    printf("\n\n\n");
 
-   PreprocessExpr(vExpr);
-
    char outstr[400], file[400];
    time_t t = time(NULL);
 
@@ -94,6 +171,10 @@ void Benchmark::DoAll(std::vector<string> vExpr, long num)
    fprintf(pRes,  "# Benchmark results\n");
    fprintf(pRes,  "#   Parser:  %s\n", GetName().c_str());
    fprintf(pRes,  "#   Evals per expr:  %ld\n", num);
+   fprintf(pRes,  "#   Timer:  %s (resolution %.3f ns, overhead %.3f ns)\n",
+           Stopwatch::GetBackendName(),
+           Stopwatch::GetResolution() * 1e9,
+           Stopwatch::GetOverhead() * 1e9);
    fprintf(pRes,  "#\"ms per eval [ms]\", \"evals per sec\", \"Result\", \"expr_len\", \"Expression\"\n");
 
    std::string sExpr;
@@ -102,16 +183,20 @@ void Benchmark::DoAll(std::vector<string> vExpr, long num)
    timer.Start();
    for (std::size_t i = 0; i < vExpr.size(); ++i)
    {
+      // One expression at a time, the corpus itself stays untouched in the mapped file.
+      sExpr.assign(vExpr[i].data, vExpr[i].size);
+      PreprocessExpr(sExpr);
+
       try
       {
-         DoBenchmark(vExpr[i], num);
-         fprintf(pRes, "%4.6lf, %4.6lf, %4.6lf, %d, %s, %s\n", m_fTime1, 1000.0/m_fTime1, m_fResult, (int)vExpr[i].length(), vExpr[i].c_str(), m_sInfo.c_str());
-         printf(       "%4.6lf, %4.6lf, %4.6lf, %d, %s, %s\n", m_fTime1, 1000.0/m_fTime1, m_fResult, (int)vExpr[i].length(), vExpr[i].c_str(), m_sInfo.c_str());
+         DoBenchmark(sExpr, num);
+         fprintf(pRes, "%4.6lf, %4.6lf, %4.6lf, %d, %s, %s\n", m_fTime1, 1000.0/m_fTime1, m_fResult, (int)sExpr.length(), sExpr.c_str(), m_sInfo.c_str());
+         printf(       "%4.6lf, %4.6lf, %4.6lf, %d, %s, %s\n", m_fTime1, 1000.0/m_fTime1, m_fResult, (int)sExpr.length(), sExpr.c_str(), m_sInfo.c_str());
       }
       catch(...)
       {
-         fprintf(pRes, "fail: %s\n", vExpr[i].c_str());
-         printf(       "fail: %s\n", vExpr[i].c_str());
+         fprintf(pRes, "fail: %s\n", sExpr.c_str());
+         printf(       "fail: %s\n", sExpr.c_str());
       }
 
       fflush(pRes);
@@ -131,12 +216,496 @@ void Benchmark::DoAll(std::vector<string> vExpr, long num)
    fclose(pRes);
 }
 
+//-------------------------------------------------------------------------------------------------
+/** \brief Run DoBenchmark nWarmup + nRepeat times and keep the per-eval time of the last nRepeat.
+
+  Afterwards GetTime() returns the median of the samples and GetStats() its spread, only one
+  rate is recorded for the expression. Stops at the first failing run. If pBatch is given
+  DoBenchmarkBatch is timed instead of DoBenchmark.
+*/
+double Benchmark::DoBenchmarkRepeated(const std::string &sExpr,
+                                      long iCount,
+                                      int nWarmup,
+                                      int nRepeat,
+                                      const BatchColumns *pBatch)
+{
+   m_vSamples.clear();
+   m_stats = SampleStats();
+
+   for (int i = 0; i < nWarmup + nRepeat; ++i)
+   {
+      if (i > 0)
+         IgnoreLastRate();
+
+      if (pBatch)
+         DoBenchmarkBatch(sExpr, *pBatch);
+      else
+         DoBenchmark(sExpr, iCount);
+
+      if (DidNotEvaluate())
+         return m_fTime1;
+
+      if (i >= nWarmup)
+         m_vSamples.push_back(m_fTime1);
+   }
+
+   m_stats  = ComputeStats(m_vSamples);
+   m_fTime1 = m_stats.median;
+
+   if (!rate_list.empty())
+      rate_list.back() = (double)iCount / m_fTime1;
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluate the expression once for every row of cols.
+
+  Parsers that support this override it; those without a native bulk interface copy each row
+  into their bound variables. The sum covers all rows, the result is the one of row 0.
+*/
+double Benchmark::DoBenchmarkBatch(const std::string &/*sExpr*/, const BatchColumns &/*cols*/)
+{
+   m_fResult     = 0;
+   m_fSum        = 0;
+   m_fTime1      = 0;
+   m_bFail       = true;
+   m_sFailReason = "batch evaluation not supported";
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluate the expression iCount times on each of nThreads threads concurrently.
+
+  Parsers that support this override it and hand an evaluation loop to RunThreaded. Afterwards
+  GetTime() is the wall clock time divided by the total number of evaluations, GetSum() is
+  the sum of a single thread.
+*/
+double Benchmark::DoBenchmarkThreaded(const std::string &/*sExpr*/, long /*iCount*/, int /*nThreads*/)
+{
+   m_fResult     = 0;
+   m_fSum        = 0;
+   m_fTime1      = 0;
+   m_bFail       = true;
+   m_sFailReason = "multi-threaded evaluation not supported";
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Run worker on nThreads threads and time them from the common start to the last join.
+
+  Each worker does its setup, calls gate.Arrive(), runs iCount evaluations on its own set of
+  variables and returns their sum. A worker signals a setup error by throwing. All threads
+  must return the same sum, otherwise the engine has shared mutable state and the run is
+  reported as failed.
+*/
+double Benchmark::RunThreaded(int nThreads, long iCount, const thread_worker_type &worker)
+{
+   StartGate gate(nThreads);
+   std::vector<double> vSum(nThreads, 0.0);
+   std::vector<double> vRes(nThreads, 0.0);
+   std::vector<std::string> vError(nThreads);
+   std::vector<std::thread> vThreads;
+
+   for (int t = 0; t < nThreads; ++t)
+   {
+      vThreads.push_back(std::thread([&, t]()
+      {
+         try
+         {
+            vSum[t] = worker(t, gate, vRes[t]);
+         }
+         catch (std::exception &e)
+         {
+            vError[t] = e.what();
+            gate.Abandon();
+         }
+         catch (...)
+         {
+            vError[t] = "unexpected exception";
+            gate.Abandon();
+         }
+      }));
+   }
+
+   gate.WaitForAll();
+   m_timer.Start();
+   gate.Open();
+
+   for (int t = 0; t < nThreads; ++t)
+   {
+      vThreads[t].join();
+   }
+
+   m_fTime1  = m_timer.Stop() / ((double)iCount * nThreads);
+   m_fResult = vRes[0];
+   m_fSum    = vSum[0];
+   m_bFail   = false;
+
+   for (int t = 0; t < nThreads; ++t)
+   {
+      if (!vError[t].empty())
+      {
+         m_bFail       = true;
+         m_sFailReason = vError[t];
+         break;
+      }
+
+      if (vSum[t] != vSum[0] || vRes[t] != vRes[0])
+      {
+         m_bFail       = true;
+         m_sFailReason = "results differ between threads";
+         break;
+      }
+   }
+
+   return m_fTime1;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Measure how long it takes to turn the expression into something evaluable.
+
+  Parsers that support this override it, prepare their variables and then time iCount
+  compilations between StartCompileTimer and StopCompileTimer. The evaluation results of
+  DoBenchmark are left untouched.
+*/
+double Benchmark::DoCompileBenchmark(const std::string &/*sExpr*/, long /*iCount*/)
+{
+   m_fCompileTime       = 0;
+   m_nCompileMemory     = 0;
+   m_bCompileFail       = true;
+   m_sCompileFailReason = "compile benchmark not supported";
+   return std::numeric_limits<double>::quiet_NaN();
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time iCount compilations with DoCompileBenchmark, then measure the peak heap of one
+           more, untimed compilation.
+
+  The bookkeeping of MemoryCounter costs a lock and a map update per allocation, so it would
+  penalize parsers allocating per node if it ran during the timed loop.
+*/
+double Benchmark::DoCompileBenchmarkWithMemory(const std::string &sExpr, long iCount)
+{
+   const double fTime = DoCompileBenchmark(sExpr, iCount);
+
+   if (m_bCompileFail || !MemoryCounter::IsAvailable())
+      return fTime;
+
+   const double fCompileTime = m_fCompileTime;
+
+   m_bCountCompileMemory = true;
+   DoCompileBenchmark(sExpr, 1);
+   m_bCountCompileMemory = false;
+
+   m_fCompileTime = fCompileTime;
+   m_bCompileFail = false;
+   return fTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Measure how long it takes to obtain the evaluable form from the expression cache.
+
+  This is the warm counterpart of DoCompileBenchmark. The first lookup, which compiles the
+  expression unless PrewarmExprCache already did, is not timed. Parsers without an expression
+  cache leave GetWarmCompileTime at NaN.
+*/
+double Benchmark::DoWarmCompileBenchmark(const std::string &sExpr, long iCount)
+{
+   m_fWarmCompileTime = std::numeric_limits<double>::quiet_NaN();
+
+   if (iCount <= 0 || !LookupCompiled(sExpr))
+      return m_fWarmCompileTime;
+
+   Stopwatch timer;
+   timer.Start();
+
+   for (long j = 0; j < iCount; ++j)
+   {
+      LookupCompiled(sExpr);
+   }
+
+   m_fWarmCompileTime = timer.Stop() / (double)iCount;
+   return m_fWarmCompileTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compile all expressions into the expression cache of the parser.
+
+  Returns the number of cached expressions, 0 for parsers without a cache.
+*/
+std::size_t Benchmark::PrewarmExprCache(const std::vector<std::string> &/*vExpr*/)
+{
+   return 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Counters of the expression cache, false if the parser has none. */
+bool Benchmark::GetExprCacheStats(ExprCacheStats &/*stats*/) const
+{
+   return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+PoolStats::PoolStats()
+  :hits(0)
+  ,misses(0)
+  ,remoteFrees(0)
+  ,live(0)
+  ,peakLive(0)
+  ,bytes(0)
+  ,pools(0)
+{}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Counters of the memory pool the parser allocates from, false if it has none.
+
+  The counters are process wide, they include all instances of the parser.
+*/
+bool Benchmark::GetPoolStats(PoolStats &/*stats*/) const
+{
+   return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+StartupResult::StartupResult()
+  :supported(false)
+  ,formulas(0)
+  ,failed(0)
+  ,mismatches(0)
+  ,bytes(0)
+  ,coldTime(0)
+  ,saveTime(0)
+  ,warmTime(0)
+  ,failReason()
+{}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compare the startup of an application with the formulas vExpr: compiling all of
+           them versus restoring their compiled forms from sFile.
+
+  Parsers able to persist their compiled form override this. They compile and optimize every
+  formula (coldTime), write the results to sFile (saveTime), and read them back into fresh
+  parser objects (warmTime). The restored formulas are checked against the compiled ones.
+*/
+StartupResult Benchmark::DoStartupBenchmark(const std::vector<std::string> &/*vExpr*/,
+                                            const std::string &/*sFile*/)
+{
+   StartupResult res;
+   res.failReason = "persisting compiled expressions not supported";
+   return res;
+}
+
+//-------------------------------------------------------------------------------------------------
+FootprintResult::FootprintResult()
+  :supported(false)
+  ,formulas(0)
+  ,failed(0)
+  ,bytes(0)
+  ,compileTime(0)
+  ,evalTime(0)
+  ,sum(0)
+  ,failReason()
+{}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compile all formulas of vExpr, keep them alive at the same time and measure the
+           heap they take with MemoryCounter.
+
+  This is the memory an application holding vExpr.size() formulas pays for the compiled
+  forms alone, parser objects that are only needed for compiling are not included.
+  The default implementation reports the parser as not supported.
+*/
+FootprintResult Benchmark::DoFootprintBenchmark(const std::vector<std::string> &/*vExpr*/)
+{
+   FootprintResult res;
+   res.failReason = "footprint benchmark not supported";
+   return res;
+}
+
+//-------------------------------------------------------------------------------------------------
+GradientResult::GradientResult()
+  :supported(false)
+  ,variables(0)
+  ,value(0)
+  ,gradientSum(0)
+  ,deviation(0)
+  ,adTime(0)
+  ,symbolicTime(0)
+  ,failReason()
+{}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Compute the value of sExpr and its partial derivatives with respect to the variables
+           a, b, c, x, y, z and w iCount times.
+
+  Parsers able to differentiate override this. They time an automatic differentiation sweep
+  returning value and gradient at once (adTime) against evaluating the expression and the
+  symbolic derivative for every variable one after another (symbolicTime), and report how far
+  the partial derivatives of both methods deviate. The default implementation reports the
+  parser as not supported.
+*/
+GradientResult Benchmark::DoGradientBenchmark(const std::string &/*sExpr*/, long /*iCount*/)
+{
+   GradientResult res;
+   res.failReason = "differentiation not supported";
+   return res;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Fetch the compiled form of sExpr from the expression cache.
+
+  Returns false if the parser has no cache or the expression does not compile.
+*/
+bool Benchmark::LookupCompiled(const std::string &/*sExpr*/)
+{
+   return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+void Benchmark::StartCompileTimer()
+{
+   if (m_bCountCompileMemory)
+      MemoryCounter::Start();
+
+   m_compileTimer.Start();
+}
+
+//-------------------------------------------------------------------------------------------------
+double Benchmark::StopCompileTimer(long iCount)
+{
+   m_fCompileTime   = m_compileTimer.Stop() / (double)iCount;
+   m_nCompileMemory = m_bCountCompileMemory ? MemoryCounter::Stop() : 0;
+   m_bCompileFail   = false;
+   return m_fCompileTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+double Benchmark::StopCompileTimerAndReport(const std::string &msg)
+{
+   m_compileTimer.Stop();
+   if (m_bCountCompileMemory)
+      MemoryCounter::Stop();
+
+   m_fCompileTime       = 0;
+   m_nCompileMemory     = 0;
+   m_bCompileFail       = true;
+   m_sCompileFailReason = msg;
+   return std::numeric_limits<double>::quiet_NaN();
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time per cache lookup in ms of the last DoWarmCompileBenchmark, NaN if unsupported. */
+double Benchmark::GetWarmCompileTime() const
+{
+   return m_fWarmCompileTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Time per compilation in ms of the last DoCompileBenchmark. */
+double Benchmark::GetCompileTime() const
+{
+   return m_fCompileTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Peak heap usage in bytes during the last DoCompileBenchmark. */
+std::size_t Benchmark::GetCompileMemory() const
+{
+   return m_nCompileMemory;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool Benchmark::CompileFailed() const
+{
+   return m_bCompileFail;
+}
+
+//-------------------------------------------------------------------------------------------------
+const std::string &Benchmark::GetCompileFailReason() const
+{
+   return m_sCompileFailReason;
+}
+
+//-------------------------------------------------------------------------------------------------
+void Benchmark::AddCompilePoints(int pt)
+{
+   m_nCompilePoints += pt;
+}
+
+//-------------------------------------------------------------------------------------------------
+int Benchmark::GetCompilePoints() const
+{
+   return m_nCompilePoints;
+}
+
+//-------------------------------------------------------------------------------------------------
+void Benchmark::AddCompileScore(double sc)
+{
+   m_fCompileScore += sc;
+}
+
+//-------------------------------------------------------------------------------------------------
+double Benchmark::GetCompileScore() const
+{
+   return m_fCompileScore;
+}
+
+//-------------------------------------------------------------------------------------------------
+const std::vector<double> &Benchmark::GetSamples() const
+{
+   return m_vSamples;
+}
+
+//-------------------------------------------------------------------------------------------------
+const SampleStats &Benchmark::GetStats() const
+{
+   return m_stats;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Account the lookups of a memoizing benchmark run, call after StopTimer. */
+void Benchmark::AddMemoStats(const MemoCache &cache)
+{
+   const std::size_t nEvals = cache.GetHits() + cache.GetMisses();
+
+   m_nMemoHits   += cache.GetHits();
+   m_nMemoMisses += cache.GetMisses();
+   m_fMemoTime   += m_fTime1 * nEvals;
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t Benchmark::GetMemoHits() const
+{
+   return m_nMemoHits;
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t Benchmark::GetMemoMisses() const
+{
+   return m_nMemoMisses;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Evaluations per second including cache hits, in millions. */
+double Benchmark::GetMemoThroughput() const
+{
+   return (m_fMemoTime > 0) ? 0.001 * (m_nMemoHits + m_nMemoMisses) / m_fMemoTime : 0.0;
+}
+
 //-------------------------------------------------------------------------------------------------
 std::string Benchmark::GetName() const
 {
    return m_sName;
 }
 
+//-------------------------------------------------------------------------------------------------
+/** \brief Engine configuration worth noting in the result file, empty if there is none. */
+const std::string &Benchmark::GetInfo() const
+{
+   return m_sInfo;
+}
+
 //-------------------------------------------------------------------------------------------------
 std::string Benchmark::GetShortName() const
 {
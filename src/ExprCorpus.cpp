@@ -0,0 +1,273 @@
+#include "ExprCorpus.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef WIN32
+#   ifndef NOMINMAX
+#      define NOMINMAX
+#   endif
+#   ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+
+namespace
+{
+   // Layout of <file>.idx: this header followed by nCount entries.
+   struct IndexHeader
+   {
+      char magic[8];
+      unsigned long long nFileSize;
+      long long nModified;
+      unsigned long long nCount;
+      unsigned int nEntrySize;
+      unsigned int nReserved;
+   };
+
+   const char s_sIndexMagic[8] = { 'E', 'X', 'P', 'R', 'I', 'D', 'X', '1' };
+
+   std::string IndexFileName(const std::string &sFile)
+   {
+      return sFile + ".idx";
+   }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+ExprCorpus::ExprCorpus()
+  :m_pData(nullptr)
+  ,m_nSize(0)
+  ,m_nModified(0)
+  ,m_vIndex()
+  ,m_bIndexFromCache(false)
+#ifdef WIN32
+  ,m_hFile(INVALID_HANDLE_VALUE)
+  ,m_hMapping(nullptr)
+#else
+  ,m_fd(-1)
+#endif
+{}
+
+//-------------------------------------------------------------------------------------------------
+ExprCorpus::~ExprCorpus()
+{
+   Close();
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Map sFile and build or load the index of its expressions.
+
+  Returns false if the file can not be opened or mapped.
+*/
+bool ExprCorpus::Load(const std::string &sFile)
+{
+   Close();
+
+   if (!Map(sFile))
+      return false;
+
+   if (ReadIndex(sFile))
+   {
+      m_bIndexFromCache = true;
+   }
+   else
+   {
+      Scan();
+      WriteIndex(sFile);
+   }
+
+   return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+void ExprCorpus::Close()
+{
+#ifdef WIN32
+   if (m_pData)
+      UnmapViewOfFile(m_pData);
+
+   if (m_hMapping)
+      CloseHandle((HANDLE)m_hMapping);
+
+   if (m_hFile != INVALID_HANDLE_VALUE)
+      CloseHandle((HANDLE)m_hFile);
+
+   m_hMapping = nullptr;
+   m_hFile = INVALID_HANDLE_VALUE;
+#else
+   if (m_pData)
+      munmap((void*)m_pData, m_nSize);
+
+   if (m_fd >= 0)
+      close(m_fd);
+
+   m_fd = -1;
+#endif
+
+   m_pData = nullptr;
+   m_nSize = 0;
+   m_nModified = 0;
+   m_vIndex.clear();
+   m_bIndexFromCache = false;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Map the whole file read only, an empty file is valid and has no mapping. */
+bool ExprCorpus::Map(const std::string &sFile)
+{
+#ifdef WIN32
+   HANDLE hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (hFile == INVALID_HANDLE_VALUE)
+      return false;
+
+   m_hFile = hFile;
+
+   LARGE_INTEGER size;
+   FILETIME modified;
+   if (!GetFileSizeEx(hFile, &size) || !GetFileTime(hFile, nullptr, nullptr, &modified))
+      return false;
+
+   m_nSize = (std::size_t)size.QuadPart;
+   m_nModified = ((long long)modified.dwHighDateTime << 32) | modified.dwLowDateTime;
+
+   if (m_nSize == 0)
+      return true;
+
+   m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (!m_hMapping)
+      return false;
+
+   m_pData = (const char*)MapViewOfFile((HANDLE)m_hMapping, FILE_MAP_READ, 0, 0, 0);
+   return m_pData != nullptr;
+#else
+   m_fd = open(sFile.c_str(), O_RDONLY);
+   if (m_fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(m_fd, &st) != 0)
+      return false;
+
+   m_nSize = (std::size_t)st.st_size;
+   #ifdef __linux__
+   m_nModified = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+   #else
+   m_nModified = (long long)st.st_mtime;
+   #endif
+
+   if (m_nSize == 0)
+      return true;
+
+   void *p = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+   if (p == MAP_FAILED)
+      return false;
+
+   // The file is read front to back once, either by Scan or by the benchmark.
+   madvise(p, m_nSize, MADV_SEQUENTIAL);
+
+   m_pData = (const char*)p;
+   return true;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Find all lines that hold an expression. */
+void ExprCorpus::Scan()
+{
+   m_vIndex.clear();
+
+   const char *pBegin = m_pData;
+   const char *pEnd   = m_pData + m_nSize;
+
+   for (const char *pLine = pBegin; pLine < pEnd; )
+   {
+      const char *pEol = (const char*)memchr(pLine, '\n', pEnd - pLine);
+      if (!pEol)
+         pEol = pEnd;
+
+      std::size_t nLen = pEol - pLine;
+      if (nLen > 0 && pLine[nLen - 1] == '\r')
+         --nLen;
+
+      if (nLen > 0 && pLine[0] != '#')
+      {
+         Entry e;
+         e.offset = (unsigned long long)(pLine - pBegin);
+         e.length = (unsigned int)nLen;
+         e.reserved = 0;
+         m_vIndex.push_back(e);
+      }
+
+      pLine = pEol + 1;
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Load the cached index, false if there is none or it belongs to another file version. */
+bool ExprCorpus::ReadIndex(const std::string &sFile)
+{
+   FILE *pFile = fopen(IndexFileName(sFile).c_str(), "rb");
+   if (!pFile)
+      return false;
+
+   IndexHeader header;
+   bool bOk = fread(&header, sizeof(header), 1, pFile) == 1
+           && memcmp(header.magic, s_sIndexMagic, sizeof(s_sIndexMagic)) == 0
+           && header.nFileSize == m_nSize
+           && header.nModified == m_nModified
+           && header.nEntrySize == sizeof(Entry)
+           && header.nCount <= m_nSize;
+
+   if (bOk)
+   {
+      m_vIndex.resize((std::size_t)header.nCount);
+      bOk = m_vIndex.empty() || fread(&m_vIndex[0], sizeof(Entry), m_vIndex.size(), pFile) == m_vIndex.size();
+   }
+
+   for (std::size_t i = 0; bOk && i < m_vIndex.size(); ++i)
+   {
+      bOk = m_vIndex[i].offset + m_vIndex[i].length <= m_nSize;
+   }
+
+   fclose(pFile);
+
+   if (!bOk)
+      m_vIndex.clear();
+
+   return bOk;
+}
+
+//-------------------------------------------------------------------------------------------------
+void ExprCorpus::WriteIndex(const std::string &sFile) const
+{
+   FILE *pFile = fopen(IndexFileName(sFile).c_str(), "wb");
+   if (!pFile)
+      return;
+
+   IndexHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, s_sIndexMagic, sizeof(s_sIndexMagic));
+   header.nFileSize  = m_nSize;
+   header.nModified  = m_nModified;
+   header.nCount     = m_vIndex.size();
+   header.nEntrySize = sizeof(Entry);
+
+   bool bOk = fwrite(&header, sizeof(header), 1, pFile) == 1;
+   if (bOk && !m_vIndex.empty())
+      bOk = fwrite(&m_vIndex[0], sizeof(Entry), m_vIndex.size(), pFile) == m_vIndex.size();
+
+   fclose(pFile);
+
+   // Never leave a truncated index behind.
+   if (!bOk)
+      remove(IndexFileName(sFile).c_str());
+}
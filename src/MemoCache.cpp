@@ -0,0 +1,57 @@
+#include "MemoCache.h"
+
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Create an empty cache, nSlots is rounded up to a power of two. */
+MemoCache::MemoCache(std::size_t nSlots)
+: m_nMask(0),
+  m_vVars(),
+  m_vSlotKey(),
+  m_vResult(),
+  m_vValid(),
+  m_nHits(0),
+  m_nMisses(0)
+{
+   std::size_t n = 1;
+   while (n < nSlots)
+      n <<= 1;
+
+   m_nMask = n - 1;
+   m_vResult.resize(n);
+   m_vValid.resize(n);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Set the variables the cached expression depends on, all entries are invalidated. */
+void MemoCache::Bind(const std::vector<const double*> &vVars)
+{
+   m_vVars = vVars;
+   m_vSlotKey.assign(vVars.size() * m_vResult.size(), 0);
+   m_vValid.assign(m_vValid.size(), 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t MemoCache::GetHits() const
+{
+   return m_nHits;
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t MemoCache::GetMisses() const
+{
+   return m_nMisses;
+}
+
+//-------------------------------------------------------------------------------------------------
+double MemoCache::GetHitRate() const
+{
+   const std::size_t n = m_nHits + m_nMisses;
+   return (n > 0) ? (double)m_nHits / (double)n : 0.0;
+}
+
+//-------------------------------------------------------------------------------------------------
+void MemoCache::ResetStats()
+{
+   m_nHits = 0;
+   m_nMisses = 0;
+}
@@ -0,0 +1,229 @@
+#include "MemoryCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#define MEMCOUNTER_BLOCK_SIZE(p) _msize(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define MEMCOUNTER_BLOCK_SIZE(p) malloc_size(p)
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#define MEMCOUNTER_BLOCK_SIZE(p) malloc_usable_size(p)
+#endif
+
+
+namespace
+{
+   /** \brief Allocator of the block map, it must not go through the counted operator new. */
+   template<typename T>
+   struct MallocAllocator
+   {
+      typedef T value_type;
+
+      MallocAllocator() {}
+
+      template<typename U>
+      MallocAllocator(const MallocAllocator<U>&) {}
+
+      T* allocate(std::size_t n)
+      {
+         void *p = std::malloc(n * sizeof(T));
+         if (!p)
+            throw std::bad_alloc();
+         return static_cast<T*>(p);
+      }
+
+      void deallocate(T *p, std::size_t)
+      {
+         std::free(p);
+      }
+
+      template<typename U>
+      bool operator==(const MallocAllocator<U>&) const { return true; }
+
+      template<typename U>
+      bool operator!=(const MallocAllocator<U>&) const { return false; }
+   };
+
+   typedef std::unordered_map<void*, long long, std::hash<void*>, std::equal_to<void*>,
+                              MallocAllocator<std::pair<void* const, long long> > > BlockMap;
+
+   std::atomic<bool> g_bEnabled(false);
+   std::mutex        g_lock;
+   long long         g_nCurrent = 0;
+   long long         g_nPeak    = 0;
+
+   // Blocks allocated since Start() and their size, freeing a block allocated before
+   // Start() must not lower the current level.
+   BlockMap          g_blocks;
+
+#ifdef MEMCOUNTER_BLOCK_SIZE
+   inline void on_alloc(void *p)
+   {
+      if (!p || !g_bEnabled.load(std::memory_order_relaxed))
+         return;
+
+      const long long n = (long long)MEMCOUNTER_BLOCK_SIZE(p);
+
+      std::lock_guard<std::mutex> lock(g_lock);
+      g_blocks[p] = n;
+      g_nCurrent += n;
+      if (g_nCurrent > g_nPeak)
+         g_nPeak = g_nCurrent;
+   }
+
+   inline void on_free(void *p)
+   {
+      if (!p || !g_bEnabled.load(std::memory_order_relaxed))
+         return;
+
+      std::lock_guard<std::mutex> lock(g_lock);
+      BlockMap::iterator it = g_blocks.find(p);
+      if (it == g_blocks.end())
+         return;
+
+      g_nCurrent -= it->second;
+      g_blocks.erase(it);
+   }
+#else
+   inline void on_alloc(void *) {}
+   inline void on_free(void *) {}
+#endif
+
+   void* counted_alloc(std::size_t n)
+   {
+      for (;;)
+      {
+         void *p = std::malloc(n ? n : 1);
+
+         if (p)
+         {
+            on_alloc(p);
+            return p;
+         }
+
+         std::new_handler handler = std::get_new_handler();
+         if (!handler)
+            return 0;
+
+         handler();
+      }
+   }
+
+   void counted_free(void *p)
+   {
+      on_free(p);
+      std::free(p);
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+// Replacements of the global allocation functions.
+
+void* operator new(std::size_t n)
+{
+   void *p = counted_alloc(n);
+   if (!p)
+      throw std::bad_alloc();
+   return p;
+}
+
+void* operator new[](std::size_t n)
+{
+   void *p = counted_alloc(n);
+   if (!p)
+      throw std::bad_alloc();
+   return p;
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+   return counted_alloc(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept
+{
+   return counted_alloc(n);
+}
+
+void operator delete(void *p) noexcept
+{
+   counted_free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+   counted_free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+   counted_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+   counted_free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, std::size_t) noexcept
+{
+   counted_free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+   counted_free(p);
+}
+#endif
+
+//-------------------------------------------------------------------------------------------------
+bool MemoryCounter::IsAvailable()
+{
+#ifdef MEMCOUNTER_BLOCK_SIZE
+   return true;
+#else
+   return false;
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Begin a measured section, the current heap level becomes the zero line. */
+void MemoryCounter::Start()
+{
+   {
+      std::lock_guard<std::mutex> lock(g_lock);
+      g_blocks.clear();
+      g_nCurrent = 0;
+      g_nPeak    = 0;
+   }
+
+   g_bEnabled.store(true);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Bytes allocated since Start() that are still held. */
+std::size_t MemoryCounter::Current()
+{
+   std::lock_guard<std::mutex> lock(g_lock);
+   return (std::size_t)g_nCurrent;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief End the measured section and return the peak number of bytes allocated in it. */
+std::size_t MemoryCounter::Stop()
+{
+   g_bEnabled.store(false);
+
+   std::lock_guard<std::mutex> lock(g_lock);
+   BlockMap().swap(g_blocks);
+   return (std::size_t)g_nPeak;
+}
@@ -4,9 +4,9 @@
 #include <cstdio>
 #include <ctime>
 #include <deque>
-#include <fstream>
 #include <iostream>
 #include <map>
+#include <thread>
 
 #ifdef _MSC_VER
  #ifndef NOMINMAX
@@ -21,8 +21,10 @@
 #endif
 
 #include "FormelGenerator.h"
+#include "ExprCorpus.h"
 #include "cpuid.h"
 #include "Benchmark.h"
+#include "MemoryCounter.h"
 #include "BenchMuParserX.h"
 #include "BenchMuParser2.h"
 #include "BenchATMSP.h"
@@ -40,7 +42,7 @@
 #include "BenchMTParser.h"
 #endif
 
-#ifdef _MSC_VER
+#if defined(_MSC_VER) || (defined(__x86_64__) && defined(__linux__))
 #include "BenchMuParserSSE.h"
 #endif
 
@@ -58,29 +60,6 @@ inline bool is_equal(const T v0, const T v1)
    return (std::abs(v0 - v1) <= (std::max(T(1),std::max(std::abs(v0),std::abs(v1))) * epsilon)) ? true : false;
 }
 
-std::vector<std::string> load_expressions(const std::string& file_name)
-{
-   std::vector<std::string> result;
-
-   std::ifstream stream(file_name.c_str());
-
-   if (stream)
-   {
-      std::string buffer;
-      while (std::getline(stream,buffer))
-      {
-         if (buffer.empty())
-            continue;
-         else if ('#' == buffer[0])
-            continue;
-         else
-            result.push_back(buffer);
-      }
-   }
-
-   return result;
-}
-
 void output(FILE *pFile, const char *fmt, ...)
 {
   va_list args;
@@ -100,7 +79,7 @@ void output(FILE *pFile, const char *fmt, ...)
   fflush(nullptr);
 }
 
-void WriteResultTable(FILE* pRes, std::vector<Benchmark*>& vBenchmarks, std::vector<std::string>& vExpr)
+void WriteResultTable(FILE* pRes, std::vector<Benchmark*>& vBenchmarks, const ExprCorpus& vExpr)
 {
    output(pRes, "\n\n\n");
 
@@ -118,7 +97,7 @@ void WriteResultTable(FILE* pRes, std::vector<Benchmark*>& vBenchmarks, std::vec
          output(pRes, "%13.3f\t", vBenchmarks[j]->GetRate(i));
       }
 
-      output(pRes, "%s\t\n",vExpr[i].c_str());
+      output(pRes, "%.*s\t\n", vExpr[i].length(), vExpr[i].data);
    }
 
    output(pRes, "\n\n\n");
@@ -126,9 +105,13 @@ void WriteResultTable(FILE* pRes, std::vector<Benchmark*>& vBenchmarks, std::vec
 
 void Shootout(const std::string &sCaption,
               std::vector<Benchmark*> vBenchmarks,
-              std::vector<std::string> vExpr,
+              const ExprCorpus &vExpr,
               int iCount,
-              bool writeResultTable = false)
+              bool writeResultTable = false,
+              int nRepeat = 1,
+              int nWarmup = 0,
+              int nCompile = 0,
+              bool bBatch = false)
 {
    char outstr[1024] = {0};
    char file  [1024] = {0};
@@ -142,15 +125,51 @@ void Shootout(const std::string &sCaption,
    assert(pRes);
 
    output(pRes, "Benchmark (Shootout for file \"%s\")\n", sCaption.c_str());
+   output(pRes, "Timer: %s (resolution %.3f ns, overhead %.3f ns per measurement)\n",
+          Stopwatch::GetBackendName(),
+          Stopwatch::GetResolution() * 1e9,
+          Stopwatch::GetOverhead() * 1e9);
 
    Benchmark* pRefBench = vBenchmarks[0];
 
+   // In batch mode every parser evaluates the same iCount rows of SoA input instead of
+   // running its scalar loop. The reference result still comes from DoBenchmark.
+   const BatchColumns batch(bBatch ? iCount : 0);
+
    std::map<double, std::vector<Benchmark*>> results;
+   std::map<double, std::vector<Benchmark*>> compile_results;
+
+   // Per parser accumulated compile time [ms] and largest compile memory peak [bytes].
+   std::vector<double>      vCompileTimeSum(vBenchmarks.size(), 0.0);
+   std::vector<int>         vCompileCount(vBenchmarks.size(), 0);
+   std::vector<std::size_t> vCompileMemMax(vBenchmarks.size(), 0);
+
+   // Per parser accumulated time [ms] of fetching the compiled form from the expression cache.
+   std::vector<double>      vWarmTimeSum(vBenchmarks.size(), 0.0);
+   std::vector<int>         vWarmCount(vBenchmarks.size(), 0);
+
+   // Parsers with an expression cache compile the whole file up front, the warm compile
+   // measurement then consists of cache hits only (unless the file exceeds the capacity).
+   if (nCompile > 0)
+   {
+      for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+      {
+         std::vector<std::string> vPrewarm(vExpr.size());
+         for (std::size_t i = 0; i < vExpr.size(); ++i)
+         {
+            vPrewarm[i] = vExpr[i].str();
+            vBenchmarks[j]->PreprocessExpr(vPrewarm[i]);
+            vPrewarm[i] += " ";
+         }
+
+         vBenchmarks[j]->PrewarmExprCache(vPrewarm);
+      }
+   }
 
    for (std::size_t i = 0; i < vExpr.size(); ++i)
    {
       std::size_t failure_count = 0;
-      const std::string current_expr = vExpr[i];
+      const std::string current_expr = vExpr[i].str();
 
       output(pRes, "\nExpression %d of %d: \"%s\"; Progress: ",
              (int)(i + 1),
@@ -197,14 +216,20 @@ void Shootout(const std::string &sCaption,
          // constants.
          pBench->PreprocessExpr(sExpr);
 
-         double time = 1000000.0 * pBench->DoBenchmark(sExpr + " ", iCount);
+         // With nRepeat > 1 the time is the median of all repetitions; a parser is only
+         // ranked ahead of another if the confidence intervals of the medians are disjoint.
+         double time = 1000000.0 * pBench->DoBenchmarkRepeated(sExpr + " ",
+                                                                iCount,
+                                                                nWarmup,
+                                                                nRepeat,
+                                                                bBatch ? &batch : nullptr);
 
          // The first parser is used for obtaining reference results.
          // If the reference result is a NaA the reference parser is
          // disqualified too.
          if (pBench->DidNotEvaluate())
          {
-            pBench->AddFail(vExpr[i]);
+            pBench->AddFail(current_expr);
             ++failure_count;
          }
          else if (
@@ -216,17 +241,42 @@ void Shootout(const std::string &sCaption,
          {
             // Check the sum of all results and if the sum is ok,
             // check the last result of the benchmark run.
-            pBench->AddFail(vExpr[i]);
+            pBench->AddFail(current_expr);
             ++failure_count;
          }
 
          results[time].push_back(pBench);
+
+         // Second phase: time the creation of the evaluable form of the expression. Only
+         // parsers that evaluated the expression correctly take part in the ranking.
+         if (nCompile > 0)
+         {
+            pBench->DoCompileBenchmarkWithMemory(sExpr + " ", nCompile);
+            pBench->DoWarmCompileBenchmark(sExpr + " ", nCompile);
+
+            if (!pBench->CompileFailed() && !pBench->ExpressionFailed(current_expr))
+            {
+               compile_results[pBench->GetCompileTime()].push_back(pBench);
+               vCompileTimeSum[j] += pBench->GetCompileTime();
+               vCompileMemMax[j]   = std::max(vCompileMemMax[j], pBench->GetCompileMemory());
+               ++vCompileCount[j];
+
+               if (pBench->GetWarmCompileTime() == pBench->GetWarmCompileTime())
+               {
+                  vWarmTimeSum[j] += pBench->GetWarmCompileTime();
+                  ++vWarmCount[j];
+               }
+            }
+         }
       }
 
       output(pRes, "\n");
 
       int ct = 1;
       int parser_index = 0;
+      int tie_ct = 0;
+      int tie_index = 0;
+      const Benchmark* pTieLeader = nullptr;
       for (auto it = results.begin(); it != results.end(); ++it)
       {
          const std::vector<Benchmark*>& vBench = it->second;
@@ -240,15 +290,42 @@ void Shootout(const std::string &sCaption,
                continue;
             }
 
-            pBench->AddPoints(vBenchmarks.size() - ct + 1);
+            ++parser_index;
+
+            // Parsers whose confidence interval overlaps the one of the fastest parser of the
+            // current group are considered equally fast and share its points.
+            if (!pTieLeader || !pBench->GetStats().Overlaps(pTieLeader->GetStats()))
+            {
+               pTieLeader = pBench;
+               tie_ct     = ct;
+               tie_index  = parser_index;
+            }
+
+            pBench->AddPoints(vBenchmarks.size() - tie_ct + 1);
             pBench->AddScore(pRefBench->GetTime() / pBench->GetTime() );
 
-            output(pRes, "[%02d] %-20s (%9.3f ns, %26.18f, %26.18f)\n",
-                   static_cast<int>(++parser_index),
-                   pBench->GetShortName().c_str(),
-                   it->first,
-                   pBench->GetRes(),
-                   pBench->GetSum());
+            if (nRepeat > 1)
+            {
+               const SampleStats& stats = pBench->GetStats();
+               output(pRes, "[%02d] %-20s (%9.3f ns, MAD %8.3f ns, CI [%9.3f, %9.3f] ns, %26.18f, %26.18f)\n",
+                      tie_index,
+                      pBench->GetShortName().c_str(),
+                      it->first,
+                      1000000.0 * stats.mad,
+                      1000000.0 * stats.ci_lo,
+                      1000000.0 * stats.ci_hi,
+                      pBench->GetRes(),
+                      pBench->GetSum());
+            }
+            else
+            {
+               output(pRes, "[%02d] %-20s (%9.3f ns, %26.18f, %26.18f)\n",
+                      parser_index,
+                      pBench->GetShortName().c_str(),
+                      it->first,
+                      pBench->GetRes(),
+                      pBench->GetSum());
+            }
          }
 
          ct += vBench.size();
@@ -292,6 +369,60 @@ void Shootout(const std::string &sCaption,
          }
       }
 
+      if (nCompile > 0)
+      {
+         output(pRes, "Compile:\n");
+
+         int compile_ct    = 1;
+         int compile_index = 0;
+         for (auto it = compile_results.begin(); it != compile_results.end(); ++it)
+         {
+            const std::vector<Benchmark*>& vBench = it->second;
+
+            for (std::size_t k = 0; k < vBench.size(); ++k)
+            {
+               Benchmark* pBench = vBench[k];
+
+               pBench->AddCompilePoints(vBenchmarks.size() - compile_ct + 1);
+
+               if (!pRefBench->CompileFailed())
+                  pBench->AddCompileScore(pRefBench->GetCompileTime() / pBench->GetCompileTime());
+
+               if (pBench->GetWarmCompileTime() == pBench->GetWarmCompileTime())
+               {
+                  output(pRes, "[%02d] %-20s (%9.3f us, peak %9.1f KB, warm %9.3f us)\n",
+                         ++compile_index,
+                         pBench->GetShortName().c_str(),
+                         1000.0 * it->first,
+                         pBench->GetCompileMemory() / 1024.0,
+                         1000.0 * pBench->GetWarmCompileTime());
+               }
+               else
+               {
+                  output(pRes, "[%02d] %-20s (%9.3f us, peak %9.1f KB)\n",
+                         ++compile_index,
+                         pBench->GetShortName().c_str(),
+                         1000.0 * it->first,
+                         pBench->GetCompileMemory() / 1024.0);
+               }
+            }
+
+            compile_ct += vBench.size();
+         }
+
+         for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+         {
+            if (vBenchmarks[j]->CompileFailed() && !vBenchmarks[j]->ExpressionFailed(current_expr))
+            {
+               output(pRes, "[--] %-20s (%s)\n",
+                      vBenchmarks[j]->GetShortName().c_str(),
+                      vBenchmarks[j]->GetCompileFailReason().c_str());
+            }
+         }
+
+         compile_results.clear();
+      }
+
       if (failure_count > 2)
       {
          output(pRes, "**** ERROR ****   Excessive number of evaluation failures!  [%d]\n\n",
@@ -307,6 +438,17 @@ void Shootout(const std::string &sCaption,
    output(pRes, "  - Reference parser is %s\n"       , pRefBench->GetShortName().c_str());
    output(pRes, "  - Iterations per expression: %d\n", iCount);
    output(pRes, "  - Number of expressions: %d\n"    , vExpr.size());
+   if (bBatch)
+   output(pRes, "  - Batch evaluation of %d rows (structure of arrays)\n", iCount);
+   for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+   {
+      if (!vBenchmarks[j]->GetInfo().empty())
+      output(pRes, "  - %s: %s\n", vBenchmarks[j]->GetShortName().c_str(), vBenchmarks[j]->GetInfo().c_str());
+   }
+   if (nCompile > 0)
+   output(pRes, "  - Compilations per expression: %d\n", nCompile);
+   if (nRepeat > 1)
+   output(pRes, "  - Repetitions per expression: %d (+%d warmup), ranked on median, ties on overlapping 95%% CI\n", nRepeat, nWarmup);
    if (excessive_failure_cnt)
    output(pRes, "  - Number of excessive failures: %d\n", excessive_failure_cnt);
 
@@ -324,6 +466,10 @@ void Shootout(const std::string &sCaption,
 
    output(pRes, "  - IEEE 754 (IEC 559) is %s\n", (std::numeric_limits<double>::is_iec559) ? "Available" : " NOT AVAILABLE");
    output(pRes, "  - %d-bit build\n", sizeof(void*)*8);
+   output(pRes, "  - Timer: %s, resolution %.3f ns, overhead %.3f ns\n",
+          Stopwatch::GetBackendName(),
+          Stopwatch::GetResolution() * 1e9,
+          Stopwatch::GetOverhead() * 1e9);
 
    dump_cpuid(pRes);
 
@@ -359,6 +505,61 @@ void Shootout(const std::string &sCaption,
              pBench->GetFails().size());
    }
 
+   if (nCompile > 0)
+   {
+      std::deque<std::pair<int,std::size_t> > compile_order;
+
+      for (std::size_t i = 0; i < vBenchmarks.size(); ++i)
+      {
+         compile_order.push_back(std::make_pair(vBenchmarks[i]->GetCompilePoints(), i));
+      }
+
+      std::sort(compile_order.begin(),compile_order.end());
+      std::reverse(compile_order.begin(),compile_order.end());
+
+      output(pRes, "\n\nCompile scores:\n");
+      output(pRes,  "  #     Parser                  Type            Points   Score   Avg [us]   Peak [KB]\n");
+      output(pRes,  "  ------------------------------------------------------------------------------------\n");
+
+      for (std::size_t i = 0; i < compile_order.size(); ++i)
+      {
+         const std::size_t j = compile_order[i].second;
+         Benchmark* pBench = vBenchmarks[j];
+
+         output(pRes,  "  %02d\t%-20s\t%-10s\t%6d\t%6d\t%9.3f\t%9.1f\n",
+                i,
+                pBench->GetShortName().c_str(),
+                pBench->GetBaseType().c_str(),
+                pBench->GetCompilePoints(),
+                (int)((pBench->GetCompileScore() / (double)vExpr.size()) * 100.0),
+                vCompileCount[j] ? 1000.0 * vCompileTimeSum[j] / vCompileCount[j] : 0.0,
+                vCompileMemMax[j] / 1024.0);
+      }
+
+      output(pRes, "\n\nExpression caches (cold = compile, warm = cache lookup):\n");
+      output(pRes,  "  Parser                  Cold [us]   Warm [us]    Hits     Misses   Evictions   Size\n");
+      output(pRes,  "  -----------------------------------------------------------------------------------\n");
+
+      for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+      {
+         Benchmark* pBench = vBenchmarks[j];
+
+         ExprCacheStats stats;
+         if (!pBench->GetExprCacheStats(stats) || !vWarmCount[j])
+            continue;
+
+         output(pRes,  "  %-20s\t%9.3f\t%9.3f\t%8d\t%6d\t%6d\t%4d/%d\n",
+                pBench->GetShortName().c_str(),
+                vCompileCount[j] ? 1000.0 * vCompileTimeSum[j] / vCompileCount[j] : 0.0,
+                1000.0 * vWarmTimeSum[j] / vWarmCount[j],
+                (int)stats.hits,
+                (int)stats.misses,
+                (int)stats.evictions,
+                (int)stats.size,
+                (int)stats.capacity);
+      }
+   }
+
    // Dump failures
    if (bHasFailures)
    {
@@ -386,6 +587,36 @@ void Shootout(const std::string &sCaption,
       }
    }
 
+   bool bHasMemo = false;
+   for (std::size_t i = 0; i < vBenchmarks.size(); ++i)
+   {
+      bHasMemo |= (vBenchmarks[i]->GetMemoHits() + vBenchmarks[i]->GetMemoMisses()) > 0;
+   }
+
+   if (bHasMemo)
+   {
+      output(pRes, "\n\nMemoization:\n");
+      output(pRes, "  Parser                        Hits        Misses   Hit rate   Mevals/s\n");
+      output(pRes, "  ---------------------------------------------------------------------\n");
+
+      for (std::size_t i = 0; i < vBenchmarks.size(); ++i)
+      {
+         Benchmark *pBench = vBenchmarks[i];
+         const std::size_t nHits   = pBench->GetMemoHits();
+         const std::size_t nMisses = pBench->GetMemoMisses();
+
+         if (nHits + nMisses == 0)
+            continue;
+
+         output(pRes, "  %-20s  %12lu  %12lu   %7.2f%%   %8.2f\n",
+                pBench->GetShortName().c_str(),
+                (unsigned long)nHits,
+                (unsigned long)nMisses,
+                100.0 * nHits / (double)(nHits + nMisses),
+                pBench->GetMemoThroughput());
+      }
+   }
+
    if (writeResultTable)
    {
       WriteResultTable(pRes,vBenchmarks,vExpr);
@@ -394,7 +625,429 @@ void Shootout(const std::string &sCaption,
    fclose(pRes);
 }
 
-void DoBenchmark(std::vector<Benchmark*> vBenchmarks, std::vector<std::string> vExpr, int iCount)
+void ScalingShootout(const std::string &sCaption,
+                     std::vector<Benchmark*> vBenchmarks,
+                     const ExprCorpus &vExpr,
+                     int iCount,
+                     int nMaxThreads)
+{
+   char outstr[1024] = {0};
+   char file  [1024] = {0};
+   time_t t          = time(NULL);
+
+   sprintf(outstr, "Scaling_%%Y%%m%%d_%%H%%M%%S.txt");
+   strftime(file, sizeof(file), outstr, localtime(&t));
+
+   FILE* pRes = fopen(file, "w");
+   assert(pRes);
+
+   const int nHwThreads = (int)std::thread::hardware_concurrency();
+
+   output(pRes, "Benchmark (Thread scaling for file \"%s\")\n", sCaption.c_str());
+   output(pRes, "Timer: %s (resolution %.3f ns, overhead %.3f ns per measurement)\n",
+          Stopwatch::GetBackendName(),
+          Stopwatch::GetResolution() * 1e9,
+          Stopwatch::GetOverhead() * 1e9);
+   output(pRes, "Threads: 1..%d; hardware threads: %d\n", nMaxThreads, nHwThreads);
+
+   if (nHwThreads > 0 && nMaxThreads > nHwThreads)
+   {
+      output(pRes, "WARNING: More threads than hardware threads, efficiency beyond %d threads is meaningless.\n", nHwThreads);
+   }
+
+   // Sum of the scaling efficiencies per parser and thread count over all expressions
+   // the parser evaluated correctly at every thread count.
+   std::vector<std::vector<double>> vEffSum(vBenchmarks.size(), std::vector<double>(nMaxThreads + 1, 0.0));
+   std::vector<int> vEffCount(vBenchmarks.size(), 0);
+
+   // Memory pool allocations during the threaded runs of each parser.
+   std::vector<PoolStats> vPool(vBenchmarks.size());
+   std::vector<bool> vHasPool(vBenchmarks.size(), false);
+
+   for (std::size_t i = 0; i < vExpr.size(); ++i)
+   {
+      const std::string current_expr = vExpr[i].str();
+
+      output(pRes, "\nExpression %d of %d: \"%s\"\n",
+             (int)(i + 1),
+             vExpr.size(),
+             current_expr.c_str());
+
+      // Single threaded reference result and sum of the first parser.
+      Benchmark *pRefBench = vBenchmarks[0];
+      pRefBench->DoBenchmark(current_expr + " ", iCount);
+      pRefBench->IgnoreLastRate();
+
+      const double fRefResult = pRefBench->GetRes();
+      const double fRefSum    = pRefBench->GetSum();
+
+      if (pRefBench->DidNotEvaluate() || (fRefResult != fRefResult) || std::abs(fRefResult) == std::numeric_limits<double>::infinity())
+      {
+         output(pRes, "WARNING: Expression rejected due to non-numeric result.\n");
+         continue;
+      }
+
+      output(pRes, "     %-20s", "Parser");
+      for (int nThreads = 1; nThreads <= nMaxThreads; ++nThreads)
+      {
+         output(pRes, "   T=%-3d", nThreads);
+      }
+      output(pRes, "   [Mevals/s]  Efficiency\n");
+
+      for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+      {
+         Benchmark* pBench = vBenchmarks[j];
+
+         std::string sExpr = current_expr;
+         pBench->PreprocessExpr(sExpr);
+
+         std::vector<double> vThroughput(nMaxThreads + 1, 0.0);
+         std::string sFail;
+
+         PoolStats poolBefore, poolAfter;
+         pBench->GetPoolStats(poolBefore);
+
+         for (int nThreads = 1; nThreads <= nMaxThreads; ++nThreads)
+         {
+            pBench->DoBenchmarkThreaded(sExpr + " ", iCount, nThreads);
+
+            if (pBench->DidNotEvaluate())
+            {
+               sFail = pBench->GetFailReason();
+               break;
+            }
+
+            if (
+                 !is_equal(pBench->GetRes(), fRefResult) ||
+                 (std::abs(static_cast<long long>(pBench->GetSum()) - static_cast<long long>(fRefSum)) > 5)
+               )
+            {
+               sFail = "incorrect result";
+               break;
+            }
+
+            vThroughput[nThreads] = 0.001 / pBench->GetTime();
+         }
+
+         if (pBench->GetPoolStats(poolAfter))
+         {
+            vHasPool[j] = true;
+            vPool[j].hits        += poolAfter.hits - poolBefore.hits;
+            vPool[j].misses      += poolAfter.misses - poolBefore.misses;
+            vPool[j].remoteFrees += poolAfter.remoteFrees - poolBefore.remoteFrees;
+            vPool[j].live         = poolAfter.live;
+            vPool[j].peakLive     = poolAfter.peakLive;
+            vPool[j].bytes        = poolAfter.bytes;
+            vPool[j].pools        = poolAfter.pools;
+         }
+
+         output(pRes, "     %-20s", pBench->GetShortName().c_str());
+
+         if (!sFail.empty())
+         {
+            output(pRes, "   (%s)\n", sFail.c_str());
+            continue;
+         }
+
+         for (int nThreads = 1; nThreads <= nMaxThreads; ++nThreads)
+         {
+            output(pRes, " %8.2f", vThroughput[nThreads]);
+            vEffSum[j][nThreads] += vThroughput[nThreads] / (nThreads * vThroughput[1]);
+         }
+
+         ++vEffCount[j];
+
+         output(pRes, "   %10.1f%%\n", 100.0 * vThroughput[nMaxThreads] / (nMaxThreads * vThroughput[1]));
+      }
+   }
+
+   output(pRes, "\n\nBenchmark settings:\n");
+   output(pRes, "  - Expressions File is \"%s\"\n"   , sCaption.c_str());
+   output(pRes, "  - Reference parser is %s\n"       , vBenchmarks[0]->GetShortName().c_str());
+   output(pRes, "  - Iterations per expression and thread: %d\n", iCount);
+   output(pRes, "  - Number of expressions: %d\n"    , vExpr.size());
+   output(pRes, "  - Maximum number of threads: %d\n", nMaxThreads);
+
+   dump_cpuid(pRes);
+
+   // An engine whose throughput at nMaxThreads stays below half of the ideal linear
+   // speedup most likely serializes on shared state (locks, allocator, false sharing).
+   output(pRes, "\n\nMean scaling efficiency (throughput at T threads / (T * throughput at 1 thread)):\n");
+   output(pRes, "  %-20s", "Parser");
+   for (int nThreads = 1; nThreads <= nMaxThreads; ++nThreads)
+   {
+      output(pRes, "  T=%-4d", nThreads);
+   }
+   output(pRes, "\n");
+
+   for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+   {
+      output(pRes, "  %-20s", vBenchmarks[j]->GetShortName().c_str());
+
+      if (vEffCount[j] == 0)
+      {
+         output(pRes, "  n/a\n");
+         continue;
+      }
+
+      for (int nThreads = 1; nThreads <= nMaxThreads; ++nThreads)
+      {
+         output(pRes, " %5.1f%%", 100.0 * vEffSum[j][nThreads] / vEffCount[j]);
+      }
+
+      const double fEff = vEffSum[j][nMaxThreads] / vEffCount[j];
+      output(pRes, "%s\n", (nMaxThreads > 1 && fEff < 0.5) ? "  <-- serializes" : "");
+   }
+
+   if (std::find(vHasPool.begin(), vHasPool.end(), true) != vHasPool.end())
+   {
+      // Hits, misses and remote frees are counted during the parser's own runs, the other
+      // columns are process wide totals afterwards.
+      output(pRes, "\n\nMemory pools (allocations during the threaded runs):\n");
+      output(pRes, "  Parser                      Hits      Misses   Remote frees     Live   Peak live   Pools   Memory [kB]\n");
+      output(pRes, "  ---------------------------------------------------------------------------------------------------\n");
+
+      for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+      {
+         if (!vHasPool[j])
+            continue;
+
+         output(pRes, "  %-20s\t%10d\t%8d\t%8d\t%6d\t%8d\t%4d\t%9.1f\n",
+                vBenchmarks[j]->GetShortName().c_str(),
+                (int)vPool[j].hits,
+                (int)vPool[j].misses,
+                (int)vPool[j].remoteFrees,
+                (int)vPool[j].live,
+                (int)vPool[j].peakLive,
+                (int)vPool[j].pools,
+                vPool[j].bytes / 1024.0);
+      }
+   }
+
+   fclose(pRes);
+}
+
+void StartupShootout(const std::string &sCaption,
+                     std::vector<Benchmark*> vBenchmarks,
+                     const ExprCorpus &vExpr,
+                     int nFormulas)
+{
+   char outstr[1024] = {0};
+   char file  [1024] = {0};
+   time_t t          = time(NULL);
+
+   sprintf(outstr, "Startup_%%Y%%m%%d_%%H%%M%%S.txt");
+   strftime(file, sizeof(file), outstr, localtime(&t));
+
+   FILE* pRes = fopen(file, "w");
+   assert(pRes);
+
+   output(pRes, "Benchmark (Startup with %d formulas of file \"%s\")\n", nFormulas, sCaption.c_str());
+   output(pRes, "Timer: %s (resolution %.3f ns, overhead %.3f ns per measurement)\n",
+          Stopwatch::GetBackendName(),
+          Stopwatch::GetResolution() * 1e9,
+          Stopwatch::GetOverhead() * 1e9);
+
+   // An application starting with nFormulas formulas; the file is repeated if it is shorter.
+   std::vector<std::string> vFormulas(nFormulas);
+   for (int i = 0; i < nFormulas; ++i)
+   {
+      vFormulas[i] = vExpr[i % vExpr.size()].str();
+   }
+
+   output(pRes, "\nCold = compile and optimize every formula, warm = restore the stored compiled forms.\n");
+   output(pRes, "  Parser                 Cold [ms]   Save [ms]   Warm [ms]   Speedup   Size [KB]   Failed   Mismatch\n");
+   output(pRes, "  ---------------------------------------------------------------------------------------------------\n");
+
+   for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+   {
+      Benchmark* pBench = vBenchmarks[j];
+
+      std::vector<std::string> vPreprocessed(vFormulas);
+      for (std::size_t i = 0; i < vPreprocessed.size(); ++i)
+      {
+         pBench->PreprocessExpr(vPreprocessed[i]);
+         vPreprocessed[i] += " ";
+      }
+
+      char tmp[64] = {0};
+      sprintf(tmp, "Startup_%d.tmp", (int)j);
+
+      const StartupResult res = pBench->DoStartupBenchmark(vPreprocessed, tmp);
+      std::remove(tmp);
+
+      if (!res.supported)
+         continue;
+
+      output(pRes, "  %-20s\t%9.3f\t%9.3f\t%9.3f\t%7.1fx\t%9.1f\t%6d\t%6d\n",
+             pBench->GetShortName().c_str(),
+             res.coldTime,
+             res.saveTime,
+             res.warmTime,
+             (res.warmTime > 0) ? res.coldTime / res.warmTime : 0.0,
+             res.bytes / 1024.0,
+             (int)res.failed,
+             (int)res.mismatches);
+   }
+
+   fclose(pRes);
+}
+
+void FootprintShootout(const std::string &sCaption,
+                       std::vector<Benchmark*> vBenchmarks,
+                       const ExprCorpus &vExpr,
+                       int nFormulas)
+{
+   char outstr[1024] = {0};
+   char file  [1024] = {0};
+   time_t t          = time(NULL);
+
+   sprintf(outstr, "Footprint_%%Y%%m%%d_%%H%%M%%S.txt");
+   strftime(file, sizeof(file), outstr, localtime(&t));
+
+   FILE* pRes = fopen(file, "w");
+   assert(pRes);
+
+   output(pRes, "Benchmark (Memory footprint of %d compiled formulas of file \"%s\")\n", nFormulas, sCaption.c_str());
+
+   if (!MemoryCounter::IsAvailable())
+      output(pRes, "Heap accounting is not available in this build, sizes are not reported.\n");
+
+   // The file is repeated if it is shorter.
+   std::vector<std::string> vFormulas(nFormulas);
+   for (int i = 0; i < nFormulas; ++i)
+   {
+      vFormulas[i] = vExpr[i % vExpr.size()].str();
+   }
+
+   output(pRes, "\nHeap held by all compiled formulas at the same time, compile and a single evaluation\n");
+   output(pRes, "of every formula in ms. Engines computing the same values report the same sum.\n");
+   output(pRes, "  Parser                 Heap [KB]   Per formula [B]   Compile [ms]   Eval [ms]   Failed   Sum\n");
+   output(pRes, "  ---------------------------------------------------------------------------------------------------\n");
+
+   for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+   {
+      Benchmark* pBench = vBenchmarks[j];
+
+      std::vector<std::string> vPreprocessed(vFormulas);
+      for (std::size_t i = 0; i < vPreprocessed.size(); ++i)
+      {
+         pBench->PreprocessExpr(vPreprocessed[i]);
+         vPreprocessed[i] += " ";
+      }
+
+      const FootprintResult res = pBench->DoFootprintBenchmark(vPreprocessed);
+
+      if (!res.supported)
+         continue;
+
+      const std::size_t nHeld = res.formulas - res.failed;
+
+      output(pRes, "  %-20s\t%9.1f\t%9.1f\t%9.3f\t%9.3f\t%6d\t%.10g\n",
+             pBench->GetShortName().c_str(),
+             res.bytes / 1024.0,
+             (nHeld > 0) ? res.bytes / (double)nHeld : 0.0,
+             res.compileTime,
+             res.evalTime,
+             (int)res.failed,
+             res.sum);
+   }
+
+   fclose(pRes);
+}
+
+void GradientShootout(const std::string &sCaption,
+                      std::vector<Benchmark*> vBenchmarks,
+                      const ExprCorpus &vExpr,
+                      int iCount)
+{
+   char outstr[1024] = {0};
+   char file  [1024] = {0};
+   time_t t          = time(NULL);
+
+   sprintf(outstr, "Gradient_%%Y%%m%%d_%%H%%M%%S.txt");
+   strftime(file, sizeof(file), outstr, localtime(&t));
+
+   FILE* pRes = fopen(file, "w");
+   assert(pRes);
+
+   output(pRes, "Benchmark (Value and gradient of the expressions of file \"%s\", %d iterations)\n", sCaption.c_str(), iCount);
+   output(pRes, "Timer: %s (resolution %.3f ns, overhead %.3f ns per measurement)\n",
+          Stopwatch::GetBackendName(),
+          Stopwatch::GetResolution() * 1e9,
+          Stopwatch::GetOverhead() * 1e9);
+
+   output(pRes, "\nAD = value and all partial derivatives in one automatic differentiation sweep,\n");
+   output(pRes, "symbolic = value and every symbolic derivative evaluated separately.\n");
+
+   for (std::size_t j = 0; j < vBenchmarks.size(); ++j)
+   {
+      Benchmark* pBench = vBenchmarks[j];
+
+      bool bHeader = false;
+      int nFailed = 0;
+      int nMismatch = 0;
+      double fTotalAD = 0;
+      double fTotalSymbolic = 0;
+
+      for (std::size_t i = 0; i < vExpr.size(); ++i)
+      {
+         std::string sExpr = vExpr[i].str();
+         pBench->PreprocessExpr(sExpr);
+         sExpr += " ";
+
+         const GradientResult res = pBench->DoGradientBenchmark(sExpr, iCount);
+
+         if (!res.supported)
+            break;
+
+         if (!bHeader)
+         {
+            output(pRes, "\n%s, %d partial derivatives per iteration\n", pBench->GetName().c_str(), res.variables);
+            output(pRes, "  AD [ns]   Symbolic [ns]   Speedup   Deviation   Expression\n");
+            output(pRes, "  ---------------------------------------------------------------------------------------------------\n");
+            bHeader = true;
+         }
+
+         if (!res.failReason.empty())
+         {
+            output(pRes, "  failed: %s\t%.*s\n", res.failReason.c_str(), vExpr[i].length(), vExpr[i].data);
+            ++nFailed;
+            continue;
+         }
+
+         // Partial derivatives agreeing to this relative precision are taken as equal.
+         if (res.deviation > 1e-9)
+            ++nMismatch;
+
+         fTotalAD += res.adTime;
+         fTotalSymbolic += res.symbolicTime;
+
+         output(pRes, "  %7.1f\t%9.1f\t%7.2fx\t%9.2e\t%.*s\n",
+                res.adTime * 1e6 / iCount,
+                res.symbolicTime * 1e6 / iCount,
+                (res.adTime > 0) ? res.symbolicTime / res.adTime : 0.0,
+                res.deviation,
+                vExpr[i].length(),
+                vExpr[i].data);
+      }
+
+      if (!bHeader)
+         continue;
+
+      output(pRes, "  ---------------------------------------------------------------------------------------------------\n");
+      output(pRes, "  Total: AD %.3f ms, symbolic %.3f ms, speedup %.2fx, %d failed, %d mismatches\n",
+             fTotalAD,
+             fTotalSymbolic,
+             (fTotalAD > 0) ? fTotalSymbolic / fTotalAD : 0.0,
+             nFailed,
+             nMismatch);
+   }
+
+   fclose(pRes);
+}
+
+void DoBenchmark(std::vector<Benchmark*> vBenchmarks, const ExprCorpus &vExpr, int iCount)
 {
    for (std::size_t i = 0; i < vBenchmarks.size(); ++i)
    {
@@ -417,6 +1070,17 @@ int main(int argc, const char *argv[])
    int iCount = 10000000;
 
    bool writeResultTable = false;
+   int nRepeat = 1;
+   int nWarmup = 0;
+   int nThreads = 0;
+   int nStartup = 0;
+   int nFootprint = 0;
+   int nCompile = 0;
+   bool bBatch = false;
+   bool bMemo = false;
+   bool bGradient = false;
+   bool bFlat = false;
+   simd_level_t eSimd = detect_simd_level();
 
    const std::string benchmark_file_set[] =
                      {
@@ -435,6 +1099,31 @@ int main(int argc, const char *argv[])
    // 1. ParserBench
    // 2. ParserBench <num iterations>
    // 3. ParserBench <num iterations> <benchmark expression file>
+   // 4. ParserBench <num iterations> <benchmark expression file> [options]
+   //
+   // Options:
+   //    write_table         - append the table of evaluation rates to the result file
+   //    timer=<name>        - force the clock source: tsc, monotonic or gettimeofday
+   //                          (default: invariant TSC if available, else monotonic)
+   //    repeat=<n>          - time every expression n times per parser and rank on the median
+   //    warmup=<n>          - number of discarded runs preceding the repetitions
+   //    compile=<n>         - additionally time n compilations of every expression per parser
+   //                          and rank the parsers on compile time; parsers with an
+   //                          expression cache also report the warm (cached) time
+   //    threads=<n>         - run the thread scaling benchmark on 1..n threads instead of
+   //                          the shootout
+   //    startup=<n>         - instead of the shootout compare compiling n formulas of the file
+   //                          with restoring their stored compiled forms
+   //    footprint=<n>       - instead of the shootout report the heap taken by n compiled
+   //                          formulas of the file held at the same time
+   //    batch               - evaluate all iterations as one batch of rows through
+   //                          DoBenchmarkBatch instead of the scalar loop
+   //    gradient            - instead of the shootout compare computing value and gradient of
+   //                          every expression by automatic and by symbolic differentiation
+   //    simd=<level>        - limit the muparser block kernels to none, avx2 or avx512
+   //                          (default: widest instruction set supported by the CPU)
+   //    flat                - also run "ExprTk (flat)", which is not yet faster than the
+   //                          node tree on bench_expr_extensive.txt
 
    if (argc >= 2)
    {
@@ -446,14 +1135,98 @@ int main(int argc, const char *argv[])
       benchmark_file = argv[2];
    }
 
-   if ((argc >= 4) && (std::string(argv[3]) == "write_table"))
+   Stopwatch::SelectBestBackend();
+
+   for (int i = 3; i < argc; ++i)
    {
-      writeResultTable = true;
+      const std::string sOpt = argv[i];
+
+      if (sOpt == "write_table")
+      {
+         writeResultTable = true;
+      }
+      else if (sOpt == "batch")
+      {
+         bBatch = true;
+      }
+      else if (sOpt == "memo")
+      {
+         bMemo = true;
+      }
+      else if (sOpt == "gradient")
+      {
+         bGradient = true;
+      }
+      else if (sOpt == "flat")
+      {
+         bFlat = true;
+      }
+      else if (sOpt.compare(0, 5, "simd=") == 0)
+      {
+         const std::string sSimd = sOpt.substr(5);
+
+         simd_level_t eLimit = SIMD_NONE;
+
+         if (sSimd == "avx512")
+            eLimit = SIMD_AVX512;
+         else if (sSimd == "avx2")
+            eLimit = SIMD_AVX2;
+         else if (sSimd != "none")
+            std::cout << "WARNING - Unknown SIMD level \"" << sSimd << "\", using none\n";
+
+         eSimd = std::min(eSimd, eLimit);
+      }
+      else if (sOpt.compare(0, 7, "repeat=") == 0)
+      {
+         nRepeat = std::max(1, atoi(sOpt.c_str() + 7));
+      }
+      else if (sOpt.compare(0, 7, "warmup=") == 0)
+      {
+         nWarmup = std::max(0, atoi(sOpt.c_str() + 7));
+      }
+      else if (sOpt.compare(0, 8, "compile=") == 0)
+      {
+         nCompile = std::max(0, atoi(sOpt.c_str() + 8));
+      }
+      else if (sOpt.compare(0, 8, "threads=") == 0)
+      {
+         nThreads = std::max(1, atoi(sOpt.c_str() + 8));
+      }
+      else if (sOpt.compare(0, 8, "startup=") == 0)
+      {
+         nStartup = std::max(1, atoi(sOpt.c_str() + 8));
+      }
+      else if (sOpt.compare(0, 10, "footprint=") == 0)
+      {
+         nFootprint = std::max(1, atoi(sOpt.c_str() + 10));
+      }
+      else if (sOpt.compare(0, 6, "timer=") == 0)
+      {
+         const std::string sTimer = sOpt.substr(6);
+
+         bool bOk = true;
+
+         if (sTimer == "tsc")
+            bOk = Stopwatch::SelectBackend(Stopwatch::TSC);
+         else if (sTimer == "monotonic")
+            bOk = Stopwatch::SelectBackend(Stopwatch::MONOTONIC_RAW);
+         else if (sTimer == "gettimeofday")
+            bOk = Stopwatch::SelectBackend(Stopwatch::GETTIMEOFDAY);
+         else
+            bOk = false;
+
+         if (!bOk)
+         {
+            std::cout << "WARNING - Timer \"" << sTimer << "\" not available, using " << Stopwatch::GetBackendName() << "\n";
+         }
+      }
    }
 
-   std::vector<std::string> vExpr = load_expressions(benchmark_file);
+   // Mapped, the expressions are views into the file. Its line index is cached in
+   // <benchmark_file>.idx.
+   ExprCorpus vExpr;
 
-   if (vExpr.empty())
+   if (!vExpr.Load(benchmark_file) || vExpr.empty())
    {
       std::cout << "ERROR - Failed to load any expressions!\n";
       return 1;
@@ -469,27 +1242,67 @@ int main(int argc, const char *argv[])
    //
 
    vBenchmarks.push_back(new BenchExprTk()          );  // <-- Note: first parser becomes the reference!
-   vBenchmarks.push_back(new BenchMuParser2(false)  );
-   vBenchmarks.push_back(new BenchMuParser2(true)   );
+   vBenchmarks.push_back(new BenchExprTk(BenchExprTk::ARENA));
+   vBenchmarks.push_back(new BenchExprTk(BenchExprTk::BATCH));
+   vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::STANDARD));
+   vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::BULK)    );
+   vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::BLOCK, eSimd));
+   vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::JIT)     );
+   vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::REGCODE) );
    vBenchmarks.push_back(new BenchMuParserX()       );
+   vBenchmarks.push_back(new BenchMuParserX(true)   );
    vBenchmarks.push_back(new BenchATMSP()           );
+   vBenchmarks.push_back(new BenchATMSP(true)       );
    vBenchmarks.push_back(new BenchLepton()          );
+   vBenchmarks.push_back(new BenchLepton(true)      );
    vBenchmarks.push_back(new BenchFParser()         );
+   vBenchmarks.push_back(new BenchFParser(true)     );
    vBenchmarks.push_back(new BenchMathExpr()        );
+   vBenchmarks.push_back(new BenchMathExpr(true)    );
    #if defined(_MSC_VER) && defined(NDEBUG)
    vBenchmarks.push_back(new BenchMTParser()        ); // <-- Crash in debug mode
    #endif
 
-   #ifdef _MSC_VER
+   #if defined(_MSC_VER) || (defined(__x86_64__) && defined(__linux__))
    vBenchmarks.push_back(new BenchMuParserSSE());
    #endif
    vBenchmarks.push_back(new BenchExprTkFloat());
 
+   if (bMemo)
+   {
+      vBenchmarks.push_back(new BenchExprTk(BenchExprTk::MEMO));
+      vBenchmarks.push_back(new BenchMuParser2(BenchMuParser2::MEMO));
+   }
+
+   if (bFlat)
+   {
+      vBenchmarks.push_back(new BenchExprTk(BenchExprTk::FLAT));
+   }
+
    #ifdef ENABLE_MPFR
    vBenchmarks.push_back(new BenchExprTkMPFR ());
    #endif
 
-   Shootout(benchmark_file, vBenchmarks, vExpr, iCount, writeResultTable);
+   if (nStartup > 0)
+   {
+      StartupShootout(benchmark_file, vBenchmarks, vExpr, nStartup);
+   }
+   else if (nFootprint > 0)
+   {
+      FootprintShootout(benchmark_file, vBenchmarks, vExpr, nFootprint);
+   }
+   else if (bGradient)
+   {
+      GradientShootout(benchmark_file, vBenchmarks, vExpr, iCount);
+   }
+   else if (nThreads > 0)
+   {
+      ScalingShootout(benchmark_file, vBenchmarks, vExpr, iCount, nThreads);
+   }
+   else
+   {
+      Shootout(benchmark_file, vBenchmarks, vExpr, iCount, writeResultTable, nRepeat, nWarmup, nCompile, bBatch);
+   }
 
    for (std::size_t i = 0; i < vBenchmarks.size(); ++i)
    {
@@ -0,0 +1,102 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+//-------------------------------------------------------------------------------------------------
+SampleStats::SampleStats()
+: n(0),
+  median(0),
+  mad(0),
+  ci_lo(0),
+  ci_hi(0)
+{}
+
+//-------------------------------------------------------------------------------------------------
+bool SampleStats::Overlaps(const SampleStats &other) const
+{
+   return (ci_lo <= other.ci_hi) && (other.ci_lo <= ci_hi);
+}
+
+//-------------------------------------------------------------------------------------------------
+double Median(std::vector<double> v)
+{
+   if (v.empty())
+      return 0;
+
+   const std::size_t mid = v.size() / 2;
+   std::nth_element(v.begin(), v.begin() + mid, v.end());
+
+   if (v.size() & 1)
+      return v[mid];
+
+   const double hi = v[mid];
+   const double lo = *std::max_element(v.begin(), v.begin() + mid);
+   return 0.5 * (lo + hi);
+}
+
+//-------------------------------------------------------------------------------------------------
+double MedianAbsDeviation(const std::vector<double> &v, double fMedian)
+{
+   std::vector<double> dev(v.size());
+
+   for (std::size_t i = 0; i < v.size(); ++i)
+   {
+      dev[i] = std::abs(v[i] - fMedian);
+   }
+
+   return Median(dev);
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Median, MAD and a percentile bootstrap confidence interval of the median.
+
+  The resampling uses a fixed seed so that a given set of samples always yields the same
+  interval and reruns of a shootout rank identically.
+*/
+SampleStats ComputeStats(const std::vector<double> &vSamples, double fConfidence, int nResamples)
+{
+   SampleStats stats;
+
+   stats.n = vSamples.size();
+
+   if (vSamples.empty())
+      return stats;
+
+   stats.median = Median(vSamples);
+   stats.mad    = MedianAbsDeviation(vSamples, stats.median);
+   stats.ci_lo  = stats.median;
+   stats.ci_hi  = stats.median;
+
+   if (vSamples.size() < 2 || nResamples < 1)
+      return stats;
+
+   std::mt19937 rng(5489u);
+   std::uniform_int_distribution<std::size_t> pick(0, vSamples.size() - 1);
+
+   std::vector<double> vMedians(nResamples);
+   std::vector<double> vResample(vSamples.size());
+
+   for (int i = 0; i < nResamples; ++i)
+   {
+      for (std::size_t k = 0; k < vResample.size(); ++k)
+      {
+         vResample[k] = vSamples[pick(rng)];
+      }
+
+      vMedians[i] = Median(vResample);
+   }
+
+   std::sort(vMedians.begin(), vMedians.end());
+
+   const double alpha = 0.5 * (1.0 - fConfidence);
+   const std::size_t lo = (std::size_t)std::floor(alpha * (nResamples - 1));
+   const std::size_t hi = (std::size_t)std::ceil((1.0 - alpha) * (nResamples - 1));
+
+   stats.ci_lo = vMedians[lo];
+   stats.ci_hi = vMedians[hi];
+
+   return stats;
+}
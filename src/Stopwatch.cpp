@@ -1,2 +1,214 @@
 #include "Stopwatch.h"
 
+#include <algorithm>
+
+#ifndef WIN32
+#include "libcpuid/libcpuid.h"
+#endif
+
+
+#ifdef WIN32
+Stopwatch::EBackend Stopwatch::s_eBackend    = Stopwatch::QPC;
+#else
+Stopwatch::EBackend Stopwatch::s_eBackend    = Stopwatch::GETTIMEOFDAY;
+#endif
+double              Stopwatch::s_fSecPerTick = 0.000001;
+double              Stopwatch::s_fOverhead   = 0;
+
+namespace
+{
+#ifndef WIN32
+   inline unsigned long long int monotonic_raw_ns()
+   {
+      struct timespec ts;
+      #ifdef CLOCK_MONOTONIC_RAW
+      clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+      #else
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      #endif
+      return 1000000000ULL * (unsigned long long int)ts.tv_sec + (unsigned long long int)ts.tv_nsec;
+   }
+
+   // The TSC is only usable as a wall clock if it ticks at a constant rate regardless of
+   // P-/C-states: CPUID.80000007H:EDX[8] ("invariant TSC").
+   bool has_invariant_tsc()
+   {
+      if (!cpuid_present())
+         return false;
+
+      struct cpu_raw_data_t raw;
+      if (cpuid_get_raw_data(&raw) < 0)
+         return false;
+
+      if (raw.ext_cpuid[0][0] < 0x80000007)
+         return false;
+
+      return (raw.ext_cpuid[7][3] & (1 << 8)) != 0;
+   }
+
+   // Returns seconds per TSC tick measured against CLOCK_MONOTONIC_RAW; median of 5 runs
+   // of 20 ms each.
+   double calibrate_tsc()
+   {
+      double period[5];
+
+      for (int i = 0; i < 5; ++i)
+      {
+         uint64_t c0, c1;
+         unsigned long long int t0 = monotonic_raw_ns(), t1;
+
+         cpu_rdtsc(&c0);
+         do
+         {
+            t1 = monotonic_raw_ns();
+         }
+         while (t1 - t0 < 20000000ULL);
+         cpu_rdtsc(&c1);
+
+         if (c1 <= c0)
+            return 0;
+
+         period[i] = (t1 - t0) * 1e-9 / (double)(c1 - c0);
+      }
+
+      std::sort(period, period + 5);
+      return period[2];
+   }
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+unsigned long long int Stopwatch::ticks()
+{
+#ifdef WIN32
+   LARGE_INTEGER t;
+   QueryPerformanceCounter(&t);
+   return (unsigned long long int)t.QuadPart;
+#else
+   switch (s_eBackend)
+   {
+      case TSC:
+         {
+            uint64_t t;
+            cpu_rdtsc(&t);
+            return t;
+         }
+
+      case MONOTONIC_RAW:
+         return monotonic_raw_ns();
+
+      default:
+         {
+            struct timeval tv;
+            gettimeofday(&tv, 0);
+            return 1000000ULL * (unsigned long long int)tv.tv_sec + (unsigned long long int)tv.tv_usec;
+         }
+   }
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Returns the average cost of one Start()/Stop() pair in seconds. */
+double Stopwatch::MeasureOverhead()
+{
+   const int nPairs = 100000;
+
+   Stopwatch sw, total;
+   total.Start();
+   for (int i = 0; i < nPairs; ++i)
+   {
+      sw.Start();
+      sw.Stop();
+   }
+   total.Stop();
+
+   return total.time() / nPairs;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Switch all stopwatches to the given clock source.
+
+  Must be called before any timing starts. Returns false and leaves the current backend in
+  place if the requested clock is not available on this machine.
+*/
+bool Stopwatch::SelectBackend(EBackend eBackend)
+{
+#ifdef WIN32
+   if (eBackend != QPC)
+      return false;
+
+   LARGE_INTEGER freq;
+   QueryPerformanceFrequency(&freq);
+   s_fSecPerTick = 1.0 / (double)freq.QuadPart;
+#else
+   double fSecPerTick = 0;
+
+   switch (eBackend)
+   {
+      case GETTIMEOFDAY:  fSecPerTick = 1e-6; break;
+      case MONOTONIC_RAW: fSecPerTick = 1e-9; break;
+      case TSC:
+         if (has_invariant_tsc())
+            fSecPerTick = calibrate_tsc();
+         break;
+      default:
+         break;
+   }
+
+   if (fSecPerTick <= 0)
+      return false;
+
+   s_fSecPerTick = fSecPerTick;
+#endif
+
+   s_eBackend = eBackend;
+   s_fOverhead = MeasureOverhead();
+   return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Select the most precise clock available: invariant TSC, then MONOTONIC_RAW. */
+Stopwatch::EBackend Stopwatch::SelectBestBackend()
+{
+#ifdef WIN32
+   SelectBackend(QPC);
+#else
+   if (!SelectBackend(TSC))
+      SelectBackend(MONOTONIC_RAW);
+#endif
+
+   return s_eBackend;
+}
+
+//-------------------------------------------------------------------------------------------------
+Stopwatch::EBackend Stopwatch::GetBackend()
+{
+   return s_eBackend;
+}
+
+//-------------------------------------------------------------------------------------------------
+const char* Stopwatch::GetBackendName()
+{
+   switch (s_eBackend)
+   {
+      case GETTIMEOFDAY:  return "gettimeofday";
+      case MONOTONIC_RAW: return "clock_gettime(CLOCK_MONOTONIC_RAW)";
+      case TSC:           return "invariant TSC";
+      case QPC:           return "QueryPerformanceCounter";
+      default:            return "unknown";
+   }
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Duration of a single clock tick in seconds. */
+double Stopwatch::GetResolution()
+{
+   return s_fSecPerTick;
+}
+
+//-------------------------------------------------------------------------------------------------
+/** \brief Cost of one Start()/Stop() pair in seconds, measured when the backend was selected. */
+double Stopwatch::GetOverhead()
+{
+   return s_fOverhead;
+}
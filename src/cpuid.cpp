@@ -5,6 +5,26 @@
 
 #include "libcpuid/libcpuid.h"
 
+#ifdef _MSC_VER
+#include <immintrin.h>
+#endif
+
+namespace
+{
+   // XCR0 tells which register files the OS saves on a context switch, a CPU feature
+   // is only usable if its registers are among them.
+   unsigned long long read_xcr0()
+   {
+   #ifdef _MSC_VER
+      return _xgetbv(0);
+   #else
+      unsigned int eax, edx;
+      __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0)); // xgetbv
+      return ((unsigned long long)edx << 32) | eax;
+   #endif
+   }
+}
+
 void dump_cpuid(FILE* file)
 {
    if (0 == file)
@@ -48,6 +68,7 @@ void dump_cpuid(FILE* file)
    if (-1 != data.l3_cacheline)
    fprintf(file, "  - L3 line size  : %d bytes\n", data.l3_cacheline);
    fprintf(file, "  - CPU clock     : %d MHz\n",         cpu_clock());
+   fprintf(file, "  - SIMD level    : %s\n", simd_level_str(detect_simd_level()));
    fprintf(file, "  - Features      : ");
 
    std::deque<std::string> feature_list;
@@ -80,3 +101,54 @@ void dump_cpuid(FILE* file)
    fflush(file);
 }
 
+
+/** \brief Widest vector instruction set usable by the muparser block kernels.
+
+  Leaf 7 has to be queried with subleaf 0, which cpuid_get_raw_data does not guarantee, and
+  the OS must have enabled the AVX (and for AVX-512 the opmask and ZMM) register state.
+*/
+simd_level_t detect_simd_level()
+{
+   if (!cpuid_present())
+      return SIMD_NONE;
+
+   uint32_t regs[4] = { 0, 0, 0, 0 };
+   cpu_exec_cpuid(0, regs);
+
+   if (regs[0] < 7)
+      return SIMD_NONE;
+
+   cpu_exec_cpuid(1, regs);
+
+   const bool osxsave = (regs[2] & (1u << 27)) != 0;
+   const bool avx     = (regs[2] & (1u << 28)) != 0;
+
+   if (!osxsave || !avx)
+      return SIMD_NONE;
+
+   const unsigned long long xcr0 = read_xcr0();
+
+   if ((xcr0 & 0x06) != 0x06)
+      return SIMD_NONE;
+
+   uint32_t leaf7[4] = { 7, 0, 0, 0 };
+   cpu_exec_cpuid_ext(leaf7);
+
+   if ((leaf7[1] & (1u << 16)) && ((xcr0 & 0xE6) == 0xE6))
+      return SIMD_AVX512;
+
+   if (leaf7[1] & (1u << 5))
+      return SIMD_AVX2;
+
+   return SIMD_NONE;
+}
+
+const char* simd_level_str(simd_level_t level)
+{
+   switch (level)
+   {
+      case SIMD_AVX2:   return "AVX2";
+      case SIMD_AVX512: return "AVX-512";
+      default:          return "none";
+   }
+}